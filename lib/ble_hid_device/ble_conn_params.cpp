@@ -0,0 +1,130 @@
+#include <string.h>
+#include "ble_conn_params.h"
+
+/**
+ * @brief 7.5 ms without latency while active, 30-50 ms with 4 skipped events
+ * after 5 s without input
+ */
+void ble_conn_policy_default(ble_conn_policy_t* policy) {
+    policy->active.min_interval = 6;
+    policy->active.max_interval = 6;
+    policy->active.latency = 0;
+    policy->active.timeout = 200;
+    policy->idle.min_interval = 24;
+    policy->idle.max_interval = 40;
+    policy->idle.latency = 4;
+    policy->idle.timeout = 400;
+    policy->idle_after_us = 5000000;
+    policy->retry_us = 5000000;
+}
+
+void ble_conn_manager_init(ble_conn_manager_t* mgr, const ble_conn_policy_t* policy) {
+    memset(mgr, 0, sizeof(*mgr));
+    mgr->policy = *policy;
+}
+
+/**
+ * @brief A central connected, input is assumed so the short interval is requested first
+ *
+ * @param[in] mgr      Manager
+ * @param[in] now_us   Current time
+ * @param[in] granted  Parameters the central chose for the connection
+ */
+void ble_conn_manager_connected(ble_conn_manager_t* mgr, uint32_t now_us,
+                                const ble_conn_granted_t* granted) {
+    mgr->connected = true;
+    mgr->mode = BLE_CONN_MODE_NONE;
+    mgr->pending = false;
+    mgr->next_request_us = now_us;
+    mgr->last_input_us = now_us;
+    mgr->granted = *granted;
+}
+
+void ble_conn_manager_disconnected(ble_conn_manager_t* mgr) {
+    mgr->connected = false;
+    mgr->pending = false;
+    mgr->mode = BLE_CONN_MODE_NONE;
+    memset(&mgr->granted, 0, sizeof(mgr->granted));
+}
+
+/**
+ * @brief Input was sent, called by the transport for every report
+ */
+void ble_conn_manager_input(ble_conn_manager_t* mgr, uint32_t now_us) {
+    mgr->last_input_us = now_us;
+}
+
+static bool granted_matches(const ble_conn_granted_t* granted, const ble_conn_params_t* params) {
+    return granted->interval >= params->min_interval && granted->interval <= params->max_interval &&
+           granted->latency == params->latency;
+}
+
+/**
+ * @brief Decide whether new parameters have to be requested
+ *
+ * Only one request is outstanding at a time. After a rejection, or if the
+ * stack does not answer, the next request waits for retry_us.
+ *
+ * @param[in]  mgr      Manager
+ * @param[in]  now_us   Current time
+ * @param[out] request  Parameters to request from the central
+ * @return true if the request has to be sent
+ */
+bool ble_conn_manager_poll(ble_conn_manager_t* mgr, uint32_t now_us, ble_conn_params_t* request) {
+    const ble_conn_policy_t* policy = &mgr->policy;
+    if (!mgr->connected) return false;
+
+    if (mgr->pending) {
+        if (now_us - mgr->request_us < policy->retry_us) return false;
+        mgr->stats.timeouts++;
+        mgr->pending = false;
+        mgr->mode = BLE_CONN_MODE_NONE;
+    }
+
+    ble_conn_mode_t want = (now_us - mgr->last_input_us < policy->idle_after_us)
+                               ? BLE_CONN_MODE_ACTIVE
+                               : BLE_CONN_MODE_IDLE;
+    if (want == mgr->mode) return false;
+
+    const ble_conn_params_t* params = (want == BLE_CONN_MODE_ACTIVE) ? &policy->active
+                                                                    : &policy->idle;
+    if (granted_matches(&mgr->granted, params)) {
+        mgr->mode = want;  // e.g. the central chose these parameters itself
+        return false;
+    }
+    if ((int32_t)(now_us - mgr->next_request_us) < 0) return false;
+
+    mgr->mode = want;
+    mgr->pending = true;
+    mgr->request_us = now_us;
+    mgr->stats.requests++;
+    *request = *params;
+    return true;
+}
+
+/**
+ * @brief The stack reported new connection parameters, or the result of a request
+ *
+ * @param[in] mgr       Manager
+ * @param[in] now_us    Current time
+ * @param[in] accepted  false if the central rejected the request
+ * @param[in] granted   Parameters in use now
+ */
+void ble_conn_manager_updated(ble_conn_manager_t* mgr, uint32_t now_us, bool accepted,
+                              const ble_conn_granted_t* granted) {
+    if (mgr->pending) {
+        uint32_t duration = now_us - mgr->request_us;
+        mgr->stats.last_update_us = duration;
+        if (duration > mgr->stats.max_update_us) mgr->stats.max_update_us = duration;
+        mgr->pending = false;
+    }
+
+    if (!accepted) {
+        mgr->stats.rejected++;
+        mgr->mode = BLE_CONN_MODE_NONE;
+        mgr->next_request_us = now_us + mgr->policy.retry_us;
+        return;
+    }
+    mgr->stats.updates++;
+    mgr->granted = *granted;
+}
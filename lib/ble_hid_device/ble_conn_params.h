@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+// Units of the connection parameters in the BLE specification
+#define BLE_CONN_INTERVAL_UNIT_US 1250   // interval
+#define BLE_CONN_TIMEOUT_UNIT_US  10000  // supervision timeout
+
+// Parameters requested from the central
+typedef struct {
+    uint16_t min_interval;  // in 1.25 ms
+    uint16_t max_interval;
+    uint16_t latency;       // connection events the peripheral may skip
+    uint16_t timeout;       // supervision timeout in 10 ms
+} ble_conn_params_t;
+
+// Parameters in use, as reported by the BLE stack
+typedef struct {
+    uint16_t interval;  // in 1.25 ms
+    uint16_t latency;
+    uint16_t timeout;   // in 10 ms
+} ble_conn_granted_t;
+
+/**
+ * @brief Latency versus power policy
+ *
+ * Short interval without latency while there is input, longer interval with
+ * slave latency after idle_after_us without input.
+ */
+typedef struct {
+    ble_conn_params_t active;
+    ble_conn_params_t idle;
+    uint32_t idle_after_us;
+    uint32_t retry_us;  // wait after a rejected or unanswered request
+} ble_conn_policy_t;
+
+typedef enum {
+    BLE_CONN_MODE_NONE = 0,
+    BLE_CONN_MODE_ACTIVE,
+    BLE_CONN_MODE_IDLE,
+} ble_conn_mode_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t updates;         // parameter changes reported by the stack
+    uint32_t rejected;
+    uint32_t timeouts;        // requests without an answer within retry_us
+    uint32_t last_update_us;  // from request to update
+    uint32_t max_update_us;
+} ble_conn_stats_t;
+
+/**
+ * @brief Connection parameter manager, independent of the BLE stack
+ *
+ * The transport reports connect, disconnect, input and parameter updates,
+ * and sends the requests returned by ble_conn_manager_poll(). Time is passed
+ * in, so the policy can be driven by a stand-in.
+ */
+typedef struct {
+    ble_conn_policy_t policy;
+    bool connected;
+    ble_conn_mode_t mode;  // mode of the parameters in use or requested
+    bool pending;
+    uint32_t request_us;
+    uint32_t next_request_us;
+    uint32_t last_input_us;
+    ble_conn_granted_t granted;
+    ble_conn_stats_t stats;
+} ble_conn_manager_t;
+
+void ble_conn_policy_default(ble_conn_policy_t* policy);
+void ble_conn_manager_init(ble_conn_manager_t* mgr, const ble_conn_policy_t* policy);
+void ble_conn_manager_connected(ble_conn_manager_t* mgr, uint32_t now_us,
+                                const ble_conn_granted_t* granted);
+void ble_conn_manager_disconnected(ble_conn_manager_t* mgr);
+void ble_conn_manager_input(ble_conn_manager_t* mgr, uint32_t now_us);
+bool ble_conn_manager_poll(ble_conn_manager_t* mgr, uint32_t now_us, ble_conn_params_t* request);
+void ble_conn_manager_updated(ble_conn_manager_t* mgr, uint32_t now_us, bool accepted,
+                              const ble_conn_granted_t* granted);
@@ -0,0 +1,178 @@
+#include <string.h>
+#include "ble_hid_passthrough.h"
+
+/**
+ * @brief Start with an empty report map
+ */
+void ble_passthrough_init(ble_passthrough_config_t* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->version = BLE_PASSTHROUGH_CONFIG_VERSION;
+    cfg->next_ble_id = 1;
+}
+
+/**
+ * @brief Find an interface which is already part of the report map
+ *
+ * @param[in] cfg        Passthrough configuration
+ * @param[in] desc_hash  Hash of the USB report descriptor
+ * @return Interface, or NULL if the descriptor is not part of the report map
+ */
+const ble_passthrough_iface_t* ble_passthrough_find_interface(const ble_passthrough_config_t* cfg,
+                                                              uint32_t desc_hash) {
+    for (int i = 0; i < cfg->iface_count; i++) {
+        if (cfg->ifaces[i].desc_hash == desc_hash) return &cfg->ifaces[i];
+    }
+    return NULL;
+}
+
+// Index of a USB report ID in the translation table, added if not present yet
+static int map_report_id(ble_passthrough_config_t* cfg, ble_passthrough_iface_t* iface,
+                         uint8_t usb_id) {
+    for (int i = 0; i < iface->id_count; i++) {
+        if (iface->usb_ids[i] == usb_id) return i;
+    }
+    if (iface->id_count >= BLE_PASSTHROUGH_MAX_IDS || cfg->next_ble_id == 0) return -1;
+    iface->usb_ids[iface->id_count] = usb_id;
+    iface->ble_ids[iface->id_count] = cfg->next_ble_id++;
+    return iface->id_count++;
+}
+
+/**
+ * @brief Append the report descriptor of a USB interface to the BLE report map
+ *
+ * Report IDs are renumbered so they are unique over all interfaces. A
+ * descriptor without report IDs gets one inserted after its application
+ * collection, as every BLE input report is addressed by its report ID.
+ *
+ * @param[in] cfg        Passthrough configuration
+ * @param[in] desc       USB report descriptor
+ * @param[in] desc_len   Length of the USB report descriptor
+ * @param[in] desc_hash  Hash of the USB report descriptor
+ * @return The new interface, or NULL if the report map has no room for it
+ */
+const ble_passthrough_iface_t* ble_passthrough_add_interface(ble_passthrough_config_t* cfg,
+                                                             const uint8_t* desc, size_t desc_len,
+                                                             uint32_t desc_hash) {
+    if (cfg->iface_count >= BLE_PASSTHROUGH_MAX_IFACES) return NULL;
+
+    // map_len and iface_count are only updated if the whole descriptor fits
+    uint8_t saved_next_id = cfg->next_ble_id;
+    ble_passthrough_iface_t iface;
+    memset(&iface, 0, sizeof(iface));
+    iface.desc_hash = desc_hash;
+
+    // first pass: does the descriptor declare report IDs?
+    for (size_t i = 0; i < desc_len;) {
+        uint8_t b = desc[i++];
+        if (b == 0xFE) {
+            if (i >= desc_len) break;
+            i += 2 + desc[i];
+            continue;
+        }
+        uint8_t size = b & 0x03;
+        if (size == 3) size = 4;
+        if ((b & 0xFC) == 0x84) iface.usb_uses_ids = true;  // Report ID
+        i += size;
+    }
+
+    uint8_t* out = cfg->report_map + cfg->map_len;
+    size_t room = BLE_PASSTHROUGH_MAP_MAX - cfg->map_len;
+    size_t pos = 0;
+    int cur = -1;  // index of the current report ID
+    bool ok = true;
+
+    if (!iface.usb_uses_ids) {
+        cur = map_report_id(cfg, &iface, 0);
+        ok = (cur >= 0);
+    }
+
+    bool id_inserted = iface.usb_uses_ids;
+    for (size_t i = 0; ok && i < desc_len;) {
+        size_t item_start = i;
+        uint8_t b = desc[i++];
+        size_t size;
+        if (b == 0xFE) {
+            if (i >= desc_len) break;
+            size = 2 + desc[i];
+        } else {
+            size = b & 0x03;
+            if (size == 3) size = 4;
+        }
+        if (i + size > desc_len) break;
+
+        uint32_t data = 0;
+        if (b != 0xFE) {
+            for (size_t n = 0; n < size; n++) data |= (uint32_t)desc[i + n] << (8 * n);
+        }
+        i += size;
+
+        if ((b & 0xFC) == 0x84) {
+            // Report ID: renumber, always written as one byte item
+            cur = map_report_id(cfg, &iface, (uint8_t)data);
+            if (cur < 0 || pos + 2 > room) { ok = false; break; }
+            out[pos++] = 0x85;
+            out[pos++] = iface.ble_ids[cur];
+            continue;
+        }
+
+        size_t item_len = i - item_start;
+        if (pos + item_len > room) { ok = false; break; }
+        memcpy(out + pos, desc + item_start, item_len);
+        pos += item_len;
+
+        if ((b & 0xFC) == 0x80 && cur >= 0) {  // Input
+            iface.input_mask |= (uint8_t)(1u << cur);
+        }
+        if (!id_inserted && (b & 0xFC) == 0xA0 && data == 0x01) {  // Collection (Application)
+            if (pos + 2 > room) { ok = false; break; }
+            out[pos++] = 0x85;
+            out[pos++] = iface.ble_ids[cur];
+            id_inserted = true;
+        }
+    }
+
+    if (!ok || iface.id_count == 0) {
+        cfg->next_ble_id = saved_next_id;
+        return NULL;
+    }
+
+    cfg->map_len += (uint16_t)pos;
+    cfg->ifaces[cfg->iface_count] = iface;
+    return &cfg->ifaces[cfg->iface_count++];
+}
+
+/**
+ * @brief Find the BLE report ID and payload of a USB input report
+ *
+ * The payload points into the USB report, nothing is copied: BLE input report
+ * characteristics carry the report without its ID byte.
+ *
+ * @param[in]  iface        Interface the report was received on
+ * @param[in]  data         USB input report
+ * @param[in]  length       Length of the USB input report
+ * @param[out] ble_id       BLE report ID
+ * @param[out] payload      Report data without report ID
+ * @param[out] payload_len  Length of the payload
+ * @return false if the report ID is unknown
+ */
+bool ble_passthrough_translate_report(const ble_passthrough_iface_t* iface,
+                                      const uint8_t* data, size_t length, uint8_t* ble_id,
+                                      const uint8_t** payload, size_t* payload_len) {
+    if (!iface->usb_uses_ids) {
+        *ble_id = iface->ble_ids[0];
+        *payload = data;
+        *payload_len = length;
+        return true;
+    }
+
+    if (length < 1) return false;
+    for (int i = 0; i < iface->id_count; i++) {
+        if (iface->usb_ids[i] == data[0]) {
+            *ble_id = iface->ble_ids[i];
+            *payload = data + 1;
+            *payload_len = length - 1;
+            return true;
+        }
+    }
+    return false;
+}
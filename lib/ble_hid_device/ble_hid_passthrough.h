@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Limits of the combined BLE report map
+#define BLE_PASSTHROUGH_MAX_IFACES 4
+#define BLE_PASSTHROUGH_MAX_IDS    8    // report IDs per interface
+#define BLE_PASSTHROUGH_MAP_MAX    512  // bytes of the combined report map
+
+// Report ID translation of one USB HID interface
+typedef struct {
+    uint32_t desc_hash;     // identifies the USB report descriptor
+    bool usb_uses_ids;      // USB reports start with a report ID byte
+    uint8_t id_count;
+    uint8_t usb_ids[BLE_PASSTHROUGH_MAX_IDS];
+    uint8_t ble_ids[BLE_PASSTHROUGH_MAX_IDS];
+    uint8_t input_mask;     // bit n set if ble_ids[n] has an Input report
+} ble_passthrough_iface_t;
+
+/**
+ * @brief BLE report map built from the USB report descriptors of all forwarded
+ * interfaces, with report IDs made unique over all interfaces
+ */
+typedef struct {
+    uint32_t version;
+    uint8_t iface_count;
+    uint8_t next_ble_id;
+    uint16_t map_len;
+    ble_passthrough_iface_t ifaces[BLE_PASSTHROUGH_MAX_IFACES];
+    uint8_t report_map[BLE_PASSTHROUGH_MAP_MAX];
+} ble_passthrough_config_t;
+
+// Increment when ble_passthrough_config_t changes, so stored configs are ignored
+#define BLE_PASSTHROUGH_CONFIG_VERSION 1
+
+void ble_passthrough_init(ble_passthrough_config_t* cfg);
+const ble_passthrough_iface_t* ble_passthrough_find_interface(const ble_passthrough_config_t* cfg,
+                                                              uint32_t desc_hash);
+const ble_passthrough_iface_t* ble_passthrough_add_interface(ble_passthrough_config_t* cfg,
+                                                             const uint8_t* desc, size_t desc_len,
+                                                             uint32_t desc_hash);
+bool ble_passthrough_translate_report(const ble_passthrough_iface_t* iface,
+                                      const uint8_t* data, size_t length, uint8_t* ble_id,
+                                      const uint8_t** payload, size_t* payload_len);
@@ -0,0 +1,181 @@
+#include <string.h>
+#include "ble_keyboard_report.h"
+#include "usb_hid_device.h"
+
+static ble_keyboard_report_send_t registered_transport = NULL;
+static ble_keyboard_report_credits_t registered_credits = NULL;
+static ble_keyboard_report_stats_t report_stats = {0};
+
+// last snapshot of each keyboard interface, all of them are combined
+static uint8_t source_modifier[HID_KEY_SOURCES];
+static hid_key_bitmap_t source_keys[HID_KEY_SOURCES];
+
+// keys which were pressed but not sent yet, as all slots were in use
+static hid_key_bitmap_t owed_keys;
+
+// last report which was sent to the host
+static ble_keyboard_report_t last_report = {0};
+
+// the combined key state changed, but its report could not be sent yet
+static bool unsent = false;
+
+ble_keyboard_report_stats_t* get_ble_keyboard_report_stats() { return &report_stats; }
+
+/**
+ * @brief Register the function which sends a keyboard input report to the BLE host
+ *
+ * @param[in] send  Transport function, NULL to disable sending
+ */
+void register_ble_keyboard_report_transport(ble_keyboard_report_send_t send) {
+    registered_transport = send;
+}
+
+/**
+ * @brief Register the function which tells how many notifications the BLE stack can take
+ *
+ * Without credits, reports are held back until ble_keyboard_report_flush().
+ *
+ * @param[in] credits  Credit function, NULL to send without checking
+ */
+void register_ble_keyboard_report_credits(ble_keyboard_report_credits_t credits) {
+    registered_credits = credits;
+}
+
+/**
+ * @brief Forget all key state, e.g. after the BLE host disconnected
+ */
+void ble_keyboard_report_reset() {
+    memset(source_modifier, 0, sizeof(source_modifier));
+    memset(source_keys, 0, sizeof(source_keys));
+    hid_key_bitmap_clear(&owed_keys);
+    memset(&last_report, 0, sizeof(last_report));
+    unsent = false;
+}
+
+// Keys and modifiers of all keyboard interfaces
+static uint8_t combine_sources(hid_key_bitmap_t* keys) {
+    uint8_t modifier = 0;
+    hid_key_bitmap_clear(keys);
+    for (int s = 0; s < HID_KEY_SOURCES; s++) {
+        modifier |= source_modifier[s];
+        for (int i = 0; i < HID_KEY_BITMAP_WORDS; i++) keys->w[i] |= source_keys[s].w[i];
+    }
+    return modifier;
+}
+
+/**
+ * @brief Fold the pressed keys into the 6 slots of a report
+ *
+ * Keys stay in their slot while they are pressed. Keys which find no free
+ * slot, or whose report could not be sent, are owed and sent as soon as a
+ * slot becomes free, even if they were released in the meantime, so no key
+ * press is lost.
+ */
+static bool send_folded_report() {
+    hid_key_bitmap_t keys, shown, owed = owed_keys;
+    ble_keyboard_report_t report;
+    memset(&report, 0, sizeof(report));
+    report.modifier = combine_sources(&keys);
+
+    // new key presses which are not in the last report
+    hid_key_bitmap_from_keys(&shown, last_report.keys, BLE_KEYBOARD_REPORT_KEYS);
+    for (int i = 0; i < HID_KEY_BITMAP_WORDS; i++) owed.w[i] |= keys.w[i] & ~shown.w[i];
+    hid_key_bitmap_t unsent_owed = owed;
+
+    for (int n = 0; n < BLE_KEYBOARD_REPORT_KEYS; n++) {
+        uint8_t key = last_report.keys[n];
+        if (key != 0 && hid_key_bitmap_test(&keys, key)) report.keys[n] = key;
+    }
+    int key = hid_key_bitmap_next(&owed, 0);
+    for (int n = 0; n < BLE_KEYBOARD_REPORT_KEYS && key >= 0; n++) {
+        if (report.keys[n] != 0) continue;
+        report.keys[n] = (uint8_t)key;
+        owed.w[key >> 5] &= ~(1u << (key & 31));
+        key = hid_key_bitmap_next(&owed, key + 1);
+    }
+
+    if (memcmp(&report, &last_report, sizeof(report)) == 0) {
+        owed_keys = owed;
+        unsent = false;
+        return true;
+    }
+    if ((registered_credits != NULL && registered_credits() <= 0) ||
+        registered_transport == NULL || !registered_transport(&report)) {
+        // presses of a report which was not sent are owed, even if released before the retry
+        owed_keys = unsent_owed;
+        unsent = true;
+        report_stats.stalls++;
+        return false;
+    }
+
+    owed_keys = owed;
+    last_report = report;
+    unsent = false;
+    report_stats.notifications++;
+    return true;
+}
+
+/**
+ * @brief Send a keyboard snapshot as one 6KRO input report
+ *
+ * Snapshots of all keyboard interfaces are combined. If more keys are pressed
+ * than the report has slots, the keys are folded into the slots over several
+ * reports, see ble_keyboard_report_drain().
+ *
+ * @param[in] keyData  Modifiers and all pressed keys of one keyboard interface
+ * @return true if the report was sent or there was no change to send, false if
+ * it is held back until ble_keyboard_report_flush()
+ */
+bool ble_keyboard_report_submit(const unified_keyData_t* keyData) {
+    if (keyData->source >= HID_KEY_SOURCES) return false;
+    source_modifier[keyData->source] = keyData->modifier;
+    source_keys[keyData->source] = keyData->keys;
+
+    report_stats.snapshots++;
+    if (hid_key_bitmap_count(&keyData->keys) > BLE_KEYBOARD_REPORT_KEYS) report_stats.folded++;
+    return send_folded_report();
+}
+
+/**
+ * @brief Check if a held back report, owed keys or released keys still need a report
+ */
+bool ble_keyboard_report_pending() {
+    if (unsent) return true;
+    hid_key_bitmap_t keys;
+    combine_sources(&keys);
+    bool free_slot = false;
+    for (int n = 0; n < BLE_KEYBOARD_REPORT_KEYS; n++) {
+        uint8_t key = last_report.keys[n];
+        if (key == 0) free_slot = true;
+        else if (!hid_key_bitmap_test(&keys, key)) return true;  // released, still in the report
+    }
+    return free_slot && hid_key_bitmap_next(&owed_keys, 0) >= 0;
+}
+
+/**
+ * @brief Send one more report with released keys removed and owed keys added
+ *
+ * @return false if nothing was pending or the report could not be sent
+ */
+bool ble_keyboard_report_drain() {
+    if (!ble_keyboard_report_pending()) return false;
+    bool retry = unsent;  // the held back report is not an additional one
+    if (!send_folded_report()) return false;
+    if (!retry) report_stats.drain_reports++;
+    return true;
+}
+
+/**
+ * @brief Send the held back report and all reports which are still pending
+ *
+ * Called after every snapshot and by the sender task while it returns false.
+ *
+ * @return true if nothing is pending any more
+ */
+bool ble_keyboard_report_flush() {
+    if (unsent && !send_folded_report()) return false;
+    while (ble_keyboard_report_pending()) {
+        if (!ble_keyboard_report_drain()) return false;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "usb_hid_host.h"
+
+// Number of key slots of the BLE keyboard report (6KRO)
+#define BLE_KEYBOARD_REPORT_KEYS 6
+
+// BLE keyboard input report, boot protocol layout
+typedef struct {
+    uint8_t modifier;
+    uint8_t reserved;
+    uint8_t keys[BLE_KEYBOARD_REPORT_KEYS];
+} __attribute__((packed)) ble_keyboard_report_t;
+
+// Counters of the keyboard snapshots
+typedef struct {
+    uint32_t snapshots;      // keyboard snapshots submitted
+    uint32_t notifications;  // input reports handed to the transport
+    uint32_t folded;         // snapshots with more keys than slots
+    uint32_t drain_reports;  // additional reports for keys which did not fit
+    uint32_t stalls;         // times sending stopped for lack of credits or a failed send
+} ble_keyboard_report_stats_t;
+
+// Transport function which sends one keyboard input report as a single notification,
+// returns false if the report could not be sent
+typedef bool (*ble_keyboard_report_send_t)(const ble_keyboard_report_t* report);
+
+void register_ble_keyboard_report_transport(ble_keyboard_report_send_t send);
+
+// Number of notifications the BLE stack can take without blocking, shared
+// with the mouse reports (see ble_mouse_report_credits_t)
+typedef int (*ble_keyboard_report_credits_t)();
+
+void register_ble_keyboard_report_credits(ble_keyboard_report_credits_t credits);
+
+bool ble_keyboard_report_submit(const unified_keyData_t* keyData);
+void ble_keyboard_report_reset();
+
+bool ble_keyboard_report_pending();
+bool ble_keyboard_report_drain();
+bool ble_keyboard_report_flush();
+
+ble_keyboard_report_stats_t* get_ble_keyboard_report_stats();
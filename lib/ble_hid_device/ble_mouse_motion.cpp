@@ -0,0 +1,47 @@
+#include "ble_mouse_motion.h"
+
+// Clamp a residual to the range which fits into one report
+static inline int8_t saturate_motion(int32_t val) {
+    if (val > BLE_MOUSE_MOTION_MAX) return BLE_MOUSE_MOTION_MAX;
+    if (val < BLE_MOUSE_MOTION_MIN) return BLE_MOUSE_MOTION_MIN;
+    return (int8_t)val;
+}
+
+/**
+ * @brief Add received motion to the per-axis residuals
+ *
+ * @param[in] motion  Motion accumulator
+ * @param[in] x       X displacement
+ * @param[in] y       Y displacement
+ * @param[in] wheel   Scroll wheel displacement
+ */
+void ble_mouse_motion_add(ble_mouse_motion_t* motion, int32_t x, int32_t y, int32_t wheel) {
+    motion->x += x;
+    motion->y += y;
+    motion->wheel += wheel;
+}
+
+/**
+ * @brief Take as much motion as fits into one report, the rest stays in the
+ * residuals and is sent with the next report(s)
+ *
+ * @param[in]  motion  Motion accumulator
+ * @param[out] x       X displacement for the report
+ * @param[out] y       Y displacement for the report
+ * @param[out] wheel   Scroll wheel displacement for the report
+ */
+void ble_mouse_motion_take(ble_mouse_motion_t* motion, int8_t* x, int8_t* y, int8_t* wheel) {
+    *x = saturate_motion(motion->x);
+    *y = saturate_motion(motion->y);
+    *wheel = saturate_motion(motion->wheel);
+    motion->x -= *x;
+    motion->y -= *y;
+    motion->wheel -= *wheel;
+}
+
+/**
+ * @brief Check if there is motion left which was not yet taken
+ */
+bool ble_mouse_motion_pending(const ble_mouse_motion_t* motion) {
+    return motion->x != 0 || motion->y != 0 || motion->wheel != 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Value range of the relative axes in the BLE mouse report map
+#define BLE_MOUSE_MOTION_MAX 127
+#define BLE_MOUSE_MOTION_MIN (-127)
+
+// Motion which was received but not yet sent to the BLE host
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t wheel;
+} ble_mouse_motion_t;
+
+void ble_mouse_motion_add(ble_mouse_motion_t* motion, int32_t x, int32_t y, int32_t wheel);
+void ble_mouse_motion_take(ble_mouse_motion_t* motion, int8_t* x, int8_t* y, int8_t* wheel);
+bool ble_mouse_motion_pending(const ble_mouse_motion_t* motion);
@@ -0,0 +1,148 @@
+#include <string.h>
+#include "ble_mouse_report.h"
+#include "ble_mouse_motion.h"
+#include "ble_notify_queue.h"
+#include "hid_latency.h"
+
+static ble_mouse_report_send_t registered_transport = NULL;
+static ble_mouse_report_credits_t registered_credits = NULL;
+static ble_mouse_report_stats_t report_stats = {0};
+
+// button mask of the last report which was sent to the host
+static uint8_t last_buttons = 0;
+
+// mouse states not sent yet, because of the int8 range of the reports or congestion
+static ble_notify_queue_t notify_queue = {};
+static bool stalled = false;
+
+ble_mouse_report_stats_t* get_ble_mouse_report_stats() {
+    report_stats.dropped = notify_queue.dropped;
+    report_stats.queue_high_water = notify_queue.high_water;
+    return &report_stats;
+}
+
+/**
+ * @brief Clear the counters, e.g. between runs of a simulation
+ */
+void ble_mouse_report_stats_reset() {
+    memset(&report_stats, 0, sizeof(report_stats));
+    notify_queue.dropped = 0;
+    notify_queue.high_water = notify_queue.count;
+}
+
+/**
+ * @brief Register the function which sends a complete input report to the BLE host
+ *
+ * @param[in] send  Transport function, NULL to disable sending
+ */
+void register_ble_mouse_report_transport(ble_mouse_report_send_t send) {
+    registered_transport = send;
+}
+
+/**
+ * @brief Register the function which tells how many notifications can be sent
+ *
+ * @param[in] credits  Credit function, NULL to send without checking
+ */
+void register_ble_mouse_report_credits(ble_mouse_report_credits_t credits) {
+    registered_credits = credits;
+}
+
+/**
+ * @brief Forget the tracked button state and queued reports, e.g. after the
+ * BLE host disconnected
+ */
+void ble_mouse_report_reset() {
+    last_buttons = 0;
+    stalled = false;
+    uint32_t dropped = notify_queue.dropped;
+    uint32_t high_water = notify_queue.high_water;
+    ble_notify_queue_init(&notify_queue);
+    notify_queue.dropped = dropped;  // counters cover the whole runtime
+    notify_queue.high_water = high_water;
+}
+
+static void stall() {
+    if (!stalled) report_stats.stalls++;
+    stalled = true;
+}
+
+/**
+ * @brief Send queued reports while the BLE stack has credits
+ *
+ * Each report carries the buttons of the oldest entry and as much of its
+ * motion as fits into the report. Motion which could not be sent stays
+ * queued, later reports are merged into it.
+ *
+ * @return true if everything was sent, false if reports are still queued
+ */
+bool ble_mouse_report_flush() {
+    ble_notify_entry_t* entry;
+
+    while ((entry = ble_notify_queue_head(&notify_queue)) != NULL) {
+        ble_mouse_report_t report;
+        report.buttons = entry->buttons;
+        report.hwheel = 0;
+        ble_mouse_motion_take(&entry->motion, &report.x, &report.y, &report.wheel);
+
+        if (report.buttons == last_buttons && report.x == 0 && report.y == 0 &&
+            report.wheel == 0) {
+            report_stats.suppressed++;
+            ble_notify_queue_pop(&notify_queue);
+            continue;
+        }
+
+        if ((registered_credits != NULL && registered_credits() <= 0) ||
+            registered_transport == NULL || !registered_transport(&report)) {
+            // give back the motion, it is sent when the link has room again
+            ble_mouse_motion_add(&entry->motion, report.x, report.y, report.wheel);
+            stall();
+            return false;
+        }
+
+        stalled = false;
+        hid_latency_stamp_notify();
+        last_buttons = report.buttons;
+        report_stats.notifications++;
+        if (ble_mouse_motion_pending(&entry->motion)) {
+            report_stats.drain_reports++;  // the rest goes out with another report
+        } else {
+            ble_notify_queue_pop(&notify_queue);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Queue motion, button mask and wheel of a unified hidData report and
+ * send as much as the BLE link takes
+ *
+ * Usually this is a single notification. Deltas which exceed the int8 range
+ * of the report are not truncated but sent with additional reports. While
+ * the link is congested, motion is merged into the queued reports instead of
+ * blocking or being dropped. Reports without motion, wheel or button change
+ * are not sent at all.
+ *
+ * @param[in] hidData  Unified hid data report
+ * @return true if everything was sent, false if reports are still queued
+ */
+bool ble_mouse_report_submit(const unified_hidData_t* hidData) {
+    report_stats.hid_reports++;
+
+    // counted as congestion only while the stack has no room: motion beyond
+    // the int8 range of a report also waits in the queue with credits left
+    bool congested = (registered_credits != NULL) ? registered_credits() <= 0 : stalled;
+    bool merged = ble_notify_queue_push(&notify_queue,
+                                        hidData->buttons.val & BLE_MOUSE_REPORT_BUTTON_MASK,
+                                        hidData->x_displacement, hidData->y_displacement,
+                                        hidData->scroll_wheel);
+    if (merged && congested) report_stats.merged++;
+    return ble_mouse_report_flush();
+}
+
+/**
+ * @brief Check if reports are queued, e.g. waiting for a congested link
+ */
+bool ble_mouse_report_pending() {
+    return ble_notify_queue_head(&notify_queue) != NULL;
+}
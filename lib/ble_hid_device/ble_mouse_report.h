@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "usb_hid_host.h"
+
+// Number of buttons covered by the BLE mouse report map (left, right, middle, back, forward)
+#define BLE_MOUSE_REPORT_BUTTON_MASK 0x1F
+
+// BLE mouse input report, same layout as the mouse report of the BLE report map
+typedef struct {
+    uint8_t buttons;
+    int8_t x;
+    int8_t y;
+    int8_t wheel;
+    int8_t hwheel;
+} __attribute__((packed)) ble_mouse_report_t;
+
+// Counters to measure how many notifications are sent per unified hidData report
+typedef struct {
+    uint32_t hid_reports;    // unified hidData reports submitted
+    uint32_t notifications;  // input reports handed to the transport
+    uint32_t suppressed;     // reports without any change, not sent
+    uint32_t drain_reports;  // additional reports for motion exceeding the int8 range
+    uint32_t stalls;         // times sending stopped for lack of credits or a failed send
+    uint32_t merged;         // reports merged into a queued notification while out of credits
+    uint32_t dropped;        // button states lost because the queue stayed full
+    uint32_t queue_high_water;
+} ble_mouse_report_stats_t;
+
+// Transport function which sends one input report as a single notification,
+// returns false if the report could not be sent
+typedef bool (*ble_mouse_report_send_t)(const ble_mouse_report_t* report);
+
+void register_ble_mouse_report_transport(ble_mouse_report_send_t send);
+
+// Number of notifications the BLE stack can take without blocking (free
+// buffers), 0 while the link is congested
+typedef int (*ble_mouse_report_credits_t)();
+
+void register_ble_mouse_report_credits(ble_mouse_report_credits_t credits);
+
+bool ble_mouse_report_submit(const unified_hidData_t* hidData);
+void ble_mouse_report_reset();
+
+bool ble_mouse_report_pending();
+bool ble_mouse_report_flush();
+
+ble_mouse_report_stats_t* get_ble_mouse_report_stats();
+void ble_mouse_report_stats_reset();
@@ -0,0 +1,86 @@
+#include <string.h>
+#include "ble_notify_queue.h"
+
+void ble_notify_queue_init(ble_notify_queue_t* queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+static void append(ble_notify_queue_t* queue, const ble_notify_entry_t* entry) {
+    queue->entries[(queue->head + queue->count) % BLE_NOTIFY_QUEUE_SIZE] = *entry;
+    queue->count++;
+    if (queue->count > queue->high_water) queue->high_water = queue->count;
+}
+
+/**
+ * @brief Queue a mouse state, merged into the last entry where possible
+ *
+ * @param[in] queue    Queue
+ * @param[in] buttons  Button mask
+ * @param[in] x        X displacement
+ * @param[in] y        Y displacement
+ * @param[in] wheel    Scroll wheel displacement
+ * @return true if the motion was added to a state which was already queued
+ */
+bool ble_notify_queue_push(ble_notify_queue_t* queue, uint8_t buttons, int32_t x, int32_t y,
+                           int32_t wheel) {
+    if (queue->waiting) {
+        // the queue is still full: only the state which did not fit changes
+        if (queue->next.buttons != buttons) {
+            queue->next.buttons = buttons;
+            queue->dropped++;
+        }
+        ble_mouse_motion_add(&queue->next.motion, x, y, wheel);
+        return true;
+    }
+    if (queue->count > 0) {
+        ble_notify_entry_t* tail =
+            &queue->entries[(queue->head + queue->count - 1) % BLE_NOTIFY_QUEUE_SIZE];
+        if (tail->buttons == buttons) {
+            ble_mouse_motion_add(&tail->motion, x, y, wheel);
+            return true;
+        }
+    }
+
+    ble_notify_entry_t entry;
+    entry.buttons = buttons;
+    entry.motion.x = x;
+    entry.motion.y = y;
+    entry.motion.wheel = wheel;
+    if (queue->count == BLE_NOTIFY_QUEUE_SIZE) {
+        queue->next = entry;
+        queue->waiting = true;
+        return false;
+    }
+    append(queue, &entry);
+    return false;
+}
+
+/**
+ * @brief Oldest entry, NULL if the queue is empty
+ *
+ * The caller takes motion out of the entry as it is sent and pops the entry
+ * when nothing is left.
+ */
+ble_notify_entry_t* ble_notify_queue_head(ble_notify_queue_t* queue) {
+    if (queue->count == 0) return NULL;
+    return &queue->entries[queue->head];
+}
+
+void ble_notify_queue_pop(ble_notify_queue_t* queue) {
+    if (queue->count == 0) return;
+    queue->head = (queue->head + 1) % BLE_NOTIFY_QUEUE_SIZE;
+    queue->count--;
+    if (queue->waiting) {
+        // the state which waited for room goes behind the last queued one (the
+        // queue was full, so there is one)
+        queue->waiting = false;
+        ble_notify_entry_t* tail =
+            &queue->entries[(queue->head + queue->count - 1) % BLE_NOTIFY_QUEUE_SIZE];
+        if (tail->buttons == queue->next.buttons) {
+            ble_mouse_motion_add(&tail->motion, queue->next.motion.x, queue->next.motion.y,
+                                 queue->next.motion.wheel);
+        } else {
+            append(queue, &queue->next);
+        }
+    }
+}
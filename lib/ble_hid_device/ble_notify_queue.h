@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "ble_mouse_motion.h"
+
+// Mouse states waiting for the BLE link, one per button change
+#define BLE_NOTIFY_QUEUE_SIZE 8
+
+// Button state and the motion which goes out with it
+typedef struct {
+    uint8_t buttons;
+    ble_mouse_motion_t motion;
+} ble_notify_entry_t;
+
+/**
+ * @brief Bounded queue of mouse notifications which merges under congestion
+ *
+ * Relative motion with the same button state as the last queued entry is
+ * added to that entry, so a congested link delays motion but loses none of
+ * it. Every button change gets its own entry, and a queued button state is
+ * never changed. If the queue is full, the new state waits outside the queue
+ * until an entry is sent; only this waiting state is replaced by a later one
+ * (e.g. a short click is lost), so the buttons still end up as on the USB side.
+ */
+typedef struct {
+    ble_notify_entry_t entries[BLE_NOTIFY_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+    bool waiting;                  // 'next' holds a state which did not fit
+    ble_notify_entry_t next;
+    uint32_t dropped;     // waiting button states replaced while the queue was full
+    uint32_t high_water;  // most entries queued at once
+} ble_notify_queue_t;
+
+void ble_notify_queue_init(ble_notify_queue_t* queue);
+bool ble_notify_queue_push(ble_notify_queue_t* queue, uint8_t buttons, int32_t x, int32_t y,
+                           int32_t wheel);
+ble_notify_entry_t* ble_notify_queue_head(ble_notify_queue_t* queue);
+void ble_notify_queue_pop(ble_notify_queue_t* queue);
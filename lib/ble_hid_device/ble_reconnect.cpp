@@ -0,0 +1,155 @@
+#include <string.h>
+#include "ble_reconnect.h"
+
+/**
+ * @brief One directed window, 30 s at 20-30 ms, then 417.5 ms without time limit
+ *
+ * The device may be out of reach of the user, so it keeps advertising. A
+ * slow_us other than 0 stops advertising after the slow phase.
+ */
+void ble_reconnect_policy_default(ble_reconnect_policy_t* policy) {
+    policy->directed_windows = 1;
+    policy->fast_us = 30000000;
+    policy->fast_min_interval = 32;
+    policy->fast_max_interval = 48;
+    policy->slow_us = 0;
+    policy->slow_min_interval = 668;
+    policy->slow_max_interval = 668;
+}
+
+void ble_reconnect_init(ble_reconnect_t* rc, const ble_reconnect_policy_t* policy,
+                        const ble_advertiser_t* adv) {
+    memset(rc, 0, sizeof(*rc));
+    rc->policy = *policy;
+    rc->adv = adv;
+}
+
+/**
+ * @brief Host for directed advertising, the most recently bonded one
+ *
+ * @param[in] rc         State machine
+ * @param[in] addr       Identity address of the host
+ * @param[in] addr_type  Address type as used by the BLE stack (public, random)
+ */
+void ble_reconnect_set_peer(ble_reconnect_t* rc, const uint8_t addr[6], uint8_t addr_type) {
+    memcpy(rc->peer, addr, sizeof(rc->peer));
+    rc->peer_type = addr_type;
+    rc->has_peer = true;
+}
+
+void ble_reconnect_clear_peer(ble_reconnect_t* rc) {
+    rc->has_peer = false;
+}
+
+static void enter_phase(ble_reconnect_t* rc, ble_reconnect_state_t state, uint32_t now_us) {
+    const ble_reconnect_policy_t* policy = &rc->policy;
+    const ble_advertiser_t* adv = rc->adv;
+
+    adv->stop(adv->ctx);
+    rc->phase_us = now_us;
+
+    // a phase the stack refuses falls through to the next one
+    if (state == BLE_RECONNECT_DIRECTED) {
+        if (rc->has_peer && rc->windows_left > 0 &&
+            adv->directed(adv->ctx, rc->peer, rc->peer_type)) {
+            rc->windows_left--;
+            rc->state = state;
+            return;
+        }
+        state = BLE_RECONNECT_FAST;
+    }
+    if (state == BLE_RECONNECT_FAST) {
+        if (policy->fast_us > 0 &&
+            adv->undirected(adv->ctx, policy->fast_min_interval, policy->fast_max_interval)) {
+            rc->state = state;
+            return;
+        }
+        state = BLE_RECONNECT_SLOW;
+    }
+    if (state == BLE_RECONNECT_SLOW &&
+        adv->undirected(adv->ctx, policy->slow_min_interval, policy->slow_max_interval)) {
+        rc->state = state;
+        return;
+    }
+    rc->state = BLE_RECONNECT_STOPPED;
+    rc->stats.gave_up++;
+}
+
+/**
+ * @brief Start advertising after boot or link loss, directed first
+ */
+void ble_reconnect_start(ble_reconnect_t* rc, uint32_t now_us) {
+    rc->start_us = now_us;
+    rc->windows_left = rc->policy.directed_windows;
+    rc->stats.attempts++;
+    enter_phase(rc, BLE_RECONNECT_DIRECTED, now_us);
+}
+
+/**
+ * @brief A host connected: stop advertising and record the time to reconnect
+ */
+void ble_reconnect_connected(ble_reconnect_t* rc, uint32_t now_us) {
+    ble_reconnect_stats_t* stats = &rc->stats;
+
+    // the controller stops advertising on a connection, a phase started just
+    // before the connection was reported may still be running
+    rc->adv->stop(rc->adv->ctx);
+
+    switch (rc->state) {
+        case BLE_RECONNECT_DIRECTED:
+            stats->directed++;
+            break;
+        case BLE_RECONNECT_FAST:
+            stats->fast++;
+            break;
+        case BLE_RECONNECT_SLOW:
+            stats->slow++;
+            break;
+        default:
+            rc->state = BLE_RECONNECT_CONNECTED;
+            return;
+    }
+    stats->last_us = now_us - rc->start_us;
+    if (stats->last_us > stats->max_us) stats->max_us = stats->last_us;
+    rc->state = BLE_RECONNECT_CONNECTED;
+}
+
+/**
+ * @brief Move on to the next phase when the current one timed out, call regularly
+ */
+void ble_reconnect_poll(ble_reconnect_t* rc, uint32_t now_us) {
+    const ble_reconnect_policy_t* policy = &rc->policy;
+    uint32_t elapsed = now_us - rc->phase_us;
+
+    switch (rc->state) {
+        case BLE_RECONNECT_DIRECTED:
+            if (elapsed >= BLE_RECONNECT_DIRECTED_WINDOW_US) {
+                enter_phase(rc, BLE_RECONNECT_DIRECTED, now_us);  // next window or fast
+            }
+            break;
+        case BLE_RECONNECT_FAST:
+            if (elapsed >= policy->fast_us) enter_phase(rc, BLE_RECONNECT_SLOW, now_us);
+            break;
+        case BLE_RECONNECT_SLOW:
+            if (policy->slow_us > 0 && elapsed >= policy->slow_us) {
+                rc->adv->stop(rc->adv->ctx);
+                rc->state = BLE_RECONNECT_STOPPED;
+                rc->stats.gave_up++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+const char* ble_reconnect_state_name(ble_reconnect_state_t state) {
+    switch (state) {
+        case BLE_RECONNECT_IDLE: return "idle";
+        case BLE_RECONNECT_DIRECTED: return "directed";
+        case BLE_RECONNECT_FAST: return "fast";
+        case BLE_RECONNECT_SLOW: return "slow";
+        case BLE_RECONNECT_STOPPED: return "stopped";
+        case BLE_RECONNECT_CONNECTED: return "connected";
+    }
+    return "?";
+}
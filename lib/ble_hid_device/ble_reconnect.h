@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+// High duty cycle directed advertising ends after 1.28 s in the controller
+#define BLE_RECONNECT_DIRECTED_WINDOW_US 1280000
+
+// Unit of the advertising interval in the BLE specification
+#define BLE_ADV_INTERVAL_UNIT_US 625
+
+typedef enum {
+    BLE_RECONNECT_IDLE = 0,
+    BLE_RECONNECT_DIRECTED,   // high duty directed advertising to the last bonded host
+    BLE_RECONNECT_FAST,       // undirected advertising, short interval
+    BLE_RECONNECT_SLOW,       // undirected advertising, long interval
+    BLE_RECONNECT_STOPPED,    // all phases timed out, not advertising
+    BLE_RECONNECT_CONNECTED,
+} ble_reconnect_state_t;
+
+/**
+ * @brief Advertising functions of the BLE stack
+ *
+ * Starting a phase always follows stop(). A start function returns false if
+ * the stack refused it, the state machine then goes on with the next phase.
+ */
+typedef struct {
+    bool (*directed)(void* ctx, const uint8_t addr[6], uint8_t addr_type);
+    bool (*undirected)(void* ctx, uint16_t min_interval, uint16_t max_interval);
+    void (*stop)(void* ctx);
+    void* ctx;
+} ble_advertiser_t;
+
+/**
+ * @brief Advertising phases after boot or link loss
+ *
+ * Directed advertising only reaches the bonded host and connects fastest, the
+ * undirected phases follow if the host does not answer. fast_us of 0 skips
+ * the fast phase, slow_us of 0 keeps the slow phase running until a host
+ * connects.
+ */
+typedef struct {
+    uint8_t directed_windows;     // directed windows of 1.28 s, 0 = skip
+    uint32_t fast_us;
+    uint16_t fast_min_interval;   // in 0.625 ms
+    uint16_t fast_max_interval;
+    uint32_t slow_us;
+    uint16_t slow_min_interval;
+    uint16_t slow_max_interval;
+} ble_reconnect_policy_t;
+
+typedef struct {
+    uint32_t attempts;    // reconnections started (boot or link loss)
+    uint32_t directed;    // connected during directed advertising
+    uint32_t fast;        // connected during the fast undirected phase
+    uint32_t slow;
+    uint32_t gave_up;     // advertising stopped after the last phase
+    uint32_t last_us;     // time to reconnect, from link loss or boot to connection
+    uint32_t max_us;
+} ble_reconnect_stats_t;
+
+/**
+ * @brief Reconnection state machine, independent of the BLE stack
+ *
+ * Advertising goes through the advertiser functions and time is passed in,
+ * so the phases can be driven by a stand-in advertiser.
+ */
+typedef struct {
+    ble_reconnect_policy_t policy;
+    const ble_advertiser_t* adv;
+    ble_reconnect_state_t state;
+    bool has_peer;
+    uint8_t peer[6];
+    uint8_t peer_type;
+    uint8_t windows_left;
+    uint32_t start_us;   // link loss or boot
+    uint32_t phase_us;   // start of the current phase or directed window
+    ble_reconnect_stats_t stats;
+} ble_reconnect_t;
+
+void ble_reconnect_policy_default(ble_reconnect_policy_t* policy);
+void ble_reconnect_init(ble_reconnect_t* rc, const ble_reconnect_policy_t* policy,
+                        const ble_advertiser_t* adv);
+void ble_reconnect_set_peer(ble_reconnect_t* rc, const uint8_t addr[6], uint8_t addr_type);
+void ble_reconnect_clear_peer(ble_reconnect_t* rc);
+
+void ble_reconnect_start(ble_reconnect_t* rc, uint32_t now_us);
+void ble_reconnect_connected(ble_reconnect_t* rc, uint32_t now_us);
+void ble_reconnect_poll(ble_reconnect_t* rc, uint32_t now_us);
+
+const char* ble_reconnect_state_name(ble_reconnect_state_t state);
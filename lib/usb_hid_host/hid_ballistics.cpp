@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include "hid_ballistics.h"
+
+/**
+ * @brief Precompute the gain table of a profile
+ *
+ * Runs when a profile is selected, the report path only does a table lookup.
+ *
+ * @param[out] table    Gain table
+ * @param[in]  profile  Acceleration profile, an empty profile gives gain 1
+ */
+void hid_ballistics_build(hid_ballistics_t* table, const hid_ballistics_profile_t* profile) {
+    int n = profile->point_count;
+    if (n > HID_BALLISTICS_MAX_POINTS) n = HID_BALLISTICS_MAX_POINTS;
+
+    for (int i = 0; i <= HID_BALLISTICS_LUT_SIZE; i++) {
+        uint32_t speed = (uint32_t)i << HID_BALLISTICS_SPEED_STEP;
+        uint32_t gain_x100 = 100;
+
+        if (n > 0) {
+            gain_x100 = profile->points[n - 1].gain_x100;
+            if (speed <= profile->points[0].speed) {
+                gain_x100 = profile->points[0].gain_x100;
+            } else {
+                for (int p = 1; p < n; p++) {
+                    const hid_ballistics_point_t* a = &profile->points[p - 1];
+                    const hid_ballistics_point_t* b = &profile->points[p];
+                    if (speed > b->speed) continue;
+                    int32_t span = b->speed - a->speed;
+                    int32_t delta = (int32_t)b->gain_x100 - a->gain_x100;
+                    gain_x100 = a->gain_x100 +
+                                ((span > 0) ? delta * (int32_t)(speed - a->speed) / span : 0);
+                    break;
+                }
+            }
+        }
+        uint32_t q8 = (gain_x100 * 256 + 50) / 100;
+        table->gain[i] = (q8 > 0xFFFF) ? 0xFFFF : (uint16_t)q8;
+    }
+}
+
+// Scale one axis, the remainder is dropped when the direction changes
+static int16_t scale_axis(int32_t d, int32_t gain, int32_t* residual) {
+    if (d == 0) return 0;
+    if ((d < 0) != (*residual < 0)) *residual = 0;
+
+    int64_t acc = (int64_t)d * gain + *residual;
+    int64_t out = acc / 256;  // truncates toward zero, both directions behave the same
+    *residual = (int32_t)(acc - out * 256);
+    if (out > INT16_MAX) out = INT16_MAX;
+    if (out < INT16_MIN) out = INT16_MIN;
+    return (int16_t)out;
+}
+
+/**
+ * @brief Apply the gain for the current pointer speed to a mouse report
+ *
+ * The speed is the length of the motion (approximated as max + 3/8 min)
+ * over the time since the previous report. Cost is one division, one table
+ * lookup with interpolation and a few multiplications, independent of the
+ * profile.
+ *
+ * @param[in]     table   Gain table
+ * @param[in,out] state   Per device state
+ * @param[in]     now_us  Arrival time of the report
+ * @param[in,out] dx      X displacement
+ * @param[in,out] dy      Y displacement
+ */
+void hid_ballistics_apply(const hid_ballistics_t* table, hid_ballistics_state_t* state,
+                          uint32_t now_us, int16_t* dx, int16_t* dy) {
+    uint32_t dt = now_us - state->last_us;
+    state->last_us = now_us;
+    if (*dx == 0 && *dy == 0) return;
+
+    if (dt < HID_BALLISTICS_MIN_DT_US) dt = HID_BALLISTICS_MIN_DT_US;
+    if (dt > HID_BALLISTICS_MAX_DT_US) dt = HID_BALLISTICS_MAX_DT_US;
+
+    uint32_t ax = (uint32_t)abs(*dx);
+    uint32_t ay = (uint32_t)abs(*dy);
+    uint32_t mag = (ax > ay) ? ax + (3 * ay >> 3) : ay + (3 * ax >> 3);
+    uint32_t speed = (uint32_t)((uint64_t)mag * 1000000u / dt);  // counts per second
+
+    int32_t gain;
+    uint32_t i = speed >> HID_BALLISTICS_SPEED_STEP;
+    if (i >= HID_BALLISTICS_LUT_SIZE) {
+        gain = table->gain[HID_BALLISTICS_LUT_SIZE];
+    } else {
+        int32_t a = table->gain[i];
+        int32_t b = table->gain[i + 1];
+        int32_t frac = (int32_t)(speed & ((1u << HID_BALLISTICS_SPEED_STEP) - 1));
+        gain = a + (((b - a) * frac) >> HID_BALLISTICS_SPEED_STEP);
+    }
+
+    *dx = scale_axis(*dx, gain, &state->residual_x);
+    *dy = scale_axis(*dy, gain, &state->residual_y);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Gain table over the pointer speed, 256 counts/s per entry up to ~16000 counts/s
+#define HID_BALLISTICS_LUT_BITS   6
+#define HID_BALLISTICS_LUT_SIZE   (1 << HID_BALLISTICS_LUT_BITS)
+#define HID_BALLISTICS_SPEED_STEP 8  // log2 of counts/s per entry
+
+// Limits of the inter-report time used for the speed: USB full speed polling
+// and the interval assumed for the first report after a pause
+#define HID_BALLISTICS_MIN_DT_US 125
+#define HID_BALLISTICS_MAX_DT_US 20000
+
+#define HID_BALLISTICS_MAX_POINTS 8
+
+// Gain at one speed, the curve is linear between points and flat beyond the last one
+typedef struct {
+    uint16_t speed;      // counts per second
+    uint16_t gain_x100;  // output per input count, 100 = unchanged
+} hid_ballistics_point_t;
+
+// Acceleration profile, points sorted by speed
+typedef struct {
+    uint8_t point_count;
+    hid_ballistics_point_t points[HID_BALLISTICS_MAX_POINTS];
+} hid_ballistics_profile_t;
+
+// Precomputed gains in Q8, built from a profile
+typedef struct {
+    uint16_t gain[HID_BALLISTICS_LUT_SIZE + 1];
+} hid_ballistics_t;
+
+// Per device state: time of the previous report and sub-pixel remainders in Q8
+typedef struct {
+    uint32_t last_us;
+    int32_t residual_x;
+    int32_t residual_y;
+} hid_ballistics_state_t;
+
+void hid_ballistics_build(hid_ballistics_t* table, const hid_ballistics_profile_t* profile);
+void hid_ballistics_apply(const hid_ballistics_t* table, hid_ballistics_state_t* state,
+                          uint32_t now_us, int16_t* dx, int16_t* dy);
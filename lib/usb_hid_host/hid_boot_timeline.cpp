@@ -0,0 +1,86 @@
+#include <atomic>
+#include <esp_log.h>
+#include "hid_boot_timeline.h"
+
+static const char* TAG = "hid-boot";
+
+static const char* milestone_names[HID_BOOT_MILESTONES] = {
+    "setup", "ble advertising", "usb host installed", "hid driver installed",
+    "first device", "first report", "ble connected"};
+
+// 0 = not reached, milestones are recorded from several tasks
+static std::atomic<uint32_t> milestone_us[HID_BOOT_MILESTONES];
+static bool timeline_logged = false;  // by hid_boot_timeline_log_once()
+
+void hid_boot_mark(hid_boot_milestone_t milestone, uint32_t now_us) {
+    if (milestone >= HID_BOOT_MILESTONES) return;
+    std::atomic<uint32_t>* slot = &milestone_us[milestone];
+    if (slot->load(std::memory_order_relaxed) != 0) return;
+
+    uint32_t expected = 0;
+    slot->compare_exchange_strong(expected, now_us ? now_us : 1);
+}
+
+uint32_t hid_boot_get(hid_boot_milestone_t milestone) {
+    if (milestone >= HID_BOOT_MILESTONES) return 0;
+    return milestone_us[milestone].load();
+}
+
+const char* hid_boot_milestone_name(hid_boot_milestone_t milestone) {
+    if (milestone >= HID_BOOT_MILESTONES) return "?";
+    return milestone_names[milestone];
+}
+
+void hid_boot_timeline_reset() {
+    for (int i = 0; i < HID_BOOT_MILESTONES; i++) milestone_us[i].store(0);
+    timeline_logged = false;
+}
+
+/**
+ * @brief Log the reached milestones in the order they were reached, with the
+ * time since power-on and since the previous milestone
+ */
+void hid_boot_timeline_log() {
+    uint32_t times[HID_BOOT_MILESTONES];
+    int order[HID_BOOT_MILESTONES];
+    int count = 0;
+
+    for (int i = 0; i < HID_BOOT_MILESTONES; i++) {
+        times[i] = milestone_us[i].load();
+        if (times[i] == 0) continue;
+        // insertion sort by time, there are only a few milestones
+        int j = count++;
+        while (j > 0 && times[order[j - 1]] > times[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    uint32_t prev = 0;
+    for (int k = 0; k < count; k++) {
+        uint32_t t = times[order[k]];
+        ESP_LOGI(TAG, "%-22s %8lu us  +%lu us", milestone_names[order[k]], (unsigned long)t,
+                 (unsigned long)(t - prev));
+        prev = t;
+    }
+    for (int i = 0; i < HID_BOOT_MILESTONES; i++) {
+        if (times[i] == 0) ESP_LOGI(TAG, "%-22s not reached", milestone_names[i]);
+    }
+}
+
+/**
+ * @brief Log the timeline once, when a report was delivered and a host is
+ * connected, or after HID_BOOT_LOG_TIMEOUT_US; call regularly from one task
+ *
+ * @param[in] now_us  Time since power-on
+ * @return true if the timeline was logged by this call
+ */
+bool hid_boot_timeline_log_once(uint32_t now_us) {
+    if (timeline_logged) return false;
+    bool done = hid_boot_get(HID_BOOT_FIRST_REPORT) != 0 && hid_boot_get(HID_BOOT_BLE_CONNECTED) != 0;
+    if (!done && now_us < HID_BOOT_LOG_TIMEOUT_US) return false;
+    timeline_logged = true;
+    hid_boot_timeline_log();
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Startup milestones, each is recorded the first time it is reached
+typedef enum {
+    HID_BOOT_SETUP = 0,              // setup() entered
+    HID_BOOT_BLE_ADVERTISING,        // BLE stack up, advertising started
+    HID_BOOT_USB_HOST_INSTALLED,     // USB host library installed
+    HID_BOOT_HID_DRIVER_INSTALLED,   // HID host class driver installed
+    HID_BOOT_FIRST_DEVICE,           // first HID interface enumerated
+    HID_BOOT_FIRST_REPORT,           // first report handed to the BLE side
+    HID_BOOT_BLE_CONNECTED,          // first BLE connection
+    HID_BOOT_MILESTONES
+} hid_boot_milestone_t;
+
+// The timeline is logged once the first report went out over BLE, or after
+// this time since power-on with the milestones reached so far
+#define HID_BOOT_LOG_TIMEOUT_US 30000000
+
+/**
+ * @brief Record a milestone, later calls for the same milestone are ignored
+ *
+ * Safe to call from any task, cheap once the milestone is recorded.
+ *
+ * @param[in] milestone  Milestone
+ * @param[in] now_us     Time since power-on, e.g. esp_timer_get_time()
+ */
+void hid_boot_mark(hid_boot_milestone_t milestone, uint32_t now_us);
+
+// Time of the milestone since power-on, 0 if not reached yet
+uint32_t hid_boot_get(hid_boot_milestone_t milestone);
+const char* hid_boot_milestone_name(hid_boot_milestone_t milestone);
+void hid_boot_timeline_reset();
+void hid_boot_timeline_log();
+bool hid_boot_timeline_log_once(uint32_t now_us);
@@ -0,0 +1,156 @@
+#include <string.h>
+#include "hid_capture.h"
+
+static size_t put_varint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        out[n++] = b | (value ? 0x80 : 0);
+    } while (value);
+    return n;
+}
+
+static bool get_varint(hid_capture_reader_t* reader, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (reader->pos >= reader->len) return false;
+        uint8_t b = reader->buf[reader->pos++];
+        *value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Start a capture in the given buffer
+ *
+ * @param[out] cap     Capture
+ * @param[in]  buf     Buffer, e.g. in PSRAM
+ * @param[in]  size    Buffer size
+ * @param[in]  now_us  Timestamp the first delta refers to
+ */
+void hid_capture_init(hid_capture_t* cap, uint8_t* buf, size_t size, uint32_t now_us) {
+    memset(cap, 0, sizeof(*cap));
+    cap->buf = buf;
+    cap->size = size;
+    cap->last_us = now_us;
+    if (size < HID_CAPTURE_HEADER_SIZE) {
+        cap->size = 0;
+        return;
+    }
+
+    uint32_t magic = HID_CAPTURE_MAGIC;
+    memcpy(buf, &magic, 4);
+    buf[4] = HID_CAPTURE_VERSION;
+    buf[5] = buf[6] = buf[7] = 0;
+    cap->len = HID_CAPTURE_HEADER_SIZE;
+}
+
+// Reserve room for a record, NULL if the capture is full
+static uint8_t* reserve(hid_capture_t* cap, size_t max_len) {
+    if (cap->size == 0 || cap->len + max_len > cap->size) {
+        cap->dropped++;
+        return NULL;
+    }
+    return cap->buf + cap->len;
+}
+
+/**
+ * @brief Append the report descriptor of an interface
+ *
+ * @return false if the capture is full
+ */
+bool hid_capture_descriptor(hid_capture_t* cap, uint8_t iface, uint8_t sub_class, uint8_t proto,
+                            const uint8_t* desc, size_t desc_len, uint32_t now_us) {
+    uint8_t* out = reserve(cap, 1 + 5 + 2 + 5 + desc_len);
+    if (out == NULL) return false;
+
+    size_t n = 0;
+    out[n++] = HID_CAPTURE_REC_DESCRIPTOR | (iface & 0x0F);
+    n += put_varint(out + n, now_us - cap->last_us);
+    out[n++] = sub_class;
+    out[n++] = proto;
+    n += put_varint(out + n, (uint32_t)desc_len);
+    memcpy(out + n, desc, desc_len);
+    n += desc_len;
+
+    cap->len += n;
+    cap->last_us = now_us;
+    cap->records++;
+    return true;
+}
+
+/**
+ * @brief Append an input report as received from the interface
+ *
+ * @return false if the capture is full
+ */
+bool hid_capture_report(hid_capture_t* cap, uint8_t iface, const uint8_t* data, size_t length,
+                        uint32_t now_us) {
+    if (length > 255) length = 255;
+    uint8_t* out = reserve(cap, 1 + 5 + 1 + length);
+    if (out == NULL) return false;
+
+    size_t n = 0;
+    out[n++] = HID_CAPTURE_REC_REPORT | (iface & 0x0F);
+    n += put_varint(out + n, now_us - cap->last_us);
+    out[n++] = (uint8_t)length;
+    memcpy(out + n, data, length);
+    n += length;
+
+    cap->len += n;
+    cap->last_us = now_us;
+    cap->records++;
+    return true;
+}
+
+/**
+ * @brief Start reading a capture
+ *
+ * @return false if the header is missing or has another version
+ */
+bool hid_capture_reader_init(hid_capture_reader_t* reader, const uint8_t* buf, size_t len) {
+    reader->buf = buf;
+    reader->len = len;
+    reader->pos = HID_CAPTURE_HEADER_SIZE;
+
+    uint32_t magic;
+    if (len < HID_CAPTURE_HEADER_SIZE) return false;
+    memcpy(&magic, buf, 4);
+    return magic == HID_CAPTURE_MAGIC && buf[4] == HID_CAPTURE_VERSION;
+}
+
+/**
+ * @brief Read the next record, the data points into the capture buffer
+ *
+ * @return false at the end of the capture or if the record is truncated
+ */
+bool hid_capture_next(hid_capture_reader_t* reader, hid_capture_record_t* rec) {
+    if (reader->pos >= reader->len) return false;
+
+    memset(rec, 0, sizeof(*rec));
+    uint8_t b = reader->buf[reader->pos++];
+    rec->type = b & 0xF0;
+    rec->iface = b & 0x0F;
+    if (!get_varint(reader, &rec->delta_us)) return false;
+
+    uint32_t length;
+    if (rec->type == HID_CAPTURE_REC_DESCRIPTOR) {
+        if (reader->pos + 2 > reader->len) return false;
+        rec->sub_class = reader->buf[reader->pos++];
+        rec->proto = reader->buf[reader->pos++];
+        if (!get_varint(reader, &length)) return false;
+    } else if (rec->type == HID_CAPTURE_REC_REPORT) {
+        if (reader->pos + 1 > reader->len) return false;
+        length = reader->buf[reader->pos++];
+    } else {
+        return false;
+    }
+
+    if (reader->pos + length > reader->len) return false;
+    rec->data = reader->buf + reader->pos;
+    rec->length = length;
+    reader->pos += length;
+    return true;
+}
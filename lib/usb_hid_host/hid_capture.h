@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Capture header: magic and format version
+#define HID_CAPTURE_MAGIC   0x43444948  // "HIDC" little endian
+#define HID_CAPTURE_VERSION 1
+#define HID_CAPTURE_HEADER_SIZE 8
+
+// Record types (high nibble of the first byte, low nibble: interface index)
+#define HID_CAPTURE_REC_DESCRIPTOR 0x10
+#define HID_CAPTURE_REC_REPORT     0x20
+
+/**
+ * Capture format, all values little endian, "varint" is LEB128 (7 bits per byte):
+ *
+ *   header:      magic (4), version (1), reserved (3)
+ *   descriptor:  type|iface (1), delta_us (varint), sub_class (1), proto (1),
+ *                length (varint), report descriptor
+ *   report:      type|iface (1), delta_us (varint), length (1), report data
+ *
+ * delta_us is the time since the previous record, reports at 1 kHz take two
+ * bytes of timestamp.
+ */
+
+// Capture buffer, filled until it is full (later records are counted as dropped)
+typedef struct {
+    uint8_t* buf;
+    size_t size;
+    size_t len;
+    uint32_t last_us;     // timestamp of the previous record
+    uint32_t records;
+    uint32_t dropped;     // records which did not fit
+} hid_capture_t;
+
+// One record read back from a capture
+typedef struct {
+    uint8_t type;         // HID_CAPTURE_REC_x
+    uint8_t iface;
+    uint8_t sub_class;    // descriptor only
+    uint8_t proto;        // descriptor only
+    uint32_t delta_us;
+    const uint8_t* data;
+    size_t length;
+} hid_capture_record_t;
+
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    size_t pos;
+} hid_capture_reader_t;
+
+void hid_capture_init(hid_capture_t* cap, uint8_t* buf, size_t size, uint32_t now_us);
+bool hid_capture_descriptor(hid_capture_t* cap, uint8_t iface, uint8_t sub_class, uint8_t proto,
+                            const uint8_t* desc, size_t desc_len, uint32_t now_us);
+bool hid_capture_report(hid_capture_t* cap, uint8_t iface, const uint8_t* data, size_t length,
+                        uint32_t now_us);
+
+bool hid_capture_reader_init(hid_capture_reader_t* reader, const uint8_t* buf, size_t len);
+bool hid_capture_next(hid_capture_reader_t* reader, hid_capture_record_t* rec);
@@ -0,0 +1,237 @@
+#include <string.h>
+#include <atomic>
+#include <Arduino.h>
+#include <esp_log.h>
+#include "hid_host.h"
+#include "usb_hid_host.h"
+#include "hid_capture_host.h"
+#include "hid_latency.h"
+#include "usb_hid_extract.h"
+
+static const char* TAG = "hid-capture";
+
+// Capture set by the application, written by the HID driver task. Stopping
+// waits until a write in progress is done (busy flag checked after clearing
+// the request, both sequentially consistent). Every start is a new
+// generation, counted before the request is set, so the driver task which
+// sees the request also sees its generation; interfaces whose descriptor is
+// not in this generation's capture get it written before their next report.
+static std::atomic<hid_capture_t*> capture_request(nullptr);
+static std::atomic<bool> capture_busy(false);
+static std::atomic<uint32_t> capture_gen(0);
+
+// Live input is paused while a capture is replayed: the interface callback
+// marks itself busy before it checks the pause flag, the replay sets the flag
+// before it waits until the callback is not busy (all sequentially consistent).
+// So either the callback sees the pause, or the replay waits for it.
+static std::atomic<bool> live_input_paused(false);
+static std::atomic<bool> live_input_busy(false);
+
+/**
+ * @brief Called by the interface callback before it handles an event
+ *
+ * @param[in] wait  true: wait while a replay runs (e.g. disconnects, which must
+ *                  not be lost), false: return at once
+ * @return false if a replay runs and the event must be ignored
+ */
+bool hid_live_input_begin(bool wait) {
+    while (true) {
+        live_input_busy.store(true);
+        if (!live_input_paused.load()) return true;
+        live_input_busy.store(false);
+        if (!wait) return false;
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief Called by the interface callback when the event is handled
+ */
+void hid_live_input_end() {
+    live_input_busy.store(false);
+}
+
+/**
+ * @brief Record the reports of all interfaces into a capture
+ *
+ * The report descriptors of the connected interfaces are written before
+ * their first report, also when the same capture is started again.
+ *
+ * @param[in] cap  Capture initialized with hid_capture_init(), a running
+ *                 capture must be stopped first
+ */
+void hid_host_capture_start(hid_capture_t* cap) {
+    capture_gen.fetch_add(1);
+    capture_request.store(cap);
+}
+
+/**
+ * @brief Stop recording, the capture can be read after this returns
+ */
+void hid_host_capture_stop() {
+    capture_request.store(nullptr);
+    while (capture_busy.load()) {
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief Called by the interface callback for every input report
+ *
+ * @param[in] dev     Device table entry of the interface
+ * @param[in] data    Report data
+ * @param[in] length  Report length
+ * @param[in] now_us  Arrival timestamp
+ */
+void hid_capture_on_report(hid_device_t* dev, const uint8_t* data, size_t length, uint32_t now_us) {
+    capture_busy.store(true);
+    hid_capture_t* cap = capture_request.load();
+    if (cap != NULL) {
+        uint32_t gen = capture_gen.load();
+        uint8_t iface = (uint8_t)hid_device_index(dev);
+        if (dev->capture_gen != gen) {
+            size_t desc_len = 0;
+            const uint8_t* desc = hid_host_get_report_descriptor(dev->handle, &desc_len);
+            if (dev->quirk != NULL && dev->quirk->report_desc != NULL) {
+                desc = dev->quirk->report_desc;  // the descriptor the formats were parsed from
+                desc_len = dev->quirk->report_desc_len;
+            }
+            if (desc != NULL && hid_capture_descriptor(cap, iface, dev->params.sub_class,
+                                                       dev->params.proto, desc, desc_len, now_us)) {
+                dev->capture_gen = gen;
+            }
+        }
+        if (dev->capture_gen == gen) {
+            hid_capture_report(cap, iface, data, length, now_us);
+        }
+    }
+    capture_busy.store(false);
+}
+
+// Interfaces of the capture being replayed, with their own formats and state.
+// Their motion generators are never ticked (period 0), replayed joysticks move
+// with their own reports.
+static hid_device_t replay_devs[16];
+static hid_report_map_t replay_map;
+static hid_format_cache_entry_t replay_cache_entry;
+
+/**
+ * @brief Feed a capture through the report parsers and decoders
+ *
+ * Live input is paused meanwhile. The decoded reports are delivered like
+ * live ones, so this also drives the BLE side. Runs on the HID host task, see
+ * hid_capture_replay(); host tests call it directly.
+ *
+ * @param[in]  buf       Capture
+ * @param[in]  len       Capture length
+ * @param[in]  realtime  true: keep the original report timing, false: as
+ *                       fast as possible (throughput measurement)
+ * @param[out] result    Number of records and time taken
+ * @return false if the capture header is invalid
+ */
+bool hid_capture_replay_run(const uint8_t* buf, size_t len, bool realtime,
+                            hid_replay_result_t* result) {
+    hid_capture_reader_t reader;
+    hid_capture_record_t rec;
+    uint8_t data[256 + HID_PLAN_READ_PAD];
+
+    memset(result, 0, sizeof(*result));
+    if (!hid_capture_reader_init(&reader, buf, len)) {
+        ESP_LOGE(TAG, "Not a capture (version %d expected)", HID_CAPTURE_VERSION);
+        return false;
+    }
+
+    // from here on the replay is the only producer of the event ring
+    live_input_paused.store(true);
+    while (live_input_busy.load()) {
+        vTaskDelay(1);
+    }
+    for (int i = 0; i < 16; i++) hid_device_clear(&replay_devs[i]);
+
+    uint32_t start_us = hid_latency_now();
+    uint32_t target_us = start_us;
+    while (hid_capture_next(&reader, &rec)) {
+        hid_device_t* dev = &replay_devs[rec.iface];
+        target_us += rec.delta_us;
+
+        if (rec.type == HID_CAPTURE_REC_DESCRIPTOR) {
+            hid_device_clear(dev);
+            dev->handle = (hid_host_device_handle_t)dev;  // marks the entry as used
+            dev->params.sub_class = rec.sub_class;
+            dev->params.proto = rec.proto;
+            dev->keyboard_state.source = HID_KEY_SOURCE_REPLAY;
+            // formats of replayed descriptors are not written to flash
+            hid_device_parse_formats(dev, rec.data, rec.length, &replay_map, &replay_cache_entry,
+                                     false);
+            result->descriptors++;
+            continue;
+        }
+
+        if (dev->handle == NULL) {
+            result->errors++;
+            continue;
+        }
+        if (realtime) {
+            while ((int32_t)(target_us - hid_latency_now()) > 2000) vTaskDelay(1);
+            while ((int32_t)(target_us - hid_latency_now()) > 0) {}
+        }
+        memset(data, 0, sizeof(data));
+        memcpy(data, rec.data, rec.length);
+        hid_device_decode_report(dev, data, rec.length, hid_latency_now());
+        result->reports++;
+    }
+    if (reader.pos != reader.len) result->errors++;
+    result->elapsed_us = hid_latency_now() - start_us;
+
+    for (int i = 0; i < 16; i++) {
+        if (replay_devs[i].handle == NULL) continue;
+        hid_host_keyboard_release(&replay_devs[i].keyboard_state);
+        hid_host_joystick_release(&replay_devs[i].joystick_format, &replay_devs[i].joystick_motion,
+                                  &replay_devs[i].joystick_gen);
+    }
+    live_input_paused.store(false);
+
+    ESP_LOGI(TAG, "Replayed %lu reports of %lu interfaces in %lu us (%lu errors)",
+             (unsigned long)result->reports, (unsigned long)result->descriptors,
+             (unsigned long)result->elapsed_us, (unsigned long)result->errors);
+    return true;
+}
+
+// Replay handed over to the HID host task
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    bool realtime;
+    hid_replay_result_t* result;
+    bool ok;
+    TaskHandle_t caller;
+} hid_replay_request_t;
+
+static void replay_work(void* arg) {
+    hid_replay_request_t* req = (hid_replay_request_t*)arg;
+    req->ok = hid_capture_replay_run(req->buf, req->len, req->realtime, req->result);
+    xTaskNotifyGive(req->caller);
+}
+
+/**
+ * @brief Replay a capture on the HID host task and wait until it is done
+ *
+ * The replay runs in order with device connects, and the task which calls
+ * this is not a producer of the event ring.
+ *
+ * @param[in]  buf       Capture
+ * @param[in]  len       Capture length
+ * @param[in]  realtime  true: keep the original report timing, false: as fast as possible
+ * @param[out] result    Number of records and time taken
+ * @return false if the capture header is invalid or the HID host task is not running
+ */
+bool hid_capture_replay(const uint8_t* buf, size_t len, bool realtime, hid_replay_result_t* result) {
+    hid_replay_request_t req = {buf, len, realtime, result, false, xTaskGetCurrentTaskHandle()};
+    if (!hid_host_post_work(replay_work, &req)) {
+        ESP_LOGE(TAG, "HID host task not running, capture not replayed");
+        memset(result, 0, sizeof(*result));
+        return false;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return req.ok;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hid_capture.h"
+#include "usb_hid_device.h"
+
+// Result of a replay
+typedef struct {
+    uint32_t descriptors;
+    uint32_t reports;
+    uint32_t errors;      // truncated capture or reports of unknown interfaces
+    uint32_t elapsed_us;
+} hid_replay_result_t;
+
+void hid_host_capture_start(hid_capture_t* cap);
+void hid_host_capture_stop();
+
+void hid_capture_on_report(hid_device_t* dev, const uint8_t* data, size_t length, uint32_t now_us);
+
+bool hid_live_input_begin(bool wait);
+void hid_live_input_end();
+
+bool hid_capture_replay(const uint8_t* buf, size_t len, bool realtime, hid_replay_result_t* result);
+bool hid_capture_replay_run(const uint8_t* buf, size_t len, bool realtime,
+                            hid_replay_result_t* result);
@@ -0,0 +1,66 @@
+#include "hid_event_ring.h"
+
+static_assert((HID_EVENT_RING_CAPACITY & (HID_EVENT_RING_CAPACITY - 1)) == 0,
+              "HID_EVENT_RING_CAPACITY must be a power of two");
+
+/**
+ * @brief Reset ring indices and counters, must not be called while in use
+ */
+void hid_event_ring_init(hid_event_ring_t* ring) {
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->overflows.store(0, std::memory_order_relaxed);
+    ring->high_water.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Append a report, called from the producer only
+ *
+ * @param[in] ring   Event ring
+ * @param[in] event  Report to copy into the ring
+ * @return false if the ring was full and the report was dropped
+ */
+bool hid_event_ring_push(hid_event_ring_t* ring, const hid_event_t* event) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+
+    if (head - tail >= HID_EVENT_RING_CAPACITY) {
+        ring->overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ring->slots[head & (HID_EVENT_RING_CAPACITY - 1)] = *event;
+    ring->head.store(head + 1, std::memory_order_release);
+
+    uint32_t count = head + 1 - tail;
+    if (count > ring->high_water.load(std::memory_order_relaxed)) {
+        ring->high_water.store(count, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+/**
+ * @brief Remove the oldest report, called from the consumer only
+ *
+ * @param[in]  ring   Event ring
+ * @param[out] event  Report copied out of the ring
+ * @return false if the ring was empty
+ */
+bool hid_event_ring_pop(hid_event_ring_t* ring, hid_event_t* event) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+
+    if (head == tail) return false;
+
+    *event = ring->slots[tail & (HID_EVENT_RING_CAPACITY - 1)];
+    ring->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Number of queued reports (a snapshot, may change concurrently)
+ */
+uint32_t hid_event_ring_count(const hid_event_ring_t* ring) {
+    return ring->head.load(std::memory_order_acquire) -
+           ring->tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "usb_hid_host.h"
+
+// Number of events the ring can hold, must be a power of two
+#define HID_EVENT_RING_CAPACITY 32
+
+// Kinds of events in the ring
+#define HID_EVENT_HIDDATA 0  // unified hidData report
+#define HID_EVENT_KEYDATA 1  // keyboard snapshot
+
+// One report with the timestamps it collected on the USB side
+typedef struct {
+    uint8_t type;  // HID_EVENT_x
+    union {
+        unified_hidData_t hidData;
+        unified_keyData_t keyData;
+    };
+    uint32_t arrival_us;  // USB report arrival
+    uint32_t decoded_us;  // decoding done
+} hid_event_t;
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of unified hidData reports,
+ * keyboard snapshots and their timestamps
+ *
+ * The producer (USB side) only writes 'head', the consumer (BLE side) only
+ * writes 'tail'. Both are free running, the slot index is taken modulo capacity.
+ */
+typedef struct {
+    hid_event_t slots[HID_EVENT_RING_CAPACITY];
+    std::atomic<uint32_t> head;        // next slot to write, producer only
+    std::atomic<uint32_t> tail;        // next slot to read, consumer only
+    std::atomic<uint32_t> overflows;   // reports dropped because the ring was full
+    std::atomic<uint32_t> high_water;  // maximum number of queued reports
+} hid_event_ring_t;
+
+void hid_event_ring_init(hid_event_ring_t* ring);
+bool hid_event_ring_push(hid_event_ring_t* ring, const hid_event_t* event);
+bool hid_event_ring_pop(hid_event_ring_t* ring, hid_event_t* event);
+uint32_t hid_event_ring_count(const hid_event_ring_t* ring);
+
+// Ring between the USB side and the sender task
+hid_event_ring_t* get_hid_event_ring();
@@ -0,0 +1,139 @@
+#include <math.h>
+#include "hid_joystick_curve.h"
+
+/**
+ * @brief Precompute the response curve
+ *
+ * Runs once when the curve is configured, so the float math stays out of the
+ * report path. The curve starts at zero speed at the edge of the deadzone and
+ * reaches max_speed at full deflection.
+ *
+ * @param[out] curve  Lookup table
+ * @param[in]  cfg    Curve settings
+ */
+void joystick_curve_build(joystick_curve_t* curve, const joystick_curve_config_t* cfg) {
+    float deadzone = cfg->deadzone_permille / 1000.0f;
+    if (deadzone > 0.95f) deadzone = 0.95f;
+    float exponent = (cfg->exponent_x10 > 0) ? cfg->exponent_x10 / 10.0f : 1.0f;
+    float scale = (float)cfg->max_speed * (1 << JOYSTICK_CURVE_FRAC_BITS);
+
+    curve->radial = cfg->radial_deadzone;
+    for (int i = 0; i <= JOYSTICK_CURVE_LUT_SIZE; i++) {
+        float m = (float)i / JOYSTICK_CURVE_LUT_SIZE;
+        float t = (m <= deadzone) ? 0.0f : (m - deadzone) / (1.0f - deadzone);
+
+        float f;
+        switch (cfg->type) {
+            case JOYSTICK_CURVE_POWER:
+                f = powf(t, exponent);
+                break;
+            case JOYSTICK_CURVE_SCURVE:
+                f = t * t * (3.0f - 2.0f * t);
+                break;
+            default:
+                f = t;
+                break;
+        }
+        curve->lut[i] = (uint16_t)lroundf(f * scale);
+    }
+}
+
+/**
+ * @brief Scale a centered axis value of the given resolution to Q15
+ *
+ * The largest positive value of the axis maps to JOYSTICK_CURVE_Q15_MAX, so
+ * full deflection reaches max_speed whatever the resolution.
+ */
+int32_t joystick_curve_normalize(int32_t value, int bits) {
+    if (bits <= 1) return 0;
+    int32_t q;
+    if (bits <= 16) {
+        q = value * JOYSTICK_CURVE_Q15_MAX / ((1 << (bits - 1)) - 1);  // fits in 32 bits
+    } else {
+        if (bits > 32) bits = 32;
+        q = (int32_t)((int64_t)value * JOYSTICK_CURVE_Q15_MAX / (((int64_t)1 << (bits - 1)) - 1));
+    }
+    if (q > JOYSTICK_CURVE_Q15_MAX) q = JOYSTICK_CURVE_Q15_MAX;
+    if (q < -JOYSTICK_CURVE_Q15_MAX) q = -JOYSTICK_CURVE_Q15_MAX;
+    return q;
+}
+
+// Integer square root, bounded to 16 iterations
+static uint32_t isqrt32(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) bit >>= 2;
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * @brief Map a stick deflection to a pointer speed
+ *
+ * With an axial deadzone each axis goes through the curve on its own. With a
+ * radial deadzone the curve is applied to the length of the stick vector and
+ * the direction is kept, so diagonals are not faster than straight motion.
+ *
+ * @param[in]  curve    Lookup table
+ * @param[in]  x        X deflection in Q15
+ * @param[in]  y        Y deflection in Q15
+ * @param[out] speed_x  X speed in 1/256 pixel per report
+ * @param[out] speed_y  Y speed in 1/256 pixel per report
+ */
+void joystick_curve_apply(const joystick_curve_t* curve, int32_t x, int32_t y,
+                          int32_t* speed_x, int32_t* speed_y) {
+    if (!curve->radial) {
+        int32_t sx = joystick_curve_lookup(curve, (uint32_t)(x < 0 ? -x : x));
+        int32_t sy = joystick_curve_lookup(curve, (uint32_t)(y < 0 ? -y : y));
+        *speed_x = (x < 0) ? -sx : sx;
+        *speed_y = (y < 0) ? -sy : sy;
+        return;
+    }
+
+    uint32_t mag = isqrt32((uint32_t)(x * x) + (uint32_t)(y * y));
+    if (mag == 0) {
+        *speed_x = *speed_y = 0;
+        return;
+    }
+    int32_t speed = joystick_curve_lookup(
+        curve, (mag > JOYSTICK_CURVE_Q15_MAX) ? JOYSTICK_CURVE_Q15_MAX : mag);
+    *speed_x = (int32_t)((int64_t)x * speed / (int32_t)mag);
+    *speed_y = (int32_t)((int64_t)y * speed / (int32_t)mag);
+}
+
+/**
+ * @brief Add one report worth of speed and take out the whole pixels
+ *
+ * The fraction is kept for the next report, so slow deflections still move
+ * the pointer. It is dropped when the stick is back in the deadzone, so a
+ * released stick does not move the pointer any further.
+ *
+ * @param[in,out] motion   Sub-pixel residuals
+ * @param[in]     speed_x  X speed in 1/256 pixel per report
+ * @param[in]     speed_y  Y speed in 1/256 pixel per report
+ * @param[out]    dx       X displacement in pixels
+ * @param[out]    dy       Y displacement in pixels
+ */
+void joystick_motion_step(joystick_motion_t* motion, int32_t speed_x, int32_t speed_y,
+                          int16_t* dx, int16_t* dy) {
+    const int32_t one = 1 << JOYSTICK_CURVE_FRAC_BITS;
+
+    motion->residual_x = (speed_x == 0) ? 0 : motion->residual_x + speed_x;
+    motion->residual_y = (speed_y == 0) ? 0 : motion->residual_y + speed_y;
+
+    // division truncates toward zero, so both directions behave the same
+    int32_t px = motion->residual_x / one;
+    int32_t py = motion->residual_y / one;
+    motion->residual_x -= px * one;
+    motion->residual_y -= py * one;
+    *dx = (int16_t)px;
+    *dy = (int16_t)py;
+}
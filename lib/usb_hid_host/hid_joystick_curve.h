@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+// Stick deflection is normalized to Q15 (-32767..32767) before the curve is applied
+#define JOYSTICK_CURVE_Q15_MAX 32767
+
+// Lookup table over the deflection magnitude, linearly interpolated between entries
+#define JOYSTICK_CURVE_LUT_BITS 6
+#define JOYSTICK_CURVE_LUT_SIZE (1 << JOYSTICK_CURVE_LUT_BITS)
+
+// Speeds are in 1/256 pixel per report
+#define JOYSTICK_CURVE_FRAC_BITS 8
+
+typedef enum {
+    JOYSTICK_CURVE_LINEAR = 0,
+    JOYSTICK_CURVE_POWER,   // speed grows with deflection^exponent, fine control near the center
+    JOYSTICK_CURVE_SCURVE,  // smoothstep: slow near the center, flat near full deflection
+} joystick_curve_type_t;
+
+// Response curve settings, turned into a lookup table by joystick_curve_build()
+typedef struct {
+    joystick_curve_type_t type;
+    uint8_t max_speed;           // pixels per report at full deflection
+    uint16_t deadzone_permille;  // of full deflection
+    bool radial_deadzone;        // deadzone on the stick vector instead of each axis
+    uint8_t exponent_x10;        // exponent of JOYSTICK_CURVE_POWER, 20 = quadratic
+} joystick_curve_config_t;
+
+typedef struct {
+    bool radial;
+    uint16_t lut[JOYSTICK_CURVE_LUT_SIZE + 1];  // speed for magnitude i / LUT_SIZE
+} joystick_curve_t;
+
+// Motion state of one joystick, sub-pixel motion is carried over to the next report
+typedef struct {
+    int32_t residual_x;
+    int32_t residual_y;
+    uint8_t buttons;          // of the previous report
+    bool timed;               // last_report_us is set
+    uint32_t last_report_us;  // arrival of the previous report
+    uint32_t report_us;       // measured report interval, 0 until measured
+} joystick_motion_t;
+
+void joystick_curve_build(joystick_curve_t* curve, const joystick_curve_config_t* cfg);
+int32_t joystick_curve_normalize(int32_t value, int bits);
+void joystick_curve_apply(const joystick_curve_t* curve, int32_t x, int32_t y,
+                          int32_t* speed_x, int32_t* speed_y);
+void joystick_motion_step(joystick_motion_t* motion, int32_t speed_x, int32_t speed_y,
+                          int16_t* dx, int16_t* dy);
+
+/**
+ * @brief Speed for a deflection magnitude, interpolated from the lookup table
+ *
+ * @param[in] curve  Lookup table
+ * @param[in] mag    Deflection magnitude in Q15, 0..JOYSTICK_CURVE_Q15_MAX
+ * @return Speed in 1/256 pixel per report
+ */
+static inline int32_t joystick_curve_lookup(const joystick_curve_t* curve, uint32_t mag) {
+    const int shift = 15 - JOYSTICK_CURVE_LUT_BITS;
+    if (mag >= JOYSTICK_CURVE_Q15_MAX) return curve->lut[JOYSTICK_CURVE_LUT_SIZE];
+    uint32_t i = mag >> shift;
+    uint32_t frac = mag & ((1u << shift) - 1);
+    int32_t a = curve->lut[i];
+    int32_t b = curve->lut[i + 1];
+    return a + (((b - a) * (int32_t)frac) >> shift);
+}
@@ -0,0 +1,70 @@
+#include <string.h>
+#include "hid_key_bitmap.h"
+#include "hid_usage_keyboard.h"
+
+void hid_key_bitmap_clear(hid_key_bitmap_t* b) {
+    memset(b, 0, sizeof(*b));
+}
+
+/**
+ * @brief Build a key set from a key array (boot protocol style report)
+ *
+ * Empty slots and error codes (usages up to HID_KEY_ERROR_UNDEFINED) are ignored.
+ *
+ * @param[out] b      Key set
+ * @param[in]  keys   Key array
+ * @param[in]  count  Number of entries of the key array
+ */
+void hid_key_bitmap_from_keys(hid_key_bitmap_t* b, const uint8_t* keys, int count) {
+    hid_key_bitmap_clear(b);
+    for (int i = 0; i < count; i++) {
+        if (keys[i] > HID_KEY_ERROR_UNDEFINED) hid_key_bitmap_set(b, keys[i]);
+    }
+}
+
+/**
+ * @brief Compare two key sets
+ *
+ * @param[in]  prev      Keys of the previous report
+ * @param[in]  cur       Keys of the current report
+ * @param[out] pressed   Keys in cur but not in prev, may be NULL
+ * @param[out] released  Keys in prev but not in cur, may be NULL
+ * @return true if the key sets differ
+ */
+bool hid_key_bitmap_diff(const hid_key_bitmap_t* prev, const hid_key_bitmap_t* cur,
+                         hid_key_bitmap_t* pressed, hid_key_bitmap_t* released) {
+    uint32_t changed = 0;
+    for (int i = 0; i < HID_KEY_BITMAP_WORDS; i++) {
+        uint32_t x = prev->w[i] ^ cur->w[i];
+        if (pressed) pressed->w[i] = x & cur->w[i];
+        if (released) released->w[i] = x & prev->w[i];
+        changed |= x;
+    }
+    return changed != 0;
+}
+
+/**
+ * @brief Find the next key of a key set, in ascending usage order
+ *
+ * @param[in] b     Key set
+ * @param[in] from  First usage to look at
+ * @return Usage of the next key, or -1 if there is none
+ */
+int hid_key_bitmap_next(const hid_key_bitmap_t* b, int from) {
+    if (from < 0) from = 0;
+    for (int i = from >> 5; i < HID_KEY_BITMAP_WORDS; i++) {
+        uint32_t word = b->w[i];
+        if (i == (from >> 5)) word &= ~0u << (from & 31);
+        if (word) return (i << 5) + __builtin_ctz(word);
+    }
+    return -1;
+}
+
+/**
+ * @brief Number of keys in a key set
+ */
+int hid_key_bitmap_count(const hid_key_bitmap_t* b) {
+    int count = 0;
+    for (int i = 0; i < HID_KEY_BITMAP_WORDS; i++) count += __builtin_popcount(b->w[i]);
+    return count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// One bit per key usage of the keyboard usage page (0x00..0xFF)
+#define HID_KEY_BITMAP_WORDS 8
+
+/**
+ * @brief Set of pressed keys, bit n is set if the key with usage n is pressed
+ *
+ * Comparing two key sets takes a few word-wise XORs, independent of how many
+ * keys are pressed.
+ */
+typedef struct {
+    uint32_t w[HID_KEY_BITMAP_WORDS];
+} hid_key_bitmap_t;
+
+static inline void hid_key_bitmap_set(hid_key_bitmap_t* b, uint8_t key) {
+    b->w[key >> 5] |= 1u << (key & 31);
+}
+
+static inline bool hid_key_bitmap_test(const hid_key_bitmap_t* b, uint8_t key) {
+    return (b->w[key >> 5] >> (key & 31)) & 1u;
+}
+
+/**
+ * @brief Add up to 32 keys with consecutive usages, e.g. one word of an NKRO bitmap
+ *
+ * @param[in,out] b      Key set
+ * @param[in]     first  Usage of bit 0 of 'bits'
+ * @param[in]     bits   One bit per key
+ * @param[in]     count  Number of valid bits
+ */
+static inline void hid_key_bitmap_or_bits(hid_key_bitmap_t* b, int first, uint32_t bits, int count) {
+    if (count < 32) bits &= (1u << count) - 1;
+    if (first < 0 || first > 255 || bits == 0) return;
+    int word = first >> 5, shift = first & 31;
+    b->w[word] |= bits << shift;
+    if (shift != 0 && word + 1 < HID_KEY_BITMAP_WORDS) b->w[word + 1] |= bits >> (32 - shift);
+}
+
+void hid_key_bitmap_clear(hid_key_bitmap_t* b);
+void hid_key_bitmap_from_keys(hid_key_bitmap_t* b, const uint8_t* keys, int count);
+bool hid_key_bitmap_diff(const hid_key_bitmap_t* prev, const hid_key_bitmap_t* cur,
+                         hid_key_bitmap_t* pressed, hid_key_bitmap_t* released);
+int hid_key_bitmap_next(const hid_key_bitmap_t* b, int from);
+int hid_key_bitmap_count(const hid_key_bitmap_t* b);
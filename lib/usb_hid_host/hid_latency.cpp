@@ -0,0 +1,93 @@
+#include <esp_log.h>
+#include "hid_latency.h"
+
+static const char* TAG = "hid-latency";
+
+static const char* stage_names[HID_LATENCY_STAGES] = {"decode", "notify", "callback", "total"};
+
+// Written by the sender task only, read on demand (a snapshot)
+static hid_latency_hist_t latency_hist[HID_LATENCY_STAGES];
+
+// Timestamps of the report which is currently delivered by the sender task
+static uint32_t current_arrival_us = 0;
+static uint32_t current_decoded_us = 0;
+static bool current_notified = false;
+static bool current_active = false;  // between hid_latency_begin() and hid_latency_end()
+
+hid_latency_hist_t* get_hid_latency_hist(int stage) { return &latency_hist[stage]; }
+
+/**
+ * @brief Start delivering a report, called by the sender task before the callback
+ *
+ * @param[in] arrival_us  USB arrival timestamp of the report
+ * @param[in] decoded_us  Decode done timestamp of the report
+ */
+void hid_latency_begin(uint32_t arrival_us, uint32_t decoded_us) {
+    current_arrival_us = arrival_us;
+    current_decoded_us = decoded_us;
+    current_notified = false;
+    current_active = true;
+    hid_latency_hist_add(&latency_hist[HID_LATENCY_STAGE_DECODE], decoded_us - arrival_us);
+}
+
+/**
+ * @brief A notification for the current report was handed to the BLE stack,
+ * called from the callback (only the first notification per report is counted)
+ *
+ * Ignored outside of a callback, e.g. for reports which waited for a congested
+ * link and are retried by the sender task: their timestamps are gone.
+ */
+void hid_latency_stamp_notify() {
+    if (!current_active || current_notified) return;
+    current_notified = true;
+    uint32_t now = hid_latency_now();
+    hid_latency_hist_add(&latency_hist[HID_LATENCY_STAGE_NOTIFY], now - current_decoded_us);
+    hid_latency_hist_add(&latency_hist[HID_LATENCY_STAGE_TOTAL], now - current_arrival_us);
+}
+
+/**
+ * @brief The callback returned, called by the sender task
+ */
+void hid_latency_end() {
+    current_active = false;
+    hid_latency_hist_add(&latency_hist[HID_LATENCY_STAGE_CALLBACK],
+                         hid_latency_now() - current_decoded_us);
+}
+
+/**
+ * @brief The next callback delivers a report without USB timestamps (e.g.
+ * generated motion), its notification is not counted
+ */
+void hid_latency_skip() {
+    current_arrival_us = hid_latency_now();
+    current_notified = true;
+}
+
+/**
+ * @brief USB arrival timestamp of the report which is currently delivered,
+ * the time of the callback for generated motion
+ */
+uint32_t hid_latency_arrival_us() {
+    return current_arrival_us;
+}
+
+/**
+ * @brief Clear all histograms
+ */
+void hid_latency_reset() {
+    for (int i = 0; i < HID_LATENCY_STAGES; i++) hid_latency_hist_reset(&latency_hist[i]);
+}
+
+/**
+ * @brief Log count, p50, p99 and max of every stage
+ */
+void hid_latency_log() {
+    for (int i = 0; i < HID_LATENCY_STAGES; i++) {
+        const hid_latency_hist_t* hist = &latency_hist[i];
+        ESP_LOGI(TAG, "%-8s n=%lu p50=%luus p99=%luus max=%luus", stage_names[i],
+                 (unsigned long)hist->total,
+                 (unsigned long)hid_latency_hist_percentile(hist, 500),
+                 (unsigned long)hid_latency_hist_percentile(hist, 990),
+                 (unsigned long)hist->max_us);
+    }
+}
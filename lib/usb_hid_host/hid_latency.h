@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <esp_timer.h>
+#include "hid_latency_hist.h"
+
+// Stages of the report pipeline, measured between the timestamps
+// USB arrival -> decode done -> notification queued / callback done
+#define HID_LATENCY_STAGE_DECODE    0  // USB arrival to decode done
+#define HID_LATENCY_STAGE_NOTIFY    1  // decode done to notification queued (includes the event ring)
+#define HID_LATENCY_STAGE_CALLBACK  2  // decode done to callback done
+#define HID_LATENCY_STAGE_TOTAL     3  // USB arrival to notification queued
+#define HID_LATENCY_STAGES          4
+
+// Microsecond timestamp, wraps after ~71 minutes (differences stay correct)
+static inline uint32_t hid_latency_now() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+void hid_latency_begin(uint32_t arrival_us, uint32_t decoded_us);
+void hid_latency_stamp_notify();
+void hid_latency_end();
+void hid_latency_skip();
+uint32_t hid_latency_arrival_us();
+
+hid_latency_hist_t* get_hid_latency_hist(int stage);
+void hid_latency_reset();
+void hid_latency_log();
@@ -0,0 +1,42 @@
+#include <string.h>
+#include "hid_latency_hist.h"
+
+void hid_latency_hist_reset(hid_latency_hist_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * @brief Largest value which falls into a bucket
+ */
+uint32_t hid_latency_bucket_upper(int bucket) {
+    if (bucket < 4) return (uint32_t)bucket;
+    int msb = bucket / 4 + 1;
+    uint32_t lower = (uint32_t)(4 + bucket % 4) << (msb - 2);
+    return lower + (1u << (msb - 2)) - 1;
+}
+
+/**
+ * @brief Latency below which the given share of all values lies
+ *
+ * @param[in] hist      Histogram
+ * @param[in] permille  Share in 1/1000, e.g. 500 for p50, 990 for p99
+ * @return Upper bound of the bucket holding the percentile (at most the
+ *         maximum), 0 if the histogram is empty
+ */
+uint32_t hid_latency_hist_percentile(const hid_latency_hist_t* hist, uint32_t permille) {
+    if (hist->total == 0) return 0;
+
+    // rank of the value, rounded up
+    uint64_t rank = ((uint64_t)hist->total * permille + 999) / 1000;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HID_LATENCY_BUCKETS; b++) {
+        seen += hist->counts[b];
+        if (seen >= rank) {
+            uint32_t upper = hid_latency_bucket_upper(b);
+            return (upper < hist->max_us) ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
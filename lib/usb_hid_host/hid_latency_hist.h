@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// Log-scale buckets: 0..3 us exact, then 4 buckets per power of two up to ~33 s
+#define HID_LATENCY_BUCKETS 96
+
+/**
+ * @brief Histogram of latencies in microseconds
+ *
+ * Bucket widths grow with the value (about 25% relative resolution), so a
+ * fixed number of counters covers microseconds to seconds.
+ */
+typedef struct {
+    uint32_t counts[HID_LATENCY_BUCKETS];
+    uint32_t total;
+    uint32_t max_us;
+} hid_latency_hist_t;
+
+static inline int hid_latency_bucket(uint32_t us) {
+    if (us < 4) return (int)us;
+    int msb = 31 - __builtin_clz(us);
+    int bucket = (msb - 1) * 4 + (int)((us >> (msb - 2)) & 3);
+    return (bucket < HID_LATENCY_BUCKETS) ? bucket : HID_LATENCY_BUCKETS - 1;
+}
+
+static inline void hid_latency_hist_add(hid_latency_hist_t* hist, uint32_t us) {
+    hist->counts[hid_latency_bucket(us)]++;
+    hist->total++;
+    if (us > hist->max_us) hist->max_us = us;
+}
+
+void hid_latency_hist_reset(hid_latency_hist_t* hist);
+uint32_t hid_latency_bucket_upper(int bucket);
+uint32_t hid_latency_hist_percentile(const hid_latency_hist_t* hist, uint32_t permille);
@@ -0,0 +1,157 @@
+#include "hid_motion_gen.h"
+
+/**
+ * @brief Set up an idle generator
+ *
+ * @param[out] gen                 Generator
+ * @param[in]  period_us           Tick interval, e.g. the BLE connection interval
+ * @param[in]  scroll_interval_us  Wheel repeat interval while the hat is held
+ */
+void hid_motion_gen_init(hid_motion_gen_t* gen, uint32_t period_us, uint32_t scroll_interval_us) {
+    gen->speed_x.store(0, std::memory_order_relaxed);
+    gen->speed_y.store(0, std::memory_order_relaxed);
+    gen->report_us.store(0, std::memory_order_relaxed);
+    gen->scroll.store(0, std::memory_order_relaxed);
+    gen->buttons.store(0, std::memory_order_relaxed);
+    gen->period_us.store(period_us, std::memory_order_relaxed);
+    gen->scroll_interval_us = scroll_interval_us;
+    gen->running = false;
+    gen->last_us = 0;
+    gen->residual_x = gen->residual_y = 0;
+    gen->prev_scroll = 0;
+    gen->next_scroll_us = 0;
+}
+
+/**
+ * @brief Store the latest stick state, called by the decoder on every report
+ *
+ * X and Y are stored separately, a tick in between may see the new X with the
+ * old Y for one interval.
+ *
+ * @param[in] gen        Generator
+ * @param[in] speed_x    X speed in 1/256 pixel per report
+ * @param[in] speed_y    Y speed in 1/256 pixel per report
+ * @param[in] report_us  Report interval of the device, 0 if not measured yet
+ * @param[in] scroll     Hat scroll direction, -1, 0 or 1
+ * @param[in] buttons    Buttons sent with the generated motion
+ * @return true if the generator was idle and has to be woken up
+ */
+bool hid_motion_gen_set(hid_motion_gen_t* gen, int32_t speed_x, int32_t speed_y,
+                        uint32_t report_us, int8_t scroll, uint8_t buttons) {
+    bool was_active = hid_motion_gen_active(gen);
+    gen->buttons.store(buttons, std::memory_order_relaxed);
+    gen->report_us.store(report_us, std::memory_order_relaxed);
+    gen->speed_x.store(speed_x, std::memory_order_relaxed);
+    gen->speed_y.store(speed_y, std::memory_order_relaxed);
+    gen->scroll.store(scroll, std::memory_order_release);
+    return !was_active && hid_motion_gen_active(gen);
+}
+
+/**
+ * @brief Is the stick or hat deflected, i.e. does the generator need ticks?
+ */
+bool hid_motion_gen_active(const hid_motion_gen_t* gen) {
+    if (gen->period_us.load(std::memory_order_relaxed) == 0) return false;
+    return gen->speed_x.load(std::memory_order_relaxed) != 0 ||
+           gen->speed_y.load(std::memory_order_relaxed) != 0 ||
+           gen->scroll.load(std::memory_order_relaxed) != 0;
+}
+
+/**
+ * @brief Integrate the motion since the previous tick
+ *
+ * The first tick after the stick was deflected emits one period of motion,
+ * later ticks emit the motion for the time which actually passed, so a late
+ * tick does not slow the pointer down. A released stick stops at once, the
+ * sub-pixel remainder is dropped.
+ *
+ * @param[in]  gen     Generator
+ * @param[in]  now_us  Current time
+ * @param[out] dx      X displacement in pixels
+ * @param[out] dy      Y displacement in pixels
+ * @param[out] wheel   Scroll wheel steps
+ * @return true if there is motion or scrolling to send
+ */
+bool hid_motion_gen_tick(hid_motion_gen_t* gen, uint32_t now_us, int16_t* dx, int16_t* dy,
+                         int8_t* wheel) {
+    const int32_t one = 256;
+    int8_t scroll = gen->scroll.load(std::memory_order_acquire);
+    int32_t speed_x = gen->speed_x.load(std::memory_order_relaxed);
+    int32_t speed_y = gen->speed_y.load(std::memory_order_relaxed);
+    uint32_t report_us = gen->report_us.load(std::memory_order_relaxed);
+    uint32_t period_us = gen->period_us.load(std::memory_order_relaxed);
+    *dx = *dy = 0;
+    *wheel = 0;
+
+    if (period_us == 0 || (speed_x == 0 && speed_y == 0 && scroll == 0)) {
+        gen->running = false;
+        gen->residual_x = gen->residual_y = 0;
+        gen->prev_scroll = 0;
+        return false;
+    }
+
+    if (!gen->running) {
+        gen->running = true;
+        gen->last_us = now_us - period_us;
+    }
+    uint32_t elapsed = now_us - gen->last_us;
+    gen->last_us = now_us;
+    uint32_t max_elapsed = period_us * HID_MOTION_MAX_STEPS;
+    if (elapsed > max_elapsed) elapsed = max_elapsed;
+    if (report_us == 0) report_us = HID_MOTION_REF_US;
+
+    // speed is per report, 64 bit as speed * elapsed exceeds 32 bit after ~30 ms
+    if (speed_x == 0) gen->residual_x = 0;
+    if (speed_y == 0) gen->residual_y = 0;
+    gen->residual_x += (int32_t)((int64_t)speed_x * elapsed / report_us);
+    gen->residual_y += (int32_t)((int64_t)speed_y * elapsed / report_us);
+    int32_t px = gen->residual_x / one;
+    int32_t py = gen->residual_y / one;
+    gen->residual_x -= px * one;
+    gen->residual_y -= py * one;
+    *dx = (int16_t)px;
+    *dy = (int16_t)py;
+
+    // first wheel step when the hat is pressed, then one per interval
+    if (scroll != gen->prev_scroll) {
+        gen->prev_scroll = scroll;
+        gen->next_scroll_us = now_us;
+    }
+    if (scroll != 0 && (int32_t)(now_us - gen->next_scroll_us) >= 0) {
+        *wheel = scroll;
+        gen->next_scroll_us += gen->scroll_interval_us;
+        if ((int32_t)(now_us - gen->next_scroll_us) >= 0) {
+            gen->next_scroll_us = now_us + gen->scroll_interval_us;  // fell behind, no burst
+        }
+    }
+
+    return *dx != 0 || *dy != 0 || *wheel != 0;
+}
+
+/**
+ * @brief Time of the next tick
+ */
+uint32_t hid_motion_gen_next_us(const hid_motion_gen_t* gen, uint32_t now_us) {
+    if (!gen->running) return now_us;
+    uint32_t next = gen->last_us + gen->period_us.load(std::memory_order_relaxed);
+    return ((int32_t)(next - now_us) > 0) ? next : now_us;
+}
+
+/**
+ * @brief Update the measured report interval of a device
+ *
+ * Smoothed over the last few reports. Pauses of a device which stops
+ * reporting while the stick is held, and reports queued up behind each other,
+ * are not counted.
+ *
+ * @param[in] report_us  Interval so far, 0 if not measured yet
+ * @param[in] delta_us   Time since the previous report
+ * @return New interval, 0 while none was measured
+ */
+uint32_t hid_motion_gen_report_interval(uint32_t report_us, uint32_t delta_us) {
+    if (delta_us < HID_MOTION_MIN_REPORT_US || delta_us > HID_MOTION_MAX_REPORT_US) {
+        return report_us;
+    }
+    if (report_us == 0) return delta_us;
+    return (3 * report_us + delta_us) / 4;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Report interval assumed until the reports of a joystick were timed
+#define HID_MOTION_REF_US 10000
+
+// Intervals outside this range are bursts or pauses, not the report rate
+#define HID_MOTION_MIN_REPORT_US 500
+#define HID_MOTION_MAX_REPORT_US 50000
+
+// Longest interval which is integrated at once, e.g. after the sender task was blocked
+#define HID_MOTION_MAX_STEPS 4
+
+/**
+ * @brief Motion generator for held joysticks
+ *
+ * The joystick decoder stores the latest stick speed, hat scroll direction and
+ * buttons; the sender task calls hid_motion_gen_tick() at a fixed rate and
+ * gets the motion integrated over the time which actually passed. The pointer
+ * keeps moving while the stick is held, even if the device stops sending
+ * reports. Time is passed in, so the generator runs on a virtual clock too.
+ *
+ * Speeds come from the joystick curve, in 1/256 pixel per report of the
+ * device; with the device's report interval they are turned into motion per
+ * microsecond, so a held stick moves as fast as it did with one step per report.
+ */
+typedef struct {
+    // written by the decoder
+    std::atomic<int32_t> speed_x;     // 1/256 pixel per report_us
+    std::atomic<int32_t> speed_y;
+    std::atomic<uint32_t> report_us;  // report interval of the device
+    std::atomic<int8_t> scroll;       // -1, 0 or 1 while the hat is held
+    std::atomic<uint8_t> buttons;
+
+    // written by set_joystick_motion_period()
+    std::atomic<uint32_t> period_us;  // tick interval, 0 = disabled
+
+    // owned by the ticking task
+    uint32_t scroll_interval_us;  // one wheel step per interval while the hat is held
+    bool running;
+    uint32_t last_us;
+    int32_t residual_x;
+    int32_t residual_y;
+    int8_t prev_scroll;
+    uint32_t next_scroll_us;
+} hid_motion_gen_t;
+
+void hid_motion_gen_init(hid_motion_gen_t* gen, uint32_t period_us, uint32_t scroll_interval_us);
+bool hid_motion_gen_set(hid_motion_gen_t* gen, int32_t speed_x, int32_t speed_y,
+                        uint32_t report_us, int8_t scroll, uint8_t buttons);
+bool hid_motion_gen_active(const hid_motion_gen_t* gen);
+bool hid_motion_gen_tick(hid_motion_gen_t* gen, uint32_t now_us, int16_t* dx, int16_t* dy,
+                         int8_t* wheel);
+uint32_t hid_motion_gen_next_us(const hid_motion_gen_t* gen, uint32_t now_us);
+uint32_t hid_motion_gen_report_interval(uint32_t report_us, uint32_t delta_us);
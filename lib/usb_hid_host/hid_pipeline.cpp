@@ -0,0 +1,26 @@
+#include <string.h>
+#include <esp_log.h>
+#include "hid_pipeline.h"
+
+static const char* TAG = "hid-pipeline";
+
+// Written by the sender task only (when built with HID_PIPELINE_PROFILE)
+static hid_pipeline_stage_stats_t pipeline_stats[HID_PIPELINE_MAX_STAGES];
+
+hid_pipeline_stage_stats_t* get_hid_pipeline_stats() { return pipeline_stats; }
+
+void hid_pipeline_stats_reset() {
+    memset(pipeline_stats, 0, sizeof(pipeline_stats));
+}
+
+/**
+ * @brief Log the average and maximum cycles of every stage which ran
+ */
+void hid_pipeline_stats_log() {
+    for (int i = 0; i < HID_PIPELINE_MAX_STAGES; i++) {
+        const hid_pipeline_stage_stats_t* s = &pipeline_stats[i];
+        if (s->calls == 0) continue;
+        ESP_LOGI(TAG, "stage %d: n=%lu avg=%lu max=%lu cycles", i, (unsigned long)s->calls,
+                 (unsigned long)(s->cycles / s->calls), (unsigned long)s->max_cycles);
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "usb_hid_host.h"
+#include "hid_tremor_filter.h"
+#include "hid_latency.h"
+
+/*
+ * Processing of unified hidData reports, composed at compile time:
+ *
+ *   static hid_pipeline<hid_stage_invert<false, true>, hid_stage_button_map<1, 0, 2> > pipeline;
+ *   pipeline.apply(hidData);
+ *
+ * Every stage is a struct with an apply() member, the pipeline calls them in
+ * order. All calls are resolved at compile time and inlined, no allocation,
+ * no function pointers. Stages with state (scaling remainders, filters) keep
+ * it as members.
+ *
+ * Stages see mouse motion only. Joystick deadzones and scaling are applied by
+ * the decoder (hid_joystick_curve.h), on the axis values, before generated
+ * motion of a held stick exists.
+ *
+ * Build with -DHID_PIPELINE_PROFILE to count the CPU cycles of each stage,
+ * see get_hid_pipeline_stats().
+ */
+
+#define HID_PIPELINE_MAX_STAGES 8
+
+typedef struct {
+    uint32_t calls;
+    uint32_t cycles;      // sum over all calls
+    uint32_t max_cycles;
+} hid_pipeline_stage_stats_t;
+
+hid_pipeline_stage_stats_t* get_hid_pipeline_stats();
+void hid_pipeline_stats_reset();
+void hid_pipeline_stats_log();
+
+#ifdef HID_PIPELINE_PROFILE
+#ifdef ESP_PLATFORM
+#include <esp_cpu.h>
+static inline uint32_t hid_pipeline_cycles() { return esp_cpu_get_ccount(); }
+#else
+#include <chrono>
+static inline uint32_t hid_pipeline_cycles() {  // nanoseconds on a host build
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+#endif
+
+template <int INDEX, typename... Stages>
+struct hid_pipeline_impl {
+    inline void apply(unified_hidData_t*) {}
+};
+
+template <int INDEX, typename First, typename... Rest>
+struct hid_pipeline_impl<INDEX, First, Rest...> {
+    First stage;
+    hid_pipeline_impl<INDEX + 1, Rest...> rest;
+
+    inline void apply(unified_hidData_t* d) {
+#ifdef HID_PIPELINE_PROFILE
+        uint32_t start = hid_pipeline_cycles();
+        stage.apply(d);
+        if (INDEX < HID_PIPELINE_MAX_STAGES) {
+            uint32_t cycles = hid_pipeline_cycles() - start;
+            hid_pipeline_stage_stats_t* s = &get_hid_pipeline_stats()[INDEX];
+            s->calls++;
+            s->cycles += cycles;
+            if (cycles > s->max_cycles) s->max_cycles = cycles;
+        }
+#else
+        stage.apply(d);
+#endif
+        rest.apply(d);
+    }
+};
+
+template <typename... Stages>
+struct hid_pipeline : hid_pipeline_impl<0, Stages...> {};
+
+// ---- Stages ----
+
+// Drop motion of at most N counts per axis, e.g. jitter of a worn sensor
+template <int N>
+struct hid_stage_deadzone {
+    inline void apply(unified_hidData_t* d) {
+        if (abs(d->x_displacement) <= N) d->x_displacement = 0;
+        if (abs(d->y_displacement) <= N) d->y_displacement = 0;
+    }
+};
+
+// Scale motion by NUM / DEN, remainders are carried to the next report
+template <int NUM, int DEN>
+struct hid_stage_scale {
+    int32_t residual_x = 0;
+    int32_t residual_y = 0;
+
+    static inline int16_t scale(int16_t v, int32_t* residual) {
+        int32_t acc = (int32_t)v * NUM + *residual;
+        int32_t out = acc / DEN;
+        *residual = acc - out * DEN;
+        if (out > INT16_MAX) out = INT16_MAX;
+        if (out < INT16_MIN) out = INT16_MIN;
+        return (int16_t)out;
+    }
+    inline void apply(unified_hidData_t* d) {
+        d->x_displacement = scale(d->x_displacement, &residual_x);
+        d->y_displacement = scale(d->y_displacement, &residual_y);
+    }
+};
+
+// Exchange X and Y, e.g. for a device mounted sideways
+struct hid_stage_swap_xy {
+    inline void apply(unified_hidData_t* d) {
+        int16_t x = d->x_displacement;
+        d->x_displacement = d->y_displacement;
+        d->y_displacement = x;
+    }
+};
+
+template <bool X, bool Y, bool WHEEL = false>
+struct hid_stage_invert {
+    inline void apply(unified_hidData_t* d) {
+        if (X) d->x_displacement = (int16_t)-d->x_displacement;
+        if (Y) d->y_displacement = (int16_t)-d->y_displacement;
+        if (WHEEL) d->scroll_wheel = (int8_t)-d->scroll_wheel;
+    }
+};
+
+// Bits of hid_stage_button_map, unrolled at compile time
+template <unsigned I, uint8_t... MAP>
+struct hid_button_map_bits {
+    static inline uint8_t get(uint8_t) { return 0; }
+};
+
+template <unsigned I, uint8_t FROM, uint8_t... REST>
+struct hid_button_map_bits<I, FROM, REST...> {
+    static inline uint8_t get(uint8_t in) {
+        return (uint8_t)((((in >> FROM) & 1u) << I) | hid_button_map_bits<I + 1, REST...>::get(in));
+    }
+};
+
+// Output button i is input button MAP[i] (0 based), e.g. <1, 0, 2> swaps left and right
+template <uint8_t... MAP>
+struct hid_stage_button_map {
+    inline void apply(unified_hidData_t* d) {
+        uint8_t in = d->buttons.val;
+        uint8_t kept = in & (uint8_t)(0xFF << sizeof...(MAP));  // unmapped buttons stay
+        d->buttons.val = kept | hid_button_map_bits<0, MAP...>::get(in);
+    }
+};
+
+// Adaptive tremor filter, settings as in hid_tremor_filter_config_t
+template <uint16_t MIN_CUTOFF_X100, uint16_t BETA_X10000, uint16_t DCUTOFF_X100 = 100>
+struct hid_stage_tremor {
+    hid_tremor_filter_t filter;
+
+    hid_stage_tremor() {
+        hid_tremor_filter_config_t cfg = {MIN_CUTOFF_X100, BETA_X10000, DCUTOFF_X100};
+        hid_tremor_filter_init(&filter, &cfg);
+    }
+    inline void apply(unified_hidData_t* d) {
+        int16_t dx = d->x_displacement;  // aligned copies, the report is packed
+        int16_t dy = d->y_displacement;
+        hid_tremor_filter_apply(&filter, hid_latency_arrival_us(), &dx, &dy);
+        d->x_displacement = dx;
+        d->y_displacement = dy;
+    }
+};
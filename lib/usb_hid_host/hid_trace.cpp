@@ -0,0 +1,138 @@
+#include <string.h>
+#include "hid_trace.h"
+
+static_assert((HID_TRACE_RING_CAPACITY & (HID_TRACE_RING_CAPACITY - 1)) == 0,
+              "HID_TRACE_RING_CAPACITY must be a power of two");
+
+/**
+ * Bounded ring for several producers (USB task, sender task) and one consumer
+ * (drain task). Each slot has a sequence number: a producer owns the slot
+ * after claiming 'head' while seq == position, the consumer may read it once
+ * seq == position + 1.
+ */
+typedef struct {
+    std::atomic<uint32_t> seq;
+    hid_trace_record_t rec;
+} hid_trace_slot_t;
+
+static hid_trace_slot_t trace_slots[HID_TRACE_RING_CAPACITY];
+static std::atomic<uint32_t> trace_head(0);
+static uint32_t trace_tail = 0;  // consumer only
+static std::atomic<uint32_t> trace_dropped(0);
+
+std::atomic<uint32_t> hid_trace_mask(HID_TRACE_CAT_ALL);
+
+/**
+ * @brief Reset the trace ring, must be called before the first record is written
+ */
+void hid_trace_init() {
+    for (uint32_t i = 0; i < HID_TRACE_RING_CAPACITY; i++) {
+        trace_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    trace_head.store(0, std::memory_order_relaxed);
+    trace_tail = 0;
+    trace_dropped.store(0, std::memory_order_release);
+}
+
+/**
+ * @brief Select the trace categories
+ *
+ * @param[in] mask  HID_TRACE_CAT_x bits
+ */
+void hid_trace_set_mask(uint32_t mask) {
+    hid_trace_mask.store(mask, std::memory_order_relaxed);
+}
+
+// Claim a free slot, NULL if the ring is full
+static hid_trace_slot_t* claim_slot(uint32_t* pos) {
+    uint32_t head = trace_head.load(std::memory_order_relaxed);
+    while (true) {
+        hid_trace_slot_t* slot = &trace_slots[head & (HID_TRACE_RING_CAPACITY - 1)];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - head);
+        if (diff == 0) {
+            if (trace_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                *pos = head;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            head = trace_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool write_record(uint8_t type, uint8_t flags, const void* data, size_t length) {
+    uint32_t pos;
+    hid_trace_slot_t* slot = claim_slot(&pos);
+    if (slot == NULL) {
+        trace_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot->rec.type = type;
+    slot->rec.flags = flags;
+    slot->rec.length = (uint8_t)length;
+    memcpy(slot->rec.data, data, length);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Append one record, called from the hot path instead of printf
+ *
+ * @param[in] category  HID_TRACE_CAT_x of the record
+ * @param[in] type      HID_TRACE_REC_x, decides the formatting
+ * @param[in] data      Payload, copied into the record
+ * @param[in] length    Payload length, at most HID_TRACE_PAYLOAD
+ * @return false if the category is disabled or the record was dropped
+ */
+bool hid_trace_write(uint32_t category, uint8_t type, const void* data, size_t length) {
+    if (!hid_trace_enabled(category)) return false;
+    if (length > HID_TRACE_PAYLOAD) length = HID_TRACE_PAYLOAD;
+    return write_record(type, HID_TRACE_FLAG_LAST, data, length);
+}
+
+/**
+ * @brief Append data which is printed as hex, split into as many records as needed
+ *
+ * @param[in] category  HID_TRACE_CAT_x of the records
+ * @param[in] data      Bytes to dump
+ * @param[in] length    Number of bytes
+ * @return false if the category is disabled or records were dropped
+ */
+bool hid_trace_write_raw(uint32_t category, const uint8_t* data, size_t length) {
+    if (!hid_trace_enabled(category)) return false;
+    bool ok = true;
+    size_t pos = 0;
+    do {
+        size_t n = (length - pos > HID_TRACE_PAYLOAD) ? HID_TRACE_PAYLOAD : length - pos;
+        uint8_t flags = (pos + n == length) ? HID_TRACE_FLAG_LAST : 0;
+        ok &= write_record(HID_TRACE_REC_RAW, flags, data + pos, n);
+        pos += n;
+    } while (pos < length);
+    return ok;
+}
+
+/**
+ * @brief Take the oldest record out of the ring, called from the drain task only
+ *
+ * @param[out] rec  Record
+ * @return false if no record is ready
+ */
+bool hid_trace_read(hid_trace_record_t* rec) {
+    hid_trace_slot_t* slot = &trace_slots[trace_tail & (HID_TRACE_RING_CAPACITY - 1)];
+    if (slot->seq.load(std::memory_order_acquire) != trace_tail + 1) return false;
+
+    *rec = slot->rec;
+    slot->seq.store(trace_tail + HID_TRACE_RING_CAPACITY, std::memory_order_release);
+    trace_tail++;
+    return true;
+}
+
+/**
+ * @brief Number of records dropped because the ring was full
+ */
+uint32_t hid_trace_dropped() {
+    return trace_dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Number of records the trace ring can hold, must be a power of two
+#define HID_TRACE_RING_CAPACITY 64
+
+// Bytes of data per record, longer data (raw reports) is split into several records
+#define HID_TRACE_PAYLOAD 20
+
+// Categories which can be enabled separately
+#define HID_TRACE_CAT_MOUSE     0x01  // unified hidData reports
+#define HID_TRACE_CAT_KEYBOARD  0x02  // typed characters
+#define HID_TRACE_CAT_DEVICE    0x04  // report header when the device type changes
+#define HID_TRACE_CAT_RAW       0x08  // hex dump of unknown reports
+#define HID_TRACE_CAT_ALL       0xFF
+
+// Record types, decide how the payload is formatted
+#define HID_TRACE_REC_HIDDATA   1  // unified_hidData_t
+#define HID_TRACE_REC_HEADER    2  // one byte protocol (hid_protocol_t / HID_PROTOCOL_JOYSTICK)
+#define HID_TRACE_REC_TEXT      3  // characters as they are
+#define HID_TRACE_REC_RAW       4  // bytes printed as hex
+
+// Record flags
+#define HID_TRACE_FLAG_LAST     0x01  // last record of split data (raw: end of line)
+
+/**
+ * @brief Compact trace record, formatted later by the drain task (or a host
+ * side decoder reading a dump of the records)
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint8_t length;  // valid payload bytes
+    uint8_t reserved;
+    uint8_t data[HID_TRACE_PAYLOAD];
+} hid_trace_record_t;
+
+// Categories written to the ring, records of other categories are discarded
+extern std::atomic<uint32_t> hid_trace_mask;
+
+static inline bool hid_trace_enabled(uint32_t category) {
+    return (hid_trace_mask.load(std::memory_order_relaxed) & category) != 0;
+}
+
+void hid_trace_init();
+void hid_trace_set_mask(uint32_t mask);
+bool hid_trace_write(uint32_t category, uint8_t type, const void* data, size_t length);
+bool hid_trace_write_raw(uint32_t category, const uint8_t* data, size_t length);
+bool hid_trace_read(hid_trace_record_t* rec);
+uint32_t hid_trace_dropped();
+
+size_t hid_trace_format(const hid_trace_record_t* rec, char* buf, size_t size);
+
+void hid_trace_start();
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include "hid_trace.h"
+
+// Same values as hid_protocol_t and HID_PROTOCOL_JOYSTICK, this file does not
+// depend on the USB host headers so it also builds for host side decoders
+static const char* header_name(uint8_t proto) {
+    switch (proto) {
+        case 1: return "Keyboard";
+        case 2: return "Mouse";
+        case 3: return "Joystick/Gamepad";
+        default: return "Generic";
+    }
+}
+
+/**
+ * @brief Format a trace record as console text
+ *
+ * @param[in]  rec   Record
+ * @param[out] buf   Text, zero terminated
+ * @param[in]  size  Size of buf
+ * @return Length of the text (truncated to size - 1)
+ */
+size_t hid_trace_format(const hid_trace_record_t* rec, char* buf, size_t size) {
+    const uint8_t* d = rec->data;
+    int n = 0;
+    if (size == 0) return 0;
+    buf[0] = '\0';
+
+    switch (rec->type) {
+        case HID_TRACE_REC_HIDDATA: {
+            // unified_hidData_t: buttons, x (int16), y (int16), scroll wheel (int8)
+            if (rec->length < 6) break;
+            int16_t x = (int16_t)(d[1] | (d[2] << 8));
+            int16_t y = (int16_t)(d[3] | (d[4] << 8));
+            n = snprintf(buf, size, "X: %06d\tY: %06d\t|%c|%c|%c|\t%d\n", x, y,
+                         (d[0] & 0x01) ? 'L' : ' ', (d[0] & 0x04) ? 'M' : ' ',
+                         (d[0] & 0x02) ? 'R' : ' ', (int8_t)d[5]);
+            break;
+        }
+        case HID_TRACE_REC_HEADER:
+            if (rec->length < 1) break;
+            n = snprintf(buf, size, "\r\n%s\r\n", header_name(d[0]));
+            break;
+        case HID_TRACE_REC_TEXT:
+            n = snprintf(buf, size, "%.*s", (int)rec->length, (const char*)d);
+            break;
+        case HID_TRACE_REC_RAW:
+            for (int i = 0; i < rec->length && n >= 0 && (size_t)n < size; i++) {
+                n += snprintf(buf + n, size - n, "%02X", d[i]);
+            }
+            if ((rec->flags & HID_TRACE_FLAG_LAST) && n >= 0 && (size_t)n < size) {
+                n += snprintf(buf + n, size - n, "\n");
+            }
+            break;
+        default:
+            n = snprintf(buf, size, "[trace record type %d]\n", rec->type);
+            break;
+    }
+
+    if (n < 0) return 0;
+    return ((size_t)n < size) ? (size_t)n : size - 1;
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <Arduino.h>
+#include <esp_log.h>
+#include "hid_trace.h"
+
+static const char* TAG = "hid-trace";
+
+// Interval in which the drain task empties the ring
+#define HID_TRACE_DRAIN_INTERVAL_MS 20
+
+/**
+ * @brief Low priority task which formats the trace records and writes them to
+ * the console, so the report path never waits for the UART
+ */
+static void hid_trace_drain_task(void* arg) {
+    hid_trace_record_t rec;
+    char text[128];
+    uint32_t reported_dropped = 0;
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(HID_TRACE_DRAIN_INTERVAL_MS));
+
+        bool written = false;
+        while (hid_trace_read(&rec)) {
+            size_t len = hid_trace_format(&rec, text, sizeof(text));
+            fwrite(text, 1, len, stdout);
+            written = true;
+        }
+
+        uint32_t dropped = hid_trace_dropped();
+        if (dropped != reported_dropped) {
+            printf("[trace: %lu records dropped]\n", (unsigned long)(dropped - reported_dropped));
+            reported_dropped = dropped;
+            written = true;
+        }
+        if (written) fflush(stdout);
+    }
+}
+
+/**
+ * @brief Reset the trace ring and start the drain task
+ */
+void hid_trace_start() {
+    hid_trace_init();
+    BaseType_t task_created = xTaskCreatePinnedToCore(hid_trace_drain_task, "hid_trace", 3072,
+                                                      NULL, 1, NULL, 0);
+    if (task_created != pdTRUE) {
+        ESP_LOGE(TAG, "Could not create trace drain task, tracing disabled");
+        hid_trace_set_mask(0);
+    }
+}
@@ -0,0 +1,83 @@
+#include <string.h>
+#include <stdlib.h>
+#include "hid_tremor_filter.h"
+
+/**
+ * @brief Start a filter with the given settings
+ *
+ * @param[out] filter  Filter state
+ * @param[in]  cfg     Settings, min_cutoff_x100 = 0 disables the filter
+ */
+void hid_tremor_filter_init(hid_tremor_filter_t* filter, const hid_tremor_filter_config_t* cfg) {
+    memset(filter, 0, sizeof(*filter));
+    filter->cfg = *cfg;
+}
+
+// Smoothing factor of a first order low-pass in Q16: dt / (dt + 1 / (2 pi fc))
+static int32_t alpha_q16(uint32_t dt_us, uint32_t cutoff_x100) {
+    if (cutoff_x100 == 0) return 0;
+    uint32_t tau_us = 15915494u / cutoff_x100;
+    return (int32_t)(((uint64_t)dt_us << 16) / (dt_us + tau_us));
+}
+
+// Move the filtered position of one axis towards the raw position, returns whole counts
+static int16_t filter_axis(int32_t d, int32_t alpha, int32_t* err, int32_t* residual) {
+    *err += d * 256;
+    int32_t step = (int32_t)(((int64_t)*err * alpha) >> 16);
+    *err -= step;
+
+    *residual += step;
+    int32_t out = *residual / 256;  // truncates toward zero, both directions behave the same
+    *residual -= out * 256;
+    if (out > INT16_MAX) out = INT16_MAX;
+    if (out < INT16_MIN) out = INT16_MIN;
+    return (int16_t)out;
+}
+
+/**
+ * @brief Filter the motion of one report
+ *
+ * The speed estimate (itself low-pass filtered with dcutoff) sets the cutoff
+ * frequency: min_cutoff at rest, plus beta per count/s. Integer only, three
+ * divisions per report. The lag which is left when the pointer stops is
+ * sent with the first report after a pause, so no motion is lost; mice do
+ * not report while they rest, so there is no earlier report to send it with.
+ *
+ * @param[in,out] filter  Filter state
+ * @param[in]     now_us  Arrival time of the report
+ * @param[in,out] dx      X displacement
+ * @param[in,out] dy      Y displacement
+ */
+void hid_tremor_filter_apply(hid_tremor_filter_t* filter, uint32_t now_us, int16_t* dx,
+                             int16_t* dy) {
+    const hid_tremor_filter_config_t* cfg = &filter->cfg;
+    if (cfg->min_cutoff_x100 == 0) return;
+
+    uint32_t dt = now_us - filter->last_us;
+    filter->last_us = now_us;
+    if (dt > HID_TREMOR_MAX_DT_US) {
+        // the filtered position catches up with the raw one, then starts at rest
+        dt = HID_TREMOR_MAX_DT_US;
+        filter->residual_x += filter->err_x;
+        filter->residual_y += filter->err_y;
+        filter->err_x = filter->err_y = 0;
+        filter->speed = 0;
+    }
+    if (dt < HID_TREMOR_MIN_DT_US) dt = HID_TREMOR_MIN_DT_US;
+
+    uint32_t ax = (uint32_t)abs(*dx);
+    uint32_t ay = (uint32_t)abs(*dy);
+    uint32_t mag = (ax > ay) ? ax + (3 * ay >> 3) : ay + (3 * ax >> 3);
+    int32_t raw_speed = (int32_t)((uint64_t)mag * 1000000u / dt);  // counts per second
+    uint32_t dcutoff = (cfg->dcutoff_x100 != 0) ? cfg->dcutoff_x100 : 100;
+    int32_t alpha_d = alpha_q16(dt, dcutoff);
+    filter->speed += (int32_t)(((int64_t)(raw_speed - filter->speed) * alpha_d) >> 16);
+
+    // one cutoff for both axes, so the direction of motion is kept
+    uint64_t cutoff = cfg->min_cutoff_x100 + (uint64_t)cfg->beta_x10000 * filter->speed / 100;
+    if (cutoff > 100000) cutoff = 100000;  // 1 kHz, no smoothing left
+    int32_t alpha = alpha_q16(dt, (uint32_t)cutoff);
+
+    *dx = filter_axis(*dx, alpha, &filter->err_x, &filter->residual_x);
+    *dy = filter_axis(*dy, alpha, &filter->err_y, &filter->residual_y);
+}
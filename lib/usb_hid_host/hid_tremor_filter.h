@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Limits of the inter-report time, as for the pointer ballistics
+#define HID_TREMOR_MIN_DT_US 125
+#define HID_TREMOR_MAX_DT_US 50000
+
+/**
+ * @brief Settings of the adaptive low-pass filter (One Euro style)
+ *
+ * The cutoff frequency rises with the pointer speed: slow motion, where
+ * tremor jitter dominates, is smoothed heavily, fast motion passes with
+ * little lag.
+ */
+typedef struct {
+    uint16_t min_cutoff_x100;  // cutoff at rest in 1/100 Hz, 0 = filter off
+    uint16_t beta_x10000;      // cutoff increase per count/s of speed, in 1/10000 Hz
+    uint16_t dcutoff_x100;     // cutoff of the speed estimate in 1/100 Hz, 0 = 1 Hz
+} hid_tremor_filter_config_t;
+
+/**
+ * @brief Filter state of one pointer
+ *
+ * Relative motion is filtered as a position: err is how far the filtered
+ * position lags behind the raw position, so nothing grows without bound.
+ */
+typedef struct {
+    hid_tremor_filter_config_t cfg;
+    uint32_t last_us;
+    int32_t err_x;       // raw - filtered position, Q8 counts
+    int32_t err_y;
+    int32_t residual_x;  // sub-pixel output not sent yet, Q8
+    int32_t residual_y;
+    int32_t speed;       // filtered speed in counts/s
+} hid_tremor_filter_t;
+
+void hid_tremor_filter_init(hid_tremor_filter_t* filter, const hid_tremor_filter_config_t* cfg);
+void hid_tremor_filter_apply(hid_tremor_filter_t* filter, uint32_t now_us, int16_t* dx,
+                             int16_t* dy);
@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <string.h>
+#include <esp_log.h>
+#include "usb_hid_device.h"
+
+static const char* TAG = "usb-hid-device";
+
+static hid_device_t hid_device_table[HID_DEVICE_TABLE_SIZE];
+
+/**
+ * @brief Take a free entry of the device table for a new HID interface
+ *
+ * The entry is passed as callback argument when the device is opened, so
+ * reports can resolve their state without searching the table.
+ *
+ * @param[in] handle  HID Device handle
+ * @return Cleared entry, or NULL if all entries are in use
+ */
+hid_device_t* hid_device_alloc(hid_host_device_handle_t handle) {
+    hid_device_t* dev = hid_device_find(handle);
+    if (dev == NULL) {
+        dev = hid_device_find(NULL);
+    }
+    if (dev == NULL) {
+        ESP_LOGE(TAG, "Device table full (%d entries)", HID_DEVICE_TABLE_SIZE);
+        return NULL;
+    }
+
+    hid_device_clear(dev);
+    dev->handle = handle;
+    return dev;
+}
+
+/**
+ * @brief Find the entry of a HID interface
+ *
+ * @param[in] handle  HID Device handle, NULL to find a free entry
+ * @return Entry, or NULL if not found
+ */
+hid_device_t* hid_device_find(hid_host_device_handle_t handle) {
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        if (hid_device_table[i].handle == handle) {
+            return &hid_device_table[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Release the entry of a disconnected HID interface
+ *
+ * @param[in] dev  Entry to release, may be NULL
+ */
+void hid_device_free(hid_device_t* dev) {
+    if (dev == NULL) return;
+    hid_host_device_handle_t handle = dev->handle;
+    hid_device_clear(dev);
+    ESP_LOGI(TAG, "Device table entry of %p released", (void*)handle);
+}
+
+/**
+ * @brief Index of an entry in the device table
+ *
+ * @param[in] dev  Entry of the device table
+ * @return Index from 0 to HID_DEVICE_TABLE_SIZE - 1
+ */
+int hid_device_index(const hid_device_t* dev) {
+    return (int)(dev - hid_device_table);
+}
+
+/**
+ * @brief Entry of the device table by index
+ *
+ * @param[in] index  0 to HID_DEVICE_TABLE_SIZE - 1
+ * @return Entry (free if its handle is NULL), NULL if the index is out of range
+ */
+hid_device_t* hid_device_get(int index) {
+    if (index < 0 || index >= HID_DEVICE_TABLE_SIZE) return NULL;
+    return &hid_device_table[index];
+}
+
+/**
+ * @brief Clear the decoder state of an entry
+ *
+ * The joystick motion generator is left alone: the sender task may be ticking
+ * it, a released joystick has already set it idle.
+ *
+ * @param[in] dev  Entry to clear
+ */
+void hid_device_clear(hid_device_t* dev) {
+    memset((void*)dev, 0, offsetof(hid_device_t, joystick_gen));
+}
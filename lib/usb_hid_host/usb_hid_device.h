@@ -0,0 +1,51 @@
+#pragma once
+
+#include "hid_host.h"
+#include "usb_hid_mouse.h"
+#include "usb_hid_joystick.h"
+#include "usb_hid_keyboard.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_format_cache.h"
+#include "usb_hid_quirks.h"
+
+// Maximum number of HID interfaces which can be active at the same time
+#define HID_DEVICE_TABLE_SIZE 8
+
+// Sources of keyboard snapshots: the device table entries, and capture replay
+#define HID_KEY_SOURCE_REPLAY HID_DEVICE_TABLE_SIZE
+#define HID_KEY_SOURCES (HID_DEVICE_TABLE_SIZE + 1)
+
+// Parser and decoder state of one connected HID interface
+typedef struct {
+    hid_host_device_handle_t handle;  // NULL if the entry is free
+    hid_host_dev_params_t params;
+    uint16_t vid;                    // 0 if the device descriptor could not be read
+    uint16_t pid;
+    const usb_hid_quirk_t* quirk;    // NULL if the device needs no workarounds
+    uint32_t enum_us;                // from enumeration by the host library to reports started
+    mouse_report_format_t mouse_format;
+    mouse_state_t mouse_state;
+    joystick_report_format_t joystick_format;
+    joystick_motion_t joystick_motion;
+    keyboard_report_format_t keyboard_format;
+    keyboard_state_t keyboard_state;
+    void* passthrough_ctx;  // set if input reports are forwarded without decoding
+    uint32_t capture_gen;   // capture which has the report descriptor of this interface
+
+    // ticked by the sender task, so it is kept when the entry is cleared (last field)
+    hid_motion_gen_t joystick_gen;
+} hid_device_t;
+
+hid_device_t* hid_device_alloc(hid_host_device_handle_t handle);
+hid_device_t* hid_device_find(hid_host_device_handle_t handle);
+hid_device_t* hid_device_get(int index);
+void hid_device_free(hid_device_t* dev);
+void hid_device_clear(hid_device_t* dev);
+int hid_device_index(const hid_device_t* dev);
+
+// Format setup and report decoding, shared by live devices and capture replay
+void hid_device_parse_formats(hid_device_t* dev, const uint8_t* desc, size_t desc_len,
+                              hid_report_map_t* map, hid_format_cache_entry_t* cache_entry,
+                              bool cache_store);
+void hid_device_decode_report(hid_device_t* dev, const uint8_t* data, size_t length,
+                              uint32_t arrival_us);
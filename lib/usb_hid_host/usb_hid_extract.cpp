@@ -0,0 +1,169 @@
+#include <string.h>
+#include "usb_hid_extract.h"
+
+/**
+ * Extract integer value of size_bits starting at bit_offset from a HID report 
+ * (LSB = bit 0 of data[0])
+ */
+int32_t hid_extract_int(const uint8_t* data, int data_bytes,
+                        int bit_offset, int size_bits, bool is_signed) {
+    if (size_bits <= 0 || size_bits > 32) return 0;
+    if (bit_offset < 0 || bit_offset + size_bits > data_bytes * 8) return 0;
+
+    int start_byte = bit_offset / 8;
+    int start_bit = bit_offset % 8;
+
+    // Read up to 5 bytes into a 64-bit temp (enough for 32 bits at any bit
+    // offset)
+    uint64_t tmp = 0;
+    int needed_bytes = (start_bit + size_bits + 7) / 8;
+    for (int i = 0; i < needed_bytes; ++i) {
+        tmp |= (uint64_t)data[start_byte + i] << (8 * i);
+    }
+
+    tmp >>= start_bit;
+    uint32_t val =
+        (uint32_t)(tmp &
+                   ((size_bits == 32) ? 0xFFFFFFFFu : ((1u << size_bits) - 1)));
+
+    if (is_signed && size_bits < 32 && (val & (1u << (size_bits - 1)))) {
+        val |= ~((1u << size_bits) - 1);  // sign extend
+    }
+
+    return (int32_t)val;
+}
+
+/**
+ * @brief Clear a plan before fields are added
+ */
+void hid_plan_init(hid_extract_plan_t* plan) {
+    memset(plan, 0, sizeof(*plan));
+}
+
+/**
+ * @brief Add a field to the plan, values are returned by hid_plan_run() in the
+ * order the fields were added
+ *
+ * @return Index of the field in the values array, -1 if the plan is full or
+ * the field is invalid
+ */
+int hid_plan_add_field(hid_extract_plan_t* plan, int bit_offset, int bits, bool is_signed) {
+    if (plan->field_count >= HID_PLAN_MAX_FIELDS) return -1;
+    if (bits <= 0 || bits > 32 || bit_offset < 0 || bit_offset + bits > 255 * 8) return -1;
+
+    hid_plan_field_t* f = &plan->fields[plan->field_count];
+    memset(f, 0, sizeof(*f));
+    f->bit_offset = (uint16_t)bit_offset;
+    f->bits = (uint8_t)bits;
+    f->is_signed = is_signed;
+    return plan->field_count++;
+}
+
+/**
+ * @brief Decide how each field is read: byte aligned 8 and 16 bit fields get
+ * direct loads, all others share 32 bit loads with neighbouring fields
+ */
+void hid_plan_compile(hid_extract_plan_t* plan) {
+    plan->load_count = 0;
+    plan->min_length = 0;
+
+    // visit fields in report order, so adjacent fields end up in the same load
+    uint8_t order[HID_PLAN_MAX_FIELDS];
+    for (int i = 0; i < plan->field_count; i++) {
+        int j = i;
+        while (j > 0 && plan->fields[order[j - 1]].bit_offset > plan->fields[i].bit_offset) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = (uint8_t)i;
+    }
+
+    for (int n = 0; n < plan->field_count; n++) {
+        hid_plan_field_t* f = &plan->fields[order[n]];
+        int start_byte = f->bit_offset / 8;
+        int start_bit = f->bit_offset % 8;
+        int end_byte = (f->bit_offset + f->bits + 7) / 8;
+        if (end_byte > plan->min_length) plan->min_length = (uint8_t)end_byte;
+
+        f->byte_offset = (uint8_t)start_byte;
+        if (start_bit == 0 && f->bits == 8) {
+            f->kind = f->is_signed ? HID_PLAN_S8 : HID_PLAN_U8;
+            continue;
+        }
+        if (start_bit == 0 && f->bits == 16) {
+            f->kind = f->is_signed ? HID_PLAN_S16 : HID_PLAN_U16;
+            continue;
+        }
+        if (start_bit + f->bits > 32) {
+            f->kind = HID_PLAN_GENERIC;
+            continue;
+        }
+
+        // reuse the previous load if the field lies completely inside it
+        f->kind = HID_PLAN_WORD;
+        if (plan->load_count > 0) {
+            int prev = plan->load_offset[plan->load_count - 1];
+            if (start_byte >= prev && f->bit_offset + f->bits <= (prev + 4) * 8) {
+                f->load = plan->load_count - 1;
+                f->shift = (uint8_t)(f->bit_offset - prev * 8);
+                continue;
+            }
+        }
+        f->load = plan->load_count;
+        f->shift = (uint8_t)start_bit;
+        plan->load_offset[plan->load_count++] = (uint8_t)start_byte;
+    }
+}
+
+/**
+ * @brief Extract all fields of a compiled plan from a report
+ *
+ * @param[in]  plan    Compiled plan
+ * @param[in]  data    Report data, readable for HID_PLAN_READ_PAD bytes after 'length'
+ * @param[in]  length  Report length
+ * @param[out] values  One value per field, in the order the fields were added
+ * @return false if the report is too short for the plan
+ */
+bool hid_plan_run(const hid_extract_plan_t* plan, const uint8_t* data, int length, int32_t* values) {
+    if (length < plan->min_length) return false;
+
+    uint32_t words[HID_PLAN_MAX_FIELDS];
+    for (int i = 0; i < plan->load_count; i++) {
+        const uint8_t* p = data + plan->load_offset[i];
+        words[i] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+                   ((uint32_t)p[3] << 24);
+    }
+
+    for (int i = 0; i < plan->field_count; i++) {
+        const hid_plan_field_t* f = &plan->fields[i];
+        const uint8_t* p = data + f->byte_offset;
+        switch (f->kind) {
+            case HID_PLAN_U8:
+                values[i] = p[0];
+                break;
+            case HID_PLAN_S8:
+                values[i] = (int8_t)p[0];
+                break;
+            case HID_PLAN_U16:
+                values[i] = (uint16_t)(p[0] | (p[1] << 8));
+                break;
+            case HID_PLAN_S16:
+                values[i] = (int16_t)(p[0] | (p[1] << 8));
+                break;
+            case HID_PLAN_WORD: {
+                uint32_t val = words[f->load] >> f->shift;
+                if (f->bits < 32) {
+                    val &= (1u << f->bits) - 1;
+                    if (f->is_signed && (val & (1u << (f->bits - 1)))) {
+                        val |= ~((1u << f->bits) - 1);  // sign extend
+                    }
+                }
+                values[i] = (int32_t)val;
+            } break;
+            default:
+                values[i] = hid_extract_int(data, length, f->bit_offset, f->bits, f->is_signed);
+                break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// Maximum number of fields of one extraction plan
+#define HID_PLAN_MAX_FIELDS 8
+
+// Report buffers passed to hid_plan_run() must be readable this many bytes
+// beyond the report length, as unaligned fields are read with 32-bit loads
+#define HID_PLAN_READ_PAD 4
+
+int32_t hid_extract_int(const uint8_t* data, int data_bytes, int bit_offset, int size_bits, bool is_signed);
+
+// How a field is read from the report
+typedef enum {
+    HID_PLAN_U8 = 0,   // byte aligned 8 bit, direct load
+    HID_PLAN_S8,
+    HID_PLAN_U16,      // byte aligned 16 bit, direct load
+    HID_PLAN_S16,
+    HID_PLAN_WORD,     // shift and mask out of a shared 32 bit load
+    HID_PLAN_GENERIC,  // does not fit into a 32 bit load, use hid_extract_int()
+} hid_plan_kind_t;
+
+typedef struct {
+    uint16_t bit_offset;
+    uint8_t bits;
+    uint8_t is_signed;
+    uint8_t kind;        // hid_plan_kind_t
+    uint8_t load;        // HID_PLAN_WORD: index of the 32 bit load
+    uint8_t shift;       // HID_PLAN_WORD: shift within the loaded word
+    uint8_t byte_offset; // direct loads
+} hid_plan_field_t;
+
+/**
+ * @brief Extraction plan: the fields of one report format, compiled on connect
+ * into direct loads and grouped 32 bit loads
+ */
+typedef struct {
+    uint8_t field_count;
+    uint8_t load_count;
+    uint8_t min_length;  // report bytes needed for all fields
+    uint8_t load_offset[HID_PLAN_MAX_FIELDS];  // byte offset of each 32 bit load
+    hid_plan_field_t fields[HID_PLAN_MAX_FIELDS];
+} hid_extract_plan_t;
+
+void hid_plan_init(hid_extract_plan_t* plan);
+int hid_plan_add_field(hid_extract_plan_t* plan, int bit_offset, int bits, bool is_signed);
+void hid_plan_compile(hid_extract_plan_t* plan);
+bool hid_plan_run(const hid_extract_plan_t* plan, const uint8_t* data, int length, int32_t* values);
@@ -0,0 +1,113 @@
+#include <string.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "usb_hid_format_cache.h"
+
+static const char* TAG = "usb-hid-format-cache";
+
+static const hid_format_cache_storage_t* registered_storage = NULL;
+static hid_format_cache_stats_t cache_stats = {0};
+
+// lookups and stores come from the USB host task and the capture replay
+static SemaphoreHandle_t cache_mutex = NULL;
+
+// slot content read back before a store, to skip writing an identical entry
+static hid_format_cache_entry_t stored_entry;
+
+hid_format_cache_stats_t* get_hid_format_cache_stats() { return &cache_stats; }
+
+/**
+ * @brief Register the storage backend, NULL disables the cache
+ *
+ * Called once during setup, before the USB host task runs.
+ */
+void register_hid_format_cache_storage(const hid_format_cache_storage_t* storage) {
+    if (cache_mutex == NULL) cache_mutex = xSemaphoreCreateMutex();
+    registered_storage = storage;
+}
+
+static bool key_equal(const hid_format_cache_key_t* a, const hid_format_cache_key_t* b) {
+    return a->desc_hash == b->desc_hash && a->desc_len == b->desc_len &&
+           a->sub_class == b->sub_class && a->proto == b->proto && a->vid == b->vid &&
+           a->pid == b->pid;
+}
+
+static int key_slot(const hid_format_cache_key_t* key) {
+    uint32_t ids = ((uint32_t)key->vid << 16) | key->pid;
+    return (key->desc_hash ^ ids) % HID_FORMAT_CACHE_SLOTS;
+}
+
+/**
+ * @brief Build the cache key of a report descriptor
+ *
+ * @param[out] key       Cache key
+ * @param[in]  desc      Report descriptor
+ * @param[in]  desc_len  Length of the report descriptor
+ * @param[in]  params    Interface parameters (boot subclass and protocol)
+ * @param[in]  vid       Vendor ID of the device
+ * @param[in]  pid       Product ID of the device
+ */
+void hid_format_cache_make_key(hid_format_cache_key_t* key, const uint8_t* desc, size_t desc_len,
+                               const hid_host_dev_params_t* params, uint16_t vid, uint16_t pid) {
+    memset(key, 0, sizeof(*key));
+    key->desc_hash = hid_report_desc_hash(desc, desc_len);
+    key->desc_len = (uint16_t)desc_len;
+    key->sub_class = params->sub_class;
+    key->proto = params->proto;
+    key->vid = vid;
+    key->pid = pid;
+}
+
+/**
+ * @brief Look up the parsed formats of a known report descriptor
+ *
+ * @param[in]  key    Cache key
+ * @param[out] entry  Cached formats
+ * @return true on a cache hit
+ */
+bool hid_format_cache_lookup(const hid_format_cache_key_t* key, hid_format_cache_entry_t* entry) {
+    if (registered_storage == NULL) return false;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    int slot = key_slot(key);
+    bool hit = registered_storage->load(slot, entry, sizeof(*entry)) &&
+               entry->version == HID_FORMAT_CACHE_VERSION && key_equal(&entry->key, key);
+    if (hit) {
+        cache_stats.hits++;
+    } else {
+        cache_stats.misses++;
+    }
+    xSemaphoreGive(cache_mutex);
+    return hit;
+}
+
+/**
+ * @brief Store the parsed formats of a report descriptor, replacing the entry
+ * of another descriptor in the same slot
+ *
+ * Nothing is written if the slot already holds the same entry, or after
+ * HID_FORMAT_CACHE_MAX_STORES writes since boot.
+ *
+ * @param[in] entry  Formats to store, key must be set
+ */
+void hid_format_cache_store(hid_format_cache_entry_t* entry) {
+    if (registered_storage == NULL) return;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    entry->version = HID_FORMAT_CACHE_VERSION;
+    int slot = key_slot(&entry->key);
+    if (registered_storage->load(slot, &stored_entry, sizeof(stored_entry)) &&
+        memcmp(&stored_entry, entry, sizeof(*entry)) == 0) {
+        cache_stats.unchanged++;
+    } else if (cache_stats.stores >= HID_FORMAT_CACHE_MAX_STORES) {
+        cache_stats.limited++;
+        ESP_LOGD(TAG, "Store limit reached, formats not cached");
+    } else if (registered_storage->store(slot, entry, sizeof(*entry))) {
+        cache_stats.stores++;
+    } else {
+        cache_stats.errors++;
+        ESP_LOGW(TAG, "Failed to store formats in slot %d", slot);
+    }
+    xSemaphoreGive(cache_mutex);
+}
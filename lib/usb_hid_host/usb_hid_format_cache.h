@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hid_host.h"
+#include "usb_hid_mouse.h"
+#include "usb_hid_joystick.h"
+#include "usb_hid_keyboard.h"
+
+// Number of cache slots (direct mapped by descriptor hash)
+#define HID_FORMAT_CACHE_SLOTS 8
+
+// Increment when one of the format structures changes, so old entries are ignored
+#define HID_FORMAT_CACHE_VERSION 3
+
+// Entries written to NVS per boot at most, so devices which keep replacing
+// each other's slot cannot wear out the flash
+#define HID_FORMAT_CACHE_MAX_STORES 4
+
+// Identifies a report descriptor of one interface type of one device
+typedef struct {
+    uint32_t desc_hash;  // FNV-1a over the report descriptor
+    uint16_t desc_len;
+    uint8_t sub_class;
+    uint8_t proto;
+    uint16_t vid;  // 0 if the device descriptor could not be read
+    uint16_t pid;
+} hid_format_cache_key_t;
+
+// Parsed formats of one interface, as stored in the cache
+typedef struct {
+    uint32_t version;
+    hid_format_cache_key_t key;
+    mouse_report_format_t mouse_format;
+    joystick_report_format_t joystick_format;
+    keyboard_report_format_t keyboard_format;
+} hid_format_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint32_t unchanged;  // stores skipped, the slot already held the entry
+    uint32_t limited;    // stores skipped, HID_FORMAT_CACHE_MAX_STORES reached
+    uint32_t errors;     // storage failures
+} hid_format_cache_stats_t;
+
+/**
+ * @brief Storage backend of the cache (NVS on the device, e.g. files in host tests)
+ *
+ * load() returns false if the slot is empty or has a different size.
+ */
+typedef struct {
+    bool (*load)(int slot, void* data, size_t len);
+    bool (*store)(int slot, const void* data, size_t len);
+} hid_format_cache_storage_t;
+
+void register_hid_format_cache_storage(const hid_format_cache_storage_t* storage);
+const hid_format_cache_storage_t* get_hid_format_cache_nvs_storage();
+
+void hid_format_cache_make_key(hid_format_cache_key_t* key, const uint8_t* desc, size_t desc_len,
+                               const hid_host_dev_params_t* params, uint16_t vid, uint16_t pid);
+bool hid_format_cache_lookup(const hid_format_cache_key_t* key, hid_format_cache_entry_t* entry);
+void hid_format_cache_store(hid_format_cache_entry_t* entry);
+
+hid_format_cache_stats_t* get_hid_format_cache_stats();
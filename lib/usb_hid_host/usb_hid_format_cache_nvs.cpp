@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <nvs.h>
+#include <esp_log.h>
+#include "usb_hid_format_cache.h"
+
+static const char* TAG = "usb-hid-format-cache";
+static const char* NVS_NAMESPACE = "hid_fmt_cache";
+
+static bool nvs_slot_load(int slot, void* data, size_t len) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return false;
+
+    char key[8];
+    snprintf(key, sizeof(key), "slot%d", slot);
+    size_t stored_len = len;
+    esp_err_t err = nvs_get_blob(handle, key, data, &stored_len);
+    nvs_close(handle);
+    return err == ESP_OK && stored_len == len;
+}
+
+static bool nvs_slot_store(int slot, const void* data, size_t len) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_open failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    char key[8];
+    snprintf(key, sizeof(key), "slot%d", slot);
+    err = nvs_set_blob(handle, key, data, len);
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    return err == ESP_OK;
+}
+
+static const hid_format_cache_storage_t nvs_storage = {
+    .load = nvs_slot_load,
+    .store = nvs_slot_store,
+};
+
+/**
+ * @brief NVS backend of the format cache (NVS is initialized by the Arduino core)
+ */
+const hid_format_cache_storage_t* get_hid_format_cache_nvs_storage() { return &nvs_storage; }
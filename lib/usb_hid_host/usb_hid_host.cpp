@@ -4,6 +4,7 @@
  */
 #include "usb/usb_host.h"
 
+#include <atomic>
 #include <Arduino.h>
 #include <esp_log.h>
 
@@ -14,12 +15,44 @@
 #include "usb_hid_keyboard.h"
 #include "usb_hid_mouse.h"
 #include "usb_hid_joystick.h"
+#include "usb_hid_device.h"
+#include "usb_hid_extract.h"
+#include "usb_hid_format_cache.h"
+#include "hid_event_ring.h"
+#include "hid_trace.h"
+#include "hid_latency.h"
+#include "hid_capture_host.h"
+#include "hid_boot_timeline.h"
+#include "usb_hid_quirks.h"
 
 static const char* TAG = "usb-hid-host";
-QueueHandle_t hid_host_event_queue;
+QueueHandle_t hid_host_event_queue = NULL;
 bool user_shutdown = false;
-bool addDelayDuringEnumeration = true;     // TBD: this is a workaround for some devices that need delay during enumeration
-                                           // see issue: https://github.com/espressif/esp-idf/issues/
+
+// Delay of the USB host library event loop until the first device connected,
+// for all devices. Off by default: devices which need time get it from their
+// quirk entry (usb_hid_quirks.cpp), counted from the end of their
+// enumeration. Build with e.g. -DUSB_HID_ENUM_DELAY_MS=10 only for a device
+// which fails before its device descriptor can be read.
+#ifndef USB_HID_ENUM_DELAY_MS
+#define USB_HID_ENUM_DELAY_MS 0
+#endif
+static bool enum_delay_active = true;
+
+// USB host client which reads the device descriptors (VID:PID) for the quirk table
+static usb_host_client_handle_t quirk_client = NULL;
+
+// Per USB address, written by the quirk client when the host library has
+// enumerated a device, read by the HID driver task when its interfaces
+// connect. The time is stored last and 0 means not enumerated (yet).
+typedef struct {
+    std::atomic<uint32_t> us;      // enumeration by the host library done
+    uint16_t vid;
+    uint16_t pid;
+    const usb_hid_quirk_t* quirk;  // NULL if none, or the descriptor could not be read
+} usb_new_dev_t;
+
+static usb_new_dev_t new_devs[128];
 
 // Global callback function pointer
 static hidData_callback_t registered_hidData_callback = NULL;
@@ -28,44 +61,30 @@ hidData_callback_t * get_registered_hidData_callback() {
     return &registered_hidData_callback;
 }
 
+static keyData_callback_t registered_keyData_callback = NULL;
 
-/**
- * Extract integer value of size_bits starting at bit_offset from a HID report 
- * (LSB = bit 0 of data[0])
- */
-int32_t hid_extract_int(const uint8_t* data, int data_bytes,
-                               int bit_offset, int size_bits, bool is_signed) {
-    if (size_bits <= 0 || size_bits > 32) return 0;
-    if (bit_offset < 0 || bit_offset + size_bits > data_bytes * 8) return 0;
-
-    int start_byte = bit_offset / 8;
-    int start_bit = bit_offset % 8;
-
-    // Read up to 5 bytes into a 64-bit temp (enough for 32 bits at any bit
-    // offset)
-    uint64_t tmp = 0;
-    int needed_bytes = (start_bit + size_bits + 7) / 8;
-    for (int i = 0; i < needed_bytes; ++i) {
-        tmp |= (uint64_t)data[start_byte + i] << (8 * i);
-    }
+// Output held back by the receiver (e.g. a congested BLE link), retried by the sender task
+static hid_sender_flush_callback_t registered_flush_callback = NULL;
 
-    tmp >>= start_bit;
-    uint32_t val =
-        (uint32_t)(tmp &
-                   ((size_bits == 32) ? 0xFFFFFFFFu : ((1u << size_bits) - 1)));
+// Passthrough mode callbacks, NULL if not used
+static hid_descriptor_callback_t registered_descriptor_callback = NULL;
+static hid_raw_report_callback_t registered_raw_report_callback = NULL;
 
-    if (is_signed && size_bits < 32 && (val & (1u << (size_bits - 1)))) {
-        val |= ~((1u << size_bits) - 1);  // sign extend
-    }
+// Reports from the USB side, delivered to the registered callback by the sender task
+static hid_event_ring_t hid_event_ring;
+static TaskHandle_t hid_sender_task_handle = NULL;
 
-    return (int32_t)val;
-}
+hid_event_ring_t* get_hid_event_ring() { return &hid_event_ring; }
 
+// Arrival time of the report which is being decoded
+static uint32_t report_arrival_us = 0;
 
 
 /**
  * @brief Makes new line depending on report output protocol type
  *
+ * Only a trace record is written here, the text is printed by the trace drain task.
+ *
  * @param[in] proto Current protocol to output
  */
 void hid_print_new_device_report_header(hid_protocol_t proto) {
@@ -73,17 +92,8 @@ void hid_print_new_device_report_header(hid_protocol_t proto) {
 
     if (prev_proto_output != proto) {
         prev_proto_output = proto;
-        printf("\r\n");
-        if (proto == HID_PROTOCOL_MOUSE) {
-            printf("Mouse\r\n");
-        } else if (proto == HID_PROTOCOL_KEYBOARD) {
-            printf("Keyboard\r\n");
-        } else if (proto == HID_PROTOCOL_JOYSTICK) {
-            printf("Joystick/Gamepad\r\n");
-        } else {
-            printf("Generic\r\n");
-        }
-        fflush(stdout);
+        uint8_t p = (uint8_t)proto;
+        hid_trace_write(HID_TRACE_CAT_DEVICE, HID_TRACE_REC_HEADER, &p, sizeof(p));
     }
 }
 
@@ -98,6 +108,204 @@ void register_hidData_callback(hidData_callback_t callback) {
     ESP_LOGI(TAG, "HidData callback %s",callback ? "registered" : "unregistered");
 }
 
+/**
+ * @brief Hand a unified hidData report over to the sender task
+ *
+ * Called from the HID driver task. The report is only copied into the event
+ * ring, so a slow callback (e.g. blocking BLE calls) does not stall USB report
+ * handling. If the ring is full, the report is dropped and counted.
+ *
+ * @param[in] hidData  Report to deliver to the registered callback
+ */
+void hid_dispatch_hidData(const unified_hidData_t* hidData) {
+    if (*get_registered_hidData_callback() == NULL) return;
+
+    hid_event_t event;
+    event.type = HID_EVENT_HIDDATA;
+    event.hidData = *hidData;
+    event.arrival_us = report_arrival_us;
+    event.decoded_us = hid_latency_now();
+    hid_event_ring_push(&hid_event_ring, &event);
+    if (hid_sender_task_handle != NULL) {
+        xTaskNotifyGive(hid_sender_task_handle);
+    }
+}
+
+/**
+ * @brief Wake the sender task, e.g. when a joystick starts generated motion
+ */
+void hid_sender_wake() {
+    if (hid_sender_task_handle != NULL) {
+        xTaskNotifyGive(hid_sender_task_handle);
+    }
+}
+
+/**
+ * @brief Deliver generated joystick motion if the next tick is due
+ *
+ * @param[in] gen  Motion generator
+ */
+static void hid_sender_motion_tick(hid_motion_gen_t* gen) {
+    if (!gen->running && !hid_motion_gen_active(gen)) return;
+
+    uint32_t now = hid_latency_now();
+    if ((int32_t)(hid_motion_gen_next_us(gen, now) - now) > 0) return;  // woken by a report
+
+    int16_t dx, dy;
+    int8_t wheel;
+    if (!hid_motion_gen_tick(gen, now, &dx, &dy, &wheel)) return;
+
+    unified_hidData_t hidData;
+    memset(&hidData, 0, sizeof(hidData));
+    hidData.buttons.val = gen->buttons.load(std::memory_order_relaxed);
+    hidData.x_displacement = dx;
+    hidData.y_displacement = dy;
+    hidData.scroll_wheel = wheel;
+
+    hidData_callback_t callback = *get_registered_hidData_callback();
+    if (callback != NULL) {
+        hid_latency_skip();
+        callback(&hidData);
+    }
+}
+
+/**
+ * @brief Work of one sender task wake-up: call the registered callbacks for
+ * every queued report and keyboard snapshot, deliver the generated motion of
+ * every held joystick which is due and retry held back output
+ *
+ * Also called by host simulations, which run it on a virtual clock.
+ *
+ * @return true if the receiver still holds back output
+ */
+bool hid_sender_run() {
+    hid_event_t event;
+
+    while (hid_event_ring_pop(&hid_event_ring, &event)) {
+        if (event.type == HID_EVENT_KEYDATA) {
+            keyData_callback_t key_callback = registered_keyData_callback;
+            if (key_callback != NULL) {
+                key_callback(&event.keyData);
+                hid_boot_mark(HID_BOOT_FIRST_REPORT, hid_latency_now());
+            }
+            continue;
+        }
+        hidData_callback_t callback = *get_registered_hidData_callback();
+        if (callback != NULL) {
+            hid_latency_begin(event.arrival_us, event.decoded_us);
+            callback(&event.hidData);
+            hid_latency_end();
+            hid_boot_mark(HID_BOOT_FIRST_REPORT, hid_latency_now());
+        }
+    }
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_sender_motion_tick(&hid_device_get(i)->joystick_gen);
+    }
+
+    hid_sender_flush_callback_t flush = registered_flush_callback;
+    return (flush != NULL) && !flush();
+}
+
+/**
+ * @brief Time until the sender task has work without being woken up
+ *
+ * @param[in] held_back  Result of the previous hid_sender_run()
+ * @return Microseconds, HID_SENDER_WAIT_FOREVER if only a wake-up brings work
+ */
+uint32_t hid_sender_wait_us(bool held_back) {
+    uint32_t wait_us = HID_SENDER_WAIT_FOREVER;
+    uint32_t now = hid_latency_now();
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_motion_gen_t* gen = &hid_device_get(i)->joystick_gen;
+        if (!hid_motion_gen_active(gen)) continue;
+        uint32_t gen_wait_us = hid_motion_gen_next_us(gen, now) - now;
+        if (gen_wait_us < wait_us) wait_us = gen_wait_us;
+    }
+    if (held_back && wait_us > HID_SENDER_RETRY_MS * 1000) {
+        wait_us = HID_SENDER_RETRY_MS * 1000;
+    }
+    return wait_us;
+}
+
+/**
+ * @brief Sender task, calls the registered callback for every queued report
+ *
+ * While a joystick is held, the task also wakes up at the motion generators'
+ * rate and delivers the generated motion.
+ *
+ * @param[in] arg  Not used
+ */
+static void hid_sender_task(void* arg) {
+    bool held_back = false;
+
+    while (true) {
+        uint32_t wait_us = hid_sender_wait_us(held_back);
+        TickType_t wait = (wait_us == HID_SENDER_WAIT_FOREVER)
+                              ? portMAX_DELAY
+                              : pdMS_TO_TICKS((wait_us + 999) / 1000);
+        if (wait > 0) ulTaskNotifyTake(pdTRUE, wait);
+
+        held_back = hid_sender_run();
+    }
+}
+
+/**
+ * @brief Register the function which retries output held back by the receiver
+ *
+ * Called by the sender task after every wake-up. While it returns false, the
+ * task wakes up again after HID_SENDER_RETRY_MS, or earlier on hid_sender_wake().
+ *
+ * @param[in] callback  Flush function, returns true when nothing is held back
+ */
+void register_hid_sender_flush_callback(hid_sender_flush_callback_t callback) {
+    registered_flush_callback = callback;
+}
+
+/**
+ * @brief Register the callback which receives keyboard snapshots
+ *
+ * @param[in] callback  Called with modifiers and pressed keys on every change
+ */
+void register_keyData_callback(keyData_callback_t callback) {
+    registered_keyData_callback = callback;
+}
+
+/**
+ * @brief Hand a keyboard snapshot over to the sender task
+ *
+ * Snapshots share the event ring with the unified hidData reports, so the
+ * callback (and BLE notifications) never run on the USB side and key changes
+ * stay in order with mouse reports.
+ *
+ * @param[in] keyData  Snapshot to deliver to the registered callback
+ * @return false if the ring was full, the snapshot has to be dispatched again
+ */
+bool hid_dispatch_keyData(const unified_keyData_t* keyData) {
+    if (registered_keyData_callback == NULL) return true;
+
+    hid_event_t event;
+    event.type = HID_EVENT_KEYDATA;
+    event.keyData = *keyData;
+    event.arrival_us = report_arrival_us;
+    event.decoded_us = hid_latency_now();
+    if (!hid_event_ring_push(&hid_event_ring, &event)) return false;
+    hid_sender_wake();
+    return true;
+}
+
+/**
+ * @brief Register callbacks to forward raw input reports of selected interfaces
+ *
+ * @param[in] desc_callback    Called with the report descriptor on connect
+ * @param[in] report_callback  Called with every input report of forwarded interfaces
+ */
+void register_hid_passthrough_callbacks(hid_descriptor_callback_t desc_callback,
+                                        hid_raw_report_callback_t report_callback) {
+    registered_descriptor_callback = desc_callback;
+    registered_raw_report_callback = report_callback;
+    ESP_LOGI(TAG, "Passthrough callbacks %s", desc_callback ? "registered" : "unregistered");
+}
+
 /**
  * @brief HID Host event
  *
@@ -107,6 +315,7 @@ typedef struct {
     hid_host_device_handle_t hid_device_handle;
     hid_host_driver_event_t event;
     void* arg;
+    hid_host_work_t work;  // if set, called with arg instead of handling a device event
 } hid_host_event_queue_t;
 
 /**
@@ -115,54 +324,95 @@ typedef struct {
 static const char* hid_proto_name_str[] = {"NONE", "KEYBOARD", "MOUSE"};
 
 
+/**
+ * @brief Decode an input report with the formats of its interface
+ *
+ * @param[in] dev         Device table entry (or replay entry) of the interface
+ * @param[in] data        Report data, readable HID_PLAN_READ_PAD bytes beyond length
+ * @param[in] length      Report length
+ * @param[in] arrival_us  Arrival timestamp of the report
+ */
+void hid_device_decode_report(hid_device_t* dev, const uint8_t* data, size_t length,
+                              uint32_t arrival_us) {
+    const int data_length = (int)length;
+    report_arrival_us = arrival_us;
+
+    if (HID_SUBCLASS_BOOT_INTERFACE == dev->params.sub_class) {
+        if (HID_PROTOCOL_KEYBOARD == dev->params.proto) {
+            hid_print_new_device_report_header(HID_PROTOCOL_KEYBOARD);
+            hid_host_keyboard_report_callback(&dev->keyboard_format, &dev->keyboard_state, data, data_length);
+        } else if (HID_PROTOCOL_MOUSE == dev->params.proto) {
+            hid_print_new_device_report_header(HID_PROTOCOL_MOUSE);
+            hid_host_mouse_report_callback(&dev->mouse_format, &dev->mouse_state, data, data_length,
+                                           arrival_us);
+        }
+    } else if (dev->keyboard_format.is_valid) {
+        // e.g. NKRO interface of a gaming keyboard
+        hid_print_new_device_report_header(HID_PROTOCOL_KEYBOARD);
+        hid_host_keyboard_report_callback(&dev->keyboard_format, &dev->keyboard_state, data, data_length);
+    } else {
+        // try joystick report callback first
+        if (hid_host_joystick_report_callback(&dev->joystick_format, &dev->joystick_motion,
+                                              &dev->joystick_gen, data, data_length, arrival_us)) {
+            hid_print_new_device_report_header((hid_protocol_t)HID_PROTOCOL_JOYSTICK);
+        } else {
+            // Fallback: if no joystick report handled, just hex-dump the generic report
+            hid_print_new_device_report_header(HID_PROTOCOL_NONE);
+            hid_trace_write_raw(HID_TRACE_CAT_RAW, data, data_length);
+        }
+    }
+}
+
 /**
  * @brief USB HID Host interface callback
  *
  * @param[in] hid_device_handle  HID Device handle
  * @param[in] event              HID Host interface event
- * @param[in] arg                Pointer to arguments, does not used
+ * @param[in] arg                Device table entry of the interface
  */
 void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
                                  const hid_host_interface_event_t event,
                                  void* arg) {
-    uint8_t data[64] = {0};
+    // padded, so extraction plans can use 32 bit loads up to the report end
+    uint8_t data[64 + HID_PLAN_READ_PAD] = {0};
     size_t data_length = 0;
-    hid_host_dev_params_t dev_params;
-    ESP_ERROR_CHECK(hid_host_device_get_params(hid_device_handle, &dev_params));
+    hid_device_t* dev = (hid_device_t*)arg;
+    if (dev == NULL) {
+        dev = hid_device_find(hid_device_handle);
+        if (dev == NULL) return;
+    }
+    const hid_host_dev_params_t dev_params = dev->params;
+
+    // while a capture is replayed, reports are dropped and a disconnect waits
+    // until the replay is done, so the replay is the only producer of the event ring
+    if (!hid_live_input_begin(event == HID_HOST_INTERFACE_EVENT_DISCONNECTED)) return;
 
     switch (event) {
-        case HID_HOST_INTERFACE_EVENT_INPUT_REPORT:
+        case HID_HOST_INTERFACE_EVENT_INPUT_REPORT: {
+            uint32_t arrival_us = hid_latency_now();
             ESP_ERROR_CHECK(hid_host_device_get_raw_input_report_data(
                 hid_device_handle, data, 64, &data_length));
 
-            if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
-                if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
-                    hid_print_new_device_report_header(HID_PROTOCOL_KEYBOARD);
-                    hid_host_keyboard_report_callback(data, data_length);
-                } else if (HID_PROTOCOL_MOUSE == dev_params.proto) {
-                    hid_print_new_device_report_header(HID_PROTOCOL_MOUSE);
-                    hid_host_mouse_report_callback(data, data_length);
-                }
-            } else {
-                // try joystick report callback first
-                if (hid_host_joystick_report_callback(data, data_length)){
-                    hid_print_new_device_report_header((hid_protocol_t)HID_PROTOCOL_JOYSTICK);
-                } else {
-                    // Fallback: if no joystick report handled, just hex-dump the generic report
-                    hid_print_new_device_report_header(HID_PROTOCOL_NONE);
-                    for (int i = 0; i < data_length; i++) {
-                        printf("%02X", data[i]);
-                    }
-                    putchar('\n');
-                    fflush(stdout);
-                }
+            hid_capture_on_report(dev, data, data_length, arrival_us);
+
+            // passthrough: forward the report as it is, no decoding
+            if (dev->passthrough_ctx != NULL && registered_raw_report_callback != NULL) {
+                registered_raw_report_callback(dev->passthrough_ctx, data, data_length);
+                hid_boot_mark(HID_BOOT_FIRST_REPORT, hid_latency_now());
+                break;
             }
 
-            break;
+            hid_device_decode_report(dev, data, data_length, arrival_us);
+        } break;
         case HID_HOST_INTERFACE_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "HID Device, protocol '%s' DISCONNECTED",
                      hid_proto_name_str[dev_params.proto]);
             ESP_ERROR_CHECK(hid_host_device_close(hid_device_handle));
+            // keys held on a disconnected keyboard must not stay pressed
+            hid_host_keyboard_release(&dev->keyboard_state);
+            hid_host_joystick_release(&dev->joystick_format, &dev->joystick_motion,
+                                      &dev->joystick_gen);
+            hid_device_free(dev);
             break;
         case HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR:
             ESP_LOGI(TAG, "HID Device, protocol '%s' TRANSFER_ERROR",
@@ -173,9 +423,129 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
                      hid_proto_name_str[dev_params.proto]);
             break;
     }
+    hid_live_input_end();
 }
 
 
+// Parsed report descriptor and cache entry of the device being connected. Only
+// used while handling the connect event in hid_host_task, so one instance is enough.
+static hid_report_map_t report_map;
+static hid_format_cache_entry_t format_cache_entry;
+
+/**
+ * @brief Set up the report formats of an interface from its report descriptor
+ *
+ * Known descriptors take their formats from the cache, others are parsed
+ * once and the decoders look up their fields in the parsed report map.
+ *
+ * @param[in,out] dev          Entry with params set, formats are filled in
+ * @param[in]     desc         Report descriptor
+ * @param[in]     desc_len     Report descriptor length
+ * @param[in]     map          Scratch space for the parsed report map
+ * @param[in]     cache_entry  Scratch space for the cache entry
+ * @param[in]     cache_store  false: newly parsed formats are not stored (capture replay)
+ */
+void hid_device_parse_formats(hid_device_t* dev, const uint8_t* desc, size_t desc_len,
+                              hid_report_map_t* map, hid_format_cache_entry_t* cache_entry,
+                              bool cache_store) {
+    hid_format_cache_make_key(&cache_entry->key, desc, desc_len, &dev->params, dev->vid,
+                              dev->pid);
+    hid_format_cache_key_t key = cache_entry->key;
+    mouse_state_init(&dev->mouse_state, key.desc_hash, &dev->params);
+    if (hid_format_cache_lookup(&key, cache_entry)) {
+        ESP_LOGI(TAG, "Report descriptor known (hash %08lx), using cached formats",
+                 (unsigned long)key.desc_hash);
+        dev->mouse_format = cache_entry->mouse_format;
+        dev->joystick_format = cache_entry->joystick_format;
+        dev->keyboard_format = cache_entry->keyboard_format;
+        return;
+    }
+
+    ESP_LOGI(TAG, "Got report descriptor, length: %zu", desc_len);
+    if (!hid_parse_report_descriptor(desc, desc_len, map)) return;
+
+    if (HID_SUBCLASS_BOOT_INTERFACE == dev->params.sub_class) {
+        if (HID_PROTOCOL_MOUSE == dev->params.proto) {
+            parse_mouse_report_map(map, &dev->mouse_format);
+        }
+        if (HID_PROTOCOL_KEYBOARD == dev->params.proto) {
+            parse_keyboard_report_map(map, &dev->keyboard_format);
+        }
+    } else {
+        // Non-boot HID: keyboard reports (e.g. NKRO bitmap), else
+        // attempt to treat as joystick/gamepad
+        if (!parse_keyboard_report_map(map, &dev->keyboard_format)) {
+            parse_joystick_report_map(map, &dev->joystick_format);
+        }
+    }
+
+    cache_entry->mouse_format = dev->mouse_format;
+    cache_entry->joystick_format = dev->joystick_format;
+    cache_entry->keyboard_format = dev->keyboard_format;
+    if (cache_store) hid_format_cache_store(cache_entry);
+}
+
+/**
+ * @brief Wait before the next request to a device which needs time
+ */
+static void quirk_delay(const usb_hid_quirk_t* quirk) {
+    if (quirk != NULL && quirk->delay_ms > 0) vTaskDelay(pdMS_TO_TICKS(quirk->delay_ms));
+}
+
+/**
+ * @brief Read VID and PID from the device descriptor
+ *
+ * @param[in]  addr  USB address of the device
+ * @param[out] vid   Vendor ID
+ * @param[out] pid   Product ID
+ * @return false if the device could not be opened
+ */
+static bool usb_device_ids(uint8_t addr, uint16_t* vid, uint16_t* pid) {
+    usb_device_handle_t handle;
+    const usb_device_desc_t* desc;
+
+    if (quirk_client == NULL || usb_host_device_open(quirk_client, addr, &handle) != ESP_OK) {
+        return false;
+    }
+    bool ok = (usb_host_get_device_descriptor(handle, &desc) == ESP_OK);
+    if (ok) {
+        *vid = desc->idVendor;
+        *pid = desc->idProduct;
+    }
+    usb_host_device_close(quirk_client, handle);
+    return ok;
+}
+
+/**
+ * @brief Look up the quirks of a device as soon as the host library has
+ * enumerated it, so its delay starts there and not when the HID driver
+ * reports its interfaces
+ */
+static void quirk_client_event(const usb_host_client_event_msg_t* msg, void* arg) {
+    if (msg->event == USB_HOST_CLIENT_EVENT_NEW_DEV) {
+        usb_new_dev_t* nd = &new_devs[msg->new_dev.address & 0x7F];
+        uint32_t now_us = hid_latency_now();
+        nd->us.store(0);
+        nd->quirk = NULL;
+        if (usb_device_ids(msg->new_dev.address, &nd->vid, &nd->pid)) {
+            nd->quirk = usb_hid_quirk_lookup(nd->vid, nd->pid);
+        }
+        nd->us.store(now_us);
+    }
+}
+
+/**
+ * @brief Handle the events of the quirk client, the host library needs every
+ * client to take its events
+ *
+ * @param[in] arg  Not used
+ */
+static void quirk_client_task(void* arg) {
+    while (true) {
+        usb_host_client_handle_events(quirk_client, portMAX_DELAY);
+    }
+}
+
 /**
  * @brief HID Host Device event
  *
@@ -187,87 +557,138 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle,
                            const hid_host_driver_event_t event, void* arg) {
     hid_host_dev_params_t dev_params;
     ESP_ERROR_CHECK(hid_host_device_get_params(hid_device_handle, &dev_params));
-    const hid_host_device_config_t dev_config = {
-        .callback = hid_host_interface_callback, .callback_arg = NULL};
 
     switch (event) {
         case HID_HOST_DRIVER_EVENT_CONNECTED: {
-            addDelayDuringEnumeration = false; // disable delay after first device connected
+            enum_delay_active = false; // disable delay after first device connected
+            uint32_t connected_us = hid_latency_now();
+            hid_boot_mark(HID_BOOT_FIRST_DEVICE, connected_us);
             ESP_LOGI(TAG, "HID Device, protocol '%s' CONNECTED",
                      hid_proto_name_str[dev_params.proto]);
+
+            // the table entry holds the state of this interface and is passed
+            // to the interface callback with every report
+            hid_device_t* dev = hid_device_alloc(hid_device_handle);
+            if (dev == NULL) {
+                ESP_LOGE(TAG, "No free device table entry, device ignored");
+                break;
+            }
+            dev->params = dev_params;
+            dev->keyboard_state.source = (uint8_t)hid_device_index(dev);
+            // taken once: further interfaces of the device, and a later device
+            // at the same address, do not measure from this enumeration
+            usb_new_dev_t* nd = &new_devs[dev_params.addr & 0x7F];
+            uint32_t enum_start_us = nd->us.exchange(0);
+            uint32_t quirk_wait_us = 0;
+            if (enum_start_us != 0) {
+                // the quirk delay runs from the enumeration, only what is left of it is waited
+                dev->vid = nd->vid;
+                dev->pid = nd->pid;
+                dev->quirk = nd->quirk;
+                quirk_wait_us = usb_hid_quirk_wait_us(dev->quirk, enum_start_us, connected_us);
+            } else {
+                // further interface, or the quirk client was not yet done
+                enum_start_us = connected_us;
+                if (usb_device_ids(dev_params.addr, &dev->vid, &dev->pid)) {
+                    dev->quirk = usb_hid_quirk_lookup(dev->vid, dev->pid);
+                }
+                quirk_wait_us = usb_hid_quirk_wait_us(dev->quirk, connected_us, connected_us);
+            }
+            const usb_hid_quirk_t* quirk = dev->quirk;
+            uint8_t quirk_flags = quirk ? quirk->flags : 0;
+            if (quirk) {
+                ESP_LOGI(TAG, "Quirks for %04x:%04x: delay %u ms, flags 0x%02x%s", dev->vid,
+                         dev->pid, quirk->delay_ms, quirk->flags,
+                         quirk->report_desc ? ", report descriptor replaced" : "");
+            }
+            if (quirk_wait_us > 0) vTaskDelay(pdMS_TO_TICKS((quirk_wait_us + 999) / 1000));
+
+            const hid_host_device_config_t dev_config = {
+                .callback = hid_host_interface_callback, .callback_arg = dev};
             ESP_ERROR_CHECK(
                 hid_host_device_open(hid_device_handle, &dev_config));
 
-            if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
+            // Get the HID report descriptor and set up the report formats
+            size_t report_desc_len = 0;
+            const uint8_t* report_desc = hid_host_get_report_descriptor(
+                hid_device_handle, &report_desc_len);
+            if (quirk && quirk->report_desc) {
+                report_desc = quirk->report_desc;
+                report_desc_len = quirk->report_desc_len;
+            }
+
+            if (report_desc != NULL && report_desc_len > 0 &&
+                registered_descriptor_callback != NULL &&
+                registered_descriptor_callback(report_desc, report_desc_len,
+                                               &dev->passthrough_ctx)) {
+                ESP_LOGI(TAG, "Input reports are forwarded without decoding (passthrough)");
+            }
+
+            if (report_desc != NULL && report_desc_len > 0) {
+                hid_device_parse_formats(dev, report_desc, report_desc_len,
+                                         &report_map, &format_cache_entry, true);
+            } else {
+                ESP_LOGW(TAG, "Could not get report descriptor (NULL or length=0)");
+            }
+            if (quirk_flags & USB_HID_QUIRK_BOOT_PROTOCOL) {
+                // boot reports are decoded when no report format is valid
+                dev->mouse_format.is_valid = false;
+                dev->keyboard_format.is_valid = false;
+            }
+
+            if (quirk_flags & USB_HID_QUIRK_NO_SET_PROTOCOL) {
+                ESP_LOGI(TAG, "Protocol left as the device starts (quirk)");
+            } else if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
                 if (HID_PROTOCOL_MOUSE == dev_params.proto) {
-                    ESP_LOGI(TAG,"Mouse device detected, parsing report descriptor...");
-
-                    // Try to get and parse the HID report descriptor
-                    size_t report_desc_len = 0;
-                    uint8_t* report_desc = hid_host_get_report_descriptor(
-                        hid_device_handle, &report_desc_len);
-
-                    bool use_boot_protocol = true;
-
-                    if (report_desc != NULL && report_desc_len > 0) {
-                        ESP_LOGI(TAG, "Got report descriptor, length: %zu",
-                                 report_desc_len);
-
-                        if (parse_mouse_report_descriptor(
-                                report_desc, report_desc_len, get_mouse_format())) {
-                            ESP_LOGI(TAG, "Successfully parsed mouse report descriptor, using report protocol");
-                            ESP_ERROR_CHECK(hid_class_request_set_protocol(
-                                hid_device_handle, HID_REPORT_PROTOCOL_REPORT));
-                            use_boot_protocol = false;
-                        } else {
-                            ESP_LOGW(TAG, "Failed to parse mouse report descriptor");
-                        }
-
-                        // free(report_desc); // Uncomment if needed
+                    if (dev->mouse_format.is_valid) {
+                        ESP_LOGI(TAG, "Successfully parsed mouse report descriptor, using report protocol");
+                        ESP_ERROR_CHECK(hid_class_request_set_protocol(
+                            hid_device_handle, HID_REPORT_PROTOCOL_REPORT));
                     } else {
-                        ESP_LOGW(TAG, "Could not get report descriptor (NULL or length=0)");
-                    }
-
-                    if (use_boot_protocol) {
                         ESP_LOGI(TAG, "Falling back to boot protocol for mouse");
                         ESP_ERROR_CHECK(hid_class_request_set_protocol(
                             hid_device_handle, HID_REPORT_PROTOCOL_BOOT));
-                        get_mouse_format()->is_valid =
-                            false;  // Use boot protocol parsing
                     }
                 }
 
                 if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
-                    ESP_ERROR_CHECK(
-                        hid_class_request_set_idle(hid_device_handle, 0, 0));
-                    //        ESP_ERROR_CHECK(hid_class_request_set_protocol(hid_device_handle,HID_REPORT_PROTOCOL_BOOT));
-                }
-            } else {
-                // Non-boot HID: attempt to treat as joystick/gamepad
-                ESP_LOGI(TAG, "Non-boot HID device, checking for joystick/gamepad");
-                size_t report_desc_len = 0;
-                uint8_t* report_desc = hid_host_get_report_descriptor(
-                    hid_device_handle, &report_desc_len);
-
-                if (report_desc != NULL && report_desc_len > 0) {
-                    if (parse_joystick_report_descriptor(
-                            report_desc, report_desc_len, get_joystick_format())) {
-                        ESP_LOGI(TAG, "Joystick/Gamepad descriptor parsed; generic reports will be mapped to mouse");
-                        // Joystick usually uses report protocol by default
-                        // If needed:
-                        // ESP_ERROR_CHECK(hid_class_request_set_protocol(
-                        //     hid_device_handle, HID_REPORT_PROTOCOL_REPORT));
+                    if (dev->keyboard_format.is_valid) {
+                        ESP_LOGI(TAG, "Successfully parsed keyboard report descriptor, using report protocol");
+                        ESP_ERROR_CHECK(hid_class_request_set_protocol(
+                            hid_device_handle, HID_REPORT_PROTOCOL_REPORT));
                     } else {
-                        ESP_LOGI(TAG, "Non-boot HID is not recognized as joystick/gamepad");
-                        get_joystick_format()->is_valid = false;
+                        ESP_LOGI(TAG, "Falling back to boot protocol for keyboard");
+                        ESP_ERROR_CHECK(hid_class_request_set_protocol(
+                            hid_device_handle, HID_REPORT_PROTOCOL_BOOT));
                     }
-                    // free(report_desc); // Uncomment if API requires
+                }
+            } else {
+                if (dev->keyboard_format.is_valid) {
+                    ESP_LOGI(TAG, "Keyboard reports found on non-boot interface");
+                } else if (dev->joystick_format.is_valid) {
+                    ESP_LOGI(TAG, "Joystick/Gamepad descriptor parsed; generic reports will be mapped to mouse");
+                    // Joystick usually uses report protocol by default
+                    // If needed:
+                    // ESP_ERROR_CHECK(hid_class_request_set_protocol(
+                    //     hid_device_handle, HID_REPORT_PROTOCOL_REPORT));
                 } else {
-                    ESP_LOGW(TAG, "Could not get report descriptor for non-boot HID");
+                    ESP_LOGI(TAG, "Non-boot HID is not recognized as joystick/gamepad");
                 }
             }
 
+            if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class &&
+                HID_PROTOCOL_KEYBOARD == dev_params.proto &&
+                !(quirk_flags & USB_HID_QUIRK_NO_SET_IDLE)) {
+                quirk_delay(quirk);
+                ESP_ERROR_CHECK(
+                    hid_class_request_set_idle(hid_device_handle, 0, 0));
+            }
+
+            quirk_delay(quirk);
             ESP_ERROR_CHECK(hid_host_device_start(hid_device_handle));
+            dev->enum_us = hid_latency_now() - enum_start_us;
+            ESP_LOGI(TAG, "%04x:%04x interface %u ready after %lu us", dev->vid, dev->pid,
+                     dev_params.iface_num, (unsigned long)dev->enum_us);
             if (dev_params.proto == HID_PROTOCOL_KEYBOARD) {
                 ESP_LOGI(TAG, "Keyboard connected, turning on numpad LED");
                 uint8_t led = 1;  // NumLock ON
@@ -296,14 +717,15 @@ static void usb_lib_task(void* arg) {
     };
 
     ESP_ERROR_CHECK(usb_host_install(&host_config));
+    hid_boot_mark(HID_BOOT_USB_HOST_INSTALLED, hid_latency_now());
     xTaskNotifyGive((TaskHandle_t)arg);
 
     while (true) {
         uint32_t event_flags;
         usb_host_lib_handle_events(portMAX_DELAY, &event_flags);
 
-        if (addDelayDuringEnumeration)
-            vTaskDelay(pdMS_TO_TICKS(10)); 
+        if (USB_HID_ENUM_DELAY_MS > 0 && enum_delay_active)
+            vTaskDelay(pdMS_TO_TICKS(USB_HID_ENUM_DELAY_MS));
 
         // Release devices once all clients has deregistered
         if (event_flags & USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS) {
@@ -313,7 +735,7 @@ static void usb_lib_task(void* arg) {
         // All devices were removed
         if (event_flags & USB_HOST_LIB_EVENT_FLAGS_ALL_FREE) {
             ESP_LOGI(TAG, "USB Event flags: ALL_FREE");
-            addDelayDuringEnumeration = true; // re-enable delay for next enumeration
+            enum_delay_active = true; // re-enable delay for next enumeration
         }
     }
     // Clean up USB Host
@@ -338,8 +760,12 @@ void hid_host_task(void* pvParameters) {
     while (!user_shutdown) {
         if (xQueueReceive(hid_host_event_queue, &evt_queue,
                           pdMS_TO_TICKS(50))) {
-            hid_host_device_event(evt_queue.hid_device_handle, evt_queue.event,
-                                  evt_queue.arg);
+            if (evt_queue.work != NULL) {
+                evt_queue.work(evt_queue.arg);
+            } else {
+                hid_host_device_event(evt_queue.hid_device_handle, evt_queue.event,
+                                      evt_queue.arg);
+            }
         }
     }
 
@@ -360,10 +786,25 @@ void hid_host_task(void* pvParameters) {
 void hid_host_device_callback(hid_host_device_handle_t hid_device_handle,
                               const hid_host_driver_event_t event, void* arg) {
     const hid_host_event_queue_t evt_queue = {
-        .hid_device_handle = hid_device_handle, .event = event, .arg = arg};
+        .hid_device_handle = hid_device_handle, .event = event, .arg = arg, .work = NULL};
     xQueueSend(hid_host_event_queue, &evt_queue, 0);
 }
 
+/**
+ * @brief Run a function on the HID host task, after the device events queued before
+ *
+ * @param[in] work  Function to call
+ * @param[in] arg   Argument of the function
+ * @return false if the task is not running or its queue is full
+ */
+bool hid_host_post_work(hid_host_work_t work, void* arg) {
+    if (hid_host_event_queue == NULL) return false;
+    const hid_host_event_queue_t evt_queue = {
+        .hid_device_handle = NULL, .event = HID_HOST_DRIVER_EVENT_CONNECTED, .arg = arg,
+        .work = work};
+    return xQueueSend(hid_host_event_queue, &evt_queue, 0) == pdTRUE;
+}
+
 void start_usb_host(void) {
     BaseType_t task_created;
     ESP_LOGI(TAG, "USB HID Host starting ...");
@@ -378,9 +819,37 @@ void start_usb_host(void) {
                                 xTaskGetCurrentTaskHandle(), 2, NULL, 0);
     assert(task_created == pdTRUE);
 
+    /*
+     * Create sender task on the other core: it takes unified reports out of
+     * the event ring and calls the registered hidData callback. Does not
+     * depend on the USB host library, so it is set up while the library
+     * installs.
+     */
+    hid_event_ring_init(&hid_event_ring);
+    joystick_motion_init();
+    task_created =
+        xTaskCreatePinnedToCore(hid_sender_task, "hid_sender", 4096, NULL, 3,
+                                &hid_sender_task_handle, 1);
+    assert(task_created == pdTRUE);
+
     // Wait for notification from usb_lib_task to proceed
     ulTaskNotifyTake(false, 1000);
 
+    // client for the device descriptors, VID:PID select the quirks of a device
+    usb_host_client_config_t client_config = {};
+    client_config.is_synchronous = false;
+    client_config.max_num_event_msg = 5;
+    client_config.async.client_event_callback = quirk_client_event;
+    client_config.async.callback_arg = NULL;
+    if (usb_host_client_register(&client_config, &quirk_client) == ESP_OK) {
+        task_created = xTaskCreatePinnedToCore(quirk_client_task, "usb_quirks", 2048, NULL, 2,
+                                               NULL, 0);
+        assert(task_created == pdTRUE);
+    } else {
+        quirk_client = NULL;
+        ESP_LOGW(TAG, "No USB host client for device quirks");
+    }
+
     /*
      * HID host driver configuration
      * - create background task for handling low level event inside the HID
@@ -396,6 +865,7 @@ void start_usb_host(void) {
         .callback_arg = NULL};
 
     ESP_ERROR_CHECK(hid_host_install(&hid_host_driver_config));
+    hid_boot_mark(HID_BOOT_HID_DRIVER_INSTALLED, hid_latency_now());
 
     // Task is working until the devices are gone (while 'user_shutdown' if
     // false)
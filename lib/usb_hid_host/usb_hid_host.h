@@ -1,7 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include "hid_host.h"
+#include "hid_key_bitmap.h"
 
 #define  HID_PROTOCOL_JOYSTICK 0x03   // Added joystick protocol identifier
 
@@ -29,10 +31,54 @@ typedef struct {
 typedef void (*hidData_callback_t)(unified_hidData_t* hidData);
 
 void register_hidData_callback(hidData_callback_t callback);
+
+// Keyboard state: modifier byte and all pressed keys, sent on every change
+typedef struct {
+    uint8_t source;    // index of the keyboard interface, sources are combined by the receiver
+    uint8_t modifier;
+    hid_key_bitmap_t keys;
+} unified_keyData_t;
+
+// Callback function pointer for applications to receive keyboard snapshots
+typedef void (*keyData_callback_t)(const unified_keyData_t* keyData);
+
+void register_keyData_callback(keyData_callback_t callback);
+bool hid_dispatch_keyData(const unified_keyData_t* keyData);
+
+// Callbacks for applications which forward raw reports (passthrough mode):
+// the descriptor callback is called on connect and returns true to forward the
+// interface, its input reports are then passed to the raw report callback
+// without decoding, together with the context set by the descriptor callback
+typedef bool (*hid_descriptor_callback_t)(const uint8_t* desc, size_t desc_len, void** ctx);
+typedef void (*hid_raw_report_callback_t)(void* ctx, const uint8_t* data, size_t length);
+
+void register_hid_passthrough_callbacks(hid_descriptor_callback_t desc_callback,
+                                        hid_raw_report_callback_t report_callback);
 hidData_callback_t * get_registered_hidData_callback();
+void hid_dispatch_hidData(const unified_hidData_t* hidData);
+void hid_sender_wake();
+
+// Retry interval of output the receiver could not send yet
+#define HID_SENDER_RETRY_MS 2
+
+// Called by the sender task to retry held back output, returns true when done
+typedef bool (*hid_sender_flush_callback_t)();
+
+void register_hid_sender_flush_callback(hid_sender_flush_callback_t callback);
+
+// Work of the sender task, host simulations call it on a virtual clock
+#define HID_SENDER_WAIT_FOREVER 0xFFFFFFFFu
+
+bool hid_sender_run();
+uint32_t hid_sender_wait_us(bool held_back);
+
+// Work which runs on the HID host task, in order with device connects
+typedef void (*hid_host_work_t)(void* arg);
+
+bool hid_host_post_work(hid_host_work_t work, void* arg);
 
-// Declaration for the shared bit extraction utility
-int32_t hid_extract_int(const uint8_t* data, int data_bytes, int bit_offset, int size_bits, bool is_signed);
+// Shared bit extraction utility
+#include "usb_hid_extract.h"
 
 void hid_print_new_device_report_header(hid_protocol_t proto);
 
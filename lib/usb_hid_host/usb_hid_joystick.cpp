@@ -1,202 +1,147 @@
-#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
 #include <esp_log.h>
 #include "usb_hid_joystick.h"
 
 #include "usb_hid_host.h"
+#include "usb_hid_device.h"
 
 static const char* TAG = "usb-hid-joystick";
-joystick_report_format_t joystick_format = {0};
 
-joystick_report_format_t* get_joystick_format() { return &joystick_format; }
+// Response curve shared by all joysticks
+static joystick_curve_t joystick_curve;
+static bool joystick_curve_ready = false;
 
-// Helper to manually sign-extend a value of 'bits' width to 32-bit int
-static int32_t sign_extend(int32_t val, int bits) {
-    if (bits <= 0 || bits >= 32) return val;
-    int32_t m = 1U << (bits - 1);
-    return (val ^ m) - m;
-}
+// Rate of generated motion, every joystick's generator ticks at this period
+static uint32_t joystick_motion_period_us = JOYSTICK_MOTION_PERIOD_US;
 
-bool parse_joystick_report_descriptor(const uint8_t* desc, size_t desc_len,joystick_report_format_t* fmt) {
-    memset(fmt, 0, sizeof(*fmt));
+/**
+ * @brief Set up the motion generators of the device table, called before the sender task starts
+ *
+ * The generators stay with their table entries, connecting and disconnecting
+ * a joystick only changes the stick state they are given.
+ */
+void joystick_motion_init() {
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_motion_gen_init(&hid_device_get(i)->joystick_gen, joystick_motion_period_us,
+                            JOYSTICK_SCROLL_INTERVAL_US);
+    }
+}
 
-    int bit_offset = 0;
-    int report_size = 0;
-    int report_count = 0;
-    uint16_t usage_page = 0;
-    bool report_id_found = false;
-    int32_t logical_min = 0; // Track Logical Minimum to determine signedness
-
-    uint16_t usages[16];
-    int usage_count = 0;
-    uint16_t usage_min = 0;
-    uint16_t usage_max = 0;
-    bool have_usage_range = false;
-
-    bool found_x = false, found_y = false, found_buttons = false, found_hat = false;
-
-    ESP_LOGI(TAG, "Parsing HID joystick report descriptor (%u bytes)",
-             (unsigned)desc_len);
-    ESP_LOGI(TAG, "Raw descriptor:");
-    for (size_t i = 0; i < desc_len; i += 16) {
-        char line[80];
-        int pos = 0;
-        for (size_t j = i; j < desc_len && j < i + 16; ++j) {
-            pos += snprintf(line + pos, sizeof(line) - pos, "%02X ", desc[j]);
-        }
-        ESP_LOGI(TAG, "%04u: %s", (unsigned)i, line);
+/**
+ * @brief Set the rate of generated joystick motion
+ *
+ * Best aligned to the BLE connection interval, one report per connection
+ * event. With 0, motion is only sent with the joystick's own reports.
+ *
+ * @param[in] period_us  Interval of generated motion reports
+ */
+void set_joystick_motion_period(uint32_t period_us) {
+    joystick_motion_period_us = period_us;
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_device_get(i)->joystick_gen.period_us.store(period_us, std::memory_order_relaxed);
     }
+}
 
-    for (size_t i = 0; i < desc_len;) {
-        uint8_t b = desc[i++];
+/**
+ * @brief Select the response curve of joystick to mouse motion
+ *
+ * Builds the lookup table, call before start_usb_host().
+ *
+ * @param[in] cfg  Curve settings
+ */
+void set_joystick_curve_config(const joystick_curve_config_t* cfg) {
+    joystick_curve_build(&joystick_curve, cfg);
+    joystick_curve_ready = true;
+    ESP_LOGI(TAG, "Joystick curve: type=%d, max_speed=%d, deadzone=%d permille%s", cfg->type,
+             cfg->max_speed, cfg->deadzone_permille, cfg->radial_deadzone ? " (radial)" : "");
+}
 
-        if ((b & 0xF0) == 0xF0) {
-            if (i + 1 >= desc_len) break;
-            uint8_t data_len = desc[i++];
-            uint8_t long_tag = desc[i++];
-            (void)long_tag;
-            i += data_len;
-            continue;
-        }
+// Default curve if none was configured, formats may come from the cache without parsing
+static void joystick_curve_default() {
+    joystick_curve_config_t cfg = {};
+    cfg.type = JOYSTICK_CURVE_LINEAR;
+    cfg.max_speed = JOYSTICK_MAX_SPEED;
+    cfg.deadzone_permille = JOYSTICK_DEADZONE_PERMILLE;
+    set_joystick_curve_config(&cfg);
+}
 
-        uint8_t size = b & 0x03;
-        uint8_t type = (b >> 2) & 0x03;
-        uint8_t tag = (b >> 4) & 0x0F;
+/**
+ * @brief Look up the joystick/gamepad fields in the parsed report map
+ *
+ * Reports of a Joystick or Gamepad application collection are preferred,
+ * otherwise the first report with X, Y and buttons is used.
+ *
+ * @param[in]  map  Parsed report descriptor
+ * @param[out] fmt  Joystick report format
+ * @return true if a report with X, Y and buttons was found
+ */
+bool parse_joystick_report_map(const hid_report_map_t* map, joystick_report_format_t* fmt) {
+    memset(fmt, 0, sizeof(*fmt));
 
-        if (size == 3) size = 4;
+    for (int pass = 0; pass < 2 && !fmt->is_valid; pass++) {
+        for (int r = 0; r < map->report_count; r++) {
+            const hid_report_info_t* info = &map->reports[r];
+            if (pass == 0 && !(info->app_usage_page == HID_USAGE_PAGE_GENERIC_DESKTOP &&
+                               (info->app_usage == HID_USAGE_JOYSTICK ||
+                                info->app_usage == HID_USAGE_GAMEPAD))) {
+                continue;
+            }
 
-        uint32_t data = 0;
-        for (uint8_t n = 0; n < size && i < desc_len; ++n) {
-            data |= (uint32_t)desc[i++] << (8 * n);
+            int btn_off, x_off, y_off, hat_off;
+            const hid_report_field_t* btn = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_BUTTON, 1, &btn_off);
+            const hid_report_field_t* x = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_X, &x_off);
+            const hid_report_field_t* y = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_Y, &y_off);
+            if (btn == NULL || btn->size != 1 || x == NULL || y == NULL) continue;
+
+            fmt->reportid = info->report_id;
+            fmt->buttons_bit_offset = btn_off;
+            fmt->button_count = btn->count;
+            fmt->buttons_bits = (btn->count > 32) ? 32 : btn->count;
+
+            fmt->x_bit_offset = x_off;
+            fmt->x_bits = x->size;
+            fmt->x_signed = (x->logical_min < 0);  // Determine sign based on Logical Min
+            fmt->y_bit_offset = y_off;
+            fmt->y_bits = y->size;
+            fmt->y_signed = (y->logical_min < 0);
+
+            const hid_report_field_t* hat = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_HAT, &hat_off);
+            if (hat != NULL) {
+                fmt->has_hat = true;
+                fmt->hat_bit_offset = hat_off;
+                fmt->hat_bits = hat->size;
+                fmt->hat_logical_min = hat->logical_min;  // 0-7 vs 1-8 ranges
+            }
+            fmt->is_valid = true;
+            break;
         }
+    }
 
-        switch (type) {
-            case 0: // Main
-                if (tag == 0x08) { // Input
-                    ESP_LOGI(TAG, "Processing INPUT: usage_page=0x%02X, usage_count=%d, bit_offset=%d, report_size=%d, report_count=%d",
-                             usage_page, usage_count, bit_offset, report_size, report_count);
-                    
-                    // Debug: print all collected usages
-                    for (int dbg = 0; dbg < usage_count; ++dbg) {
-                        ESP_LOGI(TAG, "  Collected usage[%d] = 0x%02X", dbg, usages[dbg]);
-                    }
-                    
-                    if (usage_page == 0x01) { // Generic Desktop Page (Axes, Hat)
-                        // Start from the CURRENT bit_offset for this Input item
-                        int field_bit = bit_offset;
-                        ESP_LOGI(TAG, "  Starting field_bit at %d", field_bit);
-                        
-                        // Process each usage in the order they were declared
-                        for (int u_idx = 0; u_idx < usage_count; ++u_idx) {
-                            uint16_t uval = usages[u_idx];
-                            ESP_LOGI(TAG, "    Processing usage[%d]=0x%02X at field_bit=%d", u_idx, uval, field_bit);
-                            
-                            // Assign offsets to X and Y on their first occurrence
-                            if (!found_x && uval == 0x30) { // X-Axis 
-                                fmt->x_bit_offset = field_bit;
-                                fmt->x_bits = report_size;
-                                fmt->x_signed = (logical_min < 0); // Determine sign based on Logical Min
-                                found_x = true;
-                                ESP_LOGI(TAG, "Joystick X: bit_offset=%d bits=%d signed=%d", fmt->x_bit_offset, fmt->x_bits, fmt->x_signed);
-                            } else if (!found_y && uval == 0x31) { // Y-Axis
-                                fmt->y_bit_offset = field_bit;
-                                fmt->y_bits = report_size;
-                                fmt->y_signed = (logical_min < 0); // Determine sign based on Logical Min
-                                found_y = true;
-                                ESP_LOGI(TAG, "Joystick Y: bit_offset=%d bits=%d signed=%d", fmt->y_bit_offset, fmt->y_bits, fmt->y_signed);
-                            } else if (!found_hat && uval == 0x39) { // Hat Switch
-                                fmt->hat_bit_offset = field_bit;
-                                fmt->hat_bits = report_size;
-                                fmt->hat_logical_min = logical_min; // Capture Logical Min for Hat
-                                fmt->has_hat = true;
-                                found_hat = true;
-                                ESP_LOGI(TAG, "Joystick Hat: bit_offset=%d bits=%d min=%d", fmt->hat_bit_offset, fmt->hat_bits, fmt->hat_logical_min);
-                            }
-                            // For each usage, advance by report_size bits
-                            field_bit += report_size;
-                        }
-                    } else if (usage_page == 0x09) { // Button Page
-                        if (!found_buttons && report_count > 0 && report_size == 1) {
-                            fmt->buttons_bit_offset = bit_offset;
-                            fmt->buttons_bits = report_count;
-                            fmt->button_count = report_count;
-                            found_buttons = true;
-                            ESP_LOGI(TAG, "Joystick buttons: bit_offset=%d bits=%d", fmt->buttons_bit_offset, fmt->buttons_bits);
-                        }
-                    }
-                    
-                    // After processing all usages in this Input item, advance the main bit offset
-                    bit_offset += report_size * report_count;
-                    
-                    // Clear local items for the next Input item
-                    usage_count = 0;
-                    usage_min = 0;
-                    usage_max = 0;
-                    have_usage_range = false;
-                } else if (tag == 0x0A || tag == 0x0C) { // Collection or End Collection
-                    // Clear usages when entering/exiting collections
-                    // This prevents collection-level usages from being mixed with field usages
-                    usage_count = 0;
-                    ESP_LOGD(TAG, "Collection boundary, clearing usage list");
-                }
-                break;
-
-            case 1: // Global
-                switch (tag) {
-                    case 0x0: // Usage Page
-                        usage_page = (uint16_t)data;
-                        break;
-                    case 0x1: // Logical Min
-                        // Handle sign extension based on size
-                        if (size == 1) logical_min = (int8_t)data;
-                        else if (size == 2) logical_min = (int16_t)data;
-                        else logical_min = (int32_t)data;
-                        break;
-                    case 0x7: // Report Size
-                        report_size = (int)data;
-                        break;
-                    case 0x8: // Report ID
-                        if (!report_id_found) {
-                            bit_offset = 8;
-                            report_id_found = true;
-                            ESP_LOGI(TAG, "Report ID found (%u), setting initial bit_offset to 8", (unsigned)data);
-                        }
-                        break;
-                    case 0x9: // Report Count
-                        report_count = (int)data;
-                        break;
-
-                    default:
-                        break;
-                }
-                break;
-
-            case 2: // Local
-                switch (tag) {
-                    case 0x0: // Usage
-                        if (usage_count < (int)(sizeof(usages) / sizeof(usages[0]))) {
-                            usages[usage_count++] = (uint16_t)data;
-                        }
-                        break;
-                    case 0x1: // Usage Min
-                        usage_min = (uint16_t)data;
-                        have_usage_range = true;
-                        break;
-                    case 0x2: // Usage Max
-                        usage_max = (uint16_t)data;
-                        have_usage_range = true;
-                        break;
-                    default:
-                        break;
-                }
-                break;
+    if (fmt->is_valid) {
+        // compile the fields into direct and grouped loads, order as in JOYSTICK_PLAN_x
+        hid_plan_init(&fmt->plan);
+        hid_plan_add_field(&fmt->plan, fmt->buttons_bit_offset,
+                           (fmt->buttons_bits > 8) ? 8 : fmt->buttons_bits, false);
+        hid_plan_add_field(&fmt->plan, fmt->x_bit_offset, fmt->x_bits, fmt->x_signed);
+        hid_plan_add_field(&fmt->plan, fmt->y_bit_offset, fmt->y_bits, fmt->y_signed);
+        if (fmt->has_hat) {
+            hid_plan_add_field(&fmt->plan, fmt->hat_bit_offset, fmt->hat_bits, false);
         }
+        hid_plan_compile(&fmt->plan);
     }
 
-    fmt->is_valid = found_x && found_y && found_buttons;
     ESP_LOGI(TAG,
-             "Parsed joystick format: valid=%d, btn_off=%d bits, x_off=%d bits, "
+             "Parsed joystick format: valid=%d, reportid=%d, btn_off=%d bits, x_off=%d bits, "
              "y_off=%d bits, hat=%d",
-             fmt->is_valid, fmt->buttons_bit_offset, fmt->x_bit_offset,
+             fmt->is_valid, fmt->reportid, fmt->buttons_bit_offset, fmt->x_bit_offset,
              fmt->y_bit_offset, fmt->has_hat);
     return fmt->is_valid;
 }
@@ -204,99 +149,96 @@ bool parse_joystick_report_descriptor(const uint8_t* desc, size_t desc_len,joyst
 
 /**
  * @brief Parse joystick/gamepad input report into unified hidData report:
- *  first axis maps to x/y displacements, 
- *  first 3 buttons map to buttons 1-3
+ *  first axis maps to x/y displacements through the response curve,
+ *  first 5 buttons map to buttons 1-5
  *  hat switch up/down maps to scroll wheel
  */
-bool parse_joystick_report(const uint8_t* data, int length,
-                                  unified_hidData_t* out) {
-    if (!joystick_format.is_valid) return false;
+bool parse_joystick_report(const joystick_report_format_t* fmt, joystick_motion_t* motion,
+                           hid_motion_gen_t* gen, const uint8_t* data, int length,
+                           uint32_t arrival_us, unified_hidData_t* out) {
+    if (!fmt->is_valid) return false;
+
+    // ignore other reports of the device (e.g. consumer control, vendor data)
+    if (fmt->reportid != 0 && (length < 1 || data[0] != fmt->reportid)) return false;
 
     memset(out, 0, sizeof(*out));
+    if (!joystick_curve_ready) joystick_curve_default();
 
-    int32_t btns =
-        hid_extract_int(data, length, joystick_format.buttons_bit_offset,
-                        joystick_format.buttons_bits, false);
+    // Buttons, X, Y and Hat in one pass over the compiled plan,
+    // signed axes are already sign extended
+    int32_t values[JOYSTICK_PLAN_FIELDS] = {0};
+    if (!hid_plan_run(&fmt->plan, data, length, values)) return false;
+
+    int32_t btns = values[JOYSTICK_PLAN_BUTTONS];
     out->buttons.button1 = (btns & 0x01) != 0; // Button 1
     out->buttons.button2 = (btns & 0x02) != 0; // Button 2
     out->buttons.button3 = (btns & 0x04) != 0; // Button 3
+    out->buttons.button4 = (btns & 0x08) != 0; // Button 4
+    out->buttons.button5 = (btns & 0x10) != 0; // Button 5
 
-    // Extract X and Y axis values as UNSIGNED raw bits first
-    // We pass 'false' for is_signed to prevent hid_extract_int from doing sign extension
-    int32_t x = hid_extract_int(
-        data, length, joystick_format.x_bit_offset, joystick_format.x_bits,
-        false);
-    int32_t y = hid_extract_int(
-        data, length, joystick_format.y_bit_offset, joystick_format.y_bits,
-        false);
-
-    // Fix: Ensure correct sign extension for signed values
-    if (joystick_format.x_signed) {
-        x = sign_extend(x, joystick_format.x_bits);
-    } else if (joystick_format.x_bits > 0) {
-        // If unsigned, center the value (e.g., 0..1023 -> -512..511)
-        x -= (1 << (joystick_format.x_bits - 1));
-    }
+    int32_t x = values[JOYSTICK_PLAN_X];
+    int32_t y = values[JOYSTICK_PLAN_Y];
 
-    if (joystick_format.y_signed) {
-        y = sign_extend(y, joystick_format.y_bits);
-    } else if (joystick_format.y_bits > 0) {
-        y -= (1 << (joystick_format.y_bits - 1));
-    }
-
-    // --- Convert Joystick Axis to Mouse Displacement (Dynamic Scaling) ---
-    int16_t mouse_x = 0;
-    int16_t mouse_y = 0;
-    const int MOUSE_MAX_SPEED = 10; // Max mouse displacement per report
-
-    // --- X-Axis Scaling ---
-    if (joystick_format.x_bits > 0) {
-        int32_t x_max_val = (1 << (joystick_format.x_bits - 1)) - 1;
-        if (x_max_val > 0) {
-            int32_t x_deadzone = x_max_val / 8; // ~12.5% deadzone
-            if (abs(x) > x_deadzone) {
-                mouse_x = (int16_t)((float)x / x_max_val * MOUSE_MAX_SPEED);
-            }
-        }
+    // If unsigned, center the value (e.g., 0..1023 -> -512..511)
+    if (!fmt->x_signed && fmt->x_bits > 0) {
+        x -= (1 << (fmt->x_bits - 1));
     }
-
-    // --- Y-Axis Scaling ---
-    if (joystick_format.y_bits > 0) {
-        int32_t y_max_val = (1 << (joystick_format.y_bits - 1)) - 1;
-        if (y_max_val > 0) {
-            int32_t y_deadzone = y_max_val / 8; // ~12.5% deadzone
-            if (abs(y) > y_deadzone) {
-                mouse_y = (int16_t)((float)y / y_max_val * MOUSE_MAX_SPEED);
-            }
-        }
+    if (!fmt->y_signed && fmt->y_bits > 0) {
+        y -= (1 << (fmt->y_bits - 1));
     }
 
-    out->x_displacement = mouse_x;
-    out->y_displacement = mouse_y;
-    out->scroll_wheel = 0;
-
     // --- Hat Switch to Scroll Wheel ---
-    if (joystick_format.has_hat) {
-        int32_t hat = hid_extract_int(data, length, joystick_format.hat_bit_offset,
-                                      joystick_format.hat_bits, false);
+    int8_t scroll = 0;
+    if (fmt->has_hat) {
+        int32_t hat = values[JOYSTICK_PLAN_HAT];
         
         // Normalize Hat value to 0..7 range (0=Up, 1=NE, ... 7=NW)
         // Joystick A: Min=0 -> 0..7
         // Joystick B: Min=1 -> 1..8 -> (hat - 1) -> 0..7
-        int normalized_hat = hat - joystick_format.hat_logical_min;
+        int normalized_hat = hat - fmt->hat_logical_min;
 
         // Check if value is within valid 8-direction range
         if (normalized_hat >= 0 && normalized_hat <= 7) {
             if (normalized_hat == 7 || normalized_hat == 0 || normalized_hat == 1) {
                 // Up or up-diagonal
-                out->scroll_wheel = 1;
+                scroll = 1;
             } else if (normalized_hat == 3 || normalized_hat == 4 || normalized_hat == 5) {
                 // Down or down-diagonal
-                out->scroll_wheel = -1;
+                scroll = -1;
             }
         }
     }
 
+    // --- Convert Joystick Axis to Mouse Displacement ---
+    // fixed point curve lookup
+    int32_t speed_x, speed_y;
+    joystick_curve_apply(&joystick_curve, joystick_curve_normalize(x, fmt->x_bits),
+                         joystick_curve_normalize(y, fmt->y_bits), &speed_x, &speed_y);
+
+    // speeds are per report, the generator needs the report rate to keep them
+    if (motion->timed) {
+        motion->report_us =
+            hid_motion_gen_report_interval(motion->report_us, arrival_us - motion->last_report_us);
+    }
+    motion->timed = true;
+    motion->last_report_us = arrival_us;
+
+    if (gen->period_us.load(std::memory_order_relaxed) != 0) {
+        // the sender task moves the pointer while the stick is held, the
+        // report itself only carries the buttons
+        if (hid_motion_gen_set(gen, speed_x, speed_y, motion->report_us, scroll,
+                               out->buttons.val)) {
+            hid_sender_wake();
+        }
+    } else {
+        // one step per report, fractions of a pixel are carried to the next report
+        int16_t mouse_x, mouse_y;  // not via out, its fields are unaligned (packed)
+        joystick_motion_step(motion, speed_x, speed_y, &mouse_x, &mouse_y);
+        out->x_displacement = mouse_x;
+        out->y_displacement = mouse_y;
+        out->scroll_wheel = scroll;
+    }
+
     ESP_LOGD(TAG, "Joystick->Mouse: btns=0x%X X=%d Y=%d Wheel=%d", (unsigned)btns,
              out->x_displacement, out->y_displacement, out->scroll_wheel);
     return true;
@@ -309,21 +251,55 @@ bool parse_joystick_report(const uint8_t* data, int length,
  * (anything else than mouse or keyboard) so we need to check if it's 
  * really a joystick. If not, return false to allow other handlers to try.
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * @param[in] fmt         Parsed report format of the device
+ * @param[in] motion      Sub-pixel motion state of the device
+ * @param[in] gen         Motion generator of the device
+ * @param[in] data        Pointer to input report data buffer
+ * @param[in] length      Length of input report data buffer
+ * @param[in] arrival_us  Arrival timestamp of the report
  */
-bool hid_host_joystick_report_callback(const uint8_t* const data,
-                                             const int length) {
+bool hid_host_joystick_report_callback(const joystick_report_format_t* fmt,
+                                       joystick_motion_t* motion,
+                                       hid_motion_gen_t* gen,
+                                       const uint8_t* const data,
+                                       const int length,
+                                       uint32_t arrival_us) {
     // try to interpret HID report as joystick
-    if (joystick_format.is_valid) {
+    if (fmt->is_valid) {
         unified_hidData_t unified_hidData;
-        if (parse_joystick_report(data, length, &unified_hidData)) {
-            if (get_registered_hidData_callback() != NULL) {
-                (*get_registered_hidData_callback())(&unified_hidData);
+        uint8_t prev_buttons = motion->buttons;
+        if (parse_joystick_report(fmt, motion, gen, data, length, arrival_us, &unified_hidData)) {
+            motion->buttons = unified_hidData.buttons.val;
+            // with generated motion, only button changes are sent from here
+            if (gen->period_us.load(std::memory_order_relaxed) == 0 ||
+                unified_hidData.buttons.val != prev_buttons) {
+                hid_dispatch_hidData(&unified_hidData);
             }
             return true;  // joystick report handled
         }
     }
     // if no joystick detected, return false
     return(false);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Stop the motion and release the buttons of a disconnected joystick
+ *
+ * Only this joystick's generator is stopped, others keep moving.
+ *
+ * @param[in] fmt     Parsed report format of the device
+ * @param[in] motion  Motion state of the device
+ * @param[in] gen     Motion generator of the device
+ */
+void hid_host_joystick_release(const joystick_report_format_t* fmt, joystick_motion_t* motion,
+                               hid_motion_gen_t* gen) {
+    if (!fmt->is_valid) return;
+
+    hid_motion_gen_set(gen, 0, 0, 0, 0, 0);
+    if (motion->buttons != 0) {
+        unified_hidData_t unified_hidData;
+        memset(&unified_hidData, 0, sizeof(unified_hidData));
+        hid_dispatch_hidData(&unified_hidData);
+    }
+    memset(motion, 0, sizeof(*motion));
+}
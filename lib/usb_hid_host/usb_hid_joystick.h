@@ -1,10 +1,30 @@
 #pragma once
 
 #include "hid_host.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_extract.h"
+#include "hid_joystick_curve.h"
+#include "hid_motion_gen.h"
+
+// Default response curve, replaced with set_joystick_curve_config()
+#define JOYSTICK_MAX_SPEED         10   // pixels per report at full deflection
+#define JOYSTICK_DEADZONE_PERMILLE 125
+
+// Held stick and hat are turned into motion at a fixed rate, see set_joystick_motion_period()
+#define JOYSTICK_MOTION_PERIOD_US   15000   // e.g. the BLE connection interval
+#define JOYSTICK_SCROLL_INTERVAL_US 100000  // wheel repeat while the hat is held
+
+// Order of the fields in the joystick extraction plan
+#define JOYSTICK_PLAN_BUTTONS 0
+#define JOYSTICK_PLAN_X       1
+#define JOYSTICK_PLAN_Y       2
+#define JOYSTICK_PLAN_HAT     3
+#define JOYSTICK_PLAN_FIELDS  4
 
 // Structure to store parsed HID joystick/gamepad report format
 typedef struct {
     bool is_valid;
+    int reportid;  // report ID (0 if not used)
     int buttons_bit_offset;
     int buttons_bits;
     int button_count;
@@ -21,8 +41,18 @@ typedef struct {
     int hat_bit_offset;
     int hat_bits;
     int hat_logical_min; // Added to handle 0-7 vs 1-8 ranges
+
+    // fields above, compiled into loads on connect
+    hid_extract_plan_t plan;
 } joystick_report_format_t;
 
-joystick_report_format_t* get_joystick_format();
-bool hid_host_joystick_report_callback(const uint8_t* const data,const int length);
-bool parse_joystick_report_descriptor(const uint8_t* desc, size_t desc_len,joystick_report_format_t* fmt);
\ No newline at end of file
+bool hid_host_joystick_report_callback(const joystick_report_format_t* fmt, joystick_motion_t* motion,
+                                       hid_motion_gen_t* gen, const uint8_t* const data,
+                                       const int length, uint32_t arrival_us);
+void hid_host_joystick_release(const joystick_report_format_t* fmt, joystick_motion_t* motion,
+                               hid_motion_gen_t* gen);
+void set_joystick_curve_config(const joystick_curve_config_t* cfg);
+
+void joystick_motion_init();
+void set_joystick_motion_period(uint32_t period_us);
+bool parse_joystick_report_map(const hid_report_map_t* map, joystick_report_format_t* fmt);
\ No newline at end of file
@@ -1,8 +1,9 @@
-#include <Arduino.h>
+#include <string.h>
 #include <esp_log.h>
 #include "usb_hid_keyboard.h"
 
 #include "usb_hid_host.h"
+#include "hid_trace.h"
 
 
 #include "hid_usage_keyboard.h"
@@ -117,19 +118,20 @@ inline bool hid_keyboard_get_char(uint8_t modifier, uint8_t key_code,
 }
 
 /**
- * @brief HID Keyboard print char symbol
+ * @brief HID Keyboard print char symbol (via the trace ring)
  *
  * @param[in] key_char  Keyboard char to stdout
  */
 inline void hid_keyboard_print_char(unsigned int key_char) {
     if (!!key_char) {
-        putchar(key_char);
+        char text[2] = {(char)key_char, '\n'};
+        size_t len = 1;
 #if (KEYBOARD_ENTER_LF_EXTEND)
         if (KEYBOARD_ENTER_MAIN_CHAR == key_char) {
-            putchar('\n');
+            len = 2;
         }
 #endif  // KEYBOARD_ENTER_LF_EXTEND
-        fflush(stdout);
+        hid_trace_write(HID_TRACE_CAT_KEYBOARD, HID_TRACE_REC_TEXT, text, len);
     }
 }
 
@@ -153,59 +155,194 @@ void key_event_callback(key_event_t* key_event) {
 }
 
 /**
- * @brief Key buffer scan code search.
+ * @brief Look up modifier, key array and key bitmap fields of one report
  *
- * @param[in] src       Pointer to source buffer where to search
- * @param[in] key       Key scancode to search
- * @param[in] length    Size of the source buffer
+ * @param[in]  map     Parsed report descriptor
+ * @param[in]  info    Report to look at
+ * @param[out] layout  Position of the fields
+ * @return true if the report has a key array or a key bitmap
  */
-inline bool key_found(const uint8_t* const src, uint8_t key,
-                             unsigned int length) {
-    for (unsigned int i = 0; i < length; i++) {
-        if (src[i] == key) {
-            return true;
+static bool parse_keyboard_layout(const hid_report_map_t* map, const hid_report_info_t* info,
+                                  keyboard_report_layout_t* layout) {
+    memset(layout, 0, sizeof(*layout));
+    layout->reportid = info->report_id;
+    layout->modifier_bit_offset = -1;
+
+    for (int i = info->first_field; i < info->first_field + info->field_count; i++) {
+        const hid_report_field_t* f = &map->fields[i];
+        if (f->type != HID_FIELD_TYPE_INPUT || f->usage_page != HID_USAGE_PAGE_KEYBOARD ||
+            (f->flags & HID_FIELD_CONSTANT)) {
+            continue;
+        }
+
+        if (f->flags & HID_FIELD_VARIABLE) {
+            if (f->size != 1) continue;
+            if (f->usage_min == 0xE0 && f->count == 8) {
+                layout->modifier_bit_offset = f->bit_offset;
+            } else if (f->usage_min <= HID_KEY_A && f->usage_max >= HID_KEY_A &&
+                       layout->bitmap_count == 0) {
+                // NKRO bitmap, may include the modifiers at 0xE0..0xE7
+                layout->bitmap_bit_offset = f->bit_offset;
+                layout->bitmap_usage_min = (uint8_t)f->usage_min;
+                layout->bitmap_count = f->count;
+                if (f->usage_min + f->count > 256) layout->bitmap_count = 256 - f->usage_min;
+            }
+        } else if (f->size == 8 && layout->key_count == 0 &&
+                   f->usage_min <= HID_KEY_A && f->usage_max >= HID_KEY_A) {
+            layout->keys_bit_offset = f->bit_offset;
+            layout->key_count = (f->count > KEYBOARD_MAX_ARRAY_KEYS) ? KEYBOARD_MAX_ARRAY_KEYS : f->count;
         }
     }
-    return false;
+    return layout->key_count > 0 || layout->bitmap_count > 0;
 }
 
 /**
- * @brief USB HID Host Keyboard Interface report callback handler
+ * @brief Look up the keyboard reports in the parsed report map
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * Both boot style reports with a key array and NKRO reports with a key
+ * bitmap are supported, also both in one interface.
+ *
+ * @param[in]  map  Parsed report descriptor
+ * @param[out] fmt  Keyboard report format
+ * @return true if at least one keyboard report was found
+ */
+bool parse_keyboard_report_map(const hid_report_map_t* map, keyboard_report_format_t* fmt) {
+    memset(fmt, 0, sizeof(*fmt));
+
+    for (int r = 0; r < map->report_count && fmt->layout_count < KEYBOARD_MAX_LAYOUTS; r++) {
+        keyboard_report_layout_t* layout = &fmt->layouts[fmt->layout_count];
+        if (!parse_keyboard_layout(map, &map->reports[r], layout)) continue;
+
+        ESP_LOGI(TAG, "Parsed keyboard report: reportid=%d, mod_off=%d, keys_off=%d, keys=%d, "
+                 "bitmap_off=%d, bitmap=%d bits from usage 0x%02X",
+                 layout->reportid, layout->modifier_bit_offset, layout->keys_bit_offset,
+                 layout->key_count, layout->bitmap_bit_offset, layout->bitmap_count,
+                 layout->bitmap_usage_min);
+        fmt->layout_count++;
+    }
+
+    fmt->is_valid = fmt->layout_count > 0;
+    ESP_LOGI(TAG, "Parsed keyboard format: valid=%d, reports=%d", fmt->is_valid, fmt->layout_count);
+    return fmt->is_valid;
+}
+
+/**
+ * @brief Read modifiers and pressed keys of a report
+ *
+ * @param[in]  layout  Position of the fields
+ * @param[in]  data    Pointer to input report data buffer
+ * @param[in]  length  Length of input report data buffer
+ * @param[out] keyData Modifiers and pressed keys
+ * @return false if the report signals ErrorRollOver
  */
-void hid_host_keyboard_report_callback(const uint8_t* const data, const int length) {
-    hid_keyboard_input_report_boot_t* kb_report =
-        (hid_keyboard_input_report_boot_t*)data;
+static bool decode_keyboard_layout(const keyboard_report_layout_t* layout, const uint8_t* data,
+                                   int length, unified_keyData_t* keyData) {
+    if (layout->modifier_bit_offset >= 0) {
+        keyData->modifier = (uint8_t)hid_extract_int(data, length, layout->modifier_bit_offset, 8, false);
+    }
+
+    for (int i = 0; i < layout->key_count; i++) {
+        uint8_t key = (uint8_t)hid_extract_int(data, length, layout->keys_bit_offset + i * 8, 8, false);
+        if (key == HID_KEY_ROLLOVER) return false;
+        if (key > HID_KEY_ERROR_UNDEFINED) hid_key_bitmap_set(&keyData->keys, key);
+    }
+
+    // bitmap: 32 keys per read
+    for (int i = 0; i < layout->bitmap_count; i += 32) {
+        int bits = (layout->bitmap_count - i > 32) ? 32 : layout->bitmap_count - i;
+        uint32_t word = (uint32_t)hid_extract_int(data, length, layout->bitmap_bit_offset + i, bits, false);
+        hid_key_bitmap_or_bits(&keyData->keys, layout->bitmap_usage_min + i, word, bits);
+    }
+    return true;
+}
 
-    if (length < sizeof(hid_keyboard_input_report_boot_t)) {
+/**
+ * @brief Compare a keyboard snapshot with the previous one, print pressed keys
+ * and hand the snapshot over if anything changed
+ */
+static void keyboard_update(keyboard_state_t* state, unified_keyData_t* keyData) {
+    // no error codes, modifier usages go to the modifier byte
+    keyData->keys.w[0] &= ~((1u << (HID_KEY_ERROR_UNDEFINED + 1)) - 1);
+    keyData->modifier |= (uint8_t)keyData->keys.w[7];
+    keyData->keys.w[7] &= ~0xFFu;
+
+    hid_key_bitmap_t pressed, released;
+    if (!hid_key_bitmap_diff(&state->prev_keys, &keyData->keys, &pressed, &released) &&
+        keyData->modifier == state->prev_modifier) {
         return;
     }
 
-    static uint8_t prev_keys[HID_KEYBOARD_KEY_MAX] = {0};
+    // one snapshot with modifiers and all pressed keys per changed report. If the
+    // event ring is full, the state is kept, so the next report sends it again
+    if (!hid_dispatch_keyData(keyData)) return;
+
     key_event_t key_event;
+    key_event.modifier = 0;
+    key_event.state = key_event.KEY_STATE_RELEASED;
+    for (int key = hid_key_bitmap_next(&released, 0); key >= 0;
+         key = hid_key_bitmap_next(&released, key + 1)) {
+        key_event.key_code = key;
+        key_event_callback(&key_event);
+    }
+    key_event.modifier = keyData->modifier;
+    key_event.state = key_event.KEY_STATE_PRESSED;
+    for (int key = hid_key_bitmap_next(&pressed, 0); key >= 0;
+         key = hid_key_bitmap_next(&pressed, key + 1)) {
+        key_event.key_code = key;
+        key_event_callback(&key_event);
+    }
 
-    for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
-        // key has been released verification
-        if (prev_keys[i] > HID_KEY_ERROR_UNDEFINED &&
-            !key_found(kb_report->key, prev_keys[i], HID_KEYBOARD_KEY_MAX)) {
-            key_event.key_code = prev_keys[i];
-            key_event.modifier = 0;
-            key_event.state = key_event.KEY_STATE_RELEASED;
-            key_event_callback(&key_event);
-        }
+    state->prev_modifier = keyData->modifier;
+    state->prev_keys = keyData->keys;
+}
 
-        // key has been pressed verification
-        if (kb_report->key[i] > HID_KEY_ERROR_UNDEFINED &&
-            !key_found(prev_keys, kb_report->key[i], HID_KEYBOARD_KEY_MAX)) {
-            key_event.key_code = kb_report->key[i];
-            key_event.modifier = kb_report->modifier.val;
-            key_event.state = key_event.KEY_STATE_PRESSED;
-            key_event_callback(&key_event);
+/**
+ * @brief USB HID Host Keyboard Interface report callback handler
+ *
+ * @param[in] fmt     Parsed report format of the device
+ * @param[in] state   Decoder state of the device
+ * @param[in] data    Pointer to input report data buffer
+ * @param[in] length  Length of input report data buffer
+ */
+void hid_host_keyboard_report_callback(const keyboard_report_format_t* fmt, keyboard_state_t* state,
+                                       const uint8_t* const data, const int length) {
+    unified_keyData_t keyData;
+    memset(&keyData, 0, sizeof(keyData));
+    keyData.source = state->source;
+
+    if (fmt->is_valid) {
+        const keyboard_report_layout_t* layout = NULL;
+        for (int i = 0; i < fmt->layout_count && layout == NULL; i++) {
+            uint8_t id = fmt->layouts[i].reportid;
+            if (id == 0 || (length >= 1 && data[0] == id)) layout = &fmt->layouts[i];
+        }
+        // ErrorRollOver: too many keys pressed, the key state is unknown, keep the last one
+        if (layout == NULL || !decode_keyboard_layout(layout, data, length, &keyData)) {
+            return;
+        }
+    } else {
+        if (length < sizeof(hid_keyboard_input_report_boot_t)) {
+            return;
         }
+        const hid_keyboard_input_report_boot_t* kb_report = (const hid_keyboard_input_report_boot_t*)data;
+        for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
+            if (kb_report->key[i] == HID_KEY_ROLLOVER) return;
+        }
+        keyData.modifier = kb_report->modifier.val;
+        hid_key_bitmap_from_keys(&keyData.keys, kb_report->key, HID_KEYBOARD_KEY_MAX);
     }
 
-    memcpy(prev_keys, &kb_report->key, HID_KEYBOARD_KEY_MAX);
+    keyboard_update(state, &keyData);
 }
 
+/**
+ * @brief Release all keys of a keyboard interface, e.g. when it was disconnected
+ *
+ * @param[in] state  Decoder state of the device
+ */
+void hid_host_keyboard_release(keyboard_state_t* state) {
+    unified_keyData_t keyData;
+    memset(&keyData, 0, sizeof(keyData));
+    keyData.source = state->source;
+    keyboard_update(state, &keyData);
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "hid_host.h"
+#include "hid_usage_keyboard.h"
+#include "usb_hid_report_desc.h"
+#include "hid_key_bitmap.h"
 
 
 /**
@@ -15,6 +18,36 @@ typedef struct {
     uint8_t key_code;
 } key_event_t;
 
+// Keyboard reports of one interface which are decoded (e.g. 6KRO and NKRO report)
+#define KEYBOARD_MAX_LAYOUTS 2
+// Maximum number of entries of a key array
+#define KEYBOARD_MAX_ARRAY_KEYS 32
+
+// Position of modifiers and keys in one keyboard report
+typedef struct {
+    uint8_t reportid;             // report ID (0 if not used)
+    int16_t modifier_bit_offset;  // -1 if the report has no modifier byte
+    int16_t keys_bit_offset;      // key array: one usage per 8 bit entry
+    uint8_t key_count;            // number of key array entries, 0 if none
+    int16_t bitmap_bit_offset;    // key bitmap (NKRO): one bit per usage
+    uint8_t bitmap_usage_min;     // usage of the first bitmap bit
+    uint16_t bitmap_count;        // number of bitmap bits, 0 if none
+} keyboard_report_layout_t;
+
+// Structure to store parsed HID keyboard report format
+typedef struct {
+    bool is_valid;
+    uint8_t layout_count;
+    keyboard_report_layout_t layouts[KEYBOARD_MAX_LAYOUTS];
+} keyboard_report_format_t;
+
+// Per-device keyboard decoder state
+typedef struct {
+    uint8_t source;  // identifies the interface in keyboard snapshots
+    uint8_t prev_modifier;
+    hid_key_bitmap_t prev_keys;
+} keyboard_state_t;
+
 /* Main char symbol for ENTER key */
 #define KEYBOARD_ENTER_MAIN_CHAR '\r'
 /* When set to 1 pressing ENTER will be extending with LineFeed during serial
@@ -22,4 +55,6 @@ typedef struct {
 #define KEYBOARD_ENTER_LF_EXTEND 1
 
 
-void hid_host_keyboard_report_callback(const uint8_t* const data, const int length);
\ No newline at end of file
+void hid_host_keyboard_report_callback(const keyboard_report_format_t* fmt, keyboard_state_t* state, const uint8_t* const data, const int length);
+void hid_host_keyboard_release(keyboard_state_t* state);
+bool parse_keyboard_report_map(const hid_report_map_t* map, keyboard_report_format_t* fmt);
\ No newline at end of file
@@ -1,4 +1,4 @@
-#include <Arduino.h>
+#include <string.h>
 #include <esp_log.h>
 #include "usb_hid_mouse.h"
 
@@ -7,247 +7,159 @@
 
 
 static const char* TAG = "usb-hid-mouse";
-mouse_report_format_t mouse_format = {0};
-mouse_report_format_t* get_mouse_format() { return &mouse_format; }
 
+// Gain tables of the acceleration profiles, built on first use
+static const hid_ballistics_profile_t default_profiles[MOUSE_BALLISTICS_PROFILES] = {
+    {1, {{0, 100}}},
+    {4, {{0, 100}, {1000, 100}, {4000, 200}, {8000, 300}}},
+    {4, {{0, 150}, {500, 200}, {2000, 400}, {5000, 600}}},
+    {4, {{0, 100}, {300, 150}, {1500, 300}, {4000, 500}}},
+};
+static hid_ballistics_t ballistics_tables[MOUSE_BALLISTICS_PROFILES];
+static bool ballistics_ready = false;
+static mouse_settings_t mouse_settings_default = {MOUSE_BALLISTICS_NONE, {0, 0, 0}};
+static mouse_settings_callback_t registered_settings_callback = NULL;
+
+static void ballistics_build_defaults() {
+    for (int i = 0; i < MOUSE_BALLISTICS_PROFILES; i++) {
+        hid_ballistics_build(&ballistics_tables[i], &default_profiles[i]);
+    }
+    ballistics_ready = true;
+}
 
-bool parse_mouse_report_descriptor(const uint8_t* desc, size_t desc_len,
-                                          mouse_report_format_t* fmt) {
-    memset(fmt, 0, sizeof(*fmt));
+/**
+ * @brief Select the default acceleration profile of mice
+ *
+ * @param[in] profile  MOUSE_BALLISTICS_x
+ */
+void set_mouse_ballistics_default(uint8_t profile) {
+    if (profile < MOUSE_BALLISTICS_PROFILES) mouse_settings_default.ballistics_profile = profile;
+}
 
-    int bit_offset = 0;
-    int report_size = 0;   // bits
-    int report_count = 0;  // fields
-    int report_id = 0;  // report id
-    uint16_t usage_page = 0;
-
-    // local state
-    uint16_t usages[16];
-    int usage_count = 0;
-    uint16_t usage_min = 0;
-    uint16_t usage_max = 0;
-    bool have_usage_range = false;
-
-    bool found_x = false, found_y = false, found_buttons = false,
-         found_wheel = false;
-
-    ESP_LOGI(TAG, "Parsing HID Mouse report descriptor (%u bytes)",
-             (unsigned)desc_len);
-    ESP_LOGI(TAG, "Raw descriptor:");
-    for (size_t i = 0; i < desc_len; i += 16) {
-        char line[80];
-        int pos = 0;
-        for (size_t j = i; j < desc_len && j < i + 16; ++j) {
-            pos += snprintf(line + pos, sizeof(line) - pos, "%02X ", desc[j]);
-        }
-        ESP_LOGI(TAG, "%04u: %s", (unsigned)i, line);
+/**
+ * @brief Set the default tremor filter of mice
+ *
+ * @param[in] cfg  Filter settings, min_cutoff_x100 = 0 disables the filter
+ */
+void set_mouse_tremor_filter_default(const hid_tremor_filter_config_t* cfg) {
+    mouse_settings_default.tremor = *cfg;
+}
+
+/**
+ * @brief Replace the curve of a built-in profile, call before start_usb_host()
+ *
+ * @param[in] profile  MOUSE_BALLISTICS_x, except MOUSE_BALLISTICS_NONE
+ * @param[in] points   Gain curve
+ */
+void set_mouse_ballistics_profile(uint8_t profile, const hid_ballistics_profile_t* points) {
+    if (profile == MOUSE_BALLISTICS_NONE || profile >= MOUSE_BALLISTICS_PROFILES) return;
+    if (!ballistics_ready) ballistics_build_defaults();
+    hid_ballistics_build(&ballistics_tables[profile], points);
+}
+
+/**
+ * @brief Register a callback which chooses the motion processing per device
+ *
+ * @param[in] callback  Called on connect with the report descriptor hash
+ */
+void register_mouse_settings_callback(mouse_settings_callback_t callback) {
+    registered_settings_callback = callback;
+}
+
+/**
+ * @brief Set up the motion processing of a newly connected interface
+ *
+ * @param[out] state      Motion processing state
+ * @param[in]  desc_hash  Hash of the report descriptor
+ * @param[in]  params     Interface parameters
+ */
+void mouse_state_init(mouse_state_t* state, uint32_t desc_hash,
+                      const hid_host_dev_params_t* params) {
+    mouse_settings_t settings = mouse_settings_default;
+    if (registered_settings_callback != NULL) {
+        registered_settings_callback(desc_hash, params, &settings);
     }
 
-    for (size_t i = 0; i < desc_len;) {
-        uint8_t b = desc[i++];
-
-        if ((b & 0xF0) == 0xF0) {
-            // Long item – not used in typical mouse descriptors, skip safely
-            if (i + 1 >= desc_len) break;
-            uint8_t data_len = desc[i++];
-            uint8_t long_tag = desc[i++];
-            (void)long_tag;
-            i += data_len;
-            continue;
-        }
+    memset(state, 0, sizeof(*state));
+    state->profile = (settings.ballistics_profile < MOUSE_BALLISTICS_PROFILES)
+                         ? settings.ballistics_profile
+                         : MOUSE_BALLISTICS_NONE;
+    hid_tremor_filter_init(&state->tremor, &settings.tremor);
+}
 
-        uint8_t size = b & 0x03;
-        uint8_t type = (b >> 2) & 0x03;
-        uint8_t tag = (b >> 4) & 0x0F;
 
-        if (size == 3) size = 4;  // HID quirk
+/**
+ * @brief Look up the mouse fields in the parsed report map
+ *
+ * Reports of a Mouse application collection are preferred, otherwise the
+ * first report with X, Y and buttons is used.
+ *
+ * @param[in]  map  Parsed report descriptor
+ * @param[out] fmt  Mouse report format
+ * @return true if a report with X, Y and buttons was found
+ */
+bool parse_mouse_report_map(const hid_report_map_t* map, mouse_report_format_t* fmt) {
+    memset(fmt, 0, sizeof(*fmt));
 
-        uint32_t data = 0;
-        for (uint8_t n = 0; n < size && i < desc_len; ++n) {
-            data |= (uint32_t)desc[i++] << (8 * n);
+    for (int pass = 0; pass < 2 && !fmt->is_valid; pass++) {
+        for (int r = 0; r < map->report_count; r++) {
+            const hid_report_info_t* info = &map->reports[r];
+            if (pass == 0 && !(info->app_usage_page == HID_USAGE_PAGE_GENERIC_DESKTOP &&
+                               info->app_usage == HID_USAGE_MOUSE)) {
+                continue;
+            }
+
+            int btn_off, x_off, y_off, wheel_off;
+            const hid_report_field_t* btn = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_BUTTON, 1, &btn_off);
+            const hid_report_field_t* x = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_X, &x_off);
+            const hid_report_field_t* y = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_Y, &y_off);
+            if (btn == NULL || btn->size != 1 || x == NULL || y == NULL) continue;
+
+            fmt->reportid = info->report_id;
+            fmt->buttons_bit_offset = btn_off;
+            fmt->button_count = btn->count;
+            fmt->buttons_bits = (btn->count > 32) ? 32 : btn->count;
+
+            // relative axes are signed even if a device declares no negative minimum
+            fmt->x_bit_offset = x_off;
+            fmt->x_bits = x->size;
+            fmt->x_signed = x->logical_min < 0 || (x->flags & HID_FIELD_RELATIVE);
+            fmt->y_bit_offset = y_off;
+            fmt->y_bits = y->size;
+            fmt->y_signed = y->logical_min < 0 || (y->flags & HID_FIELD_RELATIVE);
+
+            const hid_report_field_t* wheel = hid_report_find_usage(
+                map, HID_FIELD_TYPE_INPUT, info->report_id, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                HID_USAGE_WHEEL, &wheel_off);
+            if (wheel != NULL) {
+                fmt->wheel_bit_offset = wheel_off;
+                fmt->wheel_bits = wheel->size;
+                fmt->wheel_signed = wheel->logical_min < 0 || (wheel->flags & HID_FIELD_RELATIVE);
+            }
+            fmt->is_valid = true;
+            break;
         }
+    }
 
-        switch (type) {
-            case 0:                 // Main
-                if (tag == 0x08) {  // Input
-                    ESP_LOGD(TAG,
-                             "Input: usage_page=0x%X, bit_offset=%d, "
-                             "report_size=%d, report_count=%d, usage_count=%d",
-                             usage_page, bit_offset, report_size, report_count,
-                             usage_count);
-
-                    // BUTTONS
-                    if (usage_page == 0x09) {  // Button page
-                        if (!found_buttons && report_count > 0 &&
-                            report_size == 1) {
-                            fmt->buttons_bit_offset = bit_offset;
-                            fmt->buttons_bits =
-                                report_count;  // could be > physical buttons
-                            fmt->button_count = report_count;
-                            found_buttons = true;
-                            ESP_LOGI(TAG, "Buttons: bit_offset=%d, bits=%d",
-                                     fmt->buttons_bit_offset,
-                                     fmt->buttons_bits);
-                        }
-                    }
-                    // AXES / WHEELS
-                    else if (usage_page == 0x01) {  // Generic Desktop
-                        int field_bit = bit_offset;
-
-                        // 1) explicit usages
-                        for (int u = 0; u < usage_count; ++u) {
-                            uint16_t uval = usages[u];
-
-                            if (!found_x && uval == 0x30) {  // X
-                                fmt->x_bit_offset = field_bit;
-                                fmt->x_bits = report_size;
-                                fmt->x_signed =
-                                    (data & 0x02) !=
-                                    0;  // Variable bit => signed for rel axes
-                                found_x = true;
-                                ESP_LOGI(TAG,
-                                         "X: bit_offset=%d, bits=%d, signed=%d",
-                                         fmt->x_bit_offset, fmt->x_bits,
-                                         fmt->x_signed);
-                            } else if (!found_y && uval == 0x31) {  // Y
-                                fmt->y_bit_offset = field_bit;
-                                fmt->y_bits = report_size;
-                                fmt->y_signed = (data & 0x02) != 0;
-                                found_y = true;
-                                ESP_LOGI(TAG,
-                                         "Y: bit_offset=%d, bits=%d, signed=%d",
-                                         fmt->y_bit_offset, fmt->y_bits,
-                                         fmt->y_signed);
-                            } else if (!found_wheel && uval == 0x38) {  // Wheel
-                                fmt->wheel_bit_offset = field_bit;
-                                fmt->wheel_bits = report_size;
-                                fmt->wheel_signed = (data & 0x02) != 0;
-                                found_wheel = true;
-                                ESP_LOGI(
-                                    TAG,
-                                    "Wheel: bit_offset=%d, bits=%d, signed=%d",
-                                    fmt->wheel_bit_offset, fmt->wheel_bits,
-                                    fmt->wheel_signed);
-                            }
-
-                            field_bit += report_size;
-                        }
-
-                        // 2) usage range (X..Y etc.)
-                        if (usage_count == 0 && have_usage_range) {
-                            uint16_t u = usage_min;
-                            for (int idx = 0; idx < report_count; ++idx, ++u) {
-                                int obit = bit_offset + idx * report_size;
-                                if (!found_x && u == 0x30) {
-                                    fmt->x_bit_offset = obit;
-                                    fmt->x_bits = report_size;
-                                    fmt->x_signed = (data & 0x02) != 0;
-                                    found_x = true;
-                                    ESP_LOGI(TAG,
-                                             "X(range): bit_offset=%d, "
-                                             "bits=%d, signed=%d",
-                                             fmt->x_bit_offset, fmt->x_bits,
-                                             fmt->x_signed);
-                                } else if (!found_y && u == 0x31) {
-                                    fmt->y_bit_offset = obit;
-                                    fmt->y_bits = report_size;
-                                    fmt->y_signed = (data & 0x02) != 0;
-                                    found_y = true;
-                                    ESP_LOGI(TAG,
-                                             "Y(range): bit_offset=%d, "
-                                             "bits=%d, signed=%d",
-                                             fmt->y_bit_offset, fmt->y_bits,
-                                             fmt->y_signed);
-                                } else if (!found_wheel && u == 0x38) {
-                                    fmt->wheel_bit_offset = obit;
-                                    fmt->wheel_bits = report_size;
-                                    fmt->wheel_signed = (data & 0x02) != 0;
-                                    found_wheel = true;
-                                    ESP_LOGI(TAG,
-                                             "Wheel(range): bit_offset=%d, "
-                                             "bits=%d, signed=%d",
-                                             fmt->wheel_bit_offset,
-                                             fmt->wheel_bits,
-                                             fmt->wheel_signed);
-                                }
-                            }
-                        }
-                    }
-
-                    bit_offset += report_size * report_count;
-
-                    // reset locals
-                    usage_count = 0;
-                    usage_min = 0;
-                    usage_max = 0;
-                    have_usage_range = false;
-                } else if (tag == 0x0A) { // Collection
-                    // Clear usages when entering a collection.
-                    // Usages defined before a collection apply to the collection itself.
-                    usage_count = 0;
-                    usage_min = 0;
-                    usage_max = 0;
-                    have_usage_range = false;
-                }
-                // other main items (Output, Feature, End Collection) are ignored for format
-                break;
-
-            case 1:  // Global
-                switch (tag) {
-                    case 0x0:  // Usage Page
-                        usage_page = (uint16_t)data;
-                        break;
-                    case 0x7:  // Report Size
-                        report_size = (int)data;
-                        break;
-                    case 0x9:  // Report Count
-                        report_count = (int)data;
-                        break;
-                    case 0x8:  // Report ID
-                        //because we want to save only the reportID of the mouse usage page:
-                        //if we already found a valid set of buttons/x/y/wheel, we can assume
-                        //we don't want any following report ids saved
-                        if(!(found_x && found_y && found_buttons)) {
-                            report_id = (int)data;
-                        }
-                        break;
-                    default:
-                        break;
-                }
-                break;
-
-            case 2:  // Local
-                switch (tag) {
-                    case 0x0:  // Usage
-                        if (usage_count <
-                            (int)(sizeof(usages) / sizeof(usages[0]))) {
-                            usages[usage_count++] = (uint16_t)data;
-                        }
-                        break;
-                    case 0x1:  // Usage Min
-                        usage_min = (uint16_t)data;
-                        have_usage_range = true;
-                        break;
-                    case 0x2:  // Usage Max
-                        usage_max = (uint16_t)data;
-                        have_usage_range = true;
-                        break;
-                    default:
-                        break;
-                }
-                break;
+    if (fmt->is_valid) {
+        // compile the fields into direct and grouped loads, order as in MOUSE_PLAN_x
+        hid_plan_init(&fmt->plan);
+        hid_plan_add_field(&fmt->plan, fmt->buttons_bit_offset,
+                           (fmt->buttons_bits > 8) ? 8 : fmt->buttons_bits, false);
+        hid_plan_add_field(&fmt->plan, fmt->x_bit_offset, fmt->x_bits, fmt->x_signed);
+        hid_plan_add_field(&fmt->plan, fmt->y_bit_offset, fmt->y_bits, fmt->y_signed);
+        if (fmt->wheel_bits > 0) {
+            hid_plan_add_field(&fmt->plan, fmt->wheel_bit_offset, fmt->wheel_bits,
+                               fmt->wheel_signed);
         }
+        hid_plan_compile(&fmt->plan);
     }
 
-    fmt->is_valid = found_x && found_y && found_buttons;
-    fmt->reportid = report_id;
-    //offset all fields by 1Byte if report id is found:
-    if(fmt->reportid > 0) {
-        fmt->buttons_bit_offset += 8;
-        fmt->x_bit_offset += 8;
-        fmt->y_bit_offset += 8;
-        fmt->wheel_bit_offset += 8;
-    }
     ESP_LOGI(TAG,
              "Parsed mouse format: valid=%d, reportid=%d, btn_off=%d bits, x_off=%d bits, "
              "y_off=%d bits, wheel_off=%d bits",
@@ -257,43 +169,33 @@ bool parse_mouse_report_descriptor(const uint8_t* desc, size_t desc_len,
 }
 
 
-bool parse_custom_mouse_report(const uint8_t* data, int length,
-                                      unified_hidData_t* out) {
-    if (!mouse_format.is_valid) return false;
+bool parse_custom_mouse_report(const mouse_report_format_t* fmt,
+                               const uint8_t* data, int length,
+                               unified_hidData_t* out) {
+    if (!fmt->is_valid) return false;
 
-    //check if report id matches in mouse_format
-    uint8_t reportid = hid_extract_int(data,1,0,8,false);
+    // other reports of the device, e.g. consumer control of a receiver
+    if (fmt->reportid != 0 && (length < 1 || data[0] != fmt->reportid)) return false;
+
+    memset(out, 0, sizeof(*out));
 
-    if(mouse_format.reportid != 0 && mouse_format.reportid != reportid) {
-        ESP_LOGE(TAG,"Wrong report ID, expected %d, got %d",mouse_format.reportid,reportid);
+    // Buttons, X, Y and Wheel in one pass over the compiled plan
+    int32_t values[MOUSE_PLAN_FIELDS] = {0};
+    if (!hid_plan_run(&fmt->plan, data, length, values)) {
+        ESP_LOGW(TAG, "Report too short (length=%d)", length);
         return false;
     }
 
-    memset(out, 0, sizeof(*out));
-
-    // Buttons: just look at first 8 bits starting at buttons_bit_offset.
-    int32_t btns =
-        hid_extract_int(data, length, mouse_format.buttons_bit_offset,
-                        mouse_format.buttons_bits, false);
+    int32_t btns = values[MOUSE_PLAN_BUTTONS];
     out->buttons.button1 = (btns & 0x01) != 0;
     out->buttons.button2 = (btns & 0x02) != 0;
     out->buttons.button3 = (btns & 0x04) != 0;
+    out->buttons.button4 = (btns & 0x08) != 0;  // back
+    out->buttons.button5 = (btns & 0x10) != 0;  // forward
 
-    // X, Y, Wheel
-    out->x_displacement =
-        (int16_t)hid_extract_int(data, length, mouse_format.x_bit_offset,
-                                 mouse_format.x_bits, mouse_format.x_signed);
-    out->y_displacement =
-        (int16_t)hid_extract_int(data, length, mouse_format.y_bit_offset,
-                                 mouse_format.y_bits, mouse_format.y_signed);
-
-    if (mouse_format.wheel_bits > 0) {
-        out->scroll_wheel = (int8_t)hid_extract_int(
-            data, length, mouse_format.wheel_bit_offset,
-            mouse_format.wheel_bits, mouse_format.wheel_signed);
-    } else {
-        out->scroll_wheel = 0;
-    }
+    out->x_displacement = (int16_t)values[MOUSE_PLAN_X];
+    out->y_displacement = (int16_t)values[MOUSE_PLAN_Y];
+    out->scroll_wheel = (int8_t)values[MOUSE_PLAN_WHEEL];
 
     ESP_LOGD(TAG, "Parsed report: btns=0x%X X=%d Y=%d Wheel=%d", (unsigned)btns,
              out->x_displacement, out->y_displacement, out->scroll_wheel);
@@ -304,17 +206,25 @@ bool parse_custom_mouse_report(const uint8_t* data, int length,
 /**
  * @brief USB HID Host Mouse Interface report callback handler
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * @param[in] fmt         Parsed report format of the device
+ * @param[in] state       Motion processing state of the device
+ * @param[in] data        Pointer to input report data buffer
+ * @param[in] length      Length of input report data buffer
+ * @param[in] arrival_us  Arrival time of the report
  */
-void hid_host_mouse_report_callback(const uint8_t* const data,
-                                           const int length) {
+void hid_host_mouse_report_callback(const mouse_report_format_t* fmt,
+                                    mouse_state_t* state,
+                                    const uint8_t* const data,
+                                    const int length,
+                                    uint32_t arrival_us) {
     unified_hidData_t unified_hidData;
     bool parsed = false;
 
     // Try to parse using custom descriptor format first
-    if (mouse_format.is_valid) {
-        parsed = parse_custom_mouse_report(data, length, &unified_hidData);
+    if (fmt->is_valid) {
+        // reports with other IDs are no mouse reports, the boot layout does not apply to them
+        if (fmt->reportid != 0 && (length < 1 || data[0] != fmt->reportid)) return;
+        parsed = parse_custom_mouse_report(fmt, data, length, &unified_hidData);
     }
 
     // Fall back to boot protocol format
@@ -323,6 +233,7 @@ void hid_host_mouse_report_callback(const uint8_t* const data,
             (hid_mouse_input_report_boot_t*)data;
 
         // Convert boot format to standard format
+        memset(&unified_hidData, 0, sizeof(unified_hidData));
         unified_hidData.x_displacement = boot_report->x_displacement;
         unified_hidData.y_displacement = boot_report->y_displacement;
         unified_hidData.buttons.button1 = boot_report->buttons.button1;
@@ -339,9 +250,22 @@ void hid_host_mouse_report_callback(const uint8_t* const data,
         return;
     }
 
-    // Call registered callback function if one exists
-    if (get_registered_hidData_callback() != NULL) {
-        (*get_registered_hidData_callback())(&unified_hidData);
+    // motion is processed in aligned copies, the unified report is packed
+    int16_t dx = unified_hidData.x_displacement;
+    int16_t dy = unified_hidData.y_displacement;
 
+    // tremor filter first, so the acceleration sees the smoothed speed
+    hid_tremor_filter_apply(&state->tremor, arrival_us, &dx, &dy);
+
+    // pointer acceleration, keyed on the speed over the real inter-report time
+    if (state->profile != MOUSE_BALLISTICS_NONE) {
+        if (!ballistics_ready) ballistics_build_defaults();
+        hid_ballistics_apply(&ballistics_tables[state->profile], &state->ballistics, arrival_us,
+                             &dx, &dy);
     }
+    unified_hidData.x_displacement = dx;
+    unified_hidData.y_displacement = dy;
+
+    // Pass report on to the sender task, which calls the registered callback
+    hid_dispatch_hidData(&unified_hidData);
 }
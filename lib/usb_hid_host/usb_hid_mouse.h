@@ -1,6 +1,24 @@
 #pragma once
 
 #include "hid_host.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_extract.h"
+#include "hid_ballistics.h"
+#include "hid_tremor_filter.h"
+
+// Built-in acceleration profiles, selected per device on connect
+#define MOUSE_BALLISTICS_NONE      0  // deltas are forwarded unchanged
+#define MOUSE_BALLISTICS_ACCEL     1  // unchanged when slow, up to 3x when fast
+#define MOUSE_BALLISTICS_LOW_DPI   2  // for low resolution mice, 1.5x to 6x
+#define MOUSE_BALLISTICS_TRACKBALL 3  // fine control when slow, 5x for long moves
+#define MOUSE_BALLISTICS_PROFILES  4
+
+// Order of the fields in the mouse extraction plan
+#define MOUSE_PLAN_BUTTONS 0
+#define MOUSE_PLAN_X       1
+#define MOUSE_PLAN_Y       2
+#define MOUSE_PLAN_WHEEL   3
+#define MOUSE_PLAN_FIELDS  4
 
 
 // Structure to store parsed HID mouse report format
@@ -26,10 +44,37 @@ typedef struct {
     int wheel_bit_offset;
     int wheel_bits;
     bool wheel_signed;
+
+    // fields above, compiled into loads on connect
+    hid_extract_plan_t plan;
 } mouse_report_format_t;
 
 
-mouse_report_format_t* get_mouse_format();
+// Motion processing of one mouse, chosen on connect
+typedef struct {
+    uint8_t ballistics_profile;         // MOUSE_BALLISTICS_x
+    hid_tremor_filter_config_t tremor;  // min_cutoff_x100 = 0: no filter
+} mouse_settings_t;
+
+// Motion processing state of one mouse
+typedef struct {
+    uint8_t profile;  // MOUSE_BALLISTICS_x
+    hid_ballistics_state_t ballistics;
+    hid_tremor_filter_t tremor;
+} mouse_state_t;
+
+// Callback which adjusts the settings of a mouse on connect, called with the defaults
+typedef void (*mouse_settings_callback_t)(uint32_t desc_hash, const hid_host_dev_params_t* params,
+                                          mouse_settings_t* settings);
+
+void hid_host_mouse_report_callback(const mouse_report_format_t* fmt, mouse_state_t* state,
+                                    const uint8_t* const data, const int length,
+                                    uint32_t arrival_us);
+bool parse_mouse_report_map(const hid_report_map_t* map, mouse_report_format_t* fmt);
 
-void hid_host_mouse_report_callback(const uint8_t* const data, const int length);
-bool parse_mouse_report_descriptor(const uint8_t* desc, size_t desc_len, mouse_report_format_t* fmt);
\ No newline at end of file
+void set_mouse_ballistics_default(uint8_t profile);
+void set_mouse_ballistics_profile(uint8_t profile, const hid_ballistics_profile_t* points);
+void set_mouse_tremor_filter_default(const hid_tremor_filter_config_t* cfg);
+void register_mouse_settings_callback(mouse_settings_callback_t callback);
+void mouse_state_init(mouse_state_t* state, uint32_t desc_hash,
+                      const hid_host_dev_params_t* params);
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "usb_hid_quirks.h"
+
+/*
+ * Devices which need workarounds during enumeration, the delay is counted
+ * from the end of the host library's enumeration. Keep the table sorted by
+ * VID:PID, this is checked when compiling. Example:
+ *
+ *   {0x1234, 0x5678, 10, USB_HID_QUIRK_NO_SET_IDLE, NULL, 0},
+ */
+static constexpr usb_hid_quirk_t quirk_table[] = {
+    USB_HID_QUIRK_END
+};
+
+static constexpr size_t quirk_count = sizeof(quirk_table) / sizeof(quirk_table[0]);
+
+static_assert(usb_hid_quirks_sorted(quirk_table, quirk_count),
+              "quirk_table must be sorted by VID:PID");
+
+/**
+ * @brief Binary search for the quirks of a device
+ *
+ * @param[in] table  Quirk table sorted by VID:PID
+ * @param[in] count  Number of entries
+ * @param[in] vid    Vendor ID
+ * @param[in] pid    Product ID
+ * @return Quirks of the device, or NULL if there are none
+ */
+const usb_hid_quirk_t* usb_hid_quirk_find(const usb_hid_quirk_t* table, size_t count,
+                                          uint16_t vid, uint16_t pid) {
+    uint32_t key = usb_hid_quirk_key(vid, pid);
+    if (key == usb_hid_quirk_key(0xFFFF, 0xFFFF)) return NULL;  // end marker
+
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t k = usb_hid_quirk_key(table[mid].vid, table[mid].pid);
+        if (k == key) return &table[mid];
+        if (k < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+// Quirks of a device from the built-in table, NULL if there are none
+const usb_hid_quirk_t* usb_hid_quirk_lookup(uint16_t vid, uint16_t pid) {
+    return usb_hid_quirk_find(quirk_table, quirk_count, vid, pid);
+}
+
+/**
+ * @brief Time still to wait before the interface of a device is opened
+ *
+ * @param[in] quirk    Quirks of the device, or NULL
+ * @param[in] enum_us  When the host library finished enumerating the device
+ * @param[in] now_us   Current time
+ * @return What is left of the quirk delay counted from enum_us, 0 for devices
+ *         without a delay
+ */
+uint32_t usb_hid_quirk_wait_us(const usb_hid_quirk_t* quirk, uint32_t enum_us, uint32_t now_us) {
+    if (quirk == NULL || quirk->delay_ms == 0) return 0;
+    uint32_t elapsed_us = now_us - enum_us;
+    uint32_t delay_us = (uint32_t)quirk->delay_ms * 1000;
+    return (elapsed_us < delay_us) ? delay_us - elapsed_us : 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Quirk flags
+#define USB_HID_QUIRK_NO_SET_IDLE      0x01  // device stalls SET_IDLE, do not send it
+#define USB_HID_QUIRK_NO_SET_PROTOCOL  0x02  // keep the protocol the device starts with
+#define USB_HID_QUIRK_BOOT_PROTOCOL    0x04  // use the boot protocol even if the descriptor parses
+
+/**
+ * @brief Workarounds for one device, keyed by VID:PID
+ *
+ * Devices without an entry get no delays and the default class requests.
+ */
+typedef struct {
+    uint16_t vid;
+    uint16_t pid;
+    uint16_t delay_ms;           // from the end of enumeration until the interface is
+                                 // opened, and before each class request
+    uint8_t flags;               // USB_HID_QUIRK_*
+    const uint8_t* report_desc;  // replaces the report descriptor of the device, or NULL
+    uint16_t report_desc_len;
+} usb_hid_quirk_t;
+
+// Ends a quirk table, sorts after every real device and is never matched
+#define USB_HID_QUIRK_END {0xFFFF, 0xFFFF, 0, 0, NULL, 0}
+
+constexpr uint32_t usb_hid_quirk_key(uint16_t vid, uint16_t pid) {
+    return ((uint32_t)vid << 16) | pid;
+}
+
+// True if the table is sorted by VID:PID without duplicates, for static_assert
+constexpr bool usb_hid_quirks_sorted(const usb_hid_quirk_t* table, size_t count) {
+    return count < 2 ||
+           (usb_hid_quirk_key(table[0].vid, table[0].pid) <
+                usb_hid_quirk_key(table[1].vid, table[1].pid) &&
+            usb_hid_quirks_sorted(table + 1, count - 1));
+}
+
+const usb_hid_quirk_t* usb_hid_quirk_find(const usb_hid_quirk_t* table, size_t count,
+                                          uint16_t vid, uint16_t pid);
+const usb_hid_quirk_t* usb_hid_quirk_lookup(uint16_t vid, uint16_t pid);
+uint32_t usb_hid_quirk_wait_us(const usb_hid_quirk_t* quirk, uint32_t enum_us, uint32_t now_us);
@@ -0,0 +1,389 @@
+#include <string.h>
+#include <esp_log.h>
+#include "usb_hid_report_desc.h"
+
+static const char* TAG = "usb-hid-report-desc";
+
+// Global items, saved and restored by Push/Pop
+typedef struct {
+    uint16_t usage_page;
+    int32_t logical_min;
+    int32_t logical_max;
+    uint16_t report_size;
+    uint16_t report_count;
+    uint8_t report_id;
+} hid_global_state_t;
+
+// Local usage or usage range (usage_min == usage_max for a single usage)
+typedef struct {
+    uint16_t usage_page;
+    uint16_t usage_min;
+    uint16_t usage_max;
+} hid_usage_range_t;
+
+typedef struct {
+    hid_usage_range_t usages[HID_REPORT_MAX_USAGES];
+    int usage_count;
+    uint32_t pending_usage_min;
+    bool have_usage_min;
+} hid_local_state_t;
+
+/**
+ * @brief Get the report index entry for a report ID, add it if not present yet
+ */
+static hid_report_info_t* get_report_info(hid_report_map_t* map, uint8_t report_id) {
+    for (int i = 0; i < map->report_count; i++) {
+        if (map->reports[i].report_id == report_id) return &map->reports[i];
+    }
+    if (map->report_count >= HID_REPORT_MAX_IDS) return NULL;
+
+    hid_report_info_t* info = &map->reports[map->report_count++];
+    memset(info, 0, sizeof(*info));
+    info->report_id = report_id;
+    return info;
+}
+
+/**
+ * @brief Add a local usage or usage range, extended usages carry their own page
+ */
+static void add_local_usage(hid_local_state_t* local, const hid_global_state_t* global,
+                            uint32_t usage_min, uint32_t usage_max, uint8_t item_size) {
+    if (local->usage_count >= HID_REPORT_MAX_USAGES) return;
+
+    hid_usage_range_t* u = &local->usages[local->usage_count++];
+    u->usage_page = (item_size == 4) ? (uint16_t)(usage_min >> 16) : global->usage_page;
+    u->usage_min = (uint16_t)usage_min;
+    u->usage_max = (uint16_t)usage_max;
+    if (u->usage_max < u->usage_min) u->usage_max = u->usage_min;
+}
+
+/**
+ * @brief Usage of element 'index' of a variable main item. Elements beyond the
+ * declared usages repeat the last usage, as defined by the HID spec.
+ */
+static bool get_element_usage(const hid_local_state_t* local, int index,
+                              uint16_t* usage_page, uint16_t* usage) {
+    if (local->usage_count == 0) return false;
+
+    for (int i = 0; i < local->usage_count; i++) {
+        const hid_usage_range_t* u = &local->usages[i];
+        int range = u->usage_max - u->usage_min + 1;
+        if (index < range) {
+            *usage_page = u->usage_page;
+            *usage = u->usage_min + index;
+            return true;
+        }
+        index -= range;
+    }
+    const hid_usage_range_t* last = &local->usages[local->usage_count - 1];
+    *usage_page = last->usage_page;
+    *usage = last->usage_max;
+    return true;
+}
+
+static hid_report_field_t* new_field(hid_report_map_t* map, const hid_global_state_t* global,
+                                     uint8_t type, uint8_t flags, int bit_offset) {
+    if (map->field_count >= HID_REPORT_MAX_FIELDS) {
+        ESP_LOGW(TAG, "Field table full, ignoring remaining fields");
+        return NULL;
+    }
+    hid_report_field_t* f = &map->fields[map->field_count++];
+    memset(f, 0, sizeof(*f));
+    f->bit_offset = (uint16_t)bit_offset;
+    f->size = (uint8_t)global->report_size;
+    f->flags = flags;
+    f->type = type;
+    f->report_id = global->report_id;
+    f->logical_min = global->logical_min;
+    f->logical_max = global->logical_max;
+    return f;
+}
+
+/**
+ * @brief Add the fields of one Input, Output or Feature main item
+ */
+static void add_main_item(hid_report_map_t* map, const hid_global_state_t* global,
+                          const hid_local_state_t* local, uint8_t type, uint8_t flags,
+                          int bit_offset) {
+    if (global->report_size == 0 || global->report_count == 0) return;
+    if ((flags & HID_FIELD_CONSTANT) || local->usage_count == 0) return;  // padding
+
+    if (!(flags & HID_FIELD_VARIABLE)) {
+        // Array: each element holds the index of one usage out of the ranges
+        hid_report_field_t* f = new_field(map, global, type, flags, bit_offset);
+        if (f == NULL) return;
+        f->count = global->report_count;
+        f->usage_page = local->usages[0].usage_page;
+        f->usage_min = local->usages[0].usage_min;
+        f->usage_max = local->usages[local->usage_count - 1].usage_max;
+        return;
+    }
+
+    // Variable: one field per run of elements with consecutive usages
+    hid_report_field_t* f = NULL;
+    int declared = 0;
+    for (int i = 0; i < local->usage_count; i++) {
+        declared += local->usages[i].usage_max - local->usages[i].usage_min + 1;
+    }
+    for (int i = 0; i < global->report_count; i++) {
+        uint16_t usage_page, usage;
+        get_element_usage(local, i, &usage_page, &usage);
+
+        if (f != NULL && (i >= declared ||
+                          (f->usage_page == usage_page && f->usage_max + 1 == usage))) {
+            f->count++;
+            if (i < declared) f->usage_max = usage;
+            continue;
+        }
+        f = new_field(map, global, type, flags, bit_offset + i * global->report_size);
+        if (f == NULL) return;
+        f->count = 1;
+        f->usage_page = usage_page;
+        f->usage_min = usage;
+        f->usage_max = usage;
+    }
+}
+
+/**
+ * @brief Group the fields by report ID and build the per report index
+ */
+static void index_fields(hid_report_map_t* map) {
+    // stable insertion sort, keeps descriptor order within a report
+    for (int i = 1; i < map->field_count; i++) {
+        hid_report_field_t f = map->fields[i];
+        int j = i - 1;
+        while (j >= 0 && map->fields[j].report_id > f.report_id) {
+            map->fields[j + 1] = map->fields[j];
+            j--;
+        }
+        map->fields[j + 1] = f;
+    }
+
+    for (int r = 0; r < map->report_count; r++) {
+        hid_report_info_t* info = &map->reports[r];
+        info->field_count = 0;
+        for (int i = 0; i < map->field_count; i++) {
+            if (map->fields[i].report_id != info->report_id) continue;
+            if (info->field_count == 0) info->first_field = (uint8_t)i;
+            info->field_count++;
+        }
+    }
+
+    // report data starts with the report ID byte if report IDs are used
+    if (map->uses_report_ids) {
+        for (int i = 0; i < map->field_count; i++) {
+            map->fields[i].bit_offset += 8;
+        }
+    }
+}
+
+/**
+ * @brief Parse a HID report descriptor into a table of fields per report ID
+ *
+ * Handles Push/Pop, usage ranges, extended usages, multiple report IDs and
+ * separate bit offsets for Input, Output and Feature reports.
+ *
+ * @param[in]  desc      Report descriptor
+ * @param[in]  desc_len  Length of the report descriptor
+ * @param[out] map       Parsed report map
+ * @return true if at least one field was found
+ */
+bool hid_parse_report_descriptor(const uint8_t* desc, size_t desc_len, hid_report_map_t* map) {
+    memset(map, 0, sizeof(*map));
+
+    hid_global_state_t global = {0};
+    hid_global_state_t stack[HID_REPORT_STACK_DEPTH];
+    int stack_depth = 0;
+    hid_local_state_t local = {0};
+    uint16_t app_usage_page = 0, app_usage = 0;
+
+    for (size_t i = 0; i < desc_len;) {
+        uint8_t b = desc[i++];
+
+        if (b == 0xFE) {
+            // Long item, not used by any known device, skip safely
+            if (i + 1 >= desc_len) break;
+            uint8_t data_len = desc[i++];
+            i += 1 + data_len;
+            continue;
+        }
+
+        uint8_t size = b & 0x03;
+        uint8_t type = (b >> 2) & 0x03;
+        uint8_t tag = (b >> 4) & 0x0F;
+
+        if (size == 3) size = 4;  // HID quirk
+        if (i + size > desc_len) break;
+
+        uint32_t data = 0;
+        for (uint8_t n = 0; n < size; ++n) {
+            data |= (uint32_t)desc[i++] << (8 * n);
+        }
+        // sign extended value for logical / physical extents
+        int32_t sdata = (size == 1) ? (int8_t)data : (size == 2) ? (int16_t)data : (int32_t)data;
+
+        switch (type) {
+            case 0:  // Main
+                if (tag == 0x08 || tag == 0x09 || tag == 0x0B) {  // Input, Output, Feature
+                    uint8_t field_type = (tag == 0x08)   ? HID_FIELD_TYPE_INPUT
+                                         : (tag == 0x09) ? HID_FIELD_TYPE_OUTPUT
+                                                         : HID_FIELD_TYPE_FEATURE;
+                    hid_report_info_t* info = get_report_info(map, global.report_id);
+                    if (info == NULL) {
+                        ESP_LOGW(TAG, "Too many report IDs, ignoring report %u", global.report_id);
+                    } else {
+                        uint16_t* bits = (field_type == HID_FIELD_TYPE_INPUT)    ? &info->input_bits
+                                         : (field_type == HID_FIELD_TYPE_OUTPUT) ? &info->output_bits
+                                                                                 : &info->feature_bits;
+                        add_main_item(map, &global, &local, field_type, (uint8_t)data, *bits);
+                        *bits += global.report_size * global.report_count;
+                        if (info->app_usage == 0) {
+                            info->app_usage_page = app_usage_page;
+                            info->app_usage = app_usage;
+                        }
+                    }
+                } else if (tag == 0x0A) {  // Collection
+                    // usages before a collection apply to the collection itself
+                    if (data == 0x01 && local.usage_count > 0) {  // Application
+                        app_usage_page = local.usages[0].usage_page;
+                        app_usage = local.usages[0].usage_min;
+                    }
+                }
+                // local items only apply to the next main item
+                memset(&local, 0, sizeof(local));
+                break;
+
+            case 1:  // Global
+                switch (tag) {
+                    case 0x0:  // Usage Page
+                        global.usage_page = (uint16_t)data;
+                        break;
+                    case 0x1:  // Logical Minimum
+                        global.logical_min = sdata;
+                        break;
+                    case 0x2:  // Logical Maximum
+                        // many descriptors give e.g. 0..255 as one byte, treat as unsigned then
+                        global.logical_max = (sdata < global.logical_min) ? (int32_t)data : sdata;
+                        break;
+                    case 0x7:  // Report Size
+                        global.report_size = (uint16_t)data;
+                        break;
+                    case 0x8:  // Report ID
+                        global.report_id = (uint8_t)data;
+                        map->uses_report_ids = true;
+                        break;
+                    case 0x9:  // Report Count
+                        global.report_count = (uint16_t)data;
+                        break;
+                    case 0xA:  // Push
+                        if (stack_depth < HID_REPORT_STACK_DEPTH) {
+                            stack[stack_depth++] = global;
+                        } else {
+                            ESP_LOGW(TAG, "Push exceeds stack depth %d", HID_REPORT_STACK_DEPTH);
+                        }
+                        break;
+                    case 0xB:  // Pop
+                        if (stack_depth > 0) {
+                            global = stack[--stack_depth];
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                break;
+
+            case 2:  // Local
+                switch (tag) {
+                    case 0x0:  // Usage
+                        add_local_usage(&local, &global, data, data, size);
+                        break;
+                    case 0x1:  // Usage Minimum
+                        local.pending_usage_min = data;
+                        local.have_usage_min = true;
+                        break;
+                    case 0x2:  // Usage Maximum
+                        if (local.have_usage_min) {
+                            add_local_usage(&local, &global, local.pending_usage_min, data, size);
+                            local.have_usage_min = false;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                break;
+
+            default:  // Reserved
+                break;
+        }
+    }
+
+    index_fields(map);
+
+    ESP_LOGI(TAG, "Parsed report descriptor: %d report(s), %d field(s), report IDs %s",
+             map->report_count, map->field_count, map->uses_report_ids ? "used" : "not used");
+    for (int i = 0; i < map->field_count; i++) {
+        const hid_report_field_t* f = &map->fields[i];
+        ESP_LOGD(TAG, "  id=%u type=%u page=0x%02X usage=0x%02X..0x%02X off=%u size=%u count=%u "
+                      "flags=0x%02X logical=%ld..%ld",
+                 f->report_id, f->type, f->usage_page, f->usage_min, f->usage_max, f->bit_offset,
+                 f->size, f->count, f->flags, (long)f->logical_min, (long)f->logical_max);
+    }
+    return map->field_count > 0;
+}
+
+/**
+ * @brief FNV-1a hash of a report descriptor, identifies known descriptors
+ */
+uint32_t hid_report_desc_hash(const uint8_t* desc, size_t desc_len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < desc_len; i++) {
+        hash = (hash ^ desc[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Find the index entry of a report ID
+ *
+ * @return Report index entry, or NULL if the report ID is not declared
+ */
+const hid_report_info_t* hid_report_find_info(const hid_report_map_t* map, uint8_t report_id) {
+    for (int i = 0; i < map->report_count; i++) {
+        if (map->reports[i].report_id == report_id) return &map->reports[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the field which carries a usage in a given report
+ *
+ * @param[in]  map         Parsed report map
+ * @param[in]  type        HID_FIELD_TYPE_x
+ * @param[in]  report_id   Report ID to search in
+ * @param[in]  usage_page  Usage page
+ * @param[in]  usage       Usage
+ * @param[out] bit_offset  Bit offset of the element carrying the usage (variable
+ *                         fields) or of the first array element, may be NULL
+ * @return Field, or NULL if the report does not contain the usage
+ */
+const hid_report_field_t* hid_report_find_usage(const hid_report_map_t* map, uint8_t type,
+                                                uint8_t report_id, uint16_t usage_page,
+                                                uint16_t usage, int* bit_offset) {
+    const hid_report_info_t* info = hid_report_find_info(map, report_id);
+    if (info == NULL) return NULL;
+
+    for (int i = info->first_field; i < info->first_field + info->field_count; i++) {
+        const hid_report_field_t* f = &map->fields[i];
+        if (f->type != type || f->usage_page != usage_page) continue;
+        if (usage < f->usage_min || usage > f->usage_max) continue;
+
+        if (bit_offset != NULL) {
+            *bit_offset = f->bit_offset;
+            if (f->flags & HID_FIELD_VARIABLE) {
+                *bit_offset += (usage - f->usage_min) * f->size;
+            }
+        }
+        return f;
+    }
+    return NULL;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Limits of the parsed report map
+#define HID_REPORT_MAX_FIELDS 64   // fields over all reports of one interface
+#define HID_REPORT_MAX_IDS    16   // distinct report IDs of one interface
+#define HID_REPORT_MAX_USAGES 32   // local usages / usage ranges per main item
+#define HID_REPORT_STACK_DEPTH 4   // Push/Pop nesting
+
+// Main item types (same values as the HID report types)
+#define HID_FIELD_TYPE_INPUT   1
+#define HID_FIELD_TYPE_OUTPUT  2
+#define HID_FIELD_TYPE_FEATURE 3
+
+// Main item flags
+#define HID_FIELD_CONSTANT  0x01
+#define HID_FIELD_VARIABLE  0x02
+#define HID_FIELD_RELATIVE  0x04
+
+// Frequently used usage pages and usages
+#define HID_USAGE_PAGE_GENERIC_DESKTOP 0x01
+#define HID_USAGE_PAGE_KEYBOARD        0x07
+#define HID_USAGE_PAGE_BUTTON          0x09
+#define HID_USAGE_POINTER   0x01
+#define HID_USAGE_MOUSE     0x02
+#define HID_USAGE_JOYSTICK  0x04
+#define HID_USAGE_GAMEPAD   0x05
+#define HID_USAGE_KEYBOARD  0x06
+#define HID_USAGE_X         0x30
+#define HID_USAGE_Y         0x31
+#define HID_USAGE_WHEEL     0x38
+#define HID_USAGE_HAT       0x39
+
+/**
+ * @brief One field of a report: either a run of variable elements with
+ * consecutive usages, or an array of 'count' elements selecting usages out of
+ * usage_min..usage_max
+ */
+typedef struct {
+    uint16_t usage_page;
+    uint16_t usage_min;
+    uint16_t usage_max;
+    uint16_t bit_offset;  // from the start of the report data, including the report ID byte
+    uint16_t count;       // number of elements
+    uint8_t size;         // bits per element
+    uint8_t flags;        // main item flags
+    uint8_t type;         // HID_FIELD_TYPE_x
+    uint8_t report_id;
+    int32_t logical_min;
+    int32_t logical_max;
+} hid_report_field_t;
+
+// Per report ID index into the field table
+typedef struct {
+    uint8_t report_id;
+    uint8_t field_count;
+    uint8_t first_field;
+    uint16_t app_usage_page;  // usage of the application collection
+    uint16_t app_usage;
+    uint16_t input_bits;      // report sizes without the report ID byte
+    uint16_t output_bits;
+    uint16_t feature_bits;
+} hid_report_info_t;
+
+typedef struct {
+    bool uses_report_ids;
+    uint8_t report_count;
+    uint8_t field_count;
+    hid_report_info_t reports[HID_REPORT_MAX_IDS];
+    hid_report_field_t fields[HID_REPORT_MAX_FIELDS];
+} hid_report_map_t;
+
+bool hid_parse_report_descriptor(const uint8_t* desc, size_t desc_len, hid_report_map_t* map);
+uint32_t hid_report_desc_hash(const uint8_t* desc, size_t desc_len);
+
+const hid_report_info_t* hid_report_find_info(const hid_report_map_t* map, uint8_t report_id);
+const hid_report_field_t* hid_report_find_usage(const hid_report_map_t* map, uint8_t type,
+                                                uint8_t report_id, uint16_t usage_page,
+                                                uint16_t usage, int* bit_offset);
@@ -0,0 +1,456 @@
+#include <Arduino.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_gap_ble_api.h>
+#include <BLE2902.h>
+#include <BLESecurity.h>
+#include <Preferences.h>
+
+#include "ble_hid_transport.h"
+#include "hid_boot_timeline.h"
+
+static const char* TAG = "ble-hid-transport";
+
+// Mouse report: same layout as ble_mouse_report_t (the BleMouse report map
+// with a report ID), keyboard report: boot keyboard layout with LED output
+static const uint8_t hid_report_map[] = {
+    0x05, 0x01,        // Usage Page (Generic Desktop)
+    0x09, 0x02,        // Usage (Mouse)
+    0xA1, 0x01,        // Collection (Application)
+    0x85, BLE_HID_REPORT_ID_MOUSE,
+    0x09, 0x01,        //   Usage (Pointer)
+    0xA1, 0x00,        //   Collection (Physical)
+    0x05, 0x09,        //     Usage Page (Button)
+    0x19, 0x01,        //     Usage Minimum (1)
+    0x29, 0x05,        //     Usage Maximum (5)
+    0x15, 0x00,        //     Logical Minimum (0)
+    0x25, 0x01,        //     Logical Maximum (1)
+    0x95, 0x05,        //     Report Count (5)
+    0x75, 0x01,        //     Report Size (1)
+    0x81, 0x02,        //     Input (Data, Variable, Absolute)
+    0x95, 0x01,        //     Report Count (1)
+    0x75, 0x03,        //     Report Size (3)
+    0x81, 0x03,        //     Input (Constant) padding
+    0x05, 0x01,        //     Usage Page (Generic Desktop)
+    0x09, 0x30,        //     Usage (X)
+    0x09, 0x31,        //     Usage (Y)
+    0x09, 0x38,        //     Usage (Wheel)
+    0x15, 0x81,        //     Logical Minimum (-127)
+    0x25, 0x7F,        //     Logical Maximum (127)
+    0x75, 0x08,        //     Report Size (8)
+    0x95, 0x03,        //     Report Count (3)
+    0x81, 0x06,        //     Input (Data, Variable, Relative)
+    0x05, 0x0C,        //     Usage Page (Consumer)
+    0x0A, 0x38, 0x02,  //     Usage (AC Pan)
+    0x15, 0x81,        //     Logical Minimum (-127)
+    0x25, 0x7F,        //     Logical Maximum (127)
+    0x75, 0x08,        //     Report Size (8)
+    0x95, 0x01,        //     Report Count (1)
+    0x81, 0x06,        //     Input (Data, Variable, Relative)
+    0xC0,              //   End Collection
+    0xC0,              // End Collection
+
+    0x05, 0x01,        // Usage Page (Generic Desktop)
+    0x09, 0x06,        // Usage (Keyboard)
+    0xA1, 0x01,        // Collection (Application)
+    0x85, BLE_HID_REPORT_ID_KEYBOARD,
+    0x05, 0x07,        //   Usage Page (Keyboard)
+    0x19, 0xE0,        //   Usage Minimum (Left Control)
+    0x29, 0xE7,        //   Usage Maximum (Right GUI)
+    0x15, 0x00,        //   Logical Minimum (0)
+    0x25, 0x01,        //   Logical Maximum (1)
+    0x75, 0x01,        //   Report Size (1)
+    0x95, 0x08,        //   Report Count (8)
+    0x81, 0x02,        //   Input (Data, Variable, Absolute) modifiers
+    0x95, 0x01,        //   Report Count (1)
+    0x75, 0x08,        //   Report Size (8)
+    0x81, 0x03,        //   Input (Constant) reserved
+    0x95, 0x05,        //   Report Count (5)
+    0x75, 0x01,        //   Report Size (1)
+    0x05, 0x08,        //   Usage Page (LEDs)
+    0x19, 0x01,        //   Usage Minimum (Num Lock)
+    0x29, 0x05,        //   Usage Maximum (Kana)
+    0x91, 0x02,        //   Output (Data, Variable, Absolute)
+    0x95, 0x01,        //   Report Count (1)
+    0x75, 0x03,        //   Report Size (3)
+    0x91, 0x03,        //   Output (Constant) padding
+    0x95, BLE_KEYBOARD_REPORT_KEYS,  // Report Count (6)
+    0x75, 0x08,        //   Report Size (8)
+    0x15, 0x00,        //   Logical Minimum (0)
+    0x26, 0xE7, 0x00,  //   Logical Maximum (231)
+    0x05, 0x07,        //   Usage Page (Keyboard)
+    0x19, 0x00,        //   Usage Minimum (0)
+    0x29, 0xE7,        //   Usage Maximum (231)
+    0x81, 0x00,        //   Input (Data, Array) keys
+    0xC0,              // End Collection
+};
+
+// Instance which receives the GAP events, there is one BLE HID device
+static BleHidTransport* gap_instance = nullptr;
+
+static uint32_t now_us() { return (uint32_t)esp_timer_get_time(); }
+
+// Last bonded host as stored in NVS
+typedef struct {
+    uint8_t addr[6];
+    uint8_t addr_type;
+} ble_hid_peer_t;
+
+// Advertiser of the reconnection state machine, ctx is the BLEAdvertising instance
+static bool adv_directed(void* ctx, const uint8_t addr[6], uint8_t addr_type) {
+    esp_ble_adv_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.adv_int_min = 0x20;  // not used for high duty cycle directed advertising
+    params.adv_int_max = 0x20;
+    params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+    params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    memcpy(params.peer_addr, addr, sizeof(esp_bd_addr_t));
+    params.peer_addr_type = (esp_ble_addr_type_t)addr_type;
+    params.channel_map = ADV_CHNL_ALL;
+    params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
+    return esp_ble_gap_start_advertising(&params) == ESP_OK;
+}
+
+static bool adv_undirected(void* ctx, uint16_t min_interval, uint16_t max_interval) {
+    BLEAdvertising* advertising = (BLEAdvertising*)ctx;
+    advertising->setMinInterval(min_interval);
+    advertising->setMaxInterval(max_interval);
+    advertising->start();
+    return true;
+}
+
+static void adv_stop(void* ctx) {
+    ((BLEAdvertising*)ctx)->stop();
+}
+
+/**
+ * @brief Start the HID service and advertising with the default connection policy
+ */
+void BleHidTransport::begin() {
+    ble_conn_policy_t policy;
+    ble_conn_policy_default(&policy);
+    begin(&policy);
+}
+
+/**
+ * @brief Start the HID service and advertising
+ *
+ * @param[in] policy  Connection parameters for active input and idle
+ */
+void BleHidTransport::begin(const ble_conn_policy_t* policy) {
+    ble_conn_manager_init(&connManager, policy);
+    gap_instance = this;
+
+    BLEDevice::init(deviceName);
+    BLEDevice::setCustomGapHandler(gapEventHandler);
+    BLEDevice::setCustomGattsHandler(gattsEventHandler);
+    BLEServer* pServer = BLEDevice::createServer();
+    pServer->setCallbacks(this);
+    server = pServer;
+
+    hid = new BLEHIDDevice(pServer);
+    mouseInput = hid->inputReport(BLE_HID_REPORT_ID_MOUSE);
+    keyboardInput = hid->inputReport(BLE_HID_REPORT_ID_KEYBOARD);
+    keyboardOutput = hid->outputReport(BLE_HID_REPORT_ID_KEYBOARD);
+
+    hid->manufacturer()->setValue(deviceManufacturer);
+    hid->pnp(0x02, 0xe502, 0xa111, 0x0210);
+    hid->hidInfo(0x00, 0x02);
+
+    BLESecurity* pSecurity = new BLESecurity();
+    pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+
+    hid->reportMap((uint8_t*)hid_report_map, sizeof(hid_report_map));
+    hid->startServices();
+
+    BLEAdvertising* pAdvertising = pServer->getAdvertising();
+    pAdvertising->setAppearance(HID_MOUSE);
+    pAdvertising->addServiceUUID(hid->hidService()->getUUID());
+    hid->setBatteryLevel(100);
+
+    advertiser.directed = adv_directed;
+    advertiser.undirected = adv_undirected;
+    advertiser.stop = adv_stop;
+    advertiser.ctx = pAdvertising;
+    ble_reconnect_policy_t reconnectPolicy;
+    ble_reconnect_policy_default(&reconnectPolicy);
+    ble_reconnect_init(&reconnect, &reconnectPolicy, &advertiser);
+    loadPeer();
+    ble_reconnect_start(&reconnect, now_us());
+
+    ESP_LOGI(TAG, "Advertising started (%s)", ble_reconnect_state_name(reconnect.state));
+}
+
+/**
+ * @brief Pick the host for directed advertising
+ *
+ * The host stored on the last bonding, if it is still bonded, otherwise the
+ * last entry of the bond list.
+ */
+void BleHidTransport::loadPeer() {
+    ble_hid_peer_t stored;
+    Preferences prefs;
+    prefs.begin("ble_hid", true);
+    bool has_stored = prefs.getBytes("peer", &stored, sizeof(stored)) == sizeof(stored);
+    prefs.end();
+
+    int count = esp_ble_get_bond_device_num();
+    if (count <= 0) return;
+    esp_ble_bond_dev_t* list = (esp_ble_bond_dev_t*)malloc(sizeof(esp_ble_bond_dev_t) * count);
+    if (list == NULL) return;
+    esp_ble_get_bond_device_list(&count, list);
+
+    int found = -1;
+    for (int i = 0; i < count && has_stored; i++) {
+        if (memcmp(list[i].bd_addr, stored.addr, sizeof(esp_bd_addr_t)) == 0) found = i;
+    }
+    if (found >= 0) {
+        ble_reconnect_set_peer(&reconnect, stored.addr, stored.addr_type);
+    } else if (count > 0) {
+        const esp_ble_bond_dev_t* dev = &list[count - 1];
+        uint8_t addr_type = (dev->bond_key.key_mask & ESP_LE_KEY_PID)
+                                ? dev->bond_key.pid_key.addr_type
+                                : BLE_ADDR_TYPE_PUBLIC;
+        ble_reconnect_set_peer(&reconnect, dev->bd_addr, addr_type);
+    }
+    free(list);
+
+    if (reconnect.has_peer) {
+        ESP_LOGI(TAG, "Reconnect to %02x:%02x:%02x:%02x:%02x:%02x", reconnect.peer[0],
+                 reconnect.peer[1], reconnect.peer[2], reconnect.peer[3], reconnect.peer[4],
+                 reconnect.peer[5]);
+    }
+}
+
+void BleHidTransport::savePeer(const uint8_t addr[6], uint8_t addr_type) {
+    ble_hid_peer_t peer;
+    memcpy(peer.addr, addr, sizeof(peer.addr));
+    peer.addr_type = addr_type;
+
+    Preferences prefs;
+    prefs.begin("ble_hid", false);
+    prefs.putBytes("peer", &peer, sizeof(peer));
+    prefs.end();
+    ble_reconnect_set_peer(&reconnect, addr, addr_type);
+}
+
+void BleHidTransport::setNotifications(bool enable) {
+    BLECharacteristic* inputs[] = {mouseInput, keyboardInput};
+    for (BLECharacteristic* input : inputs) {
+        BLE2902* desc = (BLE2902*)input->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+        if (desc) desc->setNotifications(enable);
+    }
+}
+
+void BleHidTransport::onConnect(BLEServer* pServer) {
+    connected = true;
+    setNotifications(true);
+}
+
+void BleHidTransport::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+    ble_conn_granted_t granted;
+    granted.interval = param->connect.conn_params.interval;
+    granted.latency = param->connect.conn_params.latency;
+    granted.timeout = param->connect.conn_params.timeout;
+    memcpy(peer, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+    connId = param->connect.conn_id;
+    congested = false;
+
+    portENTER_CRITICAL(&connLock);
+    uint32_t now = now_us();
+    ble_conn_manager_connected(&connManager, now, &granted);
+    linkUp = true;
+    linkUpUs = now;
+    portEXIT_CRITICAL(&connLock);
+    hid_boot_mark(HID_BOOT_BLE_CONNECTED, now);
+    ESP_LOGI(TAG, "Connected, interval %u us, latency %u, timeout %u ms",
+             granted.interval * BLE_CONN_INTERVAL_UNIT_US, granted.latency, granted.timeout * 10);
+
+    // longer link layer packets, so forwarded reports above 20 bytes fit into one
+    esp_ble_gap_set_pkt_data_len(peer, 251);
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    esp_ble_gap_set_preferred_phy(peer, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                  ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+}
+
+void BleHidTransport::onDisconnect(BLEServer* pServer) {
+    connected = false;
+    setNotifications(false);
+    portENTER_CRITICAL(&connLock);
+    ble_conn_manager_disconnected(&connManager);
+    linkLost = true;
+    linkLostUs = now_us();
+    portEXIT_CRITICAL(&connLock);
+    // advertising is restarted by poll(), directed to this host first
+}
+
+/**
+ * @brief Result of a connection parameter request, or parameters changed by
+ * the central, and completed bonding
+ */
+void BleHidTransport::gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    if (gap_instance == nullptr) return;
+    BleHidTransport* self = gap_instance;
+
+    if (event == ESP_GAP_BLE_AUTH_CMPL_EVT && param->ble_security.auth_cmpl.success) {
+        portENTER_CRITICAL(&self->connLock);
+        memcpy(self->bondedPeer, param->ble_security.auth_cmpl.bd_addr, sizeof(esp_bd_addr_t));
+        self->bondedPeerType = param->ble_security.auth_cmpl.addr_type;
+        self->bonded = true;
+        portEXIT_CRITICAL(&self->connLock);
+        return;
+    }
+    if (event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) return;
+
+    ble_conn_granted_t granted;
+    granted.interval = param->update_conn_params.conn_int;
+    granted.latency = param->update_conn_params.latency;
+    granted.timeout = param->update_conn_params.timeout;
+    bool accepted = (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS);
+
+    portENTER_CRITICAL(&self->connLock);
+    ble_conn_manager_updated(&self->connManager, now_us(), accepted, &granted);
+    uint32_t update_us = self->connManager.stats.last_update_us;
+    portEXIT_CRITICAL(&self->connLock);
+
+    if (accepted) {
+        ESP_LOGI(TAG, "Connection parameters: interval %u us, latency %u, timeout %u ms (%lu us)",
+                 granted.interval * BLE_CONN_INTERVAL_UNIT_US, granted.latency,
+                 granted.timeout * 10, (unsigned long)update_us);
+    } else {
+        ESP_LOGW(TAG, "Connection parameter update rejected (status %d)",
+                 param->update_conn_params.status);
+    }
+}
+
+/**
+ * @brief Congestion of the link, reported by the stack when its buffers run full
+ */
+void BleHidTransport::gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                                        esp_ble_gatts_cb_param_t* param) {
+    if (event != ESP_GATTS_CONGEST_EVT || gap_instance == nullptr) return;
+    BleHidTransport* self = gap_instance;
+
+    self->congested = param->congest.congested;
+    if (!self->congested && self->writableCallback != nullptr) self->writableCallback();
+}
+
+/**
+ * @brief Number of notifications the stack can take now, 0 while congested
+ *
+ * notify() waits for the stack, so a caller which sends only with credits
+ * does not block on a congested link.
+ */
+int BleHidTransport::sendCredits() {
+    if (!connected || congested) return 0;
+    return esp_ble_get_cur_sendable_packets_num(connId);
+}
+
+/**
+ * @brief Request new connection parameters from the central
+ */
+void BleHidTransport::requestConnParams(const ble_conn_params_t* params) {
+    if (server == nullptr) return;
+    server->updateConnParams(peer, params->min_interval, params->max_interval, params->latency,
+                             params->timeout);
+}
+
+/**
+ * @brief Input was sent: switch to the short interval if the link is idle
+ */
+void BleHidTransport::inputSent() {
+    ble_conn_params_t request;
+    portENTER_CRITICAL(&connLock);
+    uint32_t now = now_us();
+    ble_conn_manager_input(&connManager, now);
+    bool send = ble_conn_manager_poll(&connManager, now, &request);
+    portEXIT_CRITICAL(&connLock);
+    if (send) requestConnParams(&request);
+}
+
+/**
+ * @brief Switch to the idle parameters after the idle timeout and run the
+ * reconnection phases, call regularly from loop()
+ */
+void BleHidTransport::poll() {
+    ble_conn_params_t request;
+    portENTER_CRITICAL(&connLock);
+    uint32_t now = now_us();
+    bool send = ble_conn_manager_poll(&connManager, now, &request);
+    portEXIT_CRITICAL(&connLock);
+    if (send) requestConnParams(&request);
+    pollReconnect(now);
+}
+
+/**
+ * @brief Apply the link events recorded by the BLE callbacks to the
+ * reconnection state machine
+ */
+void BleHidTransport::pollReconnect(uint32_t now) {
+    esp_bd_addr_t addr;
+    uint8_t addr_type;
+
+    portENTER_CRITICAL(&connLock);
+    bool up = linkUp, lost = linkLost, bond = bonded;
+    uint32_t up_us = linkUpUs, lost_us = linkLostUs;
+    memcpy(addr, bondedPeer, sizeof(addr));
+    addr_type = bondedPeerType;
+    linkUp = linkLost = bonded = false;
+    portEXIT_CRITICAL(&connLock);
+
+    if (bond) savePeer(addr, addr_type);
+
+    // both since the last poll: the order follows from the current link state
+    bool up_last = connected;
+    if (up && !up_last) ble_reconnect_connected(&reconnect, up_us);
+    if (lost) ble_reconnect_start(&reconnect, lost_us);
+    if (up && up_last) {
+        ble_reconnect_state_t phase = reconnect.state;
+        ble_reconnect_connected(&reconnect, up_us);
+        if (phase != BLE_RECONNECT_CONNECTED && phase != BLE_RECONNECT_IDLE) {
+            ESP_LOGI(TAG, "Reconnected in %lu us (%s)", (unsigned long)reconnect.stats.last_us,
+                     ble_reconnect_state_name(phase));
+        }
+    }
+
+    ble_reconnect_poll(&reconnect, now);
+}
+
+/**
+ * @brief Snapshot of the connection parameter state and statistics
+ */
+ble_conn_manager_t BleHidTransport::getConnParams() {
+    portENTER_CRITICAL(&connLock);
+    ble_conn_manager_t copy = connManager;
+    portEXIT_CRITICAL(&connLock);
+    return copy;
+}
+
+/**
+ * @brief Send one complete mouse input report to the connected BLE host
+ *
+ * @param[in] report  Report with button mask, motion and wheel
+ * @return true if the report was handed to the BLE stack
+ */
+bool BleHidTransport::sendMouseReport(const ble_mouse_report_t* report) {
+    if (!connected) return false;
+    mouseInput->setValue((uint8_t*)report, sizeof(ble_mouse_report_t));
+    mouseInput->notify();
+    inputSent();
+    return true;
+}
+
+/**
+ * @brief Send one complete keyboard input report to the connected BLE host
+ *
+ * @param[in] report  Report with modifiers and up to 6 keys
+ * @return true if the report was handed to the BLE stack
+ */
+bool BleHidTransport::sendKeyboardReport(const ble_keyboard_report_t* report) {
+    if (!connected) return false;
+    keyboardInput->setValue((uint8_t*)report, sizeof(ble_keyboard_report_t));
+    keyboardInput->notify();
+    inputSent();
+    return true;
+}
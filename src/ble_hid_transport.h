@@ -0,0 +1,85 @@
+#pragma once
+
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLEHIDDevice.h>
+#include <BLECharacteristic.h>
+
+#include "ble_mouse_report.h"
+#include "ble_keyboard_report.h"
+#include "ble_conn_params.h"
+#include "ble_reconnect.h"
+
+// Report IDs of the combined report map
+#define BLE_HID_REPORT_ID_MOUSE     0x01
+#define BLE_HID_REPORT_ID_KEYBOARD  0x02
+
+/**
+ * @brief BLE HID device with a mouse and a keyboard input report
+ *
+ * Each report is written as a whole, so buttons, motion and wheel (or
+ * modifiers and all keys) reach the host with a single notification.
+ * Connection parameters follow the input activity, see ble_conn_params.h.
+ * After boot or link loss the last bonded host is reconnected with directed
+ * advertising first, see ble_reconnect.h.
+ */
+class BleHidTransport : public BLEServerCallbacks {
+public:
+    BleHidTransport(std::string deviceName, std::string deviceManufacturer)
+        : deviceName(deviceName), deviceManufacturer(deviceManufacturer) {}
+
+    void begin();
+    void begin(const ble_conn_policy_t* policy);
+    bool isConnected() { return connected; }
+    void poll();
+    ble_conn_manager_t getConnParams();
+    ble_reconnect_t getReconnect() { return reconnect; }
+    int sendCredits();
+    void setWritableCallback(void (*callback)()) { writableCallback = callback; }
+    bool sendMouseReport(const ble_mouse_report_t* report);
+    bool sendKeyboardReport(const ble_keyboard_report_t* report);
+
+    void onConnect(BLEServer* pServer) override;
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+    void onDisconnect(BLEServer* pServer) override;
+
+private:
+    void setNotifications(bool enable);
+    void inputSent();
+    void requestConnParams(const ble_conn_params_t* params);
+    void loadPeer();
+    void savePeer(const uint8_t addr[6], uint8_t addr_type);
+    void pollReconnect(uint32_t now);
+    static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+    static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                                  esp_ble_gatts_cb_param_t* param);
+
+    std::string deviceName;
+    std::string deviceManufacturer;
+    BLEHIDDevice* hid = nullptr;
+    BLECharacteristic* mouseInput = nullptr;
+    BLECharacteristic* keyboardInput = nullptr;
+    BLECharacteristic* keyboardOutput = nullptr;
+    volatile bool connected = false;
+
+    BLEServer* server = nullptr;
+    esp_bd_addr_t peer;
+    uint16_t connId = 0;
+    volatile bool congested = false;
+    void (*writableCallback)() = nullptr;  // called when the link is no longer congested
+    ble_conn_manager_t connManager;
+    portMUX_TYPE connLock = portMUX_INITIALIZER_UNLOCKED;
+
+    // owned by the loop task, the BLE callbacks only record link events
+    ble_advertiser_t advertiser;
+    ble_reconnect_t reconnect;
+
+    // link events for poll(), protected by connLock
+    bool linkUp = false;
+    bool linkLost = false;
+    uint32_t linkUpUs = 0;
+    uint32_t linkLostUs = 0;
+    bool bonded = false;
+    esp_bd_addr_t bondedPeer;
+    uint8_t bondedPeerType = 0;
+};
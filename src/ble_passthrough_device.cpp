@@ -0,0 +1,85 @@
+#include <BLE2902.h>
+#include <BLESecurity.h>
+#include "ble_passthrough_device.h"
+#include "hid_boot_timeline.h"
+#include "hid_latency.h"
+
+static const char *TAG = "ble_passthrough";
+
+/**
+ * @brief Start the HID service with the report map of the passthrough configuration
+ *
+ * @param[in] cfg  Passthrough configuration with at least one interface
+ */
+void BlePassthroughDevice::begin(const ble_passthrough_config_t* cfg) {
+    BLEDevice::init(deviceName);
+    BLEServer* pServer = BLEDevice::createServer();
+    pServer->setCallbacks(this);
+
+    hid = new BLEHIDDevice(pServer);
+    hid->manufacturer()->setValue(deviceManufacturer);
+    hid->pnp(0x02, 0xe502, 0xa111, 0x0210);
+    hid->hidInfo(0x00, 0x01);
+
+    // one input report characteristic per BLE report ID with Input items
+    for (int i = 0; i < cfg->iface_count; i++) {
+        const ble_passthrough_iface_t* iface = &cfg->ifaces[i];
+        for (int n = 0; n < iface->id_count; n++) {
+            if (iface->input_mask & (1u << n)) {
+                inputReports[iface->ble_ids[n]] = hid->inputReport(iface->ble_ids[n]);
+            }
+        }
+    }
+
+    BLESecurity* pSecurity = new BLESecurity();
+    pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+
+    hid->reportMap((uint8_t*)cfg->report_map, cfg->map_len);
+    hid->startServices();
+
+    BLEAdvertising* pAdvertising = pServer->getAdvertising();
+    pAdvertising->setAppearance(HID_MOUSE);
+    pAdvertising->addServiceUUID(hid->hidService()->getUUID());
+    pAdvertising->start();
+    hid->setBatteryLevel(100);
+
+    ESP_LOGI(TAG, "Started with %d interface(s), report map of %d bytes",
+             cfg->iface_count, cfg->map_len);
+}
+
+/**
+ * @brief Send an input report
+ *
+ * @param[in] ble_id   BLE report ID
+ * @param[in] payload  Report data without report ID
+ * @param[in] length   Length of the report data
+ * @return false if not connected or the report ID has no input report
+ */
+bool BlePassthroughDevice::sendReport(uint8_t ble_id, const uint8_t* payload, size_t length) {
+    BLECharacteristic* characteristic = inputReports[ble_id];
+    if (!connected || characteristic == nullptr) return false;
+    characteristic->setValue((uint8_t*)payload, length);
+    characteristic->notify();
+    return true;
+}
+
+void BlePassthroughDevice::onConnect(BLEServer* pServer) {
+    connected = true;
+    hid_boot_mark(HID_BOOT_BLE_CONNECTED, hid_latency_now());
+    // enable notifications of all input reports, as BleMouse does
+    for (int i = 0; i < 256; i++) {
+        if (inputReports[i] == nullptr) continue;
+        BLE2902* desc = (BLE2902*)inputReports[i]->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+        if (desc) desc->setNotifications(true);
+    }
+}
+
+void BlePassthroughDevice::onDisconnect(BLEServer* pServer) {
+    connected = false;
+    for (int i = 0; i < 256; i++) {
+        if (inputReports[i] == nullptr) continue;
+        BLE2902* desc = (BLE2902*)inputReports[i]->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+        if (desc) desc->setNotifications(false);
+    }
+    pServer->getAdvertising()->start();
+}
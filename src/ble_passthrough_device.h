@@ -0,0 +1,35 @@
+#pragma once
+
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLEHIDDevice.h>
+#include <BLECharacteristic.h>
+
+#include "ble_hid_passthrough.h"
+
+/**
+ * @brief BLE HID device whose report map is built from the USB report
+ * descriptors of the connected devices (passthrough mode)
+ *
+ * Every input report of the map gets its own input report characteristic, raw
+ * USB reports are written to them without decoding.
+ */
+class BlePassthroughDevice : public BLEServerCallbacks {
+public:
+    BlePassthroughDevice(std::string deviceName, std::string deviceManufacturer)
+        : deviceName(deviceName), deviceManufacturer(deviceManufacturer) {}
+
+    void begin(const ble_passthrough_config_t* cfg);
+    bool isConnected() { return connected; }
+    bool sendReport(uint8_t ble_id, const uint8_t* payload, size_t length);
+
+    void onConnect(BLEServer* pServer) override;
+    void onDisconnect(BLEServer* pServer) override;
+
+private:
+    std::string deviceName;
+    std::string deviceManufacturer;
+    BLEHIDDevice* hid = nullptr;
+    BLECharacteristic* inputReports[256] = {};
+    volatile bool connected = false;
+};
@@ -1,77 +1,293 @@
 
 #include <Arduino.h>
-#include <BleMouse.h>
+#include <freertos/event_groups.h>
 #include <BLEDevice.h>
 #include "usb_hid_host.h"
+#include "usb_hid_format_cache.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_mouse.h"
+#include "usb_hid_joystick.h"
+#include "hid_trace.h"
+#include "hid_latency.h"
+#include "hid_event_ring.h"
+#include "hid_pipeline.h"
+#include "hid_capture_host.h"
+#include "hid_boot_timeline.h"
+#include "ble_mouse_report.h"
+#include "ble_keyboard_report.h"
+#include "ble_hid_transport.h"
+#include "ble_hid_passthrough.h"
+#include "ble_passthrough_device.h"
+#include <Preferences.h>
 
 #define OUTPUT_UNIFIED_MOUSE_DATA_TO_CONSOLE
+// log USB to BLE latency percentiles, queue depth and report counters every 10 seconds
+//#define OUTPUT_PIPELINE_STATS_TO_CONSOLE
 
-BleMouse bleMouse("Assistronik USB Adapter","Assistronik");
+// record and replay USB reports via serial commands:
+// c = start capture, s = stop, d = dump (hex), r = replay, f = replay as fast as possible,
+// b = log the boot timeline
+//#define HID_CAPTURE_CONSOLE
+#define HID_CAPTURE_BUFFER_SIZE (512 * 1024)  // in PSRAM
 
-void update_hidData (unified_hidData_t *hidData) {
+// pointer acceleration of all mice, one of MOUSE_BALLISTICS_ACCEL, _LOW_DPI, _TRACKBALL
+//#define MOUSE_ACCELERATION_PROFILE MOUSE_BALLISTICS_ACCEL
+
+// smooth tremor jitter of all mice: heavy smoothing when slow, little lag when fast
+//#define MOUSE_TREMOR_FILTER
+
+// forward raw reports with a BLE report map built from the USB descriptors,
+// instead of translating everything to mouse reports
+//#define BLE_HID_PASSTHROUGH
+
+BleHidTransport bleHid("Assistronik USB Adapter","Assistronik");
+
+// processing of every unified report, stages are composed and inlined at compile time, e.g.
+// hid_pipeline<hid_stage_invert<false, true>, hid_stage_button_map<1, 0, 2> > (see hid_pipeline.h)
+typedef hid_pipeline<> hid_report_pipeline_t;
+static hid_report_pipeline_t reportPipeline;
+
+// set when the BLE stack is up, BLE and USB are started concurrently
+static EventGroupHandle_t ble_init_events = NULL;
+#define BLE_INIT_DONE_BIT (1 << 0)
+
+static void wait_ble_ready() {
+  xEventGroupWaitBits(ble_init_events, BLE_INIT_DONE_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+bool send_ble_mouse_report(const ble_mouse_report_t* report) {
+  return bleHid.sendMouseReport(report);
+}
+
+bool send_ble_keyboard_report(const ble_keyboard_report_t* report) {
+  return bleHid.sendKeyboardReport(report);
+}
+
+int ble_mouse_report_credits() {
+  return bleHid.sendCredits();
+}
+
+#ifdef BLE_HID_PASSTHROUGH
+BlePassthroughDevice blePassthrough("Assistronik USB Adapter","Assistronik");
+static ble_passthrough_config_t passthrough_cfg;
+static bool passthrough_active = false;  // BLE mouse and keyboard not started
+
+static bool load_passthrough_config() {
+  Preferences prefs;
+  prefs.begin("hid_passthru", true);
+  size_t len = prefs.getBytes("config", &passthrough_cfg, sizeof(passthrough_cfg));
+  prefs.end();
+  if (len != sizeof(passthrough_cfg) ||
+      passthrough_cfg.version != BLE_PASSTHROUGH_CONFIG_VERSION) {
+    ble_passthrough_init(&passthrough_cfg);
+    return false;
+  }
+  return passthrough_cfg.iface_count > 0;
+}
+
+static void save_passthrough_config(bool clear) {
+  Preferences prefs;
+  prefs.begin("hid_passthru", false);
+  if (clear) prefs.clear();
+  else prefs.putBytes("config", &passthrough_cfg, sizeof(passthrough_cfg));
+  prefs.end();
+}
+
+// Called on connect of a USB HID interface
+bool passthrough_descriptor(const uint8_t* desc, size_t desc_len, void** ctx) {
+  uint32_t hash = hid_report_desc_hash(desc, desc_len);
+  const ble_passthrough_iface_t* iface = ble_passthrough_find_interface(&passthrough_cfg, hash);
+  if (iface == NULL) {
+    // the BLE report map can't change while the services run:
+    // add the new interface and restart to advertise the new map
+    wait_ble_ready();  // the services are built from passthrough_cfg
+    if (ble_passthrough_add_interface(&passthrough_cfg, desc, desc_len, hash) == NULL) {
+      ESP_LOGW("PASSTHROUGH", "No room in report map, decoding reports instead");
+      return false;
+    }
+    Serial.println("New HID interface, restarting with new report map");
+    save_passthrough_config(false);
+    esp_restart();
+  }
+  *ctx = (void*)iface;
+  return true;
+}
 
-  static int x_pos = 0;
-  static int y_pos = 0;
+// Called for every input report of a forwarded interface
+void passthrough_report(void* ctx, const uint8_t* data, size_t length) {
+  uint8_t ble_id;
+  const uint8_t* payload;
+  size_t payload_len;
+  if (ble_passthrough_translate_report((const ble_passthrough_iface_t*)ctx, data, length,
+                                       &ble_id, &payload, &payload_len)) {
+    blePassthrough.sendReport(ble_id, payload, payload_len);
+  }
+}
+#endif
+
+void update_hidData (unified_hidData_t *hidData) {
 
-  // Calculate absolute position from displacement
-  x_pos += hidData->x_displacement;
-  y_pos += hidData->y_displacement;
+  reportPipeline.apply(hidData);
 
   #ifdef OUTPUT_UNIFIED_MOUSE_DATA_TO_CONSOLE
-      printf("X: %06d\tY: %06d\t|%c|%c|%c|\t%d\n",
-          hidData->x_displacement,
-          hidData->y_displacement,
-          (hidData->buttons.button1 ? 'L' : ' '),
-          (hidData->buttons.button3 ? 'M' : ' '),
-          (hidData->buttons.button2 ? 'R' : ' '),
-          hidData->scroll_wheel);
-      fflush(stdout);
+      // printed by the trace drain task, not in the report path
+      hid_trace_write(HID_TRACE_CAT_MOUSE, HID_TRACE_REC_HIDDATA, hidData, sizeof(*hidData));
   #endif
 
-  if(bleMouse.isConnected()) {
-    static bool leftButtonPressed = false;
-    static bool rightButtonPressed = false;
-    static bool middleButtonPressed = false;
+#ifdef BLE_HID_PASSTHROUGH
+  if (passthrough_active) return;
+#endif
 
-    bleMouse.move((int8_t)hidData->x_displacement, (int8_t)hidData->y_displacement);
+  if(bleHid.isConnected()) {
+    // one notification with motion, all buttons and wheel; motion exceeding the
+    // int8 range of a report goes out with additional reports, and is merged
+    // into the queued reports while the link is congested
+    ble_mouse_report_submit(hidData);
+  } else {
+    ble_mouse_report_reset();
+  }
+}
 
-    // Track and update left button state
-    if (hidData->buttons.button1 != leftButtonPressed) {
-      leftButtonPressed = hidData->buttons.button1;
-      if (leftButtonPressed) {
-        bleMouse.press(MOUSE_LEFT);
-      } else {
-        bleMouse.release(MOUSE_LEFT);
-      }
-    }
-    
-    // Track and update right button state
-    if (hidData->buttons.button2 != rightButtonPressed) {
-      rightButtonPressed = hidData->buttons.button2;
-      if (rightButtonPressed) {
-        bleMouse.press(MOUSE_RIGHT);
-      } else {
-        bleMouse.release(MOUSE_RIGHT);
-      }
-    }
+// Retried by the sender task while mouse and keyboard reports wait for a congested link
+bool flush_ble_reports() {
+#ifdef BLE_HID_PASSTHROUGH
+  if (passthrough_active) return true;
+#endif
+  if (!bleHid.isConnected()) {
+    ble_mouse_report_reset();
+    ble_keyboard_report_reset();
+    return true;
+  }
+  bool keys_sent = ble_keyboard_report_flush();
+  return ble_mouse_report_flush() && keys_sent;
+}
 
-    // Track and update middle button state
-    if (hidData->buttons.button3 != middleButtonPressed) {
-      middleButtonPressed = hidData->buttons.button3;
-      if (middleButtonPressed) {
-        bleMouse.press(MOUSE_MIDDLE);
-      } else {
-        bleMouse.release(MOUSE_MIDDLE);
-      }
-    }
+void update_keyData (const unified_keyData_t *keyData) {
 
-    // Handle scroll wheel
-    if (hidData->scroll_wheel != 0) {
-      bleMouse.move(0, 0, hidData->scroll_wheel);
-    }
+#ifdef BLE_HID_PASSTHROUGH
+  if (passthrough_active) return;
+#endif
+
+  if(bleHid.isConnected()) {
+    // one notification with modifiers and all pressed keys, sent with the same
+    // credits as mouse reports
+    ble_keyboard_report_submit(keyData);
+    // keys which did not fit into the 6 slots go out with additional reports,
+    // reports held back for lack of credits are retried by flush_ble_reports()
+    ble_keyboard_report_flush();
+  } else {
+    ble_keyboard_report_reset();
+  }
+}
+
+#ifdef OUTPUT_PIPELINE_STATS_TO_CONSOLE
+// How USB report rate and BLE connection interval interact: latencies per
+// stage, event ring depth (reports waiting for the BLE side) and what
+// happened to the reports (dropped when the ring was full, merged into
+// fewer notifications, or needing extra notifications)
+void log_pipeline_stats() {
+  hid_event_ring_t* ring = get_hid_event_ring();
+  ble_mouse_report_stats_t* mouse = get_ble_mouse_report_stats();
+  ble_keyboard_report_stats_t* keyboard = get_ble_keyboard_report_stats();
+
+  ble_conn_manager_t conn = bleHid.getConnParams();
+  ble_reconnect_t reconnect = bleHid.getReconnect();
+
+  hid_latency_log();
+  hid_pipeline_stats_log();  // only with HID_PIPELINE_PROFILE
+  ESP_LOGI("STATS", "event ring: queued=%lu high_water=%lu dropped=%lu",
+           (unsigned long)hid_event_ring_count(ring),
+           (unsigned long)ring->high_water.load(),
+           (unsigned long)ring->overflows.load());
+  ESP_LOGI("STATS", "mouse: reports=%lu notifications=%lu suppressed=%lu extra=%lu",
+           (unsigned long)mouse->hid_reports, (unsigned long)mouse->notifications,
+           (unsigned long)mouse->suppressed, (unsigned long)mouse->drain_reports);
+  ESP_LOGI("STATS", "mouse congestion: stalls=%lu merged=%lu dropped=%lu queue_high_water=%lu",
+           (unsigned long)mouse->stalls, (unsigned long)mouse->merged,
+           (unsigned long)mouse->dropped, (unsigned long)mouse->queue_high_water);
+  ESP_LOGI("STATS", "keyboard: snapshots=%lu notifications=%lu folded=%lu extra=%lu stalls=%lu",
+           (unsigned long)keyboard->snapshots, (unsigned long)keyboard->notifications,
+           (unsigned long)keyboard->folded, (unsigned long)keyboard->drain_reports,
+           (unsigned long)keyboard->stalls);
+  ESP_LOGI("STATS", "connection: interval=%uus latency=%u requests=%lu rejected=%lu "
+           "timeouts=%lu update=%luus max=%luus",
+           conn.granted.interval * BLE_CONN_INTERVAL_UNIT_US, conn.granted.latency,
+           (unsigned long)conn.stats.requests, (unsigned long)conn.stats.rejected,
+           (unsigned long)conn.stats.timeouts, (unsigned long)conn.stats.last_update_us,
+           (unsigned long)conn.stats.max_update_us);
+  ESP_LOGI("STATS", "reconnect: state=%s attempts=%lu directed=%lu fast=%lu slow=%lu "
+           "gave_up=%lu last=%luus max=%luus",
+           ble_reconnect_state_name(reconnect.state), (unsigned long)reconnect.stats.attempts,
+           (unsigned long)reconnect.stats.directed, (unsigned long)reconnect.stats.fast,
+           (unsigned long)reconnect.stats.slow, (unsigned long)reconnect.stats.gave_up,
+           (unsigned long)reconnect.stats.last_us, (unsigned long)reconnect.stats.max_us);
+}
+#endif
+
+// Generated joystick motion once per connection event, at most at the default period
+void align_motion_to_connection() {
+  static uint16_t motionInterval = 0;
+  uint16_t interval = bleHid.getConnParams().granted.interval;
+  if (interval == motionInterval || interval == 0) return;
+  motionInterval = interval;
+
+  uint32_t period_us = interval * BLE_CONN_INTERVAL_UNIT_US;
+  set_joystick_motion_period(period_us < JOYSTICK_MOTION_PERIOD_US ? period_us
+                                                                   : JOYSTICK_MOTION_PERIOD_US);
+}
+
+#ifdef HID_CAPTURE_CONSOLE
+static uint8_t* capture_buffer = NULL;
+static hid_capture_t capture;
+static bool capture_running = false;
+
+void dump_capture() {
+  printf("HIDC capture, %u bytes, %lu records, %lu dropped\n", (unsigned)capture.len,
+         (unsigned long)capture.records, (unsigned long)capture.dropped);
+  for (size_t i = 0; i < capture.len; i++) {
+    printf("%02X", capture.buf[i]);
+    if ((i % 32) == 31 || i == capture.len - 1) printf("\n");
   }
+  printf("HIDC end\n");
+  fflush(stdout);
 }
 
+void handle_capture_command(int cmd) {
+  if (cmd == 'b') {
+    hid_boot_timeline_log();
+    return;
+  }
+  if (capture_buffer == NULL) return;
+  hid_replay_result_t result;
+
+  switch (cmd) {
+    case 'c':
+      if (capture_running) hid_host_capture_stop();
+      hid_capture_init(&capture, capture_buffer, HID_CAPTURE_BUFFER_SIZE, hid_latency_now());
+      hid_host_capture_start(&capture);
+      capture_running = true;
+      Serial.println("Capture started");
+      break;
+    case 's':
+      hid_host_capture_stop();
+      capture_running = false;
+      Serial.printf("Capture stopped, %u bytes\n", (unsigned)capture.len);
+      break;
+    case 'd':
+      if (!capture_running) dump_capture();
+      break;
+    case 'r':
+    case 'f':
+      if (capture_running) break;
+      hid_capture_replay(capture.buf, capture.len, cmd == 'r', &result);
+      if (result.elapsed_us > 0) {
+        Serial.printf("Replay: %lu reports in %lu us\n", (unsigned long)result.reports,
+                      (unsigned long)result.elapsed_us);
+      }
+      break;
+  }
+}
+#endif
 
 void unbond_all_devices() {
     int dev_num = 0;  // To store the number of bonded devices
@@ -122,23 +338,85 @@ void unbond_all_devices() {
 }
 
 
+/**
+ * @brief BLE stack bring-up, runs on its own task while setup() starts the USB host
+ */
+static void ble_init_task(void* arg) {
+#ifdef BLE_HID_PASSTHROUGH
+    if (passthrough_active) {
+      // report map of known devices, forward their reports as they are
+      blePassthrough.begin(&passthrough_cfg);
+    } else {
+      bleHid.begin();
+    }
+#else
+    // start BLE mouse and keyboard
+    bleHid.begin();
+#endif
+    hid_boot_mark(HID_BOOT_BLE_ADVERTISING, hid_latency_now());
+    xEventGroupSetBits(ble_init_events, BLE_INIT_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
 void setup() { 
+    hid_boot_mark(HID_BOOT_SETUP, hid_latency_now());
     Serial.begin(115200);
     Serial.setDebugOutput(true);
 
+    // console output of the report path goes through the trace ring
+    hid_trace_start();
+
+#ifdef HID_CAPTURE_CONSOLE
+    capture_buffer = (uint8_t*)ps_malloc(HID_CAPTURE_BUFFER_SIZE);
+    if (capture_buffer == NULL) Serial.println("No PSRAM for the capture buffer");
+    hid_capture_init(&capture, capture_buffer, 0, 0);
+#endif
+
     //use internal button & LED, switch off LED
     pinMode(GPIO_NUM_0,INPUT_PULLUP);
     pinMode(LED_BUILTIN,OUTPUT);
     digitalWrite(LED_BUILTIN,HIGH);
 
-    // start BLE mouse
-    bleMouse.begin();
+#ifdef BLE_HID_PASSTHROUGH
+    passthrough_active = load_passthrough_config();
+    register_hid_passthrough_callbacks(passthrough_descriptor, passthrough_report);
+#endif
+    // BLE comes up on this core while the USB host installs on core 0; at the
+    // priority of setup(), so both share the core and setup() goes on to
+    // start the USB host instead of waiting for the BLE stack
+    ble_init_events = xEventGroupCreate();
+    BaseType_t task_created = xTaskCreatePinnedToCore(ble_init_task, "ble_init", 8192, NULL,
+                                                      uxTaskPriorityGet(NULL), NULL, 1);
+    assert(task_created == pdTRUE);
+
+    register_ble_mouse_report_transport(send_ble_mouse_report);
+    register_ble_mouse_report_credits(ble_mouse_report_credits);
+    register_hid_sender_flush_callback(flush_ble_reports);
+    bleHid.setWritableCallback(hid_sender_wake);  // retry as soon as the link has room
+    register_ble_keyboard_report_transport(send_ble_keyboard_report);
+    register_ble_keyboard_report_credits(ble_mouse_report_credits);
 
     // register mouse report callback handler
     register_hidData_callback(update_hidData);
+    register_keyData_callback(update_keyData);
+
+#ifdef MOUSE_ACCELERATION_PROFILE
+    set_mouse_ballistics_default(MOUSE_ACCELERATION_PROFILE);
+#endif
+#ifdef MOUSE_TREMOR_FILTER
+    // 1 Hz cutoff at rest, 2 Hz more per 100 counts/s
+    hid_tremor_filter_config_t tremor = {100, 200, 100};
+    set_mouse_tremor_filter_default(&tremor);
+#endif
+
+    // keep parsed report formats of known devices in NVS
+    register_hid_format_cache_storage(get_hid_format_cache_nvs_storage());
 
     //start main USB/HID task
     start_usb_host(); 
+
+    // loop() polls the BLE transport
+    wait_ble_ready();
 }
 
 void loop() {
@@ -158,6 +436,10 @@ void loop() {
   if(lastbuttonPress && (millis() - lastbuttonPress > 1000)) {
     Serial.println("Reset pairings");
     unbond_all_devices();
+#ifdef BLE_HID_PASSTHROUGH
+    // forget the report map, hosts cache it together with the bond
+    save_passthrough_config(true);
+#endif
     lastbuttonPress = 0;
     //blink a few times
     for(int i = 0; i<5; i++) {
@@ -170,12 +452,29 @@ void loop() {
     esp_restart();
   }
 
-  //TODO: stop advertising after x seconds?
-  //BLEDevice::getAdvertising()->stop();
+#ifdef HID_CAPTURE_CONSOLE
+  if (Serial.available()) handle_capture_command(Serial.read());
+#endif
+
+  // short connection interval while there is input, longer when idle;
+  // advertising phases after boot or link loss
+  bleHid.poll();
+  align_motion_to_connection();
+
+  // once the first report went out over BLE, or 30 s after power-on
+  hid_boot_timeline_log_once(hid_latency_now());
+
+#ifdef OUTPUT_PIPELINE_STATS_TO_CONSOLE
+  static unsigned long lastStatsLog = 0;
+  if (millis() - lastStatsLog > 10000) {
+    lastStatsLog = millis();
+    log_pipeline_stats();
+  }
+#endif
 
   /*  
   // indicate connection status
-  if(bleMouse.isConnected()) {
+  if(bleHid.isConnected()) {
     digitalWrite(LED_BUILTIN,HIGH);
   } else {
     digitalWrite(LED_BUILTIN,LOW);
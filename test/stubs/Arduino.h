@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define LOW  0x0
+#define HIGH 0x1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+#define LED_BUILTIN  21
+
+inline void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { (void)pin; (void)value; }
+inline int digitalRead(uint8_t pin) { (void)pin; return HIGH; }
+
+inline unsigned long millis() { return (unsigned long)(native_clock_now_us() / 1000); }
+inline unsigned long micros() { return (unsigned long)native_clock_now_us(); }
+inline void delay(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+
+inline void* ps_malloc(size_t size) { return malloc(size); }
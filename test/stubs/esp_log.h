@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+// Level of printed messages, warnings and errors by default so test output stays readable
+inline esp_log_level_t* native_log_level() {
+    static esp_log_level_t level = ESP_LOG_WARN;
+    return &level;
+}
+
+inline void native_log(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > *native_log_level()) return;
+    static const char letters[] = "NEWIDV";
+    va_list args;
+    va_start(args, format);
+    printf("%c (%s) ", letters[level], tag);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// As with CORE_DEBUG_LEVEL=3: debug and verbose messages are compiled out
+#define ESP_LOGE(tag, format, ...) native_log(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) native_log(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) native_log(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { } while (0)
+#define ESP_LOGV(tag, format, ...) do { } while (0)
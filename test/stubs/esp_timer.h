@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+#include "native_clock.h"
+
+inline int64_t esp_timer_get_time() { return native_clock_now_us(); }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "native_clock.h"
+
+// FreeRTOS stand-ins: tasks are not run (tests call the task's work directly),
+// queues, mutexes and event groups work within one process
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configTICK_RATE_HZ 1000
+
+struct native_task_t {
+    TaskFunction_t function;
+    void* arg;
+    const char* name;
+    uint32_t notifications;
+};
+typedef native_task_t* TaskHandle_t;
+
+struct native_queue_t {
+    size_t item_size;
+    size_t length;
+    std::deque<std::vector<uint8_t> > items;
+};
+typedef native_queue_t* QueueHandle_t;
+
+typedef std::mutex* SemaphoreHandle_t;
+
+// The task which called the stubs, i.e. the test
+inline TaskHandle_t native_current_task() {
+    static native_task_t main_task = {NULL, NULL, "main", 0};
+    return &main_task;
+}
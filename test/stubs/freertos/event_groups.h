@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef EventBits_t* EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreate() { return new EventBits_t(0); }
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    *group |= bits;
+    return *group;
+}
+
+// Does not block, returns the bits which are set
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                       BaseType_t clear, BaseType_t all, TickType_t ticks) {
+    (void)all;
+    (void)ticks;
+    EventBits_t set = *group;
+    if (clear) *group &= ~bits;
+    return set;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    native_queue_t* queue = new native_queue_t;
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    (void)ticks;
+    if (queue->items.size() >= queue->length) return pdFALSE;
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->item_size));
+    return pdTRUE;
+}
+
+// Does not block, an empty queue returns at once
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    (void)ticks;
+    if (queue->items.empty()) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->items.clear();
+    return pdPASS;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return (UBaseType_t)queue->items.size();
+}
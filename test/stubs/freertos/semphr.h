@@ -0,0 +1,18 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+
+inline void vSemaphoreDelete(SemaphoreHandle_t mutex) { delete mutex; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    (void)ticks;
+    mutex->lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->unlock();
+    return pdTRUE;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Created tasks are recorded, not started
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name,
+                                          uint32_t stack_depth, void* arg, UBaseType_t priority,
+                                          TaskHandle_t* handle, BaseType_t core) {
+    (void)stack_depth;
+    (void)priority;
+    (void)core;
+    native_task_t* task = new native_task_t;
+    task->function = function;
+    task->arg = arg;
+    task->name = name;
+    task->notifications = 0;
+    if (handle != NULL) *handle = task;
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                              void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, handle,
+                                   tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t task) { (void)task; }
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return native_current_task(); }
+
+inline void vTaskDelay(TickType_t ticks) {
+    native_clock_sleep_us((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return (TickType_t)(native_clock_now_us() / (1000 * portTICK_PERIOD_MS));
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    task->notifications++;
+    return pdPASS;
+}
+
+// Does not block: returns the pending notifications of the calling (main) task
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    (void)ticks;
+    TaskHandle_t task = native_current_task();
+    uint32_t count = task->notifications;
+    if (clear) task->notifications = 0;
+    else if (count > 0) task->notifications--;
+    return count;
+}
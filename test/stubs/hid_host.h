@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Types of the ESP32_USB_Host_HID driver which the libraries use. Devices are
+// not enumerated on the host: the driver calls fail, tests feed descriptors
+// and reports to the decoders directly.
+
+typedef struct hid_interface* hid_host_device_handle_t;
+
+typedef enum {
+    HID_SUBCLASS_NO_SUBCLASS = 0x00,
+    HID_SUBCLASS_BOOT_INTERFACE = 0x01
+} hid_subclass_t;
+
+typedef enum {
+    HID_PROTOCOL_NONE = 0x00,
+    HID_PROTOCOL_KEYBOARD = 0x01,
+    HID_PROTOCOL_MOUSE = 0x02,
+    HID_PROTOCOL_MAX
+} hid_protocol_t;
+
+typedef enum {
+    HID_REPORT_PROTOCOL_BOOT = 0x00,
+    HID_REPORT_PROTOCOL_REPORT = 0x01
+} hid_report_protocol_t;
+
+typedef enum {
+    HID_REPORT_TYPE_INPUT = 0x01,
+    HID_REPORT_TYPE_OUTPUT = 0x02,
+    HID_REPORT_TYPE_FEATURE = 0x03
+} hid_report_type_t;
+
+typedef enum {
+    HID_HOST_DRIVER_EVENT_CONNECTED = 0x00
+} hid_host_driver_event_t;
+
+typedef enum {
+    HID_HOST_INTERFACE_EVENT_INPUT_REPORT = 0x00,
+    HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR,
+    HID_HOST_INTERFACE_EVENT_DISCONNECTED
+} hid_host_interface_event_t;
+
+typedef struct {
+    uint8_t addr;
+    uint8_t iface_num;
+    uint8_t sub_class;
+    uint8_t proto;
+} hid_host_dev_params_t;
+
+typedef void (*hid_host_driver_event_cb_t)(hid_host_device_handle_t hid_device_handle,
+                                           const hid_host_driver_event_t event, void* arg);
+typedef void (*hid_host_interface_event_cb_t)(hid_host_device_handle_t hid_device_handle,
+                                              const hid_host_interface_event_t event, void* arg);
+
+typedef struct {
+    bool create_background_task;
+    size_t task_priority;
+    size_t stack_size;
+    int core_id;
+    hid_host_driver_event_cb_t callback;
+    void* callback_arg;
+} hid_host_driver_config_t;
+
+typedef struct {
+    hid_host_interface_event_cb_t callback;
+    void* callback_arg;
+} hid_host_device_config_t;
+
+inline esp_err_t hid_host_install(const hid_host_driver_config_t* config) {
+    (void)config;
+    return ESP_OK;
+}
+
+inline esp_err_t hid_host_device_get_params(hid_host_device_handle_t handle,
+                                            hid_host_dev_params_t* params) {
+    (void)handle;
+    (void)params;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t hid_host_device_get_raw_input_report_data(hid_host_device_handle_t handle,
+                                                           uint8_t* data, size_t data_length_max,
+                                                           size_t* data_length) {
+    (void)handle;
+    (void)data;
+    (void)data_length_max;
+    *data_length = 0;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t hid_host_device_open(hid_host_device_handle_t handle,
+                                      const hid_host_device_config_t* config) {
+    (void)handle;
+    (void)config;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t hid_host_device_close(hid_host_device_handle_t handle) {
+    (void)handle;
+    return ESP_OK;
+}
+
+inline esp_err_t hid_host_device_start(hid_host_device_handle_t handle) {
+    (void)handle;
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Report descriptor the driver returns for every interface, NULL by default
+typedef struct {
+    const uint8_t* report_desc;
+    size_t report_desc_len;
+} native_hid_host_t;
+
+inline native_hid_host_t* native_hid_host() {
+    static native_hid_host_t host;
+    return &host;
+}
+
+inline uint8_t* hid_host_get_report_descriptor(hid_host_device_handle_t handle,
+                                               size_t* report_desc_len) {
+    (void)handle;
+    *report_desc_len = native_hid_host()->report_desc_len;
+    return (uint8_t*)native_hid_host()->report_desc;
+}
+
+inline esp_err_t hid_class_request_set_protocol(hid_host_device_handle_t handle,
+                                                hid_report_protocol_t protocol) {
+    (void)handle;
+    (void)protocol;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t hid_class_request_set_idle(hid_host_device_handle_t handle, uint8_t duration,
+                                            uint8_t report_id) {
+    (void)handle;
+    (void)duration;
+    (void)report_id;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t hid_class_request_set_report(hid_host_device_handle_t handle,
+                                              uint8_t report_type, uint8_t report_id,
+                                              uint8_t* data, size_t length) {
+    (void)handle;
+    (void)report_type;
+    (void)report_id;
+    (void)data;
+    (void)length;
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#define HID_KEYBOARD_KEY_MAX 6
+
+// Key codes and modifiers which the libraries use
+#define HID_KEY_NO_PRESS        0x00
+#define HID_KEY_ROLLOVER        0x01
+#define HID_KEY_POST_FAIL       0x02
+#define HID_KEY_ERROR_UNDEFINED 0x03
+#define HID_KEY_A               0x04
+#define HID_KEY_SLASH           0x38
+
+#define HID_LEFT_CONTROL  (1 << 0)
+#define HID_LEFT_SHIFT    (1 << 1)
+#define HID_LEFT_ALT      (1 << 2)
+#define HID_LEFT_GUI      (1 << 3)
+#define HID_RIGHT_CONTROL (1 << 4)
+#define HID_RIGHT_SHIFT   (1 << 5)
+#define HID_RIGHT_ALT     (1 << 6)
+#define HID_RIGHT_GUI     (1 << 7)
+
+// Keyboard boot report, as in the HID specification
+typedef struct {
+    union {
+        struct {
+            uint8_t left_ctr : 1;
+            uint8_t left_shift : 1;
+            uint8_t left_alt : 1;
+            uint8_t left_gui : 1;
+            uint8_t rigth_ctr : 1;
+            uint8_t right_shift : 1;
+            uint8_t right_alt : 1;
+            uint8_t right_gui : 1;
+        };
+        uint8_t val;
+    } modifier;
+    uint8_t reserved;
+    uint8_t key[HID_KEYBOARD_KEY_MAX];
+} __attribute__((packed)) hid_keyboard_input_report_boot_t;
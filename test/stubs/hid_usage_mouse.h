@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Mouse boot report, as in the HID specification
+typedef struct {
+    union {
+        struct {
+            uint8_t button1 : 1;
+            uint8_t button2 : 1;
+            uint8_t button3 : 1;
+            uint8_t reserved : 5;
+        };
+        uint8_t val;
+    } buttons;
+    int8_t x_displacement;
+    int8_t y_displacement;
+} __attribute__((packed)) hid_mouse_input_report_boot_t;
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+
+// Clock of the host build: real time, or a virtual clock driven by the test
+
+struct native_clock_state_t {
+    bool is_virtual;
+    int64_t now_us;
+};
+
+inline native_clock_state_t* native_clock_state() {
+    static native_clock_state_t state = {false, 0};
+    return &state;
+}
+
+inline int64_t native_clock_real_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Switch to the virtual clock and set it
+inline void native_clock_set(int64_t now_us) {
+    native_clock_state()->is_virtual = true;
+    native_clock_state()->now_us = now_us;
+}
+
+inline void native_clock_advance(int64_t us) { native_clock_state()->now_us += us; }
+
+// Back to real time
+inline void native_clock_real() { native_clock_state()->is_virtual = false; }
+
+inline int64_t native_clock_now_us() {
+    if (native_clock_state()->is_virtual) return native_clock_state()->now_us;
+    return native_clock_real_us();
+}
+
+// Wait: the virtual clock advances, real time sleeps
+inline void native_clock_sleep_us(int64_t us) {
+    if (native_clock_state()->is_virtual) {
+        native_clock_advance(us);
+    } else if (us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
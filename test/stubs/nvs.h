@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "esp_err.h"
+
+// NVS in memory, with a count of writes so tests can check flash wear
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+struct native_nvs_t {
+    std::vector<std::string> namespaces;
+    std::map<std::string, std::vector<uint8_t> > blobs;  // "namespace/key"
+    uint32_t writes;
+    uint32_t commits;
+};
+
+inline native_nvs_t* native_nvs() {
+    static native_nvs_t nvs;
+    return &nvs;
+}
+
+inline void native_nvs_erase_all() {
+    native_nvs()->blobs.clear();
+    native_nvs()->writes = 0;
+    native_nvs()->commits = 0;
+}
+
+inline std::string native_nvs_path(nvs_handle_t handle, const char* key) {
+    return native_nvs()->namespaces[handle] + "/" + key;
+}
+
+inline esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    (void)open_mode;
+    std::vector<std::string>& names = native_nvs()->namespaces;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) {
+            *out_handle = (nvs_handle_t)i;
+            return ESP_OK;
+        }
+    }
+    names.push_back(name);
+    *out_handle = (nvs_handle_t)(names.size() - 1);
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t handle) { (void)handle; }
+
+inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value,
+                              size_t* length) {
+    std::map<std::string, std::vector<uint8_t> >::const_iterator it =
+        native_nvs()->blobs.find(native_nvs_path(handle, key));
+    if (it == native_nvs()->blobs.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value == NULL) {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (*length < it->second.size()) return ESP_ERR_INVALID_SIZE;
+    memcpy(out_value, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value,
+                              size_t length) {
+    const uint8_t* bytes = (const uint8_t*)value;
+    native_nvs()->blobs[native_nvs_path(handle, key)] =
+        std::vector<uint8_t>(bytes, bytes + length);
+    native_nvs()->writes++;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void)handle;
+    native_nvs()->commits++;
+    return ESP_OK;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// USB host library types which the libraries use, no devices on the host
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+
+#define USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS 0x01
+#define USB_HOST_LIB_EVENT_FLAGS_ALL_FREE   0x02
+
+typedef struct usb_host_client_handle_s* usb_host_client_handle_t;
+typedef struct usb_device_handle_s* usb_device_handle_t;
+
+typedef struct {
+    bool skip_phy_setup;
+    int intr_flags;
+} usb_host_config_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t bDeviceClass;
+    uint8_t bDeviceSubClass;
+    uint8_t bDeviceProtocol;
+    uint8_t bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t iManufacturer;
+    uint8_t iProduct;
+    uint8_t iSerialNumber;
+    uint8_t bNumConfigurations;
+} usb_device_desc_t;
+
+typedef enum {
+    USB_HOST_CLIENT_EVENT_NEW_DEV,
+    USB_HOST_CLIENT_EVENT_DEV_GONE
+} usb_host_client_event_t;
+
+typedef struct {
+    usb_host_client_event_t event;
+    union {
+        struct {
+            uint8_t address;
+        } new_dev;
+        struct {
+            usb_device_handle_t dev_hdl;
+        } dev_gone;
+    };
+} usb_host_client_event_msg_t;
+
+typedef void (*usb_host_client_event_cb_t)(const usb_host_client_event_msg_t* event_msg,
+                                           void* arg);
+
+typedef struct {
+    bool is_synchronous;
+    int max_num_event_msg;
+    union {
+        struct {
+            usb_host_client_event_cb_t client_event_callback;
+            void* callback_arg;
+        } async;
+    };
+} usb_host_client_config_t;
+
+inline esp_err_t usb_host_install(const usb_host_config_t* config) {
+    (void)config;
+    return ESP_OK;
+}
+
+inline esp_err_t usb_host_uninstall() { return ESP_OK; }
+
+inline esp_err_t usb_host_lib_handle_events(uint32_t timeout_ticks, uint32_t* event_flags_ret) {
+    (void)timeout_ticks;
+    *event_flags_ret = 0;
+    return ESP_ERR_TIMEOUT;
+}
+
+inline esp_err_t usb_host_device_free_all() { return ESP_OK; }
+
+inline esp_err_t usb_host_client_register(const usb_host_client_config_t* config,
+                                          usb_host_client_handle_t* client_hdl_ret) {
+    (void)config;
+    *client_hdl_ret = NULL;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t usb_host_client_handle_events(usb_host_client_handle_t client_hdl,
+                                               uint32_t timeout_ticks) {
+    (void)client_hdl;
+    (void)timeout_ticks;
+    return ESP_ERR_TIMEOUT;
+}
+
+inline esp_err_t usb_host_device_open(usb_host_client_handle_t client_hdl, uint8_t dev_addr,
+                                      usb_device_handle_t* dev_hdl_ret) {
+    (void)client_hdl;
+    (void)dev_addr;
+    (void)dev_hdl_ret;
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t usb_host_device_close(usb_host_client_handle_t client_hdl,
+                                       usb_device_handle_t dev_hdl) {
+    (void)client_hdl;
+    (void)dev_hdl;
+    return ESP_OK;
+}
+
+inline esp_err_t usb_host_get_device_descriptor(usb_device_handle_t dev_hdl,
+                                                const usb_device_desc_t** device_desc) {
+    (void)dev_hdl;
+    (void)device_desc;
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+/*
+ * Host benchmarks: time per call and heap allocations per call.
+ *
+ *   bench_result_t r = bench_run("hid_extract_int", 1000000, [&]() { ... });
+ *
+ * Allocations are counted by bench_alloc.h, which one source file of the
+ * benchmark suite has to include. Results are printed, benchmarks do not fail
+ * on time; tests which need a bound assert on the returned result.
+ */
+
+typedef struct {
+    double ns_per_op;
+    double allocs_per_op;
+} bench_result_t;
+
+inline uint64_t* bench_alloc_counter() {
+    static uint64_t allocs = 0;
+    return &allocs;
+}
+
+// Keeps the compiler from removing the work of a benchmark
+inline void bench_consume(int64_t value) {
+    static volatile int64_t sink;
+    sink = value;
+    (void)sink;
+}
+
+template <typename F>
+bench_result_t bench_run(const char* name, uint32_t iterations, F body) {
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++) body();  // warm up caches and tables
+
+    uint64_t allocs = *bench_alloc_counter();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) body();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    bench_result_t r;
+    r.ns_per_op =
+        (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+        iterations;
+    r.allocs_per_op = (double)(*bench_alloc_counter() - allocs) / iterations;
+    printf("bench %-40s %10.1f ns/op %8.3f allocs/op\n", name, r.ns_per_op, r.allocs_per_op);
+    return r;
+}
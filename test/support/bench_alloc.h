@@ -0,0 +1,42 @@
+#pragma once
+
+// Counts heap allocations for bench_run(). Include in exactly one source file
+// of a suite: it replaces the allocation functions of the program.
+
+#include <stdlib.h>
+#include <new>
+#include "bench.h"
+
+#if defined(__GLIBC__)
+// every allocation, C and C++, goes through these
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    (*bench_alloc_counter())++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    (*bench_alloc_counter())++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    (*bench_alloc_counter())++;
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+// C++ allocations only
+void* operator new(size_t size) {
+    (*bench_alloc_counter())++;
+    void* p = malloc(size ? size : 1);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+#endif
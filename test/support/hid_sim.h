@@ -0,0 +1,303 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include "native_clock.h"
+#include "usb_hid_host.h"
+#include "hid_event_ring.h"
+#include "hid_latency.h"
+#include "hid_latency_hist.h"
+#include "hid_pipeline.h"
+#include "ble_mouse_report.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Discrete-event simulation of the mouse report path on a virtual clock:
+ *
+ *   USB mouse -> decoder -> event ring -> sender task -> update_hidData()
+ *     -> BLE mouse report queue -> BLE stack buffers -> connection events -> host
+ *
+ * Decoder, event ring, the work of the sender task (hid_sender_run) and the
+ * BLE mouse report queue are the real code. The USB device, the scheduling of
+ * the sender task and the BLE link are modeled: the link takes as many
+ * notifications as the stack has buffers and sends up to notify_budget of
+ * them per connection event.
+ *
+ * Latency is measured on the motion: the mouse only moves to +X, so a report
+ * has arrived at the BLE host when the sum of the delivered X motion reaches
+ * the sum up to that report. This also holds when reports are merged.
+ */
+
+typedef struct {
+    const char* name;
+    uint32_t report_interval_us;  // USB report interval, e.g. 1000 for 1 kHz
+    uint32_t jitter_us;           // the interval varies by up to +-jitter_us
+    uint32_t conn_interval_us;    // BLE connection interval
+    uint8_t notify_budget;        // notifications per connection event
+    uint8_t stack_buffers;        // notifications the BLE stack can hold
+    uint32_t sender_delay_us;     // sender task wake-up after a report
+    uint32_t speed;               // X motion in counts per second
+    uint32_t click_interval_us;   // button 1 changes, 0 = no clicks
+    uint32_t duration_us;         // USB reports are sent for this long
+    uint32_t seed;
+    uint16_t loss_permille;       // connection events which deliver nothing
+} hid_sim_config_t;
+
+typedef struct {
+    uint32_t reports;                   // USB reports
+    uint32_t notifications;             // delivered at connection events
+    hid_latency_hist_t motion_latency;  // USB arrival to delivery of the motion
+    hid_latency_hist_t click_latency;   // USB arrival to delivery of a button change
+    uint32_t ring_high_water;           // event ring
+    uint32_t ring_overflows;
+    uint32_t queue_high_water;          // BLE mouse report queue
+    uint32_t merged;
+    uint32_t dropped;
+    uint32_t link_high_water;           // BLE stack buffers in use
+    uint64_t link_depth_sum;            // sampled at every connection event
+    uint32_t conn_events;
+    int64_t motion_in_x;
+    int64_t motion_in_y;
+    int64_t motion_out_x;
+    int64_t motion_out_y;
+    uint32_t clicks_in;
+    uint32_t clicks_out;
+    uint32_t clicks_lost;  // button changes which never reached the host
+    uint32_t conn_events_lost;
+    uint8_t buttons_in;    // button state of the USB device at the end
+    uint8_t buttons_out;   // button state seen by the BLE host at the end
+} hid_sim_result_t;
+
+// Motion sent by the USB device up to a report
+typedef struct {
+    uint32_t arrival_us;
+    int64_t sum_x;
+} hid_sim_motion_t;
+
+typedef struct {
+    uint32_t arrival_us;
+    uint8_t buttons;
+} hid_sim_click_t;
+
+typedef struct {
+    const hid_sim_config_t* cfg;
+    hid_sim_result_t* result;
+    hid_pipeline<> pipeline;
+    std::deque<ble_mouse_report_t> link;  // in the BLE stack buffers
+    std::deque<hid_sim_motion_t> motion;  // not delivered yet
+    std::deque<hid_sim_click_t> clicks;
+    uint8_t host_buttons;
+} hid_sim_t;
+
+inline hid_sim_t*& hid_sim_current() {
+    static hid_sim_t* sim = NULL;
+    return sim;
+}
+
+// update_hidData() of src/main.cpp with a connected host
+inline void hid_sim_update_hidData(unified_hidData_t* hidData) {
+    hid_sim_current()->pipeline.apply(hidData);
+    ble_mouse_report_submit(hidData);
+}
+
+inline bool hid_sim_flush() { return ble_mouse_report_flush(); }
+
+inline bool hid_sim_send(const ble_mouse_report_t* report) {
+    hid_sim_t* sim = hid_sim_current();
+    if (sim->link.size() >= sim->cfg->stack_buffers) return false;
+    sim->link.push_back(*report);
+    if (sim->link.size() > sim->result->link_high_water) {
+        sim->result->link_high_water = (uint32_t)sim->link.size();
+    }
+    return true;
+}
+
+inline int hid_sim_credits() {
+    hid_sim_t* sim = hid_sim_current();
+    return (int)sim->cfg->stack_buffers - (int)sim->link.size();
+}
+
+// A notification reached the BLE host
+inline void hid_sim_deliver(hid_sim_t* sim, const ble_mouse_report_t* report, uint32_t now) {
+    hid_sim_result_t* r = sim->result;
+    r->notifications++;
+    r->motion_out_x += report->x;
+    r->motion_out_y += report->y;
+    while (!sim->motion.empty() && sim->motion.front().sum_x <= r->motion_out_x) {
+        hid_latency_hist_add(&r->motion_latency, now - sim->motion.front().arrival_us);
+        sim->motion.pop_front();
+    }
+
+    if (report->buttons == sim->host_buttons) return;
+    sim->host_buttons = report->buttons;
+    while (!sim->clicks.empty() && sim->clicks.front().buttons != report->buttons) {
+        r->clicks_lost++;  // an intermediate state was skipped
+        sim->clicks.pop_front();
+    }
+    if (!sim->clicks.empty()) {
+        hid_latency_hist_add(&r->click_latency, now - sim->clicks.front().arrival_us);
+        r->clicks_out++;
+        sim->clicks.pop_front();
+    }
+}
+
+// Simple deterministic generator for the report jitter
+inline uint32_t hid_sim_random(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+/**
+ * @brief Run one configuration
+ *
+ * After duration_us the USB device stops and the simulation runs on until
+ * everything queued reached the host (or two more seconds passed).
+ */
+inline void hid_sim_run(const hid_sim_config_t* cfg, hid_sim_result_t* result) {
+    const int64_t never = INT64_MAX;
+    const int64_t start = 1000000;  // timestamps of 0 mean "not set" in places
+    hid_sim_t sim;
+    sim.cfg = cfg;
+    sim.result = result;
+    sim.host_buttons = 0;
+    memset(result, 0, sizeof(*result));
+    hid_sim_current() = &sim;
+
+    native_clock_set(start);
+    hid_test_reset();
+    hid_event_ring_init(get_hid_event_ring());
+    register_hidData_callback(hid_sim_update_hidData);
+    register_hid_sender_flush_callback(hid_sim_flush);
+    register_ble_mouse_report_transport(hid_sim_send);
+    register_ble_mouse_report_credits(hid_sim_credits);
+    ble_mouse_report_reset();
+    ble_mouse_report_stats_reset();
+    hid_latency_reset();
+
+    hid_device_t* dev = hid_test_connect(0x51, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_gaming_mouse, sizeof(desc_gaming_mouse));
+
+    uint32_t random = cfg->seed;
+    int64_t next_report = start;
+    int64_t next_conn = start + cfg->conn_interval_us / 3;  // not aligned to the reports
+    int64_t next_click = cfg->click_interval_us ? start + cfg->click_interval_us / 2 : never;
+    int64_t sender_at = never;
+    int64_t usb_end = start + cfg->duration_us;
+    int64_t sim_end = usb_end + 2000000;
+    uint8_t buttons = 0;
+    int64_t sum_x = 0;
+    uint32_t report_index = 0;
+
+    while (true) {
+        bool usb_active = next_report < usb_end;
+        if (!usb_active && sim.link.empty() && !ble_mouse_report_pending() &&
+            hid_event_ring_count(get_hid_event_ring()) == 0) {
+            break;
+        }
+        int64_t now = usb_active ? next_report : never;
+        if (next_conn < now) now = next_conn;
+        if (sender_at < now) now = sender_at;
+        if (now >= sim_end) break;
+        native_clock_set(now);
+
+        if (usb_active && now == next_report) {
+            // constant speed to +X, small zig-zag on Y
+            int64_t elapsed = now - start;
+            int64_t x = elapsed * cfg->speed / 1000000;
+            int16_t dx = (int16_t)(x - sum_x);
+            int16_t dy = (int16_t)(((report_index / 4) & 1) ? -2 : 2);
+            sum_x = x;
+            report_index++;
+
+            if (now >= next_click) {
+                buttons ^= 0x01;
+                next_click += cfg->click_interval_us;
+                hid_sim_click_t click = {(uint32_t)now, buttons};
+                sim.clicks.push_back(click);
+                result->clicks_in++;
+            }
+
+            uint8_t report[7] = {0x01, buttons, (uint8_t)dx, (uint8_t)(dx >> 8), (uint8_t)dy,
+                                 (uint8_t)(dy >> 8), 0};
+            hid_test_report(dev, report, sizeof(report), (uint32_t)now);
+            result->reports++;
+            result->motion_in_x += dx;
+            result->motion_in_y += dy;
+            if (dx > 0) {
+                hid_sim_motion_t m = {(uint32_t)now, sum_x};
+                sim.motion.push_back(m);
+            }
+
+            if (now + cfg->sender_delay_us < sender_at) sender_at = now + cfg->sender_delay_us;
+            int64_t interval = cfg->report_interval_us;
+            if (cfg->jitter_us > 0) {
+                interval += (int64_t)(hid_sim_random(&random) % (2 * cfg->jitter_us + 1)) -
+                            cfg->jitter_us;
+            }
+            next_report = now + interval;
+        } else if (now == next_conn) {
+            result->conn_events++;
+            result->link_depth_sum += sim.link.size();
+            int sent = 0;
+            bool lost = cfg->loss_permille > 0 &&
+                        hid_sim_random(&random) % 1000 < cfg->loss_permille;
+            if (lost) result->conn_events_lost++;
+            while (!lost && sent < cfg->notify_budget && !sim.link.empty()) {
+                ble_mouse_report_t report = sim.link.front();
+                sim.link.pop_front();
+                hid_sim_deliver(&sim, &report, (uint32_t)now);
+                sent++;
+            }
+            // buffers became free: the transport wakes the sender task
+            if (sent > 0 && now < sender_at) sender_at = now;
+            next_conn = now + cfg->conn_interval_us;
+        } else {
+            bool held_back = hid_sender_run();
+            uint32_t wait_us = hid_sender_wait_us(held_back);
+            // the task sleeps whole ticks
+            sender_at = (wait_us == HID_SENDER_WAIT_FOREVER)
+                            ? never
+                            : now + (int64_t)(wait_us + 999) / 1000 * 1000;
+        }
+    }
+
+    hid_event_ring_t* ring = get_hid_event_ring();
+    ble_mouse_report_stats_t* stats = get_ble_mouse_report_stats();
+    result->ring_high_water = ring->high_water.load();
+    result->ring_overflows = ring->overflows.load();
+    result->queue_high_water = stats->queue_high_water;
+    result->merged = stats->merged;
+    result->dropped = stats->dropped;
+    result->clicks_lost += (uint32_t)sim.clicks.size();
+    result->buttons_in = buttons;
+    result->buttons_out = sim.host_buttons;
+
+    register_ble_mouse_report_transport(NULL);
+    register_ble_mouse_report_credits(NULL);
+    register_hid_sender_flush_callback(NULL);
+    hid_sim_current() = NULL;
+    native_clock_real();
+}
+
+inline void hid_sim_print_header() {
+    printf("%-28s %7s %6s | %-27s | %-20s | %-21s | %s\n", "configuration", "reports", "notif",
+           "motion latency p50/p90/p99/max us", "click p50/max us", "ring/queue/link max",
+           "loss x/y, clicks lost");
+}
+
+inline void hid_sim_print(const hid_sim_config_t* cfg, const hid_sim_result_t* r) {
+    const hid_latency_hist_t* m = &r->motion_latency;
+    const hid_latency_hist_t* c = &r->click_latency;
+    printf("%-28s %7lu %6lu | %6lu %6lu %6lu %6lu | %9lu %10lu | %6lu %6lu %7lu | %lld/%lld, %lu\n",
+           cfg->name, (unsigned long)r->reports, (unsigned long)r->notifications,
+           (unsigned long)hid_latency_hist_percentile(m, 500),
+           (unsigned long)hid_latency_hist_percentile(m, 900),
+           (unsigned long)hid_latency_hist_percentile(m, 990), (unsigned long)m->max_us,
+           (unsigned long)hid_latency_hist_percentile(c, 500), (unsigned long)c->max_us,
+           (unsigned long)r->ring_high_water, (unsigned long)r->queue_high_water,
+           (unsigned long)r->link_high_water, (long long)(r->motion_in_x - r->motion_out_x),
+           (long long)(r->motion_in_y - r->motion_out_y), (unsigned long)r->clicks_lost);
+}
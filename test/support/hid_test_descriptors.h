@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Report descriptors of common device types, as the decoders get them from
+ * the USB host driver. Used by the decoder tests, the benchmarks and the
+ * simulator.
+ */
+
+// Boot mouse of the HID specification: 3 buttons, 8 bit X/Y, no report ID
+static const uint8_t desc_boot_mouse[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01,
+    0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01,
+    0x75, 0x05, 0x81, 0x01, 0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F,
+    0x75, 0x08, 0x95, 0x02, 0x81, 0x06, 0xC0, 0xC0};
+
+// Office mouse: 5 buttons, 8 bit X/Y and wheel
+static const uint8_t desc_wheel_mouse[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01,
+    0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01,
+    0x75, 0x03, 0x81, 0x01, 0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x38, 0x15, 0x81,
+    0x25, 0x7F, 0x75, 0x08, 0x95, 0x03, 0x81, 0x06, 0xC0, 0xC0};
+
+// Mouse collection of a wireless receiver: report ID 2, 16 buttons, 12 bit
+// X/Y packed into 3 bytes, wheel and AC Pan
+static const uint8_t desc_receiver_mouse[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09,
+    0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02,
+    0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07, 0x75, 0x0C, 0x95, 0x02, 0x09, 0x30,
+    0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38,
+    0x81, 0x06, 0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0};
+
+// Gaming mouse: report ID 1, 8 buttons, 16 bit X/Y, 8 bit wheel
+static const uint8_t desc_gaming_mouse[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09,
+    0x19, 0x01, 0x29, 0x08, 0x15, 0x00, 0x25, 0x01, 0x95, 0x08, 0x75, 0x01, 0x81, 0x02,
+    0x05, 0x01, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x09, 0x30,
+    0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38,
+    0x81, 0x06, 0xC0, 0xC0};
+
+// Boot keyboard of the HID specification: modifiers, reserved byte, 6 key array, LEDs
+static const uint8_t desc_boot_keyboard[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00,
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02, 0x95, 0x01,
+    0x75, 0x03, 0x91, 0x01, 0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07,
+    0x19, 0x00, 0x29, 0x65, 0x81, 0x00, 0xC0};
+
+// NKRO keyboard: report ID 1, modifiers and one bit per key for usages 0..119
+static const uint8_t desc_nkro_keyboard[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7,
+    0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x19, 0x00, 0x29, 0x77,
+    0x95, 0x78, 0x81, 0x02, 0xC0};
+
+// Gamepad: 5 axes of 8 bit (X, Y, Z, Z, Rz), hat with null state, 12 buttons, vendor bits
+static const uint8_t desc_gamepad[] = {
+    0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0xA1, 0x02, 0x75, 0x08, 0x95, 0x05, 0x15, 0x00,
+    0x26, 0xFF, 0x00, 0x35, 0x00, 0x46, 0xFF, 0x00, 0x09, 0x30, 0x09, 0x31, 0x09, 0x32,
+    0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0x75, 0x04, 0x95, 0x01, 0x25, 0x07, 0x46, 0x3B,
+    0x01, 0x65, 0x14, 0x09, 0x39, 0x81, 0x42, 0x65, 0x00, 0x75, 0x01, 0x95, 0x0C, 0x25,
+    0x01, 0x45, 0x01, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x81, 0x02, 0x06, 0x00, 0xFF,
+    0x75, 0x01, 0x95, 0x08, 0x25, 0x01, 0x45, 0x01, 0x09, 0x01, 0x81, 0x02, 0xC0, 0xC0};
+
+// Joystick: report ID 3, 10 bit X/Y, 8 buttons
+static const uint8_t desc_joystick[] = {
+    0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0x85, 0x03, 0x09, 0x01, 0xA1, 0x00, 0x09, 0x30,
+    0x09, 0x31, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x75, 0x0A, 0x95, 0x02, 0x81, 0x02, 0x75,
+    0x04, 0x95, 0x01, 0x81, 0x01, 0xC0, 0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x15, 0x00,
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0xC0};
+
+// Receiver with keyboard (ID 1), mouse (ID 2, 12 bit X/Y, wheel between Push and Pop,
+// AC Pan with the restored globals) and consumer control (ID 3)
+static const uint8_t desc_combo_receiver[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7,
+    0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x06, 0x75, 0x08,
+    0x15, 0x00, 0x26, 0xFF, 0x00, 0x19, 0x00, 0x2A, 0xFF, 0x00, 0x81, 0x00, 0xC0,
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09,
+    0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+    0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0xA4, 0x15, 0x81, 0x25,
+    0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06, 0xB4, 0x05, 0x0C, 0x0A, 0x38,
+    0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x03, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x19,
+    0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xC0};
+
+typedef struct {
+    const char* name;
+    const uint8_t* desc;
+    size_t len;
+} hid_test_descriptor_t;
+
+static const hid_test_descriptor_t hid_test_descriptors[] = {
+    {"boot mouse", desc_boot_mouse, sizeof(desc_boot_mouse)},
+    {"wheel mouse", desc_wheel_mouse, sizeof(desc_wheel_mouse)},
+    {"receiver mouse", desc_receiver_mouse, sizeof(desc_receiver_mouse)},
+    {"gaming mouse", desc_gaming_mouse, sizeof(desc_gaming_mouse)},
+    {"boot keyboard", desc_boot_keyboard, sizeof(desc_boot_keyboard)},
+    {"nkro keyboard", desc_nkro_keyboard, sizeof(desc_nkro_keyboard)},
+    {"gamepad", desc_gamepad, sizeof(desc_gamepad)},
+    {"joystick", desc_joystick, sizeof(desc_joystick)},
+    {"combo receiver", desc_combo_receiver, sizeof(desc_combo_receiver)},
+};
+
+#define HID_TEST_DESCRIPTOR_COUNT (sizeof(hid_test_descriptors) / sizeof(hid_test_descriptors[0]))
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "usb_hid_host.h"
+#include "usb_hid_device.h"
+#include "hid_event_ring.h"
+
+/*
+ * Devices without USB: a device table entry is set up from a report
+ * descriptor as on connect, reports are fed to the decoders and the unified
+ * reports and keyboard snapshots are taken out of the event ring (the sender
+ * task does not run, tests call hid_sender_run() to deliver them).
+ */
+
+/**
+ * @brief Set up a device table entry as hid_host_device_event() does on connect
+ *
+ * @param[in] id         Stands in for the driver's device handle, must not be 0
+ * @param[in] sub_class  HID_SUBCLASS_x of the interface
+ * @param[in] proto      HID_PROTOCOL_x of the interface
+ * @param[in] desc       Report descriptor
+ * @param[in] desc_len   Report descriptor length
+ * @return Entry with the parsed formats, NULL if the table is full
+ */
+inline hid_device_t* hid_test_connect(uintptr_t id, uint8_t sub_class, uint8_t proto,
+                                      const uint8_t* desc, size_t desc_len) {
+    static hid_report_map_t map;
+    static hid_format_cache_entry_t cache_entry;
+
+    hid_device_t* dev = hid_device_alloc((hid_host_device_handle_t)id);
+    if (dev == NULL) return NULL;
+    dev->params.addr = (uint8_t)id;
+    dev->params.iface_num = 0;
+    dev->params.sub_class = sub_class;
+    dev->params.proto = proto;
+    dev->keyboard_state.source = (uint8_t)hid_device_index(dev);
+    hid_device_parse_formats(dev, desc, desc_len, &map, &cache_entry, true);
+    return dev;
+}
+
+/**
+ * @brief Decode one input report, copied into a padded buffer as the interface callback does
+ */
+inline void hid_test_report(hid_device_t* dev, const uint8_t* data, size_t length,
+                            uint32_t arrival_us) {
+    uint8_t buf[64 + HID_PLAN_READ_PAD] = {0};
+    if (length > 64) length = 64;
+    memcpy(buf, data, length);
+    hid_device_decode_report(dev, buf, length, arrival_us);
+}
+
+// Take the oldest unified report or keyboard snapshot out of the event ring
+inline bool hid_test_pop(hid_event_t* event) {
+    return hid_event_ring_pop(get_hid_event_ring(), event);
+}
+
+// Stop held joysticks as a disconnect does, empty the event ring and release
+// all device table entries
+inline void hid_test_reset() {
+    hid_event_t event;
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_device_t* dev = hid_device_get(i);
+        if (dev->handle != NULL) {
+            hid_host_joystick_release(&dev->joystick_format, &dev->joystick_motion,
+                                      &dev->joystick_gen);
+        }
+    }
+    while (hid_test_pop(&event)) {
+    }
+    for (int i = 0; i < HID_DEVICE_TABLE_SIZE; i++) {
+        hid_device_t* dev = hid_device_get(i);
+        if (dev->handle != NULL) hid_device_free(dev);
+    }
+}
@@ -0,0 +1,231 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hid_ballistics.h"
+#include "usb_hid_host.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Pointer ballistics: gains at steady speeds against the profile curve in
+ * float, sub-pixel remainders, per-device profiles, and the cost of one report
+ * for every profile and input size against a float implementation.
+ */
+
+#define REPORT_DT_US 1000
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+static const hid_ballistics_profile_t profile_steep = {
+    8,
+    {{0, 50}, {200, 80}, {600, 120}, {1200, 180}, {2500, 260}, {4000, 350}, {7000, 450},
+     {12000, 600}}};
+static const hid_ballistics_profile_t profile_medium = {
+    4, {{0, 100}, {1000, 100}, {4000, 200}, {8000, 300}}};
+static const hid_ballistics_profile_t profile_flat = {1, {{0, 100}}};
+
+static hid_ballistics_t table;
+static hid_ballistics_state_t state;
+static int32_t moved_x[2];
+static int mouse_index;
+
+static void hidData_received(unified_hidData_t* hidData) {
+    moved_x[mouse_index] += hidData->x_displacement;
+}
+
+static void keyData_received(const unified_keyData_t* keyData) {}
+
+void setUp() {
+    random_state = 1;
+    memset(&state, 0, sizeof(state));
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+}
+
+void tearDown() {
+    register_mouse_settings_callback(NULL);
+    hid_test_reset();
+}
+
+// Gain of the profile at a speed, as a float curve through the points
+static double reference_gain(const hid_ballistics_profile_t* profile, double speed) {
+    int n = profile->point_count;
+    if (speed <= profile->points[0].speed) return profile->points[0].gain_x100 / 100.0;
+    for (int p = 1; p < n; p++) {
+        const hid_ballistics_point_t* a = &profile->points[p - 1];
+        const hid_ballistics_point_t* b = &profile->points[p];
+        if (speed > b->speed) continue;
+        double t = (speed - a->speed) / (b->speed - a->speed);
+        return (a->gain_x100 + t * (b->gain_x100 - a->gain_x100)) / 100.0;
+    }
+    return profile->points[n - 1].gain_x100 / 100.0;
+}
+
+// Ballistics in float as it would be written without the table: exact
+// speed, the curve searched on every report, remainders kept as fractions
+static void float_ballistics(const hid_ballistics_profile_t* profile, float* rx, float* ry,
+                             uint32_t dt_us, int16_t* dx, int16_t* dy) {
+    float speed = sqrtf((float)*dx * *dx + (float)*dy * *dy) * 1e6f / dt_us;
+    float gain = (float)reference_gain(profile, speed);
+    float ox = *dx * gain + *rx;
+    float oy = *dy * gain + *ry;
+    *dx = (int16_t)ox;
+    *dy = (int16_t)oy;
+    *rx = ox - *dx;
+    *ry = oy - *dy;
+}
+
+// Steady motion along X: the output over many reports is the input times the
+// profile's gain at that speed, within the table's interpolation error
+void test_steady_speed_gain() {
+    const hid_ballistics_profile_t* profiles[] = {&profile_steep, &profile_medium, &profile_flat};
+    for (const hid_ballistics_profile_t* profile : profiles) {
+        hid_ballistics_build(&table, profile);
+        for (int counts = 1; counts <= 14; counts++) {
+            memset(&state, 0, sizeof(state));
+            uint32_t now = 0;
+            int32_t out = 0;
+            const int reports = 1000;
+            for (int n = 0; n < reports; n++) {
+                int16_t dx = (int16_t)counts, dy = 0;
+                now += REPORT_DT_US;
+                hid_ballistics_apply(&table, &state, now, &dx, &dy);
+                TEST_ASSERT_EQUAL(0, dy);
+                out += dx;
+            }
+            double speed = counts * 1e6 / REPORT_DT_US;
+            double expected = reports * counts * reference_gain(profile, speed);
+            TEST_ASSERT_TRUE(fabs(out - expected) <= expected * 0.03 + 1);
+        }
+    }
+}
+
+// Gain 1 leaves every report as it is
+void test_flat_profile_unchanged() {
+    hid_ballistics_build(&table, &profile_flat);
+    uint32_t now = 0;
+    for (int n = 0; n < 10000; n++) {
+        int16_t x = (int16_t)((int32_t)(random_next() % 4001) - 2000);
+        int16_t y = (int16_t)((int32_t)(random_next() % 4001) - 2000);
+        int16_t dx = x, dy = y;
+        now += 125 + random_next() % 20000;
+        hid_ballistics_apply(&table, &state, now, &dx, &dy);
+        TEST_ASSERT_EQUAL(x, dx);
+        TEST_ASSERT_EQUAL(y, dy);
+    }
+}
+
+// Gain below 1 at low speed: single counts add up to the scaled distance;
+// turning around drops the remainder instead of moving backwards
+void test_remainders() {
+    hid_ballistics_build(&table, &profile_steep);
+    uint32_t now = 0;
+    int32_t out = 0;
+    for (int n = 0; n < 100; n++) {
+        int16_t dx = 1, dy = 0;
+        now += 20000;  // 50 counts/s
+        hid_ballistics_apply(&table, &state, now, &dx, &dy);
+        out += dx;
+    }
+    TEST_ASSERT_INT_WITHIN(2, (int32_t)(100 * reference_gain(&profile_steep, 50)), out);
+
+    int16_t dx = -1, dy = 0;
+    now += 20000;
+    hid_ballistics_apply(&table, &state, now, &dx, &dy);
+    TEST_ASSERT_TRUE(dx <= 0);
+    TEST_ASSERT_TRUE(state.residual_x <= 0);
+}
+
+static void choose_profile(uint32_t desc_hash, const hid_host_dev_params_t* params,
+                           mouse_settings_t* settings) {
+    settings->ballistics_profile = (params->addr == 1) ? MOUSE_BALLISTICS_NONE : MOUSE_BALLISTICS_ACCEL;
+}
+
+// Two mice with the same motion: only the one with a profile is accelerated
+void test_per_device_profiles() {
+    register_mouse_settings_callback(choose_profile);
+    hid_device_t* mice[2];
+    mice[0] = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                               desc_boot_mouse, sizeof(desc_boot_mouse));
+    mice[1] = hid_test_connect(2, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                               desc_boot_mouse, sizeof(desc_boot_mouse));
+    moved_x[0] = moved_x[1] = 0;
+    const uint8_t report[] = {0x00, 10, 0};  // 10 counts per ms, 10000 counts/s
+    for (uint32_t n = 1; n <= 100; n++) {
+        for (mouse_index = 0; mouse_index < 2; mouse_index++) {
+            hid_test_report(mice[mouse_index], report, sizeof(report), n * REPORT_DT_US);
+            hid_sender_run();
+        }
+    }
+    TEST_ASSERT_EQUAL(1000, moved_x[0]);
+    TEST_ASSERT_TRUE(moved_x[1] > 2 * moved_x[0]);  // 300% at 8000 counts/s and above
+}
+
+// Cost of one report: the same for every profile and every input size, as
+// there is no search and no loop; the float version for comparison
+void bench_apply() {
+    const int samples = 256;
+    int16_t xs[samples], ys[samples], big_xs[samples];
+    uint32_t dts[samples];
+    for (int i = 0; i < samples; i++) {
+        xs[i] = (int16_t)((int32_t)(random_next() % 41) - 20);
+        ys[i] = (int16_t)((int32_t)(random_next() % 41) - 20);
+        big_xs[i] = (int16_t)((int32_t)(random_next() % 60001) - 30000);
+        dts[i] = 125 + random_next() % 8000;
+    }
+    int i = 0;
+    uint32_t now = 0;
+    char label[64];
+    double fastest = 1e9, slowest = 0;
+
+    const hid_ballistics_profile_t* profiles[] = {&profile_flat, &profile_medium, &profile_steep};
+    for (const hid_ballistics_profile_t* profile : profiles) {
+        hid_ballistics_build(&table, profile);
+        for (int big = 0; big < 2; big++) {
+            snprintf(label, sizeof(label), "ballistics %d points, %s motion",
+                     profile->point_count, big ? "large" : "small");
+            const int16_t* in_x = big ? big_xs : xs;
+            bench_result_t r = bench_run(label, 5000000, [&]() {
+                int n = i++ & (samples - 1);
+                int16_t dx = in_x[n], dy = ys[n];
+                now += dts[n];
+                hid_ballistics_apply(&table, &state, now, &dx, &dy);
+                bench_consume(dx + dy);
+            });
+            TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+            if (r.ns_per_op < fastest) fastest = r.ns_per_op;
+            if (r.ns_per_op > slowest) slowest = r.ns_per_op;
+        }
+    }
+
+    float rx = 0, ry = 0;
+    bench_result_t flt = bench_run("float ballistics 8 points", 5000000, [&]() {
+        int n = i++ & (samples - 1);
+        int16_t dx = xs[n], dy = ys[n];
+        float_ballistics(&profile_steep, &rx, &ry, dts[n], &dx, &dy);
+        bench_consume(dx + dy);
+    });
+    printf("ballistics: %.1f to %.1f ns per report, float version %.1f ns\n", fastest, slowest,
+           flt.ns_per_op);
+    // bounded: no profile or input makes a report much more expensive
+    TEST_ASSERT_TRUE(slowest < 2 * fastest + 5);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_speed_gain);
+    RUN_TEST(test_flat_profile_unchanged);
+    RUN_TEST(test_remainders);
+    RUN_TEST(test_per_device_profiles);
+    RUN_TEST(bench_apply);
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include "usb_hid_host.h"
+#include "usb_hid_extract.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_joystick.h"
+#include "hid_pipeline.h"
+#include "hid_trace.h"
+#include "ble_mouse_report.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Cost of the report path on the host: bit extraction, descriptor parsing,
+ * the mouse, joystick and keyboard decoders and the BLE side of
+ * update_hidData(). Results are printed as ns/op and allocs/op; the only
+ * assertion is that nothing allocates, absolute times depend on the host.
+ */
+
+#define BENCH_ITERATIONS 1000000
+
+static void hidData_received(unified_hidData_t* hidData) {}
+
+static void keyData_received(const unified_keyData_t* keyData) {}
+
+static bool count_mouse_report(const ble_mouse_report_t* report) {
+    bench_consume(report->x);
+    return true;
+}
+
+void setUp() {
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+}
+
+void tearDown() { hid_test_reset(); }
+
+void bench_extract_int() {
+    const uint8_t report[8 + HID_PLAN_READ_PAD] = {0x02, 0x05, 0x00, 0x9C, 0x8F, 0x0C, 0xFF, 0x00};
+    int32_t acc = 0;
+
+    bench_result_t r = bench_run("hid_extract_int 8 bit aligned", BENCH_ITERATIONS,
+                                 [&]() { acc += hid_extract_int(report, 8, 8, 8, false); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    r = bench_run("hid_extract_int 12 bit signed", BENCH_ITERATIONS,
+                  [&]() { acc += hid_extract_int(report, 8, 36, 12, true); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    r = bench_run("hid_extract_int 16 bit signed", BENCH_ITERATIONS,
+                  [&]() { acc += hid_extract_int(report, 8, 40, 16, true); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    bench_consume(acc);
+}
+
+void bench_descriptor_parser() {
+    static hid_report_map_t map;
+    char name[64];
+
+    for (size_t i = 0; i < HID_TEST_DESCRIPTOR_COUNT; i++) {
+        const hid_test_descriptor_t* d = &hid_test_descriptors[i];
+        snprintf(name, sizeof(name), "parse descriptor %s", d->name);
+        bench_result_t r = bench_run(name, BENCH_ITERATIONS / 10, [&]() {
+            bench_consume(hid_parse_report_descriptor(d->desc, d->len, &map));
+        });
+        TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    }
+
+    mouse_report_format_t mouse;
+    joystick_report_format_t joystick;
+    keyboard_report_format_t keyboard;
+    hid_parse_report_descriptor(desc_receiver_mouse, sizeof(desc_receiver_mouse), &map);
+    bench_result_t r = bench_run("parse_mouse_report_map receiver", BENCH_ITERATIONS / 10,
+                                 [&]() { bench_consume(parse_mouse_report_map(&map, &mouse)); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    hid_parse_report_descriptor(desc_gamepad, sizeof(desc_gamepad), &map);
+    r = bench_run("parse_joystick_report_map gamepad", BENCH_ITERATIONS / 10,
+                  [&]() { bench_consume(parse_joystick_report_map(&map, &joystick)); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    hid_parse_report_descriptor(desc_nkro_keyboard, sizeof(desc_nkro_keyboard), &map);
+    r = bench_run("parse_keyboard_report_map nkro", BENCH_ITERATIONS / 10,
+                  [&]() { bench_consume(parse_keyboard_report_map(&map, &keyboard)); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+}
+
+void bench_mouse_callback() {
+    hid_device_t* dev = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_receiver_mouse, sizeof(desc_receiver_mouse));
+    uint8_t report[64 + HID_PLAN_READ_PAD] = {0x02, 0x01, 0x00, 0x9C, 0x8F, 0x0C, 0xFF, 0x00};
+    hid_event_t event;
+    uint32_t t = 0;
+
+    // decode and hand over through the event ring, as far as the sender task
+    bench_result_t r = bench_run("mouse report callback + ring", BENCH_ITERATIONS, [&]() {
+        hid_host_mouse_report_callback(&dev->mouse_format, &dev->mouse_state, report, 8,
+                                       t += 1000);
+        hid_test_pop(&event);
+    });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+}
+
+void bench_joystick_callback() {
+    hid_device_t* dev = hid_test_connect(2, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_gamepad, sizeof(desc_gamepad));
+    uint8_t report[64 + HID_PLAN_READ_PAD] = {0xC0, 0x30, 0x80, 0x80, 0x80, 0x1F, 0x00, 0x00};
+    hid_event_t event;
+
+    set_joystick_motion_period(0);  // every report carries motion
+    bench_result_t r = bench_run("joystick report callback + ring", BENCH_ITERATIONS, [&]() {
+        hid_host_joystick_report_callback(&dev->joystick_format, &dev->joystick_motion,
+                                          &dev->joystick_gen, report, 8, 0);
+        hid_test_pop(&event);
+    });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    set_joystick_motion_period(JOYSTICK_MOTION_PERIOD_US);
+}
+
+void bench_keyboard_callback() {
+    hid_device_t* dev = hid_test_connect(3, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD,
+                                         desc_boot_keyboard, sizeof(desc_boot_keyboard));
+    uint8_t reports[2][8 + HID_PLAN_READ_PAD] = {{0x02, 0x00, 0x04, 0x05, 0, 0, 0, 0},
+                                                 {0x00, 0x00, 0x04, 0, 0, 0, 0, 0}};
+    hid_event_t event;
+    int i = 0, snapshots = 0;
+
+    // every report changes the keys, so every report queues a snapshot
+    bench_result_t r = bench_run("keyboard report callback + ring", BENCH_ITERATIONS, [&]() {
+        hid_host_keyboard_report_callback(&dev->keyboard_format, &dev->keyboard_state,
+                                          reports[i ^= 1], 8);
+        if (hid_test_pop(&event) && event.type == HID_EVENT_KEYDATA) snapshots++;
+    });
+    TEST_ASSERT_GREATER_THAN(0, snapshots);
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+}
+
+void bench_update_hidData() {
+    // what update_hidData() in src/main.cpp does with the default pipeline and
+    // a connected host: pipeline, trace record (drained here, by a task on the
+    // device) and the BLE mouse report with a transport which always has room
+    hid_pipeline<> pipeline;
+    hid_trace_record_t rec;
+    unified_hidData_t hidData;
+    memset(&hidData, 0, sizeof(hidData));
+
+    register_ble_mouse_report_transport(count_mouse_report);
+    register_ble_mouse_report_credits(NULL);
+    ble_mouse_report_reset();
+    int16_t step = 0;
+    bench_result_t r = bench_run("update_hidData", BENCH_ITERATIONS, [&]() {
+        hidData.x_displacement = (int16_t)((step++ & 15) - 8);
+        hidData.y_displacement = 3;
+        pipeline.apply(&hidData);
+        hid_trace_write(HID_TRACE_CAT_MOUSE, HID_TRACE_REC_HIDDATA, &hidData, sizeof(hidData));
+        ble_mouse_report_submit(&hidData);
+        hid_trace_read(&rec);
+    });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    register_ble_mouse_report_transport(NULL);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(bench_extract_int);
+    RUN_TEST(bench_descriptor_parser);
+    RUN_TEST(bench_mouse_callback);
+    RUN_TEST(bench_joystick_callback);
+    RUN_TEST(bench_keyboard_callback);
+    RUN_TEST(bench_update_hidData);
+    return UNITY_END();
+}
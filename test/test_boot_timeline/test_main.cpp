@@ -0,0 +1,111 @@
+#include <unity.h>
+#include <thread>
+#include <vector>
+#include "usb_hid_host.h"
+#include "hid_boot_timeline.h"
+#include "hid_latency.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Boot milestone recorder: the first time of a milestone is kept, also when
+ * several tasks reach it at once, the sender task records the first report,
+ * and the timeline is logged once at the end of startup.
+ */
+
+static void hidData_received(unified_hidData_t* hidData) {}
+
+static void keyData_received(const unified_keyData_t* keyData) {}
+
+void setUp() {
+    hid_boot_timeline_reset();
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    native_clock_set(2000000);
+}
+
+void tearDown() {
+    hid_test_reset();
+    native_clock_real();
+}
+
+// Later marks and unknown milestones change nothing; time 0 still counts as reached
+void test_first_mark_wins() {
+    hid_boot_mark(HID_BOOT_SETUP, 0);
+    hid_boot_mark(HID_BOOT_FIRST_DEVICE, 350000);
+    hid_boot_mark(HID_BOOT_FIRST_DEVICE, 900000);
+    hid_boot_mark(HID_BOOT_MILESTONES, 1000);
+
+    TEST_ASSERT_TRUE(hid_boot_get(HID_BOOT_SETUP) != 0);
+    TEST_ASSERT_EQUAL_UINT32(350000, hid_boot_get(HID_BOOT_FIRST_DEVICE));
+    TEST_ASSERT_EQUAL_UINT32(0, hid_boot_get(HID_BOOT_BLE_CONNECTED));
+    TEST_ASSERT_EQUAL_UINT32(0, hid_boot_get(HID_BOOT_MILESTONES));
+    TEST_ASSERT_EQUAL_STRING("first device", hid_boot_milestone_name(HID_BOOT_FIRST_DEVICE));
+    TEST_ASSERT_EQUAL_STRING("?", hid_boot_milestone_name(HID_BOOT_MILESTONES));
+
+    hid_boot_timeline_reset();
+    TEST_ASSERT_EQUAL_UINT32(0, hid_boot_get(HID_BOOT_FIRST_DEVICE));
+}
+
+// Tasks racing for the same milestone: exactly one time is kept, and it is
+// one of the times they marked
+void test_concurrent_marks() {
+    for (int round = 0; round < 50; round++) {
+        hid_boot_timeline_reset();
+        std::vector<std::thread> tasks;
+        for (uint32_t t = 1; t <= 4; t++) {
+            tasks.push_back(std::thread([t]() {
+                for (uint32_t n = 0; n < 100; n++) hid_boot_mark(HID_BOOT_FIRST_REPORT, t * 1000 + n);
+            }));
+        }
+        for (std::thread& task : tasks) task.join();
+        uint32_t kept = hid_boot_get(HID_BOOT_FIRST_REPORT);
+        TEST_ASSERT_TRUE(kept % 1000 == 0 && kept >= 1000 && kept <= 4000);
+    }
+}
+
+// The sender task records the first report it delivers, not later ones
+void test_first_report_recorded_by_sender() {
+    hid_device_t* mouse = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                           desc_boot_mouse, sizeof(desc_boot_mouse));
+    const uint8_t report[] = {0x00, 0x05, 0xFB};
+    hid_test_report(mouse, report, sizeof(report), hid_latency_now());
+    TEST_ASSERT_EQUAL_UINT32(0, hid_boot_get(HID_BOOT_FIRST_REPORT));  // still in the ring
+
+    native_clock_advance(1500);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL_UINT32(2001500, hid_boot_get(HID_BOOT_FIRST_REPORT));
+
+    native_clock_advance(8000);
+    hid_test_report(mouse, report, sizeof(report), hid_latency_now());
+    hid_sender_run();
+    TEST_ASSERT_EQUAL_UINT32(2001500, hid_boot_get(HID_BOOT_FIRST_REPORT));
+}
+
+// Logged once when a report was delivered and a host connected, or after the
+// timeout with what was reached so far
+void test_logged_once() {
+    hid_boot_mark(HID_BOOT_SETUP, 10000);
+    hid_boot_mark(HID_BOOT_FIRST_REPORT, 900000);
+    TEST_ASSERT_FALSE(hid_boot_timeline_log_once(1000000));
+    hid_boot_mark(HID_BOOT_BLE_CONNECTED, 1200000);
+    TEST_ASSERT_TRUE(hid_boot_timeline_log_once(1200000));
+    TEST_ASSERT_FALSE(hid_boot_timeline_log_once(1220000));
+    TEST_ASSERT_FALSE(hid_boot_timeline_log_once(HID_BOOT_LOG_TIMEOUT_US));
+
+    // no host in reach
+    hid_boot_timeline_reset();
+    hid_boot_mark(HID_BOOT_FIRST_REPORT, 900000);
+    TEST_ASSERT_FALSE(hid_boot_timeline_log_once(HID_BOOT_LOG_TIMEOUT_US - 1));
+    TEST_ASSERT_TRUE(hid_boot_timeline_log_once(HID_BOOT_LOG_TIMEOUT_US));
+    TEST_ASSERT_FALSE(hid_boot_timeline_log_once(HID_BOOT_LOG_TIMEOUT_US + 20000));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_mark_wins);
+    RUN_TEST(test_concurrent_marks);
+    RUN_TEST(test_first_report_recorded_by_sender);
+    RUN_TEST(test_logged_once);
+    return UNITY_END();
+}
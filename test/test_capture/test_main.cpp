@@ -0,0 +1,219 @@
+#include <unity.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <nvs.h>
+#include "usb_hid_host.h"
+#include "usb_hid_format_cache.h"
+#include "hid_capture.h"
+#include "hid_capture_host.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Capture format and replay: records read back as written, replayed reports
+ * decoded like live ones but with their own keyboard source and without
+ * format cache writes, live input held off while a replay runs, and every
+ * capture started on the live interfaces beginning with their descriptors.
+ */
+
+static uint8_t capture_buf[4096];
+static hid_capture_t cap;
+static unified_keyData_t last_keyData;
+static int keyData_count;
+
+static void hidData_received(unified_hidData_t* hidData) {}
+
+static void keyData_received(const unified_keyData_t* keyData) {
+    last_keyData = *keyData;
+    keyData_count++;
+}
+
+void setUp() {
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    keyData_count = 0;
+    native_nvs_erase_all();
+    memset(get_hid_format_cache_stats(), 0, sizeof(hid_format_cache_stats_t));
+    hid_capture_init(&cap, capture_buf, sizeof(capture_buf), 0);
+}
+
+void tearDown() {
+    native_hid_host()->report_desc = NULL;
+    native_hid_host()->report_desc_len = 0;
+    register_hid_format_cache_storage(NULL);
+    hid_test_reset();
+}
+
+void test_records_read_back() {
+    const uint8_t report[] = {0x01, 0x05, 0xFD};
+    TEST_ASSERT_TRUE(hid_capture_descriptor(&cap, 3, HID_SUBCLASS_BOOT_INTERFACE,
+                                            HID_PROTOCOL_MOUSE, desc_boot_mouse,
+                                            sizeof(desc_boot_mouse), 100));
+    TEST_ASSERT_TRUE(hid_capture_report(&cap, 3, report, sizeof(report), 1100));
+    TEST_ASSERT_TRUE(hid_capture_report(&cap, 3, report, sizeof(report), 1000000));
+
+    hid_capture_reader_t reader;
+    hid_capture_record_t rec;
+    TEST_ASSERT_TRUE(hid_capture_reader_init(&reader, cap.buf, cap.len));
+    TEST_ASSERT_TRUE(hid_capture_next(&reader, &rec));
+    TEST_ASSERT_EQUAL(HID_CAPTURE_REC_DESCRIPTOR, rec.type);
+    TEST_ASSERT_EQUAL(3, rec.iface);
+    TEST_ASSERT_EQUAL(HID_PROTOCOL_MOUSE, rec.proto);
+    TEST_ASSERT_EQUAL_UINT32(100, rec.delta_us);
+    TEST_ASSERT_EQUAL(sizeof(desc_boot_mouse), rec.length);
+    TEST_ASSERT_EQUAL_MEMORY(desc_boot_mouse, rec.data, rec.length);
+
+    TEST_ASSERT_TRUE(hid_capture_next(&reader, &rec));
+    TEST_ASSERT_EQUAL(HID_CAPTURE_REC_REPORT, rec.type);
+    TEST_ASSERT_EQUAL_UINT32(1000, rec.delta_us);
+    TEST_ASSERT_EQUAL_MEMORY(report, rec.data, sizeof(report));
+    TEST_ASSERT_TRUE(hid_capture_next(&reader, &rec));
+    TEST_ASSERT_EQUAL_UINT32(998900, rec.delta_us);
+    TEST_ASSERT_FALSE(hid_capture_next(&reader, &rec));
+    TEST_ASSERT_EQUAL(reader.len, reader.pos);
+}
+
+void test_full_capture_counts_dropped() {
+    hid_capture_init(&cap, capture_buf, 64, 0);
+    const uint8_t report[8] = {0};
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < 20; i++) {
+        if (hid_capture_report(&cap, 0, report, sizeof(report), i * 1000)) written++;
+    }
+    TEST_ASSERT_TRUE(written > 0 && written < 20);
+    TEST_ASSERT_EQUAL_UINT32(20 - written, cap.dropped);
+    TEST_ASSERT_TRUE(cap.len <= 64);
+}
+
+// A mouse and a keyboard replayed: reports come out of the event ring like
+// live ones, the keyboard has the replay source and is released at the end
+void test_replay_decodes_reports() {
+    const uint8_t mouse[] = {0x01, 0x01, 0x34, 0x12, 0xCC, 0xED, 0x01};
+    const uint8_t key_down[] = {HID_LEFT_SHIFT, 0x00, HID_KEY_A, 0, 0, 0, 0, 0};
+    hid_capture_descriptor(&cap, 0, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                           desc_gaming_mouse, sizeof(desc_gaming_mouse), 0);
+    hid_capture_descriptor(&cap, 1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD,
+                           desc_boot_keyboard, sizeof(desc_boot_keyboard), 0);
+    hid_capture_report(&cap, 0, mouse, sizeof(mouse), 1000);
+    hid_capture_report(&cap, 1, key_down, sizeof(key_down), 2000);
+    hid_capture_report(&cap, 2, mouse, sizeof(mouse), 3000);  // no descriptor: error
+
+    hid_replay_result_t result;
+    TEST_ASSERT_TRUE(hid_capture_replay_run(cap.buf, cap.len, false, &result));
+    TEST_ASSERT_EQUAL_UINT32(2, result.descriptors);
+    TEST_ASSERT_EQUAL_UINT32(2, result.reports);
+    TEST_ASSERT_EQUAL_UINT32(1, result.errors);
+
+    hid_event_t event;
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL(HID_EVENT_HIDDATA, event.type);
+    TEST_ASSERT_EQUAL(0x1234, event.hidData.x_displacement);
+
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(2, keyData_count);  // pressed, then released by the end of the replay
+    TEST_ASSERT_EQUAL(HID_KEY_SOURCE_REPLAY, last_keyData.source);
+    TEST_ASSERT_EQUAL(0, last_keyData.modifier);
+    TEST_ASSERT_EQUAL(0, hid_key_bitmap_count(&last_keyData.keys));
+}
+
+// Formats parsed for a replay are looked up, but never written to flash
+void test_replay_does_not_store_formats() {
+    register_hid_format_cache_storage(get_hid_format_cache_nvs_storage());
+    hid_capture_descriptor(&cap, 0, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                           desc_receiver_mouse, sizeof(desc_receiver_mouse), 0);
+
+    hid_replay_result_t result;
+    uint32_t writes = native_nvs()->writes;
+    TEST_ASSERT_TRUE(hid_capture_replay_run(cap.buf, cap.len, false, &result));
+    TEST_ASSERT_EQUAL_UINT32(writes, native_nvs()->writes);
+    TEST_ASSERT_EQUAL(0, get_hid_format_cache_stats()->stores);
+    TEST_ASSERT_EQUAL(1, get_hid_format_cache_stats()->misses);
+}
+
+// While a replay runs in real time, live reports are ignored and a disconnect
+// waits until every replayed report is in the event ring
+void test_live_input_held_off() {
+    const int reports = 20;
+    const uint8_t mouse[] = {0x01, 0x01, 0x00, 0x01, 0x00, 0x01};
+    hid_capture_descriptor(&cap, 0, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                           desc_boot_mouse, sizeof(desc_boot_mouse), 0);
+    for (int i = 0; i < reports; i++) {
+        hid_capture_report(&cap, 0, mouse, 3, 2000 * (i + 1));
+    }
+
+    std::atomic<bool> replayed(false);
+    std::thread replay([&replayed]() {
+        hid_replay_result_t result;
+        hid_capture_replay_run(cap.buf, cap.len, true, &result);
+        replayed.store(true);
+    });
+
+    // a live report: dropped once the replay has started
+    while (!replayed.load() && hid_live_input_begin(false)) {
+        hid_live_input_end();
+        std::this_thread::yield();
+    }
+    if (!replayed.load()) {
+        // a disconnect
+        TEST_ASSERT_TRUE(hid_live_input_begin(true));
+        TEST_ASSERT_EQUAL_UINT32(reports, hid_event_ring_count(get_hid_event_ring()));
+        hid_live_input_end();
+    }
+    replay.join();
+    TEST_ASSERT_TRUE(hid_live_input_begin(false));
+    hid_live_input_end();
+}
+
+// Reports of a live interface, as the interface callback hands them over
+static void capture_live(hid_device_t* dev, const uint8_t* report, size_t length, int reports) {
+    for (int i = 0; i < reports; i++) {
+        hid_capture_on_report(dev, report, length, 1000 * (i + 1));
+    }
+}
+
+// A capture started again, on the same buffer as the one before, begins with
+// the report descriptor and replays like the first
+void test_restart_records_descriptor() {
+    const uint8_t mouse[] = {0x01, 0x05, 0xFD};
+    native_hid_host()->report_desc = desc_boot_mouse;
+    native_hid_host()->report_desc_len = sizeof(desc_boot_mouse);
+    hid_device_t* dev = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_boot_mouse, sizeof(desc_boot_mouse));
+
+    for (int round = 0; round < 3; round++) {
+        hid_capture_init(&cap, capture_buf, sizeof(capture_buf), 0);
+        hid_host_capture_start(&cap);
+        capture_live(dev, mouse, sizeof(mouse), 4);
+        hid_host_capture_stop();
+        capture_live(dev, mouse, sizeof(mouse), 2);  // not recorded
+
+        hid_capture_reader_t reader;
+        hid_capture_record_t rec;
+        TEST_ASSERT_TRUE(hid_capture_reader_init(&reader, cap.buf, cap.len));
+        TEST_ASSERT_TRUE(hid_capture_next(&reader, &rec));
+        TEST_ASSERT_EQUAL(HID_CAPTURE_REC_DESCRIPTOR, rec.type);
+        TEST_ASSERT_EQUAL(hid_device_index(dev), rec.iface);
+        TEST_ASSERT_EQUAL_MEMORY(desc_boot_mouse, rec.data, rec.length);
+
+        hid_replay_result_t result;
+        TEST_ASSERT_TRUE(hid_capture_replay_run(cap.buf, cap.len, false, &result));
+        TEST_ASSERT_EQUAL_UINT32(1, result.descriptors);
+        TEST_ASSERT_EQUAL_UINT32(4, result.reports);
+        TEST_ASSERT_EQUAL_UINT32(0, result.errors);
+        hid_event_t event;
+        while (hid_test_pop(&event)) {
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_records_read_back);
+    RUN_TEST(test_full_capture_counts_dropped);
+    RUN_TEST(test_replay_decodes_reports);
+    RUN_TEST(test_replay_does_not_store_formats);
+    RUN_TEST(test_live_input_held_off);
+    RUN_TEST(test_restart_records_descriptor);
+    return UNITY_END();
+}
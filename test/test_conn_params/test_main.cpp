@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <string.h>
+#include "ble_conn_params.h"
+
+/*
+ * Connection parameter manager driven by a stand-in central on a virtual
+ * clock: the short interval while there is input, the idle parameters after
+ * the idle timeout, retries after rejected and unanswered requests, and the
+ * granted parameters and update times it records.
+ */
+
+#define TICK_US 1000
+
+// Central which answers requests after a few connection events, as the BLE
+// stack of a phone or PC does
+typedef struct {
+    ble_conn_granted_t in_use;
+    uint16_t min_interval;  // shortest interval it grants, e.g. 12 (15 ms) on some phones
+    bool reject;
+    bool silent;  // never answers
+    bool has_request;
+    ble_conn_params_t request;
+    uint32_t answer_us;
+} central_t;
+
+static central_t central;
+static ble_conn_manager_t mgr;
+static ble_conn_policy_t policy;
+static uint32_t now;
+
+void setUp() {
+    memset(&central, 0, sizeof(central));
+    central.in_use.interval = 24;  // 30 ms, a usual default
+    central.in_use.latency = 0;
+    central.in_use.timeout = 400;
+    central.min_interval = 6;
+    ble_conn_policy_default(&policy);
+    ble_conn_manager_init(&mgr, &policy);
+    now = 1000000;
+}
+
+void tearDown() {}
+
+static void central_receive(const ble_conn_params_t* request) {
+    central.has_request = true;
+    central.request = *request;
+    // the update takes effect a few events later, at the current interval
+    central.answer_us = now + 6 * central.in_use.interval * BLE_CONN_INTERVAL_UNIT_US;
+}
+
+static void central_run() {
+    if (!central.has_request || central.silent) return;
+    if ((int32_t)(now - central.answer_us) < 0) return;
+    central.has_request = false;
+    if (central.reject) {
+        ble_conn_manager_updated(&mgr, now, false, &central.in_use);
+        return;
+    }
+    uint16_t interval = central.request.max_interval;
+    if (interval < central.min_interval) interval = central.min_interval;
+    central.in_use.interval = interval;
+    central.in_use.latency = central.request.latency;
+    central.in_use.timeout = central.request.timeout;
+    ble_conn_manager_updated(&mgr, now, true, &central.in_use);
+}
+
+// 'us' of virtual time with or without input, the transport polling the
+// manager every millisecond as it does for every report and in loop()
+static void run_for(uint32_t us, bool input) {
+    for (uint32_t t = 0; t < us; t += TICK_US) {
+        if (input) ble_conn_manager_input(&mgr, now);
+        ble_conn_params_t request;
+        if (ble_conn_manager_poll(&mgr, now, &request)) central_receive(&request);
+        central_run();
+        now += TICK_US;
+    }
+}
+
+// The short interval is requested on connect and granted, once
+void test_active_interval_on_connect() {
+    ble_conn_manager_connected(&mgr, now, &central.in_use);
+    run_for(1000000, true);
+
+    TEST_ASSERT_EQUAL(BLE_CONN_MODE_ACTIVE, mgr.mode);
+    TEST_ASSERT_EQUAL(policy.active.max_interval, mgr.granted.interval);
+    TEST_ASSERT_EQUAL(0, mgr.granted.latency);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.updates);
+    // six events at 30 ms, within the 1 ms polling
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, 6 * 24 * BLE_CONN_INTERVAL_UNIT_US, mgr.stats.last_update_us);
+}
+
+// Without input the idle parameters are requested after the idle timeout,
+// and the next input brings the short interval back
+void test_idle_and_back() {
+    ble_conn_manager_connected(&mgr, now, &central.in_use);
+    run_for(1000000, true);
+    run_for(policy.idle_after_us - 10000, false);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.requests);
+
+    run_for(1000000, false);
+    TEST_ASSERT_EQUAL(BLE_CONN_MODE_IDLE, mgr.mode);
+    TEST_ASSERT_EQUAL(policy.idle.max_interval, mgr.granted.interval);
+    TEST_ASSERT_EQUAL(policy.idle.latency, mgr.granted.latency);
+    TEST_ASSERT_EQUAL_UINT32(2, mgr.stats.requests);
+
+    run_for(1000000, true);
+    TEST_ASSERT_EQUAL(BLE_CONN_MODE_ACTIVE, mgr.mode);
+    TEST_ASSERT_EQUAL(policy.active.max_interval, mgr.granted.interval);
+    TEST_ASSERT_EQUAL_UINT32(3, mgr.stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(3, mgr.stats.updates);
+    // the update from the idle interval took six 50 ms events
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, 6 * 40 * BLE_CONN_INTERVAL_UNIT_US, mgr.stats.max_update_us);
+}
+
+// A central which grants less than requested is not asked again and again
+void test_granted_differs_from_request() {
+    central.min_interval = 12;
+    ble_conn_manager_connected(&mgr, now, &central.in_use);
+    run_for(3000000, true);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.requests);
+    TEST_ASSERT_EQUAL(12, mgr.granted.interval);
+}
+
+// Rejections and unanswered requests are retried after retry_us, not before
+void test_retry_after_reject_and_timeout() {
+    central.reject = true;
+    ble_conn_manager_connected(&mgr, now, &central.in_use);
+    run_for(policy.retry_us - 100000, true);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.rejected);
+
+    central.reject = false;
+    central.silent = true;
+    run_for(1000000, true);
+    TEST_ASSERT_EQUAL_UINT32(2, mgr.stats.requests);
+    run_for(policy.retry_us, true);
+    TEST_ASSERT_EQUAL_UINT32(1, mgr.stats.timeouts);
+    TEST_ASSERT_EQUAL_UINT32(3, mgr.stats.requests);
+
+    central.silent = false;
+    run_for(1000000, true);
+    TEST_ASSERT_EQUAL(policy.active.max_interval, mgr.granted.interval);
+}
+
+// Nothing is requested when the central chose the parameters itself, or
+// after a disconnect
+void test_no_request_needed() {
+    central.in_use.interval = policy.active.min_interval;
+    ble_conn_manager_connected(&mgr, now, &central.in_use);
+    run_for(1000000, true);
+    TEST_ASSERT_EQUAL_UINT32(0, mgr.stats.requests);
+    TEST_ASSERT_EQUAL(BLE_CONN_MODE_ACTIVE, mgr.mode);
+
+    ble_conn_manager_disconnected(&mgr);
+    run_for(policy.idle_after_us + 1000000, false);
+    TEST_ASSERT_EQUAL_UINT32(0, mgr.stats.requests);
+    TEST_ASSERT_EQUAL(BLE_CONN_MODE_NONE, mgr.mode);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_active_interval_on_connect);
+    RUN_TEST(test_idle_and_back);
+    RUN_TEST(test_granted_differs_from_request);
+    RUN_TEST(test_retry_after_reject_and_timeout);
+    RUN_TEST(test_no_request_needed);
+    return UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <unity.h>
+#include <string.h>
+#include "usb_hid_host.h"
+#include "usb_hid_joystick.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+static unified_keyData_t last_keyData;
+static int keyData_count;
+
+static void hidData_received(unified_hidData_t* hidData) {}
+
+static void keyData_received(const unified_keyData_t* keyData) {
+    last_keyData = *keyData;
+    keyData_count++;
+}
+
+void setUp() {
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    keyData_count = 0;
+    set_joystick_motion_period(0);  // motion with the joystick's own reports
+}
+
+void tearDown() { hid_test_reset(); }
+
+void test_boot_mouse_report() {
+    hid_device_t* dev = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_boot_mouse, sizeof(desc_boot_mouse));
+    TEST_ASSERT_TRUE(dev->mouse_format.is_valid);
+    TEST_ASSERT_EQUAL(0, dev->mouse_format.reportid);
+
+    const uint8_t report[] = {0x01, 0x05, 0xFD};
+    hid_test_report(dev, report, sizeof(report), 100);
+
+    hid_event_t event;
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL_HEX8(0x01, event.hidData.buttons.val);
+    TEST_ASSERT_EQUAL(5, event.hidData.x_displacement);
+    TEST_ASSERT_EQUAL(-3, event.hidData.y_displacement);
+    TEST_ASSERT_EQUAL_UINT32(100, event.arrival_us);
+    TEST_ASSERT_FALSE(hid_test_pop(&event));
+}
+
+void test_receiver_mouse_12_bit_axes() {
+    hid_device_t* dev = hid_test_connect(2, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_receiver_mouse, sizeof(desc_receiver_mouse));
+    TEST_ASSERT_TRUE(dev->mouse_format.is_valid);
+    TEST_ASSERT_EQUAL(2, dev->mouse_format.reportid);
+
+    // X = -100 (0xF9C), Y = 200 (0x0C8), wheel -1
+    const uint8_t report[] = {0x02, 0x02, 0x00, 0x9C, 0x8F, 0x0C, 0xFF, 0x00};
+    hid_test_report(dev, report, sizeof(report), 0);
+
+    hid_event_t event;
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL_HEX8(0x02, event.hidData.buttons.val);
+    TEST_ASSERT_EQUAL(-100, event.hidData.x_displacement);
+    TEST_ASSERT_EQUAL(200, event.hidData.y_displacement);
+    TEST_ASSERT_EQUAL(-1, event.hidData.scroll_wheel);
+}
+
+// Back and forward (buttons 4 and 5) go into the unified report, button 6 has no place in it
+void test_back_forward_buttons() {
+    hid_device_t* mouse = hid_test_connect(6, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                           desc_gaming_mouse, sizeof(desc_gaming_mouse));
+    const uint8_t mouse_report[] = {0x01, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00};
+    hid_test_report(mouse, mouse_report, sizeof(mouse_report), 0);
+
+    hid_event_t event;
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL_HEX8(0x18, event.hidData.buttons.val);
+
+    // gamepad button 4 is the top bit after the hat, button 5 the lowest bit of the next byte
+    hid_device_t* pad = hid_test_connect(7, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_gamepad, sizeof(desc_gamepad));
+    const uint8_t pad_report[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x8F, 0x01, 0x00};
+    hid_test_report(pad, pad_report, sizeof(pad_report), 0);
+
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL_HEX8(0x18, event.hidData.buttons.val);
+}
+
+// Consumer control of a receiver is not decoded as a boot mouse report
+void test_other_report_id_no_boot_fallback() {
+    hid_device_t* dev = hid_test_connect(8, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                         desc_combo_receiver, sizeof(desc_combo_receiver));
+    TEST_ASSERT_TRUE(dev->mouse_format.is_valid);
+    TEST_ASSERT_EQUAL(2, dev->mouse_format.reportid);
+
+    const uint8_t consumer[] = {0x03, 0xE9, 0x00, 0x00};
+    hid_test_report(dev, consumer, sizeof(consumer), 0);
+
+    hid_event_t event;
+    TEST_ASSERT_FALSE(hid_test_pop(&event));
+}
+
+void test_boot_keyboard_snapshot() {
+    hid_device_t* dev = hid_test_connect(3, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD,
+                                         desc_boot_keyboard, sizeof(desc_boot_keyboard));
+    TEST_ASSERT_TRUE(dev->keyboard_format.is_valid);
+
+    const uint8_t report[] = {HID_LEFT_SHIFT, 0x00, HID_KEY_A, 0, 0, 0, 0, 0};
+    hid_test_report(dev, report, sizeof(report), 0);
+
+    // delivered by the sender task, not on the USB side
+    TEST_ASSERT_EQUAL(0, keyData_count);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(1, keyData_count);
+    TEST_ASSERT_EQUAL(hid_device_index(dev), last_keyData.source);
+    TEST_ASSERT_EQUAL_HEX8(HID_LEFT_SHIFT, last_keyData.modifier);
+    TEST_ASSERT_TRUE(hid_key_bitmap_test(&last_keyData.keys, HID_KEY_A));
+
+    // same state again: no snapshot
+    hid_test_report(dev, report, sizeof(report), 0);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(1, keyData_count);
+}
+
+// A snapshot which finds the event ring full is sent with the next report
+void test_keyboard_snapshot_ring_full() {
+    hid_device_t* dev = hid_test_connect(6, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD,
+                                         desc_boot_keyboard, sizeof(desc_boot_keyboard));
+    hid_event_t event;
+    memset(&event, 0, sizeof(event));
+    while (hid_event_ring_push(get_hid_event_ring(), &event)) {
+    }
+
+    const uint8_t release[] = {0, 0, 0, 0, 0, 0, 0, 0};
+    const uint8_t press[] = {0x00, 0x00, HID_KEY_A, 0, 0, 0, 0, 0};
+    hid_test_report(dev, press, sizeof(press), 0);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(0, keyData_count);
+
+    hid_test_report(dev, press, sizeof(press), 0);  // keyboards repeat their reports
+    hid_test_report(dev, release, sizeof(release), 0);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(2, keyData_count);
+    TEST_ASSERT_EQUAL(0, hid_key_bitmap_count(&last_keyData.keys));
+}
+
+void test_gamepad_to_mouse_motion() {
+    hid_device_t* dev = hid_test_connect(4, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_gamepad, sizeof(desc_gamepad));
+    TEST_ASSERT_TRUE(dev->joystick_format.is_valid);
+    TEST_ASSERT_TRUE(dev->joystick_format.has_hat);
+
+    // X full right, Y centered, hat released (null state), button 1 (bit 4 after the hat)
+    const uint8_t report[] = {0xFF, 0x80, 0x80, 0x80, 0x80, 0x1F, 0x00, 0x00};
+    hid_test_report(dev, report, sizeof(report), 0);
+
+    hid_event_t event;
+    TEST_ASSERT_TRUE(hid_test_pop(&event));
+    TEST_ASSERT_EQUAL_HEX8(0x01, event.hidData.buttons.val & 0x01);
+    TEST_ASSERT_INT_WITHIN(1, JOYSTICK_MAX_SPEED, event.hidData.x_displacement);
+    TEST_ASSERT_EQUAL(0, event.hidData.y_displacement);
+    TEST_ASSERT_EQUAL(0, event.hidData.scroll_wheel);
+}
+
+void test_unknown_report_id_ignored() {
+    hid_device_t* dev = hid_test_connect(5, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_joystick, sizeof(desc_joystick));
+    TEST_ASSERT_TRUE(dev->joystick_format.is_valid);
+
+    const uint8_t report[] = {0x07, 0xFF, 0xFF, 0xFF, 0xFF};
+    hid_test_report(dev, report, sizeof(report), 0);
+
+    hid_event_t event;
+    TEST_ASSERT_FALSE(hid_test_pop(&event));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_mouse_report);
+    RUN_TEST(test_receiver_mouse_12_bit_axes);
+    RUN_TEST(test_back_forward_buttons);
+    RUN_TEST(test_other_report_id_no_boot_fallback);
+    RUN_TEST(test_boot_keyboard_snapshot);
+    RUN_TEST(test_keyboard_snapshot_ring_full);
+    RUN_TEST(test_gamepad_to_mouse_motion);
+    RUN_TEST(test_unknown_report_id_ignored);
+    return UNITY_END();
+}
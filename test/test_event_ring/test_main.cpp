@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "hid_event_ring.h"
+
+/*
+ * The USB side and the sender task as two host threads on one ring. The
+ * events carry a sequence number, so the consumer sees any loss, duplicate or
+ * torn copy.
+ */
+
+#define EVENT_COUNT 200000u
+
+static hid_event_ring_t ring;
+
+static void make_event(uint32_t seq, hid_event_t* event) {
+    memset(event, 0, sizeof(*event));
+    event->arrival_us = seq;
+    event->decoded_us = ~seq;
+    event->hidData.x_displacement = (int16_t)seq;
+    event->hidData.y_displacement = (int16_t)(seq >> 16);
+    event->hidData.buttons.val = (uint8_t)(seq * 7);
+}
+
+static bool event_intact(const hid_event_t* event) {
+    hid_event_t expected;
+    make_event(event->arrival_us, &expected);
+    return memcmp(event, &expected, sizeof(expected)) == 0;
+}
+
+void setUp() { hid_event_ring_init(&ring); }
+
+void tearDown() {}
+
+void test_wraparound_single_thread() {
+    hid_event_t event;
+    uint32_t next_pop = 0;
+    for (uint32_t seq = 0; seq < 10 * HID_EVENT_RING_CAPACITY; seq++) {
+        make_event(seq, &event);
+        TEST_ASSERT_TRUE(hid_event_ring_push(&ring, &event));
+        if (seq % 3 == 2) {  // fall behind a little, then catch up
+            while (hid_event_ring_pop(&ring, &event)) {
+                TEST_ASSERT_EQUAL_UINT32(next_pop++, event.arrival_us);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, ring.overflows.load());
+    TEST_ASSERT_EQUAL_UINT32(3, ring.high_water.load());
+}
+
+void test_full_ring_counts_overflow() {
+    hid_event_t event;
+    for (uint32_t seq = 0; seq < HID_EVENT_RING_CAPACITY; seq++) {
+        make_event(seq, &event);
+        TEST_ASSERT_TRUE(hid_event_ring_push(&ring, &event));
+    }
+    make_event(99, &event);
+    TEST_ASSERT_FALSE(hid_event_ring_push(&ring, &event));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.overflows.load());
+    TEST_ASSERT_EQUAL_UINT32(HID_EVENT_RING_CAPACITY, ring.high_water.load());
+    TEST_ASSERT_EQUAL_UINT32(HID_EVENT_RING_CAPACITY, hid_event_ring_count(&ring));
+
+    // the oldest report comes out first, the dropped one not at all
+    TEST_ASSERT_TRUE(hid_event_ring_pop(&ring, &event));
+    TEST_ASSERT_EQUAL_UINT32(0, event.arrival_us);
+}
+
+// A producer which retries on overflow: every event arrives once, in order and intact
+void test_two_threads_in_order() {
+    std::atomic<uint32_t> retries(0);
+    std::thread producer([&retries]() {
+        hid_event_t event;
+        for (uint32_t seq = 0; seq < EVENT_COUNT; seq++) {
+            make_event(seq, &event);
+            while (!hid_event_ring_push(&ring, &event)) {
+                retries.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    hid_event_t event;
+    while (expected < EVENT_COUNT) {
+        if (!hid_event_ring_pop(&ring, &event)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (event.arrival_us != expected || !event_intact(&event)) errors++;
+        expected = event.arrival_us + 1;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+    TEST_ASSERT_FALSE(hid_event_ring_pop(&ring, &event));
+    TEST_ASSERT_EQUAL_UINT32(retries.load(), ring.overflows.load());
+    TEST_ASSERT_TRUE(ring.high_water.load() <= HID_EVENT_RING_CAPACITY);
+}
+
+// A producer which drops on overflow, as the USB side does: what arrives is in
+// order and intact, and every missing event is counted as an overflow
+void test_two_threads_drop_counted() {
+    std::atomic<bool> done(false);
+    std::thread producer([&done]() {
+        hid_event_t event;
+        for (uint32_t seq = 0; seq < EVENT_COUNT; seq++) {
+            make_event(seq, &event);
+            hid_event_ring_push(&ring, &event);
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    int64_t last = -1;
+    hid_event_t event;
+    while (true) {
+        bool finished = done.load(std::memory_order_acquire);
+        if (hid_event_ring_pop(&ring, &event)) {
+            if ((int64_t)event.arrival_us <= last || !event_intact(&event)) errors++;
+            last = event.arrival_us;
+            received++;
+        } else if (finished) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+    TEST_ASSERT_EQUAL_UINT32(EVENT_COUNT, received + ring.overflows.load());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_wraparound_single_thread);
+    RUN_TEST(test_full_ring_counts_overflow);
+    RUN_TEST(test_two_threads_in_order);
+    RUN_TEST(test_two_threads_drop_counted);
+    return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "usb_hid_extract.h"
+#include "usb_hid_report_desc.h"
+#include "usb_hid_mouse.h"
+#include "usb_hid_joystick.h"
+#include "hid_test_descriptors.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Extraction plans against hid_extract_int(): same values for any field
+ * layout, and ns/report of both for the mouse and gamepad formats.
+ */
+
+#define BENCH_ITERATIONS 1000000
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+void setUp() { random_state = 1; }
+
+void tearDown() {}
+
+// Fields at every offset and size, alone and in groups, on random report data
+void test_plan_matches_extract_int() {
+    uint8_t data[32 + HID_PLAN_READ_PAD];
+    for (int round = 0; round < 20000; round++) {
+        for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)random_next();
+
+        hid_extract_plan_t plan;
+        int offsets[HID_PLAN_MAX_FIELDS], sizes[HID_PLAN_MAX_FIELDS];
+        bool sign[HID_PLAN_MAX_FIELDS];
+        int count = 1 + (int)(random_next() % HID_PLAN_MAX_FIELDS);
+        int offset = (int)(random_next() % 16);
+        hid_plan_init(&plan);
+        for (int f = 0; f < count; f++) {
+            sizes[f] = 1 + (int)(random_next() % 32);
+            sign[f] = (random_next() & 1) != 0;
+            offsets[f] = offset;
+            offset += sizes[f] + (int)(random_next() % 3);  // adjacent or with padding
+            hid_plan_add_field(&plan, offsets[f], sizes[f], sign[f]);
+        }
+        hid_plan_compile(&plan);
+
+        int length = 32;
+        int32_t values[HID_PLAN_MAX_FIELDS] = {0};
+        TEST_ASSERT_TRUE(hid_plan_run(&plan, data, length, values));
+        for (int f = 0; f < count; f++) {
+            int32_t expected = hid_extract_int(data, length, offsets[f], sizes[f], sign[f]);
+            if (expected != values[f]) {
+                printf("offset %d bits %d signed %d: %ld != %ld\n", offsets[f], sizes[f], sign[f],
+                       (long)values[f], (long)expected);
+            }
+            TEST_ASSERT_EQUAL_INT32(expected, values[f]);
+        }
+    }
+}
+
+void test_plan_rejects_short_report() {
+    hid_extract_plan_t plan;
+    hid_plan_init(&plan);
+    hid_plan_add_field(&plan, 8, 8, false);
+    hid_plan_add_field(&plan, 16, 16, true);
+    hid_plan_compile(&plan);
+
+    // the 16 bit field ends with byte 3
+    uint8_t data[4 + HID_PLAN_READ_PAD] = {0};
+    int32_t values[HID_PLAN_MAX_FIELDS];
+    TEST_ASSERT_TRUE(hid_plan_run(&plan, data, 4, values));
+    TEST_ASSERT_FALSE(hid_plan_run(&plan, data, 3, values));
+}
+
+// The fields of a mouse format read one by one, as before the plans
+static void extract_mouse_fields(const mouse_report_format_t* fmt, const uint8_t* data,
+                                 int length, int32_t* values) {
+    values[0] = hid_extract_int(data, length, fmt->buttons_bit_offset,
+                                (fmt->buttons_bits > 8) ? 8 : fmt->buttons_bits, false);
+    values[1] = hid_extract_int(data, length, fmt->x_bit_offset, fmt->x_bits, fmt->x_signed);
+    values[2] = hid_extract_int(data, length, fmt->y_bit_offset, fmt->y_bits, fmt->y_signed);
+    if (fmt->wheel_bits > 0) {
+        values[3] = hid_extract_int(data, length, fmt->wheel_bit_offset, fmt->wheel_bits,
+                                    fmt->wheel_signed);
+    }
+}
+
+static void bench_mouse_format(const char* name, const uint8_t* desc, size_t desc_len,
+                               const uint8_t* report, int length) {
+    static hid_report_map_t map;
+    mouse_report_format_t fmt;
+    hid_parse_report_descriptor(desc, desc_len, &map);
+    TEST_ASSERT_TRUE(parse_mouse_report_map(&map, &fmt));
+
+    uint8_t data[64 + HID_PLAN_READ_PAD] = {0};
+    memcpy(data, report, length);
+    int32_t generic[HID_PLAN_MAX_FIELDS] = {0}, planned[HID_PLAN_MAX_FIELDS] = {0};
+    extract_mouse_fields(&fmt, data, length, generic);
+    hid_plan_run(&fmt.plan, data, length, planned);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(generic, planned, 4);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s hid_extract_int", name);
+    bench_result_t before = bench_run(label, BENCH_ITERATIONS, [&]() {
+        extract_mouse_fields(&fmt, data, length, generic);
+        bench_consume(generic[1]);
+    });
+    snprintf(label, sizeof(label), "%s plan", name);
+    bench_result_t after = bench_run(label, BENCH_ITERATIONS, [&]() {
+        hid_plan_run(&fmt.plan, data, length, planned);
+        bench_consume(planned[1]);
+    });
+    printf("%s: plan %.2fx faster\n", name, before.ns_per_op / after.ns_per_op);
+    TEST_ASSERT_EQUAL(0, after.allocs_per_op);
+}
+
+void bench_mouse_formats() {
+    const uint8_t boot[] = {0x01, 0x05, 0xFD};
+    const uint8_t wheel[] = {0x01, 0x05, 0xFD, 0x01};
+    const uint8_t receiver[] = {0x02, 0x01, 0x00, 0x9C, 0x8F, 0x0C, 0xFF, 0x00};
+    const uint8_t gaming[] = {0x01, 0x01, 0x34, 0x12, 0xCC, 0xED, 0x01};
+    bench_mouse_format("boot mouse", desc_boot_mouse, sizeof(desc_boot_mouse), boot,
+                       sizeof(boot));
+    bench_mouse_format("wheel mouse", desc_wheel_mouse, sizeof(desc_wheel_mouse), wheel,
+                       sizeof(wheel));
+    bench_mouse_format("12 bit receiver", desc_receiver_mouse, sizeof(desc_receiver_mouse),
+                       receiver, sizeof(receiver));
+    bench_mouse_format("16 bit mouse", desc_gaming_mouse, sizeof(desc_gaming_mouse), gaming,
+                       sizeof(gaming));
+}
+
+void bench_gamepad_format() {
+    static hid_report_map_t map;
+    joystick_report_format_t fmt;
+    hid_parse_report_descriptor(desc_gamepad, sizeof(desc_gamepad), &map);
+    TEST_ASSERT_TRUE(parse_joystick_report_map(&map, &fmt));
+
+    uint8_t data[8 + HID_PLAN_READ_PAD] = {0xFF, 0x10, 0x80, 0x80, 0x80, 0x1F, 0x00, 0x00};
+    int length = 8;
+    int32_t generic[HID_PLAN_MAX_FIELDS] = {0}, planned[HID_PLAN_MAX_FIELDS] = {0};
+
+    bench_result_t before = bench_run("gamepad hid_extract_int", BENCH_ITERATIONS, [&]() {
+        generic[0] = hid_extract_int(data, length, fmt.buttons_bit_offset,
+                                     (fmt.buttons_bits > 8) ? 8 : fmt.buttons_bits, false);
+        generic[1] = hid_extract_int(data, length, fmt.x_bit_offset, fmt.x_bits, fmt.x_signed);
+        generic[2] = hid_extract_int(data, length, fmt.y_bit_offset, fmt.y_bits, fmt.y_signed);
+        generic[3] = hid_extract_int(data, length, fmt.hat_bit_offset, fmt.hat_bits, false);
+        bench_consume(generic[1]);
+    });
+    bench_result_t after = bench_run("gamepad plan", BENCH_ITERATIONS, [&]() {
+        hid_plan_run(&fmt.plan, data, length, planned);
+        bench_consume(planned[1]);
+    });
+    printf("gamepad: plan %.2fx faster\n", before.ns_per_op / after.ns_per_op);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(generic, planned, JOYSTICK_PLAN_FIELDS);
+    TEST_ASSERT_EQUAL(0, after.allocs_per_op);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_plan_matches_extract_int);
+    RUN_TEST(test_plan_rejects_short_report);
+    RUN_TEST(bench_mouse_formats);
+    RUN_TEST(bench_gamepad_format);
+    return UNITY_END();
+}
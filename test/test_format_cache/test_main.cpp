@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <string.h>
+#include <thread>
+#include <nvs.h>
+#include "usb_hid_format_cache.h"
+#include "usb_hid_report_desc.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Format cache on the NVS backend, with the in-memory NVS of the stubs
+ * counting flash writes.
+ */
+
+static hid_host_dev_params_t mouse_params;
+
+void setUp() {
+    native_nvs_erase_all();
+    memset(get_hid_format_cache_stats(), 0, sizeof(hid_format_cache_stats_t));
+    register_hid_format_cache_storage(get_hid_format_cache_nvs_storage());
+    memset(&mouse_params, 0, sizeof(mouse_params));
+    mouse_params.sub_class = HID_SUBCLASS_BOOT_INTERFACE;
+    mouse_params.proto = HID_PROTOCOL_MOUSE;
+}
+
+void tearDown() { register_hid_format_cache_storage(NULL); }
+
+// Cache entry of a mouse descriptor, as hid_device_parse_formats() fills it
+static void make_entry(hid_format_cache_entry_t* entry, const uint8_t* desc, size_t len,
+                       uint16_t vid, uint16_t pid) {
+    static hid_report_map_t map;
+    memset(entry, 0, sizeof(*entry));
+    hid_format_cache_make_key(&entry->key, desc, len, &mouse_params, vid, pid);
+    hid_parse_report_descriptor(desc, len, &map);
+    parse_mouse_report_map(&map, &entry->mouse_format);
+}
+
+void test_hit_after_store() {
+    hid_format_cache_entry_t entry, found;
+    make_entry(&entry, desc_gaming_mouse, sizeof(desc_gaming_mouse), 0x046D, 0xC08B);
+
+    TEST_ASSERT_FALSE(hid_format_cache_lookup(&entry.key, &found));
+    hid_format_cache_store(&entry);
+    TEST_ASSERT_TRUE(hid_format_cache_lookup(&entry.key, &found));
+    TEST_ASSERT_EQUAL_MEMORY(&entry.mouse_format, &found.mouse_format,
+                             sizeof(entry.mouse_format));
+
+    hid_format_cache_stats_t* stats = get_hid_format_cache_stats();
+    TEST_ASSERT_EQUAL(1, stats->hits);
+    TEST_ASSERT_EQUAL(1, stats->misses);
+    TEST_ASSERT_EQUAL(1, stats->stores);
+}
+
+// The same descriptor on another device is a different entry
+void test_key_includes_vid_pid() {
+    hid_format_cache_entry_t entry, found;
+    make_entry(&entry, desc_boot_mouse, sizeof(desc_boot_mouse), 0x1234, 0x0001);
+    hid_format_cache_store(&entry);
+
+    hid_format_cache_key_t other;
+    hid_format_cache_make_key(&other, desc_boot_mouse, sizeof(desc_boot_mouse), &mouse_params,
+                              0x1234, 0x0002);
+    TEST_ASSERT_FALSE(hid_format_cache_lookup(&other, &found));
+    TEST_ASSERT_TRUE(hid_format_cache_lookup(&entry.key, &found));
+}
+
+// Reconnecting a known device does not write to flash
+void test_identical_store_skipped() {
+    hid_format_cache_entry_t entry;
+    make_entry(&entry, desc_receiver_mouse, sizeof(desc_receiver_mouse), 0x046D, 0xC52B);
+
+    hid_format_cache_store(&entry);
+    uint32_t writes = native_nvs()->writes;
+    hid_format_cache_store(&entry);
+    hid_format_cache_store(&entry);
+
+    TEST_ASSERT_EQUAL_UINT32(writes, native_nvs()->writes);
+    TEST_ASSERT_EQUAL(1, get_hid_format_cache_stats()->stores);
+    TEST_ASSERT_EQUAL(2, get_hid_format_cache_stats()->unchanged);
+}
+
+// Devices which keep evicting each other stop writing after the limit
+void test_store_limit() {
+    hid_format_cache_entry_t entry;
+    for (uint16_t pid = 1; pid <= 2 * HID_FORMAT_CACHE_MAX_STORES + 3; pid++) {
+        make_entry(&entry, desc_wheel_mouse, sizeof(desc_wheel_mouse), 0x1234, pid);
+        hid_format_cache_store(&entry);
+    }
+    hid_format_cache_stats_t* stats = get_hid_format_cache_stats();
+    TEST_ASSERT_EQUAL(HID_FORMAT_CACHE_MAX_STORES, stats->stores);
+    TEST_ASSERT_EQUAL(HID_FORMAT_CACHE_MAX_STORES + 3, stats->limited);
+    TEST_ASSERT_EQUAL_UINT32(HID_FORMAT_CACHE_MAX_STORES, native_nvs()->commits);
+}
+
+// Entries of an older layout are not used
+void test_old_version_ignored() {
+    hid_format_cache_entry_t entry, found;
+    make_entry(&entry, desc_gaming_mouse, sizeof(desc_gaming_mouse), 0x046D, 0xC08B);
+    hid_format_cache_store(&entry);
+    TEST_ASSERT_TRUE(hid_format_cache_lookup(&entry.key, &found));
+
+    // rewrite the slot with the previous version number
+    entry.version = HID_FORMAT_CACHE_VERSION - 1;
+    for (int slot = 0; slot < HID_FORMAT_CACHE_SLOTS; slot++) {
+        if (get_hid_format_cache_nvs_storage()->load(slot, &found, sizeof(found)) &&
+            memcmp(&found.key, &entry.key, sizeof(entry.key)) == 0) {
+            get_hid_format_cache_nvs_storage()->store(slot, &entry, sizeof(entry));
+        }
+    }
+    TEST_ASSERT_FALSE(hid_format_cache_lookup(&entry.key, &found));
+}
+
+// Lookups and stores from two tasks keep the counters consistent
+void test_concurrent_lookup_store() {
+    const int rounds = 2000;
+    hid_format_cache_entry_t a, b;
+    make_entry(&a, desc_gaming_mouse, sizeof(desc_gaming_mouse), 0x046D, 0xC08B);
+    make_entry(&b, desc_receiver_mouse, sizeof(desc_receiver_mouse), 0x046D, 0xC52B);
+    hid_format_cache_store(&a);
+    hid_format_cache_store(&b);
+    memset(get_hid_format_cache_stats(), 0, sizeof(hid_format_cache_stats_t));
+
+    std::thread other([&]() {
+        hid_format_cache_entry_t found;
+        for (int i = 0; i < rounds; i++) {
+            hid_format_cache_lookup(&b.key, &found);
+            hid_format_cache_store(&b);
+        }
+    });
+    hid_format_cache_entry_t found;
+    for (int i = 0; i < rounds; i++) {
+        hid_format_cache_lookup(&a.key, &found);
+        hid_format_cache_store(&a);
+    }
+    other.join();
+
+    hid_format_cache_stats_t* stats = get_hid_format_cache_stats();
+    TEST_ASSERT_EQUAL(2 * rounds, stats->hits + stats->misses);
+    TEST_ASSERT_EQUAL(2 * rounds, stats->unchanged + stats->stores + stats->limited);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_hit_after_store);
+    RUN_TEST(test_key_includes_vid_pid);
+    RUN_TEST(test_identical_store_skipped);
+    RUN_TEST(test_store_limit);
+    RUN_TEST(test_old_version_ignored);
+    RUN_TEST(test_concurrent_lookup_store);
+    return UNITY_END();
+}
@@ -0,0 +1,254 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hid_joystick_curve.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Fixed-point joystick curves: the lookup table against the same curves in
+ * float, sub-pixel motion against the float divide and truncation it
+ * replaced, radial deadzones, and the cost per report of both paths.
+ */
+
+#define MAX_SPEED 10
+#define DEADZONE_PERMILLE 125
+#define ONE_PX (1 << JOYSTICK_CURVE_FRAC_BITS)
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+void setUp() { random_state = 1; }
+
+void tearDown() {}
+
+static joystick_curve_config_t make_config(joystick_curve_type_t type, uint16_t deadzone,
+                                           uint8_t exponent_x10) {
+    joystick_curve_config_t cfg = {};
+    cfg.type = type;
+    cfg.max_speed = MAX_SPEED;
+    cfg.deadzone_permille = deadzone;
+    cfg.exponent_x10 = exponent_x10;
+    return cfg;
+}
+
+// The curve evaluated in double at the deflection itself, in 1/256 px per report
+static double reference_speed(const joystick_curve_config_t* cfg, uint32_t mag) {
+    double m = (double)mag / JOYSTICK_CURVE_Q15_MAX;
+    double dz = cfg->deadzone_permille / 1000.0;
+    double t = (m <= dz) ? 0.0 : (m - dz) / (1.0 - dz);
+    if (t > 1.0) t = 1.0;
+    double f;
+    switch (cfg->type) {
+        case JOYSTICK_CURVE_POWER:
+            f = pow(t, cfg->exponent_x10 / 10.0);
+            break;
+        case JOYSTICK_CURVE_SCURVE:
+            f = t * t * (3.0 - 2.0 * t);
+            break;
+        default:
+            f = t;
+            break;
+    }
+    return f * cfg->max_speed * ONE_PX;
+}
+
+// Joystick to mouse conversion before the lookup table, one axis
+static int16_t float_path_axis(int32_t v, int bits) {
+    int32_t max_val = (1 << (bits - 1)) - 1;
+    int32_t deadzone = max_val / 8;  // ~12.5% deadzone
+    if (abs(v) <= deadzone) return 0;
+    return (int16_t)((float)v / max_val * MAX_SPEED);
+}
+
+// Every magnitude in Q15 is within 2/256 px of the float curve; the deadzone
+// edges are on table entries, so only the interpolation error is left
+void test_lut_matches_float_curve() {
+    const joystick_curve_config_t configs[] = {
+        make_config(JOYSTICK_CURVE_LINEAR, DEADZONE_PERMILLE, 0),
+        make_config(JOYSTICK_CURVE_LINEAR, 0, 0),
+        make_config(JOYSTICK_CURVE_POWER, DEADZONE_PERMILLE, 20),
+        make_config(JOYSTICK_CURVE_POWER, 250, 30),
+        make_config(JOYSTICK_CURVE_SCURVE, DEADZONE_PERMILLE, 0),
+    };
+    for (const joystick_curve_config_t& cfg : configs) {
+        joystick_curve_t curve;
+        joystick_curve_build(&curve, &cfg);
+        double max_error = 0;
+        for (uint32_t mag = 0; mag <= JOYSTICK_CURVE_Q15_MAX; mag++) {
+            double error = fabs(joystick_curve_lookup(&curve, mag) - reference_speed(&cfg, mag));
+            if (error > max_error) max_error = error;
+        }
+        printf("curve type %d exponent %d deadzone %d: max error %.2f/256 px\n", cfg.type,
+               cfg.exponent_x10, cfg.deadzone_permille, max_error);
+        TEST_ASSERT_TRUE(max_error <= 2.0);
+        TEST_ASSERT_EQUAL(0, joystick_curve_lookup(&curve, 0));
+        TEST_ASSERT_EQUAL(MAX_SPEED * ONE_PX, joystick_curve_lookup(&curve, JOYSTICK_CURVE_Q15_MAX));
+    }
+}
+
+// Over many reports the pixels add up to the float curve within a pixel,
+// where the float path truncated every report: up to half the motion lost
+void test_slow_deflection_accumulates() {
+    const int reports = 1000;
+    joystick_curve_config_t cfg = make_config(JOYSTICK_CURVE_LINEAR, DEADZONE_PERMILLE, 0);
+    joystick_curve_t curve;
+    joystick_curve_build(&curve, &cfg);
+
+    double max_loss_before = 0;
+    for (int32_t v = -127; v <= 127; v++) {
+        int32_t q = joystick_curve_normalize(v, 8);
+        joystick_motion_t motion = {};
+        int32_t total = 0;
+        for (int n = 0; n < reports; n++) {
+            int32_t sx, sy;
+            int16_t dx, dy;
+            joystick_curve_apply(&curve, q, 0, &sx, &sy);
+            joystick_motion_step(&motion, sx, sy, &dx, &dy);
+            TEST_ASSERT_EQUAL(0, dy);
+            total += dx;
+        }
+        double expected = reference_speed(&cfg, (uint32_t)abs(q)) * reports / ONE_PX;
+        TEST_ASSERT_TRUE(fabs(fabs((double)total) - expected) <= 1.0 + 2.0 * reports / ONE_PX);
+        TEST_ASSERT_TRUE(total == 0 || (total < 0) == (v < 0));
+
+        if (abs(v) > 127 / 8) {
+            double exact = fabs((double)v / 127 * MAX_SPEED);
+            double loss = (exact - abs(float_path_axis(v, 8))) / exact;
+            if (loss > max_loss_before) max_loss_before = loss;
+        }
+    }
+    printf("float path: up to %.0f%% of the motion truncated per report\n", max_loss_before * 100);
+    TEST_ASSERT_TRUE(max_loss_before > 0.4);
+}
+
+// Full deflection moves exactly as fast as before, on 8 and 16 bit axes
+void test_full_deflection_matches_float_path() {
+    joystick_curve_config_t cfg = make_config(JOYSTICK_CURVE_LINEAR, DEADZONE_PERMILLE, 0);
+    joystick_curve_t curve;
+    joystick_curve_build(&curve, &cfg);
+    const int bits[] = {8, 10, 16};
+    for (int b : bits) {
+        int32_t max_val = (1 << (b - 1)) - 1;
+        joystick_motion_t motion = {};
+        int32_t sx, sy;
+        int16_t dx, dy;
+        joystick_curve_apply(&curve, joystick_curve_normalize(max_val, b),
+                             joystick_curve_normalize(-max_val, b), &sx, &sy);
+        joystick_motion_step(&motion, sx, sy, &dx, &dy);
+        TEST_ASSERT_EQUAL(float_path_axis(max_val, b), dx);
+        TEST_ASSERT_EQUAL(float_path_axis(-max_val, b), dy);
+    }
+}
+
+// Radial: a diagonal is as fast as a straight deflection of the same length,
+// and nothing moves inside the circle; axial: each axis has its own deadzone
+void test_radial_deadzone() {
+    joystick_curve_config_t cfg = make_config(JOYSTICK_CURVE_LINEAR, 250, 0);
+    cfg.radial_deadzone = true;
+    joystick_curve_t radial, axial;
+    joystick_curve_build(&radial, &cfg);
+    cfg.radial_deadzone = false;
+    joystick_curve_build(&axial, &cfg);
+
+    int32_t sx, sy, straight;
+    const int32_t len = 24000;
+    const int32_t d = (int32_t)(len / sqrt(2.0));
+    joystick_curve_apply(&radial, len, 0, &straight, &sy);
+    TEST_ASSERT_EQUAL(0, sy);
+    joystick_curve_apply(&radial, d, -d, &sx, &sy);
+    double diagonal = sqrt((double)sx * sx + (double)sy * sy);
+    TEST_ASSERT_TRUE(fabs(diagonal - straight) <= straight / 100.0 + 2);
+    TEST_ASSERT_EQUAL(sx, -sy);
+
+    // 20% each way is 28% long, outside the 25% circle; 10% each way is inside
+    const int32_t small = JOYSTICK_CURVE_Q15_MAX / 5;
+    joystick_curve_apply(&radial, small, small, &sx, &sy);
+    TEST_ASSERT_TRUE(sx > 0 && sy > 0);
+    joystick_curve_apply(&radial, small / 2, small / 2, &sx, &sy);
+    TEST_ASSERT_EQUAL(0, sx);
+    TEST_ASSERT_EQUAL(0, sy);
+
+    // axial: a large x does not let a small y through
+    joystick_curve_apply(&axial, JOYSTICK_CURVE_Q15_MAX, small, &sx, &sy);
+    TEST_ASSERT_EQUAL(MAX_SPEED * ONE_PX, sx);
+    TEST_ASSERT_EQUAL(0, sy);
+}
+
+// Both directions are symmetric, and a released stick drops the fraction
+void test_motion_symmetric_and_released() {
+    joystick_motion_t pos = {}, neg = {};
+    int16_t dx, dy, ndx, ndy;
+    for (int n = 0; n < 50; n++) {
+        int32_t speed = (int32_t)(random_next() % (3 * ONE_PX));
+        joystick_motion_step(&pos, speed, speed / 2, &dx, &dy);
+        joystick_motion_step(&neg, -speed, -speed / 2, &ndx, &ndy);
+        TEST_ASSERT_EQUAL(-dx, ndx);
+        TEST_ASSERT_EQUAL(-dy, ndy);
+    }
+    joystick_motion_step(&pos, ONE_PX - 1, 0, &dx, &dy);
+    joystick_motion_step(&pos, 0, 0, &dx, &dy);
+    TEST_ASSERT_EQUAL(0, dx);
+    TEST_ASSERT_EQUAL(0, pos.residual_x);
+    TEST_ASSERT_EQUAL(0, pos.residual_y);
+}
+
+// One report's worth of conversion, on 16 bit sticks moving at random
+void bench_curve_vs_float_path() {
+    const int samples = 256;
+    int32_t xs[samples], ys[samples];
+    for (int i = 0; i < samples; i++) {
+        xs[i] = (int32_t)(random_next() % 65535) - 32767;
+        ys[i] = (int32_t)(random_next() % 65535) - 32767;
+    }
+    joystick_curve_config_t cfg = make_config(JOYSTICK_CURVE_SCURVE, DEADZONE_PERMILLE, 0);
+    joystick_curve_t curve;
+    joystick_curve_build(&curve, &cfg);
+    joystick_motion_t motion = {};
+    int i = 0;
+
+    bench_result_t before = bench_run("float divide and truncate", 10000000, [&]() {
+        int n = i++ & (samples - 1);
+        bench_consume(float_path_axis(xs[n], 16) + float_path_axis(ys[n], 16));
+    });
+    bench_result_t axial = bench_run("curve lookup axial + residual", 10000000, [&]() {
+        int n = i++ & (samples - 1);
+        int32_t sx, sy;
+        int16_t dx, dy;
+        joystick_curve_apply(&curve, joystick_curve_normalize(xs[n], 16),
+                             joystick_curve_normalize(ys[n], 16), &sx, &sy);
+        joystick_motion_step(&motion, sx, sy, &dx, &dy);
+        bench_consume(dx + dy);
+    });
+    cfg.radial_deadzone = true;
+    joystick_curve_build(&curve, &cfg);
+    bench_result_t radial = bench_run("curve lookup radial + residual", 10000000, [&]() {
+        int n = i++ & (samples - 1);
+        int32_t sx, sy;
+        int16_t dx, dy;
+        joystick_curve_apply(&curve, joystick_curve_normalize(xs[n], 16),
+                             joystick_curve_normalize(ys[n], 16), &sx, &sy);
+        joystick_motion_step(&motion, sx, sy, &dx, &dy);
+        bench_consume(dx + dy);
+    });
+    printf("curve vs float path: axial %.2fx, radial %.2fx the time\n",
+           axial.ns_per_op / before.ns_per_op, radial.ns_per_op / before.ns_per_op);
+    TEST_ASSERT_EQUAL(0, axial.allocs_per_op);
+    TEST_ASSERT_EQUAL(0, radial.allocs_per_op);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lut_matches_float_curve);
+    RUN_TEST(test_slow_deflection_accumulates);
+    RUN_TEST(test_full_deflection_matches_float_path);
+    RUN_TEST(test_radial_deadzone);
+    RUN_TEST(test_motion_symmetric_and_released);
+    RUN_TEST(bench_curve_vs_float_path);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "hid_key_bitmap.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Key change detection: the bitmap XOR diff against the nested key array
+ * scans it replaced, on rollover traces where keys are pressed and released
+ * one at a time while up to 6 (boot) or 20 (NKRO) keys are held.
+ */
+
+#define TRACE_LENGTH 256
+#define MAX_HELD 20
+
+typedef struct {
+    uint8_t keys[MAX_HELD];  // key array of the report, 0 in unused slots
+} trace_report_t;
+
+static trace_report_t trace[TRACE_LENGTH];
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+void setUp() { random_state = 1; }
+
+void tearDown() {}
+
+// Reports of a typist rolling over 'held' keys: every report releases one
+// held key or presses a new one, in a random slot
+static void make_rollover_trace(int held) {
+    trace_report_t report;
+    memset(&report, 0, sizeof(report));
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        int slot = (int)(random_next() % held);
+        if (report.keys[slot] != 0) {
+            report.keys[slot] = 0;
+        } else {
+            uint8_t key;
+            bool used;
+            do {
+                key = (uint8_t)(0x04 + random_next() % (0xE0 - 0x04));
+                used = false;
+                for (int i = 0; i < held; i++) used |= (report.keys[i] == key);
+            } while (used);
+            report.keys[slot] = key;
+        }
+        trace[n] = report;
+    }
+}
+
+static bool key_found(const uint8_t* keys, uint8_t key, int count) {
+    for (int i = 0; i < count; i++) {
+        if (keys[i] == key) return true;
+    }
+    return false;
+}
+
+// Change detection as before the bitmaps: every key of one array looked up in the other
+static bool scan_diff(const uint8_t* prev, const uint8_t* cur, int count,
+                      hid_key_bitmap_t* pressed, hid_key_bitmap_t* released) {
+    bool changed = false;
+    hid_key_bitmap_clear(pressed);
+    hid_key_bitmap_clear(released);
+    for (int i = 0; i < count; i++) {
+        if (prev[i] != 0 && !key_found(cur, prev[i], count)) {
+            hid_key_bitmap_set(released, prev[i]);
+            changed = true;
+        }
+        if (cur[i] != 0 && !key_found(prev, cur[i], count)) {
+            hid_key_bitmap_set(pressed, cur[i]);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static void assert_same_diff(int held) {
+    make_rollover_trace(held);
+    hid_key_bitmap_t prev, cur;
+    hid_key_bitmap_clear(&prev);
+    for (int n = 1; n < TRACE_LENGTH; n++) {
+        hid_key_bitmap_t pressed, released, scan_pressed, scan_released;
+        hid_key_bitmap_from_keys(&prev, trace[n - 1].keys, held);
+        hid_key_bitmap_from_keys(&cur, trace[n].keys, held);
+        bool changed = hid_key_bitmap_diff(&prev, &cur, &pressed, &released);
+        bool scan_changed =
+            scan_diff(trace[n - 1].keys, trace[n].keys, held, &scan_pressed, &scan_released);
+        TEST_ASSERT_EQUAL(scan_changed, changed);
+        TEST_ASSERT_EQUAL_MEMORY(&scan_pressed, &pressed, sizeof(pressed));
+        TEST_ASSERT_EQUAL_MEMORY(&scan_released, &released, sizeof(released));
+        TEST_ASSERT_EQUAL(1, hid_key_bitmap_count(&pressed) + hid_key_bitmap_count(&released));
+    }
+}
+
+void test_diff_matches_scan_boot() { assert_same_diff(6); }
+
+void test_diff_matches_scan_nkro() { assert_same_diff(MAX_HELD); }
+
+// Whole report path of the change detection: the key events are iterated as
+// the keyboard decoder does, so both variants do the same work per report
+static void bench_trace(int held) {
+    make_rollover_trace(held);
+    int n = 0, events = 0;
+    char label[64];
+
+    snprintf(label, sizeof(label), "%d keys nested scan", held);
+    bench_result_t before = bench_run(label, TRACE_LENGTH * 4000, [&]() {
+        hid_key_bitmap_t pressed, released;
+        int prev = n;
+        n = (n + 1) % TRACE_LENGTH;
+        if (scan_diff(trace[prev].keys, trace[n].keys, held, &pressed, &released)) {
+            for (int k = hid_key_bitmap_next(&pressed, 0); k >= 0;
+                 k = hid_key_bitmap_next(&pressed, k + 1)) {
+                events++;
+            }
+            for (int k = hid_key_bitmap_next(&released, 0); k >= 0;
+                 k = hid_key_bitmap_next(&released, k + 1)) {
+                events++;
+            }
+        }
+    });
+
+    hid_key_bitmap_t prev_keys;
+    hid_key_bitmap_from_keys(&prev_keys, trace[n].keys, held);
+    snprintf(label, sizeof(label), "%d keys bitmap diff", held);
+    bench_result_t after = bench_run(label, TRACE_LENGTH * 4000, [&]() {
+        hid_key_bitmap_t cur, pressed, released;
+        n = (n + 1) % TRACE_LENGTH;
+        hid_key_bitmap_from_keys(&cur, trace[n].keys, held);
+        if (hid_key_bitmap_diff(&prev_keys, &cur, &pressed, &released)) {
+            for (int k = hid_key_bitmap_next(&pressed, 0); k >= 0;
+                 k = hid_key_bitmap_next(&pressed, k + 1)) {
+                events++;
+            }
+            for (int k = hid_key_bitmap_next(&released, 0); k >= 0;
+                 k = hid_key_bitmap_next(&released, k + 1)) {
+                events++;
+            }
+        }
+        prev_keys = cur;
+    });
+    bench_consume(events);
+    printf("%d held keys: bitmap diff %.2fx faster\n", held, before.ns_per_op / after.ns_per_op);
+    TEST_ASSERT_EQUAL(0, after.allocs_per_op);
+}
+
+void bench_rollover_traces() {
+    bench_trace(6);
+    bench_trace(MAX_HELD);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_diff_matches_scan_boot);
+    RUN_TEST(test_diff_matches_scan_nkro);
+    RUN_TEST(bench_rollover_traces);
+    return UNITY_END();
+}
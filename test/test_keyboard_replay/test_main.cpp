@@ -0,0 +1,164 @@
+#include <unity.h>
+#include <string.h>
+#include "usb_hid_host.h"
+#include "ble_keyboard_report.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * NKRO keyboard reports replayed through the decoder, the sender task and the
+ * 6KRO BLE keyboard report, as update_keyData() in src/main.cpp forwards them.
+ * With more than 20 keys held, every key press has to reach the BLE host.
+ */
+
+#define REPLAY_KEYS 24
+#define NKRO_REPORT_LEN 17  // report ID, modifiers, 120 key bits
+#define MAX_BLE_REPORTS 256
+
+static ble_keyboard_report_t ble_reports[MAX_BLE_REPORTS];
+static int ble_report_count;
+static int credits;
+
+static bool record_report(const ble_keyboard_report_t* report) {
+    TEST_ASSERT_TRUE(ble_report_count < MAX_BLE_REPORTS);
+    ble_reports[ble_report_count++] = *report;
+    return true;
+}
+
+static int available_credits() { return credits; }
+
+static void keyData_received(const unified_keyData_t* keyData) {
+    ble_keyboard_report_submit(keyData);
+    ble_keyboard_report_flush();
+}
+
+static void hidData_received(unified_hidData_t* hidData) {}
+
+void setUp() {
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    register_ble_keyboard_report_transport(record_report);
+    register_ble_keyboard_report_credits(available_credits);
+    register_hid_sender_flush_callback(ble_keyboard_report_flush);
+    ble_keyboard_report_reset();
+    memset(get_ble_keyboard_report_stats(), 0, sizeof(ble_keyboard_report_stats_t));
+    ble_report_count = 0;
+    credits = 1;
+}
+
+void tearDown() {
+    register_hid_sender_flush_callback(NULL);
+    register_ble_keyboard_report_credits(NULL);
+    hid_test_reset();
+}
+
+static hid_device_t* connect_nkro_keyboard() {
+    hid_device_t* dev = hid_test_connect(1, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_nkro_keyboard, sizeof(desc_nkro_keyboard));
+    TEST_ASSERT_TRUE(dev->keyboard_format.is_valid);
+    return dev;
+}
+
+// NKRO report with the keys of 'keys' pressed
+static void send_nkro_report(hid_device_t* dev, uint8_t modifier, const hid_key_bitmap_t* keys) {
+    uint8_t report[NKRO_REPORT_LEN] = {0x01, modifier};
+    for (int key = hid_key_bitmap_next(keys, 0); key >= 0; key = hid_key_bitmap_next(keys, key + 1)) {
+        report[2 + key / 8] |= (uint8_t)(1 << (key % 8));
+    }
+    hid_test_report(dev, report, sizeof(report), 0);
+    hid_sender_run();
+}
+
+// Every key of 'keys' was in a BLE report, no report had a key twice, and the
+// last report has nothing pressed
+static void assert_all_keys_reported(const hid_key_bitmap_t* keys) {
+    hid_key_bitmap_t reported;
+    hid_key_bitmap_clear(&reported);
+    for (int n = 0; n < ble_report_count; n++) {
+        hid_key_bitmap_t in_report;
+        hid_key_bitmap_clear(&in_report);
+        for (int i = 0; i < BLE_KEYBOARD_REPORT_KEYS; i++) {
+            uint8_t key = ble_reports[n].keys[i];
+            if (key == 0) continue;
+            TEST_ASSERT_FALSE(hid_key_bitmap_test(&in_report, key));
+            hid_key_bitmap_set(&in_report, key);
+            hid_key_bitmap_set(&reported, key);
+        }
+    }
+    TEST_ASSERT_EQUAL_MEMORY(keys, &reported, sizeof(reported));
+
+    TEST_ASSERT_TRUE(ble_report_count > 0);
+    const ble_keyboard_report_t* last = &ble_reports[ble_report_count - 1];
+    TEST_ASSERT_EQUAL_HEX8(0, last->modifier);
+    for (int i = 0; i < BLE_KEYBOARD_REPORT_KEYS; i++) TEST_ASSERT_EQUAL_HEX8(0, last->keys[i]);
+    TEST_ASSERT_FALSE(ble_keyboard_report_pending());
+}
+
+// Keys pressed one per report until 24 are held, then released one per report
+void test_rollover_24_keys() {
+    hid_device_t* dev = connect_nkro_keyboard();
+    hid_key_bitmap_t held, all;
+    hid_key_bitmap_clear(&held);
+    for (int i = 0; i < REPLAY_KEYS; i++) {
+        hid_key_bitmap_set(&held, (uint8_t)(HID_KEY_A + i));
+        send_nkro_report(dev, HID_LEFT_SHIFT, &held);
+    }
+    all = held;
+    for (int i = 0; i < REPLAY_KEYS; i++) {
+        uint8_t key = (uint8_t)(HID_KEY_A + (i * 7) % REPLAY_KEYS);  // another order
+        held.w[key >> 5] &= ~(1u << (key & 31));
+        send_nkro_report(dev, (i < REPLAY_KEYS - 1) ? HID_LEFT_SHIFT : 0, &held);
+    }
+
+    assert_all_keys_reported(&all);
+    ble_keyboard_report_stats_t* stats = get_ble_keyboard_report_stats();
+    TEST_ASSERT_EQUAL(2 * REPLAY_KEYS, stats->snapshots);
+    TEST_ASSERT_TRUE(stats->folded > 0);
+    TEST_ASSERT_EQUAL(0, stats->stalls);
+}
+
+// 24 keys pressed and released within two reports: the keys which did not fit
+// into the first report go out afterwards
+void test_chord_24_keys() {
+    hid_device_t* dev = connect_nkro_keyboard();
+    hid_key_bitmap_t chord, none;
+    hid_key_bitmap_clear(&chord);
+    hid_key_bitmap_clear(&none);
+    for (int i = 0; i < REPLAY_KEYS; i++) hid_key_bitmap_set(&chord, (uint8_t)(0x10 + i));
+
+    send_nkro_report(dev, 0, &chord);
+    send_nkro_report(dev, 0, &none);
+
+    assert_all_keys_reported(&chord);
+    // six keys per report, then the report with all keys released
+    TEST_ASSERT_EQUAL(REPLAY_KEYS / BLE_KEYBOARD_REPORT_KEYS + 1, ble_report_count);
+}
+
+// Without credits nothing is sent; the sender task sends every key press later,
+// although the chord was released in the meantime
+void test_chord_without_credits() {
+    hid_device_t* dev = connect_nkro_keyboard();
+    hid_key_bitmap_t chord, none;
+    hid_key_bitmap_clear(&chord);
+    hid_key_bitmap_clear(&none);
+    for (int i = 0; i < REPLAY_KEYS; i++) hid_key_bitmap_set(&chord, (uint8_t)(0x20 + i));
+
+    credits = 0;
+    send_nkro_report(dev, HID_RIGHT_ALT, &chord);
+    send_nkro_report(dev, 0, &none);
+    TEST_ASSERT_EQUAL(0, ble_report_count);
+    TEST_ASSERT_TRUE(ble_keyboard_report_pending());
+    TEST_ASSERT_TRUE(get_ble_keyboard_report_stats()->stalls > 0);
+
+    credits = 1;
+    TEST_ASSERT_FALSE(hid_sender_run());  // nothing held back any more
+    assert_all_keys_reported(&chord);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rollover_24_keys);
+    RUN_TEST(test_chord_24_keys);
+    RUN_TEST(test_chord_without_credits);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "hid_latency.h"
+#include "hid_latency_hist.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Log-scale latency histograms: bucket bounds, percentiles against the exact
+ * values of the samples, the pipeline stamps on a virtual clock, and the cost
+ * of one stamp.
+ */
+
+static hid_latency_hist_t hist;
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+void setUp() {
+    random_state = 1;
+    hid_latency_hist_reset(&hist);
+    hid_latency_reset();
+}
+
+void tearDown() { native_clock_real(); }
+
+// Every value falls into the bucket whose bounds hold it, buckets are in
+// order and at most 25% wide
+void test_bucket_bounds() {
+    int prev_bucket = 0;
+    for (uint32_t us = 0; us < (1u << 22); us++) {
+        int b = hid_latency_bucket(us);
+        TEST_ASSERT_TRUE(b == prev_bucket || b == prev_bucket + 1);
+        TEST_ASSERT_TRUE(us <= hid_latency_bucket_upper(b));
+        if (b > 0) TEST_ASSERT_TRUE(us > hid_latency_bucket_upper(b - 1));
+        if (us >= 4) TEST_ASSERT_TRUE(hid_latency_bucket_upper(b) - us < us / 4 + 1);
+        prev_bucket = b;
+    }
+    // beyond the last bucket everything is counted in it
+    TEST_ASSERT_EQUAL(HID_LATENCY_BUCKETS - 1, hid_latency_bucket(0xFFFFFFFFu));
+}
+
+static uint32_t exact_percentile(std::vector<uint32_t> values, uint32_t permille) {
+    std::sort(values.begin(), values.end());
+    size_t rank = (values.size() * permille + 999) / 1000;
+    if (rank == 0) rank = 1;
+    return values[rank - 1];
+}
+
+// p50 and p99 are never below the exact value and at most one bucket above it
+void test_percentiles_against_samples() {
+    for (int round = 0; round < 50; round++) {
+        std::vector<uint32_t> values;
+        hid_latency_hist_reset(&hist);
+        // mostly a connection interval or two, with a long tail
+        int n = 100 + (int)(random_next() % 5000);
+        for (int i = 0; i < n; i++) {
+            uint32_t us = 500 + random_next() % 15000;
+            if (random_next() % 100 == 0) us += random_next() % 200000;
+            values.push_back(us);
+            hid_latency_hist_add(&hist, us);
+        }
+        TEST_ASSERT_EQUAL_UINT32(n, hist.total);
+        TEST_ASSERT_EQUAL_UINT32(*std::max_element(values.begin(), values.end()), hist.max_us);
+
+        const uint32_t permilles[] = {500, 990, 1000};
+        for (uint32_t permille : permilles) {
+            uint32_t exact = exact_percentile(values, permille);
+            uint32_t p = hid_latency_hist_percentile(&hist, permille);
+            TEST_ASSERT_TRUE(p >= exact);
+            TEST_ASSERT_TRUE(p <= exact + exact / 4 + 1);
+            TEST_ASSERT_TRUE(p <= hist.max_us);
+        }
+    }
+}
+
+void test_empty_and_single() {
+    TEST_ASSERT_EQUAL_UINT32(0, hid_latency_hist_percentile(&hist, 500));
+    hid_latency_hist_add(&hist, 1234);
+    TEST_ASSERT_EQUAL_UINT32(1234, hid_latency_hist_percentile(&hist, 0));
+    TEST_ASSERT_EQUAL_UINT32(1234, hid_latency_hist_percentile(&hist, 990));
+}
+
+// Stamps of the sender task, with the stages between them
+void test_pipeline_stamps() {
+    native_clock_set(1000000);
+    uint32_t arrival = hid_latency_now();
+    native_clock_advance(40);
+    uint32_t decoded = hid_latency_now();
+    native_clock_advance(2000);  // waiting in the event ring
+
+    hid_latency_begin(arrival, decoded);
+    native_clock_advance(100);
+    hid_latency_stamp_notify();
+    native_clock_advance(50);
+    hid_latency_stamp_notify();  // later notifications of the same report do not count
+    hid_latency_end();
+
+    TEST_ASSERT_EQUAL_UINT32(40, get_hid_latency_hist(HID_LATENCY_STAGE_DECODE)->max_us);
+    TEST_ASSERT_EQUAL_UINT32(2100, get_hid_latency_hist(HID_LATENCY_STAGE_NOTIFY)->max_us);
+    TEST_ASSERT_EQUAL_UINT32(2150, get_hid_latency_hist(HID_LATENCY_STAGE_CALLBACK)->max_us);
+    TEST_ASSERT_EQUAL_UINT32(2140, get_hid_latency_hist(HID_LATENCY_STAGE_TOTAL)->max_us);
+    TEST_ASSERT_EQUAL_UINT32(1, get_hid_latency_hist(HID_LATENCY_STAGE_TOTAL)->total);
+
+    // generated motion has no USB timestamps
+    hid_latency_skip();
+    hid_latency_stamp_notify();
+    TEST_ASSERT_EQUAL_UINT32(1, get_hid_latency_hist(HID_LATENCY_STAGE_TOTAL)->total);
+
+    // a queued report sent by a retry of the sender task, outside a callback
+    hid_latency_begin(arrival, decoded);
+    hid_latency_end();
+    native_clock_advance(30000);
+    hid_latency_stamp_notify();
+    TEST_ASSERT_EQUAL_UINT32(1, get_hid_latency_hist(HID_LATENCY_STAGE_TOTAL)->total);
+    TEST_ASSERT_EQUAL_UINT32(2100, get_hid_latency_hist(HID_LATENCY_STAGE_NOTIFY)->max_us);
+}
+
+// Differences stay right when the 32 bit microsecond clock wraps
+void test_stamps_across_wrap() {
+    native_clock_set(0xFFFFFF00ll);
+    uint32_t arrival = hid_latency_now();
+    native_clock_advance(0x200);
+    hid_latency_begin(arrival, hid_latency_now());
+    hid_latency_stamp_notify();
+    hid_latency_end();
+    TEST_ASSERT_EQUAL_UINT32(0x200, get_hid_latency_hist(HID_LATENCY_STAGE_TOTAL)->max_us);
+}
+
+void bench_hist_add() {
+    uint32_t values[256];
+    for (int i = 0; i < 256; i++) values[i] = random_next() % 100000;
+    int i = 0;
+    bench_result_t r = bench_run("hid_latency_hist_add", 10000000,
+                                 [&]() { hid_latency_hist_add(&hist, values[i++ & 255]); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    r = bench_run("hid_latency_hist_percentile p99", 100000,
+                  [&]() { bench_consume(hid_latency_hist_percentile(&hist, 990)); });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_bounds);
+    RUN_TEST(test_percentiles_against_samples);
+    RUN_TEST(test_empty_and_single);
+    RUN_TEST(test_pipeline_stamps);
+    RUN_TEST(test_stamps_across_wrap);
+    RUN_TEST(bench_hist_add);
+    return UNITY_END();
+}
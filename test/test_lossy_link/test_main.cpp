@@ -0,0 +1,101 @@
+#include <unity.h>
+#include "hid_sim.h"
+#include "ble_notify_queue.h"
+
+/*
+ * Report path over a lossy BLE link, see hid_sim.h: connection events fail at
+ * random, notifications wait in the stack buffers and the mouse report queue
+ * fills up. Motion is never lost, clicks only when the queue stays full, and
+ * the buttons always end up as on the USB side.
+ *
+ *   pio test -e native -f test_lossy_link -v
+ */
+
+//                      name, report us, jitter, conn us, budget, buffers, sender us,
+//                      speed, click us, duration us, seed, loss permille
+static const hid_sim_config_t configs[] = {
+    {"1 kHz, 7.5 ms, b 2, 10% loss", 1000, 0, 7500, 2, 4, 50, 4000, 50000, 2000000, 11, 100},
+    {"1 kHz, 7.5 ms, b 2, 50% loss", 1000, 200, 7500, 2, 4, 50, 4000, 40000, 2000000, 12, 500},
+    {"125 Hz, 15 ms, b 1, 50% loss", 8000, 0, 15000, 1, 4, 50, 2000, 64000, 2000000, 13, 500},
+    // the queue stays full: clicks faster than the link delivers anything
+    {"1 kHz, 15 ms, b 1, 70% loss", 1000, 0, 15000, 1, 2, 50, 4000, 10000, 500000, 14, 700},
+};
+
+static const size_t config_count = sizeof(configs) / sizeof(configs[0]);
+static const size_t severe = config_count - 1;
+
+static hid_sim_result_t results[sizeof(configs) / sizeof(configs[0])];
+
+void setUp() {}
+
+void tearDown() {}
+
+static void run_all() {
+    static bool done = false;
+    if (done) return;
+    hid_sim_print_header();
+    for (size_t i = 0; i < config_count; i++) {
+        hid_sim_run(&configs[i], &results[i]);
+        hid_sim_print(&configs[i], &results[i]);
+        printf("%-28s lost events %lu/%lu, merged %lu, dropped %lu\n", "",
+               (unsigned long)results[i].conn_events_lost, (unsigned long)results[i].conn_events,
+               (unsigned long)results[i].merged, (unsigned long)results[i].dropped);
+    }
+    done = true;
+}
+
+// Lost connection events delay motion, none of it is lost
+void test_no_motion_loss() {
+    run_all();
+    for (size_t i = 0; i < config_count; i++) {
+        const hid_sim_result_t* r = &results[i];
+        TEST_ASSERT_TRUE_MESSAGE(r->conn_events_lost > 0, configs[i].name);
+        TEST_ASSERT_TRUE_MESSAGE(r->motion_in_x == r->motion_out_x, configs[i].name);
+        TEST_ASSERT_TRUE_MESSAGE(r->motion_in_y == r->motion_out_y, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r->ring_overflows, configs[i].name);
+    }
+}
+
+// While the queue has room, every click reaches the host
+void test_no_click_loss_with_room() {
+    run_all();
+    for (size_t i = 0; i < severe; i++) {
+        const hid_sim_result_t* r = &results[i];
+        TEST_ASSERT_TRUE_MESSAGE(r->queue_high_water < BLE_NOTIFY_QUEUE_SIZE, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r->dropped, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(r->clicks_in, r->clicks_out, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r->clicks_lost, configs[i].name);
+    }
+}
+
+// A queue which stays full loses clicks which never got into it, but the
+// queued ones and the final state reach the host
+void test_full_queue_keeps_final_state() {
+    run_all();
+    const hid_sim_result_t* r = &results[severe];
+    TEST_ASSERT_EQUAL(BLE_NOTIFY_QUEUE_SIZE, r->queue_high_water);
+    TEST_ASSERT_TRUE(r->dropped > 0);
+    TEST_ASSERT_TRUE(r->clicks_out >= BLE_NOTIFY_QUEUE_SIZE);
+    TEST_ASSERT_EQUAL(r->buttons_in, r->buttons_out);
+    for (size_t i = 0; i < config_count; i++) {
+        TEST_ASSERT_EQUAL_MESSAGE(results[i].buttons_in, results[i].buttons_out, configs[i].name);
+    }
+}
+
+// Reports are only counted as merged while the link is out of credits
+void test_merges_under_congestion() {
+    run_all();
+    const hid_sim_result_t* low = &results[0];
+    const hid_sim_result_t* high = &results[1];
+    TEST_ASSERT_TRUE(high->merged > low->merged);
+    TEST_ASSERT_TRUE(high->merged < high->reports);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_motion_loss);
+    RUN_TEST(test_no_click_loss_with_room);
+    RUN_TEST(test_full_queue_keeps_final_state);
+    RUN_TEST(test_merges_under_congestion);
+    return UNITY_END();
+}
@@ -0,0 +1,215 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usb_hid_host.h"
+#include "usb_hid_joystick.h"
+#include "hid_motion_gen.h"
+#include "hid_latency.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Joystick motion generators on the virtual clock: a held stick moves as far
+ * as it did with one step per report, gamepads move independently, the hat
+ * scrolls per unit of time, and late ticks integrate the time which passed.
+ * The sender task is emulated by calling hid_sender_run() every millisecond.
+ */
+
+#define PERIOD_US 15000
+#define REPORT_US 8000
+
+static int32_t moved_x, moved_y, wheel_steps, report_count;
+
+static void hidData_received(unified_hidData_t* hidData) {
+    moved_x += hidData->x_displacement;
+    moved_y += hidData->y_displacement;
+    wheel_steps += hidData->scroll_wheel;
+    report_count++;
+}
+
+static void keyData_received(const unified_keyData_t* keyData) {}
+
+void setUp() {
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    moved_x = moved_y = wheel_steps = report_count = 0;
+    native_clock_set(1000000);
+    set_joystick_motion_period(PERIOD_US);
+    joystick_motion_init();
+}
+
+void tearDown() {
+    hid_test_reset();
+    set_joystick_motion_period(0);
+    native_clock_real();
+}
+
+static hid_device_t* connect_gamepad(uintptr_t id) {
+    hid_device_t* dev = hid_test_connect(id, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE,
+                                         desc_gamepad, sizeof(desc_gamepad));
+    TEST_ASSERT_TRUE(dev->joystick_format.is_valid);
+    return dev;
+}
+
+// Gamepad report at the current time: 8 bit X/Y (0x80 centered), hat 0..7 (8 = released)
+static void gamepad_report(hid_device_t* dev, uint8_t x, uint8_t y, uint8_t hat) {
+    const uint8_t report[] = {x, y, 0x80, 0x80, 0x80, (uint8_t)(hat & 0x0F), 0x00, 0x00};
+    hid_test_report(dev, report, sizeof(report), hid_latency_now());
+}
+
+// Let 'us' pass on the virtual clock, the sender task running every millisecond
+static void run_for(uint32_t us) {
+    for (uint32_t t = 0; t < us; t += 1000) {
+        hid_sender_run();
+        native_clock_advance(1000);
+    }
+}
+
+// X motion of one second of holding the stick at 'x'; the device reports
+// every 8 ms for 'reporting_us', then keeps quiet while the stick is held
+static int32_t hold_stick(uintptr_t id, uint8_t x, uint32_t reporting_us) {
+    hid_device_t* dev = connect_gamepad(id);
+    moved_x = 0;
+    uint32_t t = 0;
+    for (; t < reporting_us; t += REPORT_US) {
+        gamepad_report(dev, x, 0x80, 8);
+        run_for(REPORT_US);
+    }
+    run_for(1000000 - t);
+    gamepad_report(dev, 0x80, 0x80, 8);
+    run_for(PERIOD_US);
+    return moved_x;
+}
+
+// Speeds are per report: with the measured 8 ms report interval, generated
+// motion covers the distance of one step per report, also when the gamepad
+// stops reporting a held stick
+void test_held_stick_matches_report_steps() {
+    set_joystick_motion_period(0);
+    int32_t per_report = hold_stick(1, 0xC0, 1000000);
+    hid_test_reset();
+
+    set_joystick_motion_period(PERIOD_US);
+    int32_t generated = hold_stick(2, 0xC0, 1000000);
+    hid_test_reset();
+    int32_t quiet = hold_stick(3, 0xC0, 100000);
+
+    int32_t step = per_report / (1000000 / REPORT_US) + 1;  // pixels of one report
+    TEST_ASSERT_TRUE(per_report > 0);
+    TEST_ASSERT_INT_WITHIN(2 * step, per_report, generated);
+    TEST_ASSERT_INT_WITHIN(2 * step, per_report, quiet);
+}
+
+// Centering or disconnecting one gamepad does not stop the other one
+void test_gamepads_move_independently() {
+    hid_device_t* a = connect_gamepad(1);
+    hid_device_t* b = connect_gamepad(2);
+    gamepad_report(a, 0xFF, 0x80, 8);
+    gamepad_report(b, 0x80, 0xFF, 8);
+    run_for(100000);
+    TEST_ASSERT_TRUE(moved_x > 0);
+    TEST_ASSERT_TRUE(moved_y > 0);
+
+    gamepad_report(b, 0x80, 0x80, 8);
+    run_for(PERIOD_US);
+    int32_t x = moved_x, y = moved_y;
+    run_for(100000);
+    TEST_ASSERT_TRUE(moved_x > x);
+    TEST_ASSERT_EQUAL(y, moved_y);
+
+    gamepad_report(b, 0x80, 0x00, 8);
+    hid_host_joystick_release(&b->joystick_format, &b->joystick_motion, &b->joystick_gen);
+    x = moved_x;
+    run_for(100000);
+    TEST_ASSERT_TRUE(moved_x > x);
+    TEST_ASSERT_EQUAL(y, moved_y);
+    TEST_ASSERT_FALSE(hid_motion_gen_active(&b->joystick_gen));
+    TEST_ASSERT_TRUE(hid_motion_gen_active(&a->joystick_gen));
+}
+
+// One wheel step when the hat is pressed, then one per scroll interval
+void test_hat_scrolls_per_time() {
+    hid_device_t* dev = connect_gamepad(1);
+    gamepad_report(dev, 0x80, 0x80, 0);  // up
+    run_for(1000000);
+    TEST_ASSERT_INT_WITHIN(1, 1000000 / JOYSTICK_SCROLL_INTERVAL_US + 1, wheel_steps);
+    TEST_ASSERT_EQUAL(0, moved_x);
+
+    gamepad_report(dev, 0x80, 0x80, 8);
+    int32_t steps = wheel_steps;
+    run_for(1000000);
+    TEST_ASSERT_EQUAL(steps, wheel_steps);
+}
+
+// The sender task waits for the nearest tick of the running generators
+void test_wait_follows_period() {
+    hid_device_t* dev = connect_gamepad(1);
+    TEST_ASSERT_EQUAL_UINT32(HID_SENDER_WAIT_FOREVER, hid_sender_wait_us(false));
+    gamepad_report(dev, 0xFF, 0x80, 8);
+    hid_sender_run();
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US, hid_sender_wait_us(false));
+
+    set_joystick_motion_period(7500);  // e.g. a shorter connection interval was granted
+    TEST_ASSERT_EQUAL_UINT32(7500, hid_sender_wait_us(false));
+    native_clock_advance(7500);
+    int reports = report_count;
+    hid_sender_run();
+    TEST_ASSERT_EQUAL(reports + 1, report_count);
+}
+
+// Ticks integrate the time which passed, up to HID_MOTION_MAX_STEPS periods
+void test_late_ticks() {
+    hid_motion_gen_t gen;
+    hid_motion_gen_init(&gen, 10000, JOYSTICK_SCROLL_INTERVAL_US);
+    int16_t dx, dy;
+    int8_t wheel;
+    uint32_t now = 5000;
+
+    hid_motion_gen_set(&gen, 256, -512, 10000, 0, 0);  // 1 and -2 px per 10 ms report
+    TEST_ASSERT_TRUE(hid_motion_gen_tick(&gen, now, &dx, &dy, &wheel));
+    TEST_ASSERT_EQUAL(1, dx);
+    TEST_ASSERT_EQUAL(-2, dy);
+    now += 30000;
+    hid_motion_gen_tick(&gen, now, &dx, &dy, &wheel);
+    TEST_ASSERT_EQUAL(3, dx);
+    TEST_ASSERT_EQUAL(-6, dy);
+    now += 1000000;
+    hid_motion_gen_tick(&gen, now, &dx, &dy, &wheel);
+    TEST_ASSERT_EQUAL(HID_MOTION_MAX_STEPS, dx);
+
+    // same speed per report, reports twice as often: twice as fast
+    hid_motion_gen_set(&gen, 256, 0, 5000, 0, 0);
+    now += 10000;
+    hid_motion_gen_tick(&gen, now, &dx, &dy, &wheel);
+    TEST_ASSERT_EQUAL(2, dx);
+
+    hid_motion_gen_set(&gen, 128, 0, 10000, 0, 0);
+    now += 10000;
+    hid_motion_gen_tick(&gen, now, &dx, &dy, &wheel);  // half a pixel left over
+    hid_motion_gen_set(&gen, 0, 0, 10000, 0, 0);
+    TEST_ASSERT_FALSE(hid_motion_gen_tick(&gen, now + 10000, &dx, &dy, &wheel));
+    TEST_ASSERT_EQUAL(0, gen.residual_x);
+    TEST_ASSERT_FALSE(gen.running);
+}
+
+// Pauses and bursts of reports do not change the measured report interval
+void test_report_interval() {
+    TEST_ASSERT_EQUAL_UINT32(0, hid_motion_gen_report_interval(0, 200000));
+    uint32_t report_us = hid_motion_gen_report_interval(0, REPORT_US);
+    TEST_ASSERT_EQUAL_UINT32(REPORT_US, report_us);
+    TEST_ASSERT_EQUAL_UINT32(REPORT_US, hid_motion_gen_report_interval(report_us, 200000));
+    TEST_ASSERT_EQUAL_UINT32(REPORT_US, hid_motion_gen_report_interval(report_us, 100));
+    for (int i = 0; i < 30; i++) report_us = hid_motion_gen_report_interval(report_us, 4000);
+    TEST_ASSERT_UINT32_WITHIN(10, 4000, report_us);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_held_stick_matches_report_steps);
+    RUN_TEST(test_gamepads_move_independently);
+    RUN_TEST(test_hat_scrolls_per_time);
+    RUN_TEST(test_wait_follows_period);
+    RUN_TEST(test_late_ticks);
+    RUN_TEST(test_report_interval);
+    return UNITY_END();
+}
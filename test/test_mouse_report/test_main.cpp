@@ -0,0 +1,226 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "ble_mouse_report.h"
+#include "ble_mouse_motion.h"
+#include "ble_notify_queue.h"
+
+/*
+ * High-velocity traces through the BLE mouse report path: int16 deltas of
+ * the unified report go out as int8 reports without losing motion. Button
+ * changes queued for a congested link are sent as they happened.
+ */
+
+static std::vector<ble_mouse_report_t> sent;
+static int credits;  // < 0: unlimited
+
+static bool transport(const ble_mouse_report_t* report) {
+    sent.push_back(*report);
+    return true;
+}
+
+static int get_credits() {
+    if (credits < 0) return 1;
+    return credits;
+}
+
+void setUp() {
+    sent.clear();
+    credits = -1;
+    register_ble_mouse_report_transport(transport);
+    register_ble_mouse_report_credits(get_credits);
+    ble_mouse_report_reset();
+    ble_mouse_report_stats_reset();
+}
+
+void tearDown() {
+    register_ble_mouse_report_transport(NULL);
+    register_ble_mouse_report_credits(NULL);
+}
+
+static unified_hidData_t make_report(uint8_t buttons, int16_t x, int16_t y, int8_t wheel) {
+    unified_hidData_t d;
+    memset(&d, 0, sizeof(d));
+    d.buttons.val = buttons;
+    d.x_displacement = x;
+    d.y_displacement = y;
+    d.scroll_wheel = wheel;
+    return d;
+}
+
+// Fast flicks of a high-DPI mouse: accelerate to full int16 speed and back, both directions
+static std::vector<unified_hidData_t> flick_trace(uint32_t seed) {
+    std::vector<unified_hidData_t> trace;
+    for (int flick = 0; flick < 8; flick++) {
+        int sign = (flick & 1) ? -1 : 1;
+        int peak = 2000 + (int)(seed % 30000);
+        seed = seed * 1664525u + 1013904223u;
+        for (int i = 0; i < 40; i++) {
+            int ramp = (i < 20) ? i : 40 - i;
+            int x = sign * peak * ramp / 20;
+            int y = -sign * (peak / 3) * ramp / 20 + (int)(seed >> 28) - 8;
+            trace.push_back(make_report(0, (int16_t)x, (int16_t)y, (int8_t)((i % 7) - 3)));
+        }
+    }
+    trace.push_back(make_report(0, 32767, -32767, 127));
+    trace.push_back(make_report(0, -32767, 32767, -127));
+    return trace;
+}
+
+static uint32_t reports_needed(int32_t x, int32_t y, int32_t wheel) {
+    uint32_t n = 0;
+    int32_t axes[3] = {abs(x), abs(y), abs(wheel)};
+    for (int i = 0; i < 3; i++) {
+        uint32_t k = (uint32_t)((axes[i] + BLE_MOUSE_MOTION_MAX - 1) / BLE_MOUSE_MOTION_MAX);
+        if (k > n) n = k;
+    }
+    return n;
+}
+
+// Every count of the trace arrives, no report wraps around
+void test_flicks_lossless() {
+    std::vector<unified_hidData_t> trace = flick_trace(12345);
+    int64_t in_x = 0, in_y = 0, in_wheel = 0;
+    uint32_t minimal = 0;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const unified_hidData_t& d = trace[i];
+        int16_t x = d.x_displacement;
+        int16_t y = d.y_displacement;
+        size_t before = sent.size();
+        TEST_ASSERT_TRUE(ble_mouse_report_submit(&d));
+        in_x += x;
+        in_y += y;
+        in_wheel += d.scroll_wheel;
+        minimal += reports_needed(x, y, d.scroll_wheel);
+
+        // the reports of one delta all point the same way
+        for (size_t k = before; k < sent.size(); k++) {
+            TEST_ASSERT_TRUE(sent[k].x == 0 || (sent[k].x > 0) == (x > 0));
+            TEST_ASSERT_TRUE(sent[k].y == 0 || (sent[k].y > 0) == (y > 0));
+        }
+    }
+
+    int64_t out_x = 0, out_y = 0, out_wheel = 0;
+    for (size_t k = 0; k < sent.size(); k++) {
+        TEST_ASSERT_TRUE(sent[k].x >= BLE_MOUSE_MOTION_MIN);
+        TEST_ASSERT_TRUE(sent[k].y >= BLE_MOUSE_MOTION_MIN);
+        out_x += sent[k].x;
+        out_y += sent[k].y;
+        out_wheel += sent[k].wheel;
+    }
+    TEST_ASSERT_TRUE(in_x == out_x);
+    TEST_ASSERT_TRUE(in_y == out_y);
+    TEST_ASSERT_TRUE(in_wheel == out_wheel);
+
+    // no more reports than the int8 range requires
+    TEST_ASSERT_EQUAL_UINT32(minimal, sent.size());
+    TEST_ASSERT_FALSE(ble_mouse_report_pending());
+}
+
+// With a congested link the trace is merged and drained later, still without loss
+void test_flicks_congested_lossless() {
+    std::vector<unified_hidData_t> trace = flick_trace(777);
+    int64_t in_x = 0, in_y = 0;
+    uint32_t minimal = 0;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        credits = (i % 5 == 0) ? 1 : 0;  // one notification every fifth report
+        ble_mouse_report_submit(&trace[i]);
+        in_x += trace[i].x_displacement;
+        in_y += trace[i].y_displacement;
+        minimal += reports_needed(trace[i].x_displacement, trace[i].y_displacement,
+                                  trace[i].scroll_wheel);
+    }
+    TEST_ASSERT_TRUE(ble_mouse_report_pending());
+    credits = -1;
+    TEST_ASSERT_TRUE(ble_mouse_report_flush());
+
+    int64_t out_x = 0, out_y = 0;
+    for (size_t k = 0; k < sent.size(); k++) {
+        out_x += sent[k].x;
+        out_y += sent[k].y;
+    }
+    TEST_ASSERT_TRUE(in_x == out_x);
+    TEST_ASSERT_TRUE(in_y == out_y);
+    // merged flicks cancel out, so fewer reports than sent one by one
+    TEST_ASSERT_TRUE(sent.size() < minimal);
+}
+
+// Motion that fits a report goes out as exactly one notification
+void test_small_motion_single_report() {
+    unified_hidData_t d = make_report(0x01, 127, -127, 5);
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL(0, get_ble_mouse_report_stats()->drain_reports);
+
+    d = make_report(0x01, 128, 0, 0);
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(3, sent.size());
+    TEST_ASSERT_EQUAL(127, sent[1].x);
+    TEST_ASSERT_EQUAL(1, sent[2].x);
+    TEST_ASSERT_EQUAL(1, get_ble_mouse_report_stats()->drain_reports);
+}
+
+// A full queue keeps every queued button change; only the state which did not
+// fit is replaced by later ones, and the buttons end up as on the USB side
+void test_full_queue_keeps_transitions() {
+    credits = 0;
+    const int queued = BLE_NOTIFY_QUEUE_SIZE;
+    for (int i = 0; i < queued; i++) {
+        unified_hidData_t d = make_report((uint8_t)((i & 1) ? 0x00 : 0x01), 3, 0, 0);
+        ble_mouse_report_submit(&d);
+    }
+    // press (waits for room), release, press, middle button: one state waits
+    const uint8_t later[] = {0x01, 0x00, 0x01, 0x04};
+    for (uint8_t buttons : later) {
+        unified_hidData_t d = make_report(buttons, 3, 0, 0);
+        ble_mouse_report_submit(&d);
+    }
+    TEST_ASSERT_EQUAL(3, get_ble_mouse_report_stats()->dropped);
+    TEST_ASSERT_EQUAL(BLE_NOTIFY_QUEUE_SIZE, get_ble_mouse_report_stats()->queue_high_water);
+    TEST_ASSERT_EQUAL(0, sent.size());
+
+    credits = -1;
+    TEST_ASSERT_TRUE(ble_mouse_report_flush());
+    TEST_ASSERT_EQUAL(queued + 1, sent.size());
+    int32_t x = 0;
+    for (int i = 0; i < queued; i++) {
+        TEST_ASSERT_EQUAL((i & 1) ? 0x00 : 0x01, sent[i].buttons);
+    }
+    for (size_t i = 0; i < sent.size(); i++) x += sent[i].x;
+    TEST_ASSERT_EQUAL(0x04, sent[queued].buttons);
+    TEST_ASSERT_EQUAL(3 * (queued + 4), x);
+}
+
+// Merging counts as congestion only while the stack has no room, not when
+// motion beyond the int8 range waits with credits left
+void test_merged_counts_congestion_only() {
+    credits = 0;
+    unified_hidData_t d = make_report(0, 5, 0, 0);
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(0, get_ble_mouse_report_stats()->merged);
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(1, get_ble_mouse_report_stats()->merged);
+
+    // one credit: a queued large delta drains over several flushes
+    credits = 1;
+    d = make_report(0, 1000, 0, 0);
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(1, get_ble_mouse_report_stats()->merged);
+    credits = -1;
+    ble_mouse_report_submit(&d);
+    TEST_ASSERT_EQUAL(1, get_ble_mouse_report_stats()->merged);
+    TEST_ASSERT_FALSE(ble_mouse_report_pending());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_flicks_lossless);
+    RUN_TEST(test_flicks_congested_lossless);
+    RUN_TEST(test_small_motion_single_report);
+    RUN_TEST(test_full_queue_keeps_transitions);
+    RUN_TEST(test_merged_counts_congestion_only);
+    return UNITY_END();
+}
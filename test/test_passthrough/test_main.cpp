@@ -0,0 +1,163 @@
+#include <unity.h>
+#include <string.h>
+#include "ble_hid_passthrough.h"
+#include "usb_hid_report_desc.h"
+#include "hid_test_descriptors.h"
+
+/*
+ * Passthrough report map built from the recorded descriptors of
+ * test/support: the BLE map must describe the same fields as the USB
+ * descriptor, under unique report IDs, and reports must be forwarded with
+ * the right ID and payload.
+ */
+
+static ble_passthrough_config_t cfg;
+static hid_report_map_t usb_map;
+static hid_report_map_t ble_map;
+
+void setUp() { ble_passthrough_init(&cfg); }
+
+void tearDown() {}
+
+// Fields of one USB report and of its BLE report are the same, apart from the ID
+// byte which BLE reports always have
+static void assert_same_fields(const hid_report_info_t* usb, const hid_report_info_t* ble,
+                               bool usb_uses_ids) {
+    TEST_ASSERT_EQUAL(usb->field_count, ble->field_count);
+    TEST_ASSERT_EQUAL(usb->input_bits, ble->input_bits);
+    TEST_ASSERT_EQUAL(usb->output_bits, ble->output_bits);
+    TEST_ASSERT_EQUAL(usb->feature_bits, ble->feature_bits);
+    for (int i = 0; i < usb->field_count; i++) {
+        const hid_report_field_t* u = &usb_map.fields[usb->first_field + i];
+        const hid_report_field_t* b = &ble_map.fields[ble->first_field + i];
+        TEST_ASSERT_EQUAL(u->usage_page, b->usage_page);
+        TEST_ASSERT_EQUAL(u->usage_min, b->usage_min);
+        TEST_ASSERT_EQUAL(u->usage_max, b->usage_max);
+        TEST_ASSERT_EQUAL(u->size, b->size);
+        TEST_ASSERT_EQUAL(u->count, b->count);
+        TEST_ASSERT_EQUAL(u->flags, b->flags);
+        TEST_ASSERT_EQUAL(u->type, b->type);
+        TEST_ASSERT_EQUAL(u->logical_min, b->logical_min);
+        TEST_ASSERT_EQUAL(u->logical_max, b->logical_max);
+        TEST_ASSERT_EQUAL(u->bit_offset + (usb_uses_ids ? 0 : 8), b->bit_offset);
+    }
+}
+
+// Every recorded descriptor on its own translates into an equivalent BLE map
+void test_corpus_translation() {
+    for (size_t n = 0; n < HID_TEST_DESCRIPTOR_COUNT; n++) {
+        const hid_test_descriptor_t* d = &hid_test_descriptors[n];
+        ble_passthrough_init(&cfg);
+        const ble_passthrough_iface_t* iface = ble_passthrough_add_interface(
+            &cfg, d->desc, d->len, hid_report_desc_hash(d->desc, d->len));
+        TEST_ASSERT_NOT_NULL_MESSAGE(iface, d->name);
+
+        TEST_ASSERT_TRUE(hid_parse_report_descriptor(d->desc, d->len, &usb_map));
+        TEST_ASSERT_TRUE(hid_parse_report_descriptor(cfg.report_map, cfg.map_len, &ble_map));
+        TEST_ASSERT_TRUE_MESSAGE(ble_map.uses_report_ids, d->name);
+        TEST_ASSERT_EQUAL_MESSAGE(usb_map.report_count, ble_map.report_count, d->name);
+        TEST_ASSERT_EQUAL(usb_map.report_count, iface->id_count);
+
+        for (int i = 0; i < iface->id_count; i++) {
+            const hid_report_info_t* usb = hid_report_find_info(&usb_map, iface->usb_ids[i]);
+            const hid_report_info_t* ble = hid_report_find_info(&ble_map, iface->ble_ids[i]);
+            TEST_ASSERT_NOT_NULL_MESSAGE(usb, d->name);
+            TEST_ASSERT_NOT_NULL_MESSAGE(ble, d->name);
+            assert_same_fields(usb, ble, iface->usb_uses_ids);
+        }
+    }
+}
+
+// A gamepad without IDs and a receiver with IDs 1..3 share one report map
+void test_ids_unique_over_interfaces() {
+    const ble_passthrough_iface_t* pad =
+        ble_passthrough_add_interface(&cfg, desc_gamepad, sizeof(desc_gamepad),
+                                      hid_report_desc_hash(desc_gamepad, sizeof(desc_gamepad)));
+    const ble_passthrough_iface_t* receiver = ble_passthrough_add_interface(
+        &cfg, desc_combo_receiver, sizeof(desc_combo_receiver),
+        hid_report_desc_hash(desc_combo_receiver, sizeof(desc_combo_receiver)));
+    TEST_ASSERT_NOT_NULL(pad);
+    TEST_ASSERT_NOT_NULL(receiver);
+    TEST_ASSERT_FALSE(pad->usb_uses_ids);
+    TEST_ASSERT_TRUE(receiver->usb_uses_ids);
+    TEST_ASSERT_EQUAL(1, pad->ble_ids[0]);
+    TEST_ASSERT_EQUAL(3, receiver->id_count);
+    for (int i = 0; i < receiver->id_count; i++) {
+        TEST_ASSERT_EQUAL(i + 1, receiver->usb_ids[i]);
+        TEST_ASSERT_EQUAL(i + 2, receiver->ble_ids[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX8(0x01, pad->input_mask);  // bit per index into the ID table
+    TEST_ASSERT_EQUAL_HEX8(0x07, receiver->input_mask);
+
+    TEST_ASSERT_TRUE(hid_parse_report_descriptor(cfg.report_map, cfg.map_len, &ble_map));
+    TEST_ASSERT_EQUAL(4, ble_map.report_count);
+    TEST_ASSERT_EQUAL_PTR(receiver, ble_passthrough_find_interface(
+                                        &cfg, hid_report_desc_hash(desc_combo_receiver,
+                                                                   sizeof(desc_combo_receiver))));
+}
+
+void test_report_id_rewriting() {
+    const ble_passthrough_iface_t* pad = ble_passthrough_add_interface(
+        &cfg, desc_gamepad, sizeof(desc_gamepad), 1);
+    const ble_passthrough_iface_t* receiver = ble_passthrough_add_interface(
+        &cfg, desc_combo_receiver, sizeof(desc_combo_receiver), 2);
+
+    uint8_t ble_id = 0;
+    const uint8_t* payload = NULL;
+    size_t payload_len = 0;
+
+    // without USB report IDs the whole report is the payload
+    const uint8_t pad_report[] = {0xFF, 0x80, 0x80, 0x80, 0x80, 0x1F, 0x00, 0x00};
+    TEST_ASSERT_TRUE(ble_passthrough_translate_report(pad, pad_report, sizeof(pad_report),
+                                                      &ble_id, &payload, &payload_len));
+    TEST_ASSERT_EQUAL(1, ble_id);
+    TEST_ASSERT_EQUAL_PTR(pad_report, payload);
+    TEST_ASSERT_EQUAL(sizeof(pad_report), payload_len);
+
+    // with report IDs the ID byte is replaced by the BLE report ID
+    const uint8_t mouse_report[] = {0x02, 0x01, 0x00, 0x9C, 0x8F, 0x0C, 0xFF};
+    TEST_ASSERT_TRUE(ble_passthrough_translate_report(receiver, mouse_report,
+                                                      sizeof(mouse_report), &ble_id, &payload,
+                                                      &payload_len));
+    TEST_ASSERT_EQUAL(3, ble_id);
+    TEST_ASSERT_EQUAL_PTR(mouse_report + 1, payload);
+    TEST_ASSERT_EQUAL(sizeof(mouse_report) - 1, payload_len);
+
+    const uint8_t unknown[] = {0x09, 0x00};
+    TEST_ASSERT_FALSE(ble_passthrough_translate_report(receiver, unknown, sizeof(unknown),
+                                                       &ble_id, &payload, &payload_len));
+    TEST_ASSERT_FALSE(ble_passthrough_translate_report(receiver, unknown, 0, &ble_id, &payload,
+                                                       &payload_len));
+}
+
+// An interface which does not fit leaves the report map as it was
+void test_full_map_unchanged() {
+    int added = 0;
+    while (ble_passthrough_add_interface(&cfg, desc_combo_receiver, sizeof(desc_combo_receiver),
+                                         (uint32_t)added) != NULL) {
+        added++;
+    }
+    TEST_ASSERT_TRUE(added > 0);
+    TEST_ASSERT_TRUE(added < BLE_PASSTHROUGH_MAX_IFACES);
+
+    uint16_t map_len = cfg.map_len;
+    uint8_t next_id = cfg.next_ble_id;
+    TEST_ASSERT_NULL(ble_passthrough_add_interface(&cfg, desc_combo_receiver,
+                                                   sizeof(desc_combo_receiver), 99));
+    TEST_ASSERT_EQUAL(map_len, cfg.map_len);
+    TEST_ASSERT_EQUAL(next_id, cfg.next_ble_id);
+    TEST_ASSERT_EQUAL(added, cfg.iface_count);
+
+    // a smaller descriptor still fits
+    TEST_ASSERT_NOT_NULL(
+        ble_passthrough_add_interface(&cfg, desc_boot_mouse, sizeof(desc_boot_mouse), 100));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_translation);
+    RUN_TEST(test_ids_unique_over_interfaces);
+    RUN_TEST(test_report_id_rewriting);
+    RUN_TEST(test_full_map_unchanged);
+    return UNITY_END();
+}
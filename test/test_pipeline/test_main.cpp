@@ -0,0 +1,215 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usb_hid_host.h"
+#include "hid_pipeline.h"
+#include "hid_tremor_filter.h"
+#include "hid_latency.h"
+#include "hid_test_device.h"
+#include "hid_test_descriptors.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Report pipeline: composed stages give the same reports as the same
+ * processing written by hand, the tremor stage is timed by USB arrival also
+ * when reports wait in the event ring, and the cost of every stage and of the
+ * composed pipeline against hand-written code.
+ */
+
+#define REPORT_US 8000
+#define BENCH_ITERATIONS 10000000
+
+typedef hid_pipeline<hid_stage_deadzone<1>, hid_stage_scale<3, 2>, hid_stage_invert<false, true, true>,
+                     hid_stage_button_map<1, 0, 2> >
+    test_pipeline_t;
+
+// test_pipeline_t written by hand
+typedef struct {
+    int32_t residual_x;
+    int32_t residual_y;
+} hand_written_state_t;
+
+static inline int16_t hand_written_scale(int16_t v, int32_t* residual) {
+    int32_t acc = (int32_t)v * 3 + *residual;
+    int32_t out = acc / 2;
+    *residual = acc - out * 2;
+    if (out > INT16_MAX) out = INT16_MAX;
+    if (out < INT16_MIN) out = INT16_MIN;
+    return (int16_t)out;
+}
+
+static inline void hand_written_apply(hand_written_state_t* s, unified_hidData_t* d) {
+    int16_t x = d->x_displacement;
+    int16_t y = d->y_displacement;
+    if (abs(x) <= 1) x = 0;
+    if (abs(y) <= 1) y = 0;
+    d->x_displacement = hand_written_scale(x, &s->residual_x);
+    d->y_displacement = (int16_t)-hand_written_scale(y, &s->residual_y);
+    d->scroll_wheel = (int8_t)-d->scroll_wheel;
+    uint8_t b = d->buttons.val;
+    d->buttons.val = (uint8_t)((b & 0xF8) | ((b >> 1) & 1) | ((b & 1) << 1) | (b & 4));
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+static void random_report(unified_hidData_t* d) {
+    memset(d, 0, sizeof(*d));
+    d->buttons.val = (uint8_t)random_next();
+    d->x_displacement = (int16_t)((int32_t)(random_next() % 81) - 40);
+    d->y_displacement = (int16_t)((int32_t)(random_next() % 81) - 40);
+    d->scroll_wheel = (int8_t)((int32_t)(random_next() % 5) - 2);
+}
+
+// Tremor filter of the callback, and the motion it delivered
+typedef hid_pipeline<hid_stage_tremor<100, 200, 100> > tremor_pipeline_t;
+static tremor_pipeline_t* tremor_pipeline;
+static int16_t delivered_x[64];
+static int delivered_count;
+
+static void hidData_received(unified_hidData_t* hidData) {
+    if (tremor_pipeline == NULL) return;
+    tremor_pipeline->apply(hidData);
+    delivered_x[delivered_count++] = hidData->x_displacement;
+}
+
+static void keyData_received(const unified_keyData_t* keyData) {}
+
+void setUp() {
+    random_state = 1;
+    tremor_pipeline = NULL;
+    delivered_count = 0;
+    register_hidData_callback(hidData_received);
+    register_keyData_callback(keyData_received);
+    native_clock_set(1000000);
+}
+
+void tearDown() {
+    hid_test_reset();
+    native_clock_real();
+}
+
+// Same reports and the same carried remainders as the hand-written version
+void test_stages_match_hand_written() {
+    test_pipeline_t pipeline;
+    hand_written_state_t state = {0, 0};
+    for (int n = 0; n < 100000; n++) {
+        unified_hidData_t a, b;
+        random_report(&a);
+        b = a;
+        pipeline.apply(&a);
+        hand_written_apply(&state, &b);
+        TEST_ASSERT_EQUAL_MEMORY(&b, &a, sizeof(a));
+    }
+}
+
+// Reports which waited in the event ring and are delivered in one burst are
+// filtered with their USB arrival intervals, like reports delivered at once
+void test_tremor_stage_timed_by_arrival() {
+    hid_device_t* mouse = hid_test_connect(1, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE,
+                                           desc_boot_mouse, sizeof(desc_boot_mouse));
+    tremor_pipeline_t pipeline;
+    tremor_pipeline = &pipeline;
+    hid_tremor_filter_config_t cfg = {100, 200, 100};
+    hid_tremor_filter_t reference;
+    hid_tremor_filter_init(&reference, &cfg);
+
+    const int reports = 24;
+    int16_t expected_x[reports];
+    uint32_t arrival_us = hid_latency_now();
+    for (int n = 0; n < reports; n++) {
+        int8_t dx = (int8_t)(2 + (int32_t)(random_next() % 7) - 3);
+        const uint8_t report[] = {0x00, (uint8_t)dx, 0x00};
+        arrival_us += REPORT_US;
+        hid_test_report(mouse, report, sizeof(report), arrival_us);
+        int16_t x = dx, y = 0;
+        hid_tremor_filter_apply(&reference, arrival_us, &x, &y);
+        expected_x[n] = x;
+    }
+    native_clock_set(arrival_us + 50000);  // the sender task was held up
+    hid_sender_run();
+
+    TEST_ASSERT_EQUAL(reports, delivered_count);
+    for (int n = 0; n < reports; n++) TEST_ASSERT_EQUAL(expected_x[n], delivered_x[n]);
+}
+
+#define BENCH_SAMPLES 256
+
+template <typename PIPELINE>
+static void bench_stage(const char* name, const unified_hidData_t* reports) {
+    PIPELINE pipeline;
+    unified_hidData_t d;
+    int i = 0;
+    bench_result_t r = bench_run(name, BENCH_ITERATIONS, [&]() {
+        d = reports[i++ & (BENCH_SAMPLES - 1)];
+        pipeline.apply(&d);
+        bench_consume(d.x_displacement + d.y_displacement + d.buttons.val);
+    });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+}
+
+// Cost of every stage alone, and of the composed pipeline against the same
+// processing written by hand: composing stages adds nothing
+void bench_stages() {
+    const int samples = BENCH_SAMPLES;
+    unified_hidData_t reports[samples];
+    for (int i = 0; i < samples; i++) random_report(&reports[i]);
+    unified_hidData_t d;
+    int i = 0;
+
+    bench_stage<hid_pipeline<> >("stage: none (copy only)", reports);
+    bench_stage<hid_pipeline<hid_stage_deadzone<1> > >("stage: deadzone", reports);
+    bench_stage<hid_pipeline<hid_stage_scale<3, 2> > >("stage: scale", reports);
+    bench_stage<hid_pipeline<hid_stage_swap_xy> >("stage: swap_xy", reports);
+    bench_stage<hid_pipeline<hid_stage_invert<false, true, true> > >("stage: invert", reports);
+    bench_stage<hid_pipeline<hid_stage_button_map<1, 0, 2> > >("stage: button_map", reports);
+
+    // the tremor stage reads the arrival of the report being delivered, which
+    // the sender task sets in hid_latency_begin() (counted here as well)
+    hid_pipeline<hid_stage_tremor<100, 200, 100> > tremor;
+    uint32_t arrival_us = 0;
+    bench_result_t r = bench_run("stage: tremor + hid_latency_begin", BENCH_ITERATIONS, [&]() {
+        d = reports[i++ & (samples - 1)];
+        arrival_us += REPORT_US;
+        hid_latency_begin(arrival_us, arrival_us);
+        tremor.apply(&d);
+        bench_consume(d.x_displacement + d.y_displacement);
+    });
+    TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+
+    // best of a few rounds, the host is not quiet
+    double composed = 1e9, hand = 1e9;
+    for (int round = 0; round < 3; round++) {
+        test_pipeline_t pipeline;
+        bench_result_t c = bench_run("composed pipeline, 4 stages", BENCH_ITERATIONS, [&]() {
+            d = reports[i++ & (samples - 1)];
+            pipeline.apply(&d);
+            bench_consume(d.x_displacement + d.y_displacement + d.buttons.val);
+        });
+        hand_written_state_t state = {0, 0};
+        bench_result_t h = bench_run("hand-written, same processing", BENCH_ITERATIONS, [&]() {
+            d = reports[i++ & (samples - 1)];
+            hand_written_apply(&state, &d);
+            bench_consume(d.x_displacement + d.y_displacement + d.buttons.val);
+        });
+        TEST_ASSERT_EQUAL(0, c.allocs_per_op);
+        if (c.ns_per_op < composed) composed = c.ns_per_op;
+        if (h.ns_per_op < hand) hand = h.ns_per_op;
+    }
+    printf("composed pipeline %.2f ns, hand-written %.2f ns per report\n", composed, hand);
+    TEST_ASSERT_TRUE(composed <= hand * 1.2 + 0.5);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stages_match_hand_written);
+    RUN_TEST(test_tremor_stage_timed_by_arrival);
+    RUN_TEST(bench_stages);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <unity.h>
+#include <vector>
+#include "usb_hid_quirks.h"
+
+/*
+ * Quirk table lookup: entries are found by VID:PID with a binary search, the
+ * end marker and missing devices are not, the sort order is checked at compile
+ * time, the search agrees with a linear scan on a large table, and the delay
+ * left to wait is counted from the end of enumeration.
+ */
+
+static const uint8_t replacement_desc[] = {0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0xC0};
+
+static constexpr usb_hid_quirk_t test_table[] = {
+    {0x045E, 0x0040, 0, USB_HID_QUIRK_NO_SET_IDLE, NULL, 0},
+    {0x046D, 0xC077, 10, 0, NULL, 0},
+    {0x046D, 0xC52B, 0, USB_HID_QUIRK_BOOT_PROTOCOL, NULL, 0},
+    {0x1234, 0x0001, 20, USB_HID_QUIRK_NO_SET_PROTOCOL, replacement_desc, sizeof(replacement_desc)},
+    USB_HID_QUIRK_END
+};
+static constexpr size_t test_count = sizeof(test_table) / sizeof(test_table[0]);
+
+static constexpr usb_hid_quirk_t unsorted_table[] = {
+    {0x046D, 0xC52B, 0, 0, NULL, 0},
+    {0x046D, 0xC077, 0, 0, NULL, 0},
+    USB_HID_QUIRK_END
+};
+static constexpr usb_hid_quirk_t duplicate_table[] = {
+    {0x046D, 0xC077, 0, 0, NULL, 0},
+    {0x046D, 0xC077, 10, 0, NULL, 0},
+    USB_HID_QUIRK_END
+};
+
+static_assert(usb_hid_quirks_sorted(test_table, test_count), "sorted table rejected");
+static_assert(!usb_hid_quirks_sorted(unsorted_table, 3), "unsorted table accepted");
+static_assert(!usb_hid_quirks_sorted(duplicate_table, 3), "duplicate entry accepted");
+static_assert(usb_hid_quirk_key(0x046D, 0xC077) < usb_hid_quirk_key(0x046E, 0x0000),
+              "VID sorts before PID");
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+void setUp() { random_state = 1; }
+
+void tearDown() {}
+
+// Every entry is found with its settings, neighbours are not
+void test_find_entries() {
+    for (size_t i = 0; i + 1 < test_count; i++) {
+        const usb_hid_quirk_t* q = usb_hid_quirk_find(test_table, test_count, test_table[i].vid,
+                                                      test_table[i].pid);
+        TEST_ASSERT_TRUE(q == &test_table[i]);
+    }
+    const usb_hid_quirk_t* q = usb_hid_quirk_find(test_table, test_count, 0x1234, 0x0001);
+    TEST_ASSERT_EQUAL(20, q->delay_ms);
+    TEST_ASSERT_EQUAL(USB_HID_QUIRK_NO_SET_PROTOCOL, q->flags);
+    TEST_ASSERT_TRUE(q->report_desc == replacement_desc);
+
+    TEST_ASSERT_NULL(usb_hid_quirk_find(test_table, test_count, 0x046D, 0xC078));
+    TEST_ASSERT_NULL(usb_hid_quirk_find(test_table, test_count, 0x046C, 0xC077));
+    TEST_ASSERT_NULL(usb_hid_quirk_find(test_table, test_count, 0x0000, 0x0000));
+}
+
+// The end marker is never a match, also in a table holding only the marker
+void test_end_marker_never_matches() {
+    TEST_ASSERT_NULL(usb_hid_quirk_find(test_table, test_count, 0xFFFF, 0xFFFF));
+    const usb_hid_quirk_t end_only[] = {USB_HID_QUIRK_END};
+    TEST_ASSERT_NULL(usb_hid_quirk_find(end_only, 1, 0xFFFF, 0xFFFF));
+    TEST_ASSERT_NULL(usb_hid_quirk_find(end_only, 1, 0x046D, 0xC077));
+    TEST_ASSERT_NULL(usb_hid_quirk_find(NULL, 0, 0x046D, 0xC077));
+    // the built-in table ships empty
+    TEST_ASSERT_NULL(usb_hid_quirk_lookup(0x046D, 0xC077));
+}
+
+// On a large table, the binary search finds what a linear scan finds
+void test_matches_linear_scan() {
+    std::vector<usb_hid_quirk_t> table;
+    uint32_t key = 0;
+    for (int i = 0; i < 1000; i++) {
+        key += 1 + random_next() % 5000;
+        usb_hid_quirk_t q = {(uint16_t)(key >> 16), (uint16_t)key, 0, (uint8_t)i, NULL, 0};
+        table.push_back(q);
+    }
+    usb_hid_quirk_t end = USB_HID_QUIRK_END;
+    table.push_back(end);
+    TEST_ASSERT_TRUE(usb_hid_quirks_sorted(table.data(), table.size()));
+
+    for (int n = 0; n < 100000; n++) {
+        uint32_t probe = random_next() % (key + 2);
+        if (n & 1) probe = usb_hid_quirk_key(table[n % 1000].vid, table[n % 1000].pid);
+        const usb_hid_quirk_t* expected = NULL;
+        for (const usb_hid_quirk_t& q : table) {
+            if (usb_hid_quirk_key(q.vid, q.pid) == probe && probe != 0xFFFFFFFFu) expected = &q;
+        }
+        const usb_hid_quirk_t* found = usb_hid_quirk_find(table.data(), table.size(),
+                                                          (uint16_t)(probe >> 16), (uint16_t)probe);
+        TEST_ASSERT_TRUE(found == expected);
+    }
+}
+
+// The delay runs from the end of enumeration: only what is left of it is
+// waited when the interface connects, and devices without it never wait
+void test_delay_counted_from_enumeration() {
+    const usb_hid_quirk_t* slow = usb_hid_quirk_find(test_table, test_count, 0x1234, 0x0001);
+    const usb_hid_quirk_t* no_delay = usb_hid_quirk_find(test_table, test_count, 0x045E, 0x0040);
+    const uint32_t enum_us = 1000000;
+
+    TEST_ASSERT_EQUAL_UINT32(20000, usb_hid_quirk_wait_us(slow, enum_us, enum_us));
+    TEST_ASSERT_EQUAL_UINT32(12000, usb_hid_quirk_wait_us(slow, enum_us, enum_us + 8000));
+    TEST_ASSERT_EQUAL_UINT32(0, usb_hid_quirk_wait_us(slow, enum_us, enum_us + 20000));
+    TEST_ASSERT_EQUAL_UINT32(0, usb_hid_quirk_wait_us(slow, enum_us, enum_us + 500000));
+    // across the wrap of the microsecond clock
+    TEST_ASSERT_EQUAL_UINT32(15000, usb_hid_quirk_wait_us(slow, 0xFFFFF000u, 0xFFFFF000u + 5000));
+
+    TEST_ASSERT_EQUAL_UINT32(0, usb_hid_quirk_wait_us(no_delay, enum_us, enum_us));
+    TEST_ASSERT_EQUAL_UINT32(0, usb_hid_quirk_wait_us(NULL, enum_us, enum_us));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_find_entries);
+    RUN_TEST(test_end_marker_never_matches);
+    RUN_TEST(test_matches_linear_scan);
+    RUN_TEST(test_delay_counted_from_enumeration);
+    return UNITY_END();
+}
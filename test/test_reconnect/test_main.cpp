@@ -0,0 +1,191 @@
+#include <unity.h>
+#include <string.h>
+#include "ble_reconnect.h"
+
+/*
+ * Reconnection state machine with a fake advertiser on a virtual clock: the
+ * order and timing of the advertising phases, phases the stack refuses, and
+ * the time to reconnect for a bonded host which answers directed advertising
+ * and for a host which only sees undirected advertising.
+ */
+
+#define TICK_US 10000
+
+// What the fake advertiser was asked to do
+typedef struct {
+    ble_reconnect_state_t running;  // BLE_RECONNECT_IDLE if stopped
+    uint16_t min_interval;
+    uint16_t max_interval;
+    uint8_t addr[6];
+    uint32_t directed_calls;
+    uint32_t undirected_calls;
+    uint32_t stop_calls;
+    bool refuse_directed;
+    bool refuse_undirected;
+} fake_advertiser_t;
+
+static fake_advertiser_t fake;
+static ble_reconnect_t rc;
+static ble_reconnect_policy_t policy;
+static uint32_t now;
+
+static const uint8_t host_addr[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+static bool fake_directed(void* ctx, const uint8_t addr[6], uint8_t addr_type) {
+    fake_advertiser_t* f = (fake_advertiser_t*)ctx;
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_IDLE, f->running);  // always stopped first
+    f->directed_calls++;
+    if (f->refuse_directed) return false;
+    memcpy(f->addr, addr, 6);
+    f->running = BLE_RECONNECT_DIRECTED;
+    return true;
+}
+
+static bool fake_undirected(void* ctx, uint16_t min_interval, uint16_t max_interval) {
+    fake_advertiser_t* f = (fake_advertiser_t*)ctx;
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_IDLE, f->running);
+    f->undirected_calls++;
+    if (f->refuse_undirected) return false;
+    f->min_interval = min_interval;
+    f->max_interval = max_interval;
+    f->running = BLE_RECONNECT_FAST;  // undirected, the interval tells fast from slow
+    return true;
+}
+
+static void fake_stop(void* ctx) {
+    fake_advertiser_t* f = (fake_advertiser_t*)ctx;
+    f->running = BLE_RECONNECT_IDLE;
+    f->stop_calls++;
+}
+
+static const ble_advertiser_t advertiser = {fake_directed, fake_undirected, fake_stop, &fake};
+
+void setUp() {
+    memset(&fake, 0, sizeof(fake));
+    ble_reconnect_policy_default(&policy);
+    now = 5000000;
+}
+
+void tearDown() {}
+
+static void start(bool bonded) {
+    ble_reconnect_init(&rc, &policy, &advertiser);
+    if (bonded) ble_reconnect_set_peer(&rc, host_addr, 0);
+    ble_reconnect_start(&rc, now);
+}
+
+// Poll every 10 ms for 'us', as loop() does; the host connects once it has
+// seen advertising it answers for connect_after_us
+static bool run_for(uint32_t us, bool answers_directed, bool answers_undirected,
+                    uint32_t connect_after_us) {
+    uint32_t seen_us = 0;
+    for (uint32_t t = 0; t < us; t += TICK_US) {
+        now += TICK_US;
+        ble_reconnect_poll(&rc, now);
+        bool answers = (fake.running == BLE_RECONNECT_DIRECTED) ? answers_directed
+                                                                : answers_undirected;
+        if (fake.running != BLE_RECONNECT_IDLE && answers) {
+            seen_us += TICK_US;
+            if (seen_us >= connect_after_us) {
+                fake.running = BLE_RECONNECT_IDLE;  // the controller stops on a connection
+                ble_reconnect_connected(&rc, now);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The bonded host in reach connects during the directed window, quickly
+void test_bonded_host_connects_directed() {
+    start(true);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_DIRECTED, rc.state);
+    TEST_ASSERT_EQUAL_MEMORY(host_addr, fake.addr, 6);
+
+    TEST_ASSERT_TRUE(run_for(BLE_RECONNECT_DIRECTED_WINDOW_US, true, true, 50000));
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_CONNECTED, rc.state);
+    TEST_ASSERT_EQUAL_UINT32(1, rc.stats.directed);
+    TEST_ASSERT_EQUAL_UINT32(50000, rc.stats.last_us);
+    TEST_ASSERT_EQUAL_UINT32(0, fake.undirected_calls);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_IDLE, fake.running);
+}
+
+// A host which does not answer directed advertising (e.g. another machine of
+// the user) connects in the fast phase, after the directed windows
+void test_fallback_to_fast() {
+    policy.directed_windows = 2;
+    start(true);
+    TEST_ASSERT_TRUE(run_for(10000000, false, true, 200000));
+    TEST_ASSERT_EQUAL_UINT32(2, fake.directed_calls);
+    TEST_ASSERT_EQUAL_UINT32(1, fake.undirected_calls);
+    TEST_ASSERT_EQUAL(policy.fast_min_interval, fake.min_interval);
+    TEST_ASSERT_EQUAL(policy.fast_max_interval, fake.max_interval);
+    TEST_ASSERT_EQUAL_UINT32(1, rc.stats.fast);
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, 2 * BLE_RECONNECT_DIRECTED_WINDOW_US + 200000,
+                              rc.stats.last_us);
+}
+
+// Without a bonded host, or when the stack refuses directed advertising,
+// undirected advertising starts right away
+void test_no_peer_or_refused_directed() {
+    start(false);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_FAST, rc.state);
+    TEST_ASSERT_EQUAL_UINT32(0, fake.directed_calls);
+
+    memset(&fake, 0, sizeof(fake));
+    fake.refuse_directed = true;
+    start(true);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_FAST, rc.state);
+    TEST_ASSERT_EQUAL_UINT32(1, fake.directed_calls);
+    TEST_ASSERT_EQUAL_UINT32(1, fake.undirected_calls);
+}
+
+// The slow phase follows the fast one and, with a time limit, ends with
+// advertising stopped; no host means no reconnection time
+void test_slow_phase_and_give_up() {
+    policy.fast_us = 2000000;
+    policy.slow_us = 3000000;
+    start(true);
+    TEST_ASSERT_FALSE(run_for(BLE_RECONNECT_DIRECTED_WINDOW_US + policy.fast_us + TICK_US,
+                              false, false, 0));
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_SLOW, rc.state);
+    TEST_ASSERT_EQUAL(policy.slow_min_interval, fake.min_interval);
+
+    TEST_ASSERT_FALSE(run_for(policy.slow_us, false, false, 0));
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_STOPPED, rc.state);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_IDLE, fake.running);
+    TEST_ASSERT_EQUAL_UINT32(1, rc.stats.gave_up);
+    TEST_ASSERT_EQUAL_UINT32(0, rc.stats.last_us);
+
+    // a stack which refuses all advertising gives up at once
+    memset(&fake, 0, sizeof(fake));
+    fake.refuse_directed = fake.refuse_undirected = true;
+    start(true);
+    TEST_ASSERT_EQUAL(BLE_RECONNECT_STOPPED, rc.state);
+}
+
+// Every link loss is a new attempt; the maximum time to reconnect is kept
+void test_repeated_link_loss() {
+    start(true);
+    TEST_ASSERT_TRUE(run_for(BLE_RECONNECT_DIRECTED_WINDOW_US, true, true, 30000));
+    ble_reconnect_start(&rc, now);
+    TEST_ASSERT_TRUE(run_for(10000000, false, true, 500000));
+    ble_reconnect_start(&rc, now);
+    TEST_ASSERT_TRUE(run_for(BLE_RECONNECT_DIRECTED_WINDOW_US, true, true, 20000));
+
+    TEST_ASSERT_EQUAL_UINT32(3, rc.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(2, rc.stats.directed);
+    TEST_ASSERT_EQUAL_UINT32(1, rc.stats.fast);
+    TEST_ASSERT_EQUAL_UINT32(20000, rc.stats.last_us);
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, BLE_RECONNECT_DIRECTED_WINDOW_US + 500000, rc.stats.max_us);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bonded_host_connects_directed);
+    RUN_TEST(test_fallback_to_fast);
+    RUN_TEST(test_no_peer_or_refused_directed);
+    RUN_TEST(test_slow_phase_and_give_up);
+    RUN_TEST(test_repeated_link_loss);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+#include <unity.h>
+#include <stdio.h>
+#include "usb_hid_report_desc.h"
+#include "hid_test_descriptors.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Report descriptor parser: field table of a receiver with several report
+ * IDs and Push/Pop, then parse time and table memory over the descriptor
+ * corpus of test/support.
+ */
+
+static hid_report_map_t map;
+
+void setUp() {}
+
+void tearDown() {}
+
+static const hid_report_field_t* find_input(uint8_t report_id, uint16_t page, uint16_t usage,
+                                            int* bit_offset) {
+    return hid_report_find_usage(&map, HID_FIELD_TYPE_INPUT, report_id, page, usage, bit_offset);
+}
+
+void test_combo_receiver_reports() {
+    TEST_ASSERT_TRUE(hid_parse_report_descriptor(desc_combo_receiver, sizeof(desc_combo_receiver),
+                                                 &map));
+    TEST_ASSERT_TRUE(map.uses_report_ids);
+    TEST_ASSERT_EQUAL(3, map.report_count);
+
+    const hid_report_info_t* keyboard = hid_report_find_info(&map, 1);
+    const hid_report_info_t* mouse = hid_report_find_info(&map, 2);
+    const hid_report_info_t* consumer = hid_report_find_info(&map, 3);
+    TEST_ASSERT_NOT_NULL(keyboard);
+    TEST_ASSERT_NOT_NULL(mouse);
+    TEST_ASSERT_NOT_NULL(consumer);
+    TEST_ASSERT_EQUAL_HEX16(0x06, keyboard->app_usage);
+    TEST_ASSERT_EQUAL_HEX16(0x02, mouse->app_usage);
+    TEST_ASSERT_EQUAL_HEX16(0x0C, consumer->app_usage_page);
+    TEST_ASSERT_EQUAL(56, keyboard->input_bits);
+    TEST_ASSERT_EQUAL(52, mouse->input_bits);
+    TEST_ASSERT_EQUAL(16, consumer->input_bits);
+    TEST_ASSERT_NULL(hid_report_find_info(&map, 4));
+}
+
+void test_combo_receiver_mouse_fields() {
+    hid_parse_report_descriptor(desc_combo_receiver, sizeof(desc_combo_receiver), &map);
+
+    // offsets count the report ID byte
+    int off = -1;
+    const hid_report_field_t* f = find_input(2, 0x09, 5, &off);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(12, off);
+
+    f = find_input(2, 0x01, 0x31, &off);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(28, off);
+    TEST_ASSERT_EQUAL(12, f->size);
+    TEST_ASSERT_EQUAL(-2047, f->logical_min);
+
+    // wheel with the globals pushed and changed
+    f = find_input(2, 0x01, 0x38, &off);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(40, off);
+    TEST_ASSERT_EQUAL(8, f->size);
+    TEST_ASSERT_EQUAL(-127, f->logical_min);
+
+    // AC Pan after Pop: 12 bit and -2047..2047 again
+    f = find_input(2, 0x0C, 0x238, &off);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(48, off);
+    TEST_ASSERT_EQUAL(12, f->size);
+    TEST_ASSERT_EQUAL(-2047, f->logical_min);
+    TEST_ASSERT_EQUAL(2047, f->logical_max);
+
+    // usages are looked up per report ID
+    TEST_ASSERT_NULL(find_input(1, 0x01, 0x30, NULL));
+    TEST_ASSERT_NOT_NULL(find_input(1, 0x07, 0xE1, NULL));
+    TEST_ASSERT_NOT_NULL(find_input(3, 0x0C, 0xE9, NULL));
+}
+
+// Parse time and table memory of every descriptor of the corpus
+void bench_parse_corpus() {
+    printf("%-20s %5s %7s %7s %11s\n", "descriptor", "bytes", "reports", "fields", "table bytes");
+    for (size_t i = 0; i < HID_TEST_DESCRIPTOR_COUNT; i++) {
+        const hid_test_descriptor_t* d = &hid_test_descriptors[i];
+        TEST_ASSERT_TRUE(hid_parse_report_descriptor(d->desc, d->len, &map));
+        size_t used = map.report_count * sizeof(hid_report_info_t) +
+                      map.field_count * sizeof(hid_report_field_t);
+        printf("%-20s %5u %7u %7u %11u\n", d->name, (unsigned)d->len, map.report_count,
+               map.field_count, (unsigned)used);
+    }
+    printf("table capacity %u bytes (%d reports, %d fields)\n", (unsigned)sizeof(map),
+           HID_REPORT_MAX_IDS, HID_REPORT_MAX_FIELDS);
+
+    char name[64];
+    for (size_t i = 0; i < HID_TEST_DESCRIPTOR_COUNT; i++) {
+        const hid_test_descriptor_t* d = &hid_test_descriptors[i];
+        snprintf(name, sizeof(name), "parse %s", d->name);
+        bench_result_t r = bench_run(name, 100000, [&]() {
+            bench_consume(hid_parse_report_descriptor(d->desc, d->len, &map));
+        });
+        TEST_ASSERT_EQUAL(0, r.allocs_per_op);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_combo_receiver_reports);
+    RUN_TEST(test_combo_receiver_mouse_fields);
+    RUN_TEST(bench_parse_corpus);
+    return UNITY_END();
+}
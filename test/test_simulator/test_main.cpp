@@ -0,0 +1,109 @@
+#include <unity.h>
+#include "hid_sim.h"
+
+/*
+ * Report path from the USB mouse to the BLE host on a virtual clock, see
+ * hid_sim.h. Prints latency, queue depths and loss of every configuration:
+ *
+ *   pio test -e native -f test_simulator -v
+ */
+
+//                      name, report us, jitter, conn us, budget, buffers, sender us,
+//                      speed, click us, duration us, seed
+static const hid_sim_config_t configs[] = {
+    {"125 Hz, 7.5 ms, budget 2", 8000, 0, 7500, 2, 4, 50, 2000, 100000, 2000000, 1},
+    {"125 Hz, 15 ms, budget 1", 8000, 0, 15000, 1, 4, 50, 2000, 100000, 2000000, 2},
+    {"1 kHz, 7.5 ms, budget 6", 1000, 0, 7500, 6, 8, 50, 4000, 50000, 2000000, 3},
+    {"1 kHz, 7.5 ms, budget 2", 1000, 0, 7500, 2, 4, 50, 4000, 50000, 2000000, 4},
+    {"1 kHz, 15 ms, budget 1", 1000, 0, 15000, 1, 2, 50, 4000, 50000, 2000000, 5},
+    {"1 kHz +-400 us, 7.5 ms, b 3", 1000, 400, 7500, 3, 4, 50, 4000, 50000, 2000000, 6},
+    {"1 kHz +-400 us, 15 ms, b 1", 1000, 400, 15000, 1, 2, 200, 4000, 30000, 2000000, 7},
+    {"1 kHz, 7.5 ms, slow sender", 1000, 0, 7500, 2, 4, 3000, 4000, 50000, 2000000, 8},
+};
+
+static const size_t config_count = sizeof(configs) / sizeof(configs[0]);
+
+static hid_sim_result_t results[sizeof(configs) / sizeof(configs[0])];
+
+void setUp() {}
+
+void tearDown() {}
+
+static void run_all() {
+    static bool done = false;
+    if (done) return;
+    hid_sim_print_header();
+    for (size_t i = 0; i < config_count; i++) {
+        hid_sim_run(&configs[i], &results[i]);
+        hid_sim_print(&configs[i], &results[i]);
+    }
+    done = true;
+}
+
+// Merging under congestion delays motion, but none of it is lost
+void test_no_motion_loss() {
+    run_all();
+    for (size_t i = 0; i < config_count; i++) {
+        const hid_sim_result_t* r = &results[i];
+        TEST_ASSERT_TRUE_MESSAGE(r->reports > 0, configs[i].name);
+        TEST_ASSERT_TRUE_MESSAGE(r->motion_in_x == r->motion_out_x, configs[i].name);
+        TEST_ASSERT_TRUE_MESSAGE(r->motion_in_y == r->motion_out_y, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r->ring_overflows, configs[i].name);
+    }
+}
+
+// Clicks far apart from each other always reach the host
+void test_no_click_loss() {
+    run_all();
+    for (size_t i = 0; i < config_count; i++) {
+        const hid_sim_result_t* r = &results[i];
+        TEST_ASSERT_TRUE_MESSAGE(r->clicks_in > 0, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(r->clicks_in, r->clicks_out, configs[i].name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r->clicks_lost, configs[i].name);
+    }
+}
+
+// Motion waits behind the notifications in the stack buffers and for at most
+// two more connection events, however many reports come in
+void test_latency_bounded() {
+    run_all();
+    for (size_t i = 0; i < config_count; i++) {
+        const hid_sim_config_t* cfg = &configs[i];
+        const hid_sim_result_t* r = &results[i];
+        uint32_t events = (cfg->stack_buffers + cfg->notify_budget - 1) / cfg->notify_budget + 2;
+        uint32_t bound =
+            events * cfg->conn_interval_us + cfg->sender_delay_us + cfg->report_interval_us;
+        TEST_ASSERT_TRUE_MESSAGE(r->motion_latency.total > 0, configs[i].name);
+        TEST_ASSERT_TRUE_MESSAGE(hid_latency_hist_percentile(&r->motion_latency, 990) <= bound,
+                                 configs[i].name);
+    }
+}
+
+// With fewer notifications than reports, reports are merged instead of queued up
+void test_congestion_merges() {
+    run_all();
+    const hid_sim_result_t* r = &results[4];  // 1 kHz over 1 notification per 15 ms
+    TEST_ASSERT_TRUE(r->notifications < r->reports / 4);
+    TEST_ASSERT_TRUE(r->merged > 0);
+    TEST_ASSERT_TRUE(r->link_high_water <= configs[4].stack_buffers);
+}
+
+// Same configuration, same result
+void test_deterministic() {
+    run_all();
+    hid_sim_result_t again;
+    hid_sim_run(&configs[5], &again);
+    TEST_ASSERT_EQUAL(results[5].notifications, again.notifications);
+    TEST_ASSERT_EQUAL(results[5].motion_latency.max_us, again.motion_latency.max_us);
+    TEST_ASSERT_EQUAL(results[5].merged, again.merged);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_motion_loss);
+    RUN_TEST(test_no_click_loss);
+    RUN_TEST(test_latency_bounded);
+    RUN_TEST(test_congestion_merges);
+    RUN_TEST(test_deterministic);
+    return UNITY_END();
+}
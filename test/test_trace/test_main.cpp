@@ -0,0 +1,182 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "hid_trace.h"
+#include "usb_hid_host.h"
+#include "bench.h"
+#include "bench_alloc.h"
+
+/*
+ * Trace ring and the record decoder shared by the drain task and host
+ * tools: console text of every record type, category masks, dropped
+ * records, two writers, and the cost of a record against formatting in the
+ * report path.
+ */
+
+#define WRITER_RECORDS 100000u
+
+void setUp() {
+    hid_trace_init();
+    hid_trace_set_mask(HID_TRACE_CAT_ALL);
+}
+
+void tearDown() {}
+
+// Everything in the ring as the drain task would print it
+static size_t drain_text(char* text, size_t size) {
+    hid_trace_record_t rec;
+    size_t used = 0;
+    text[0] = '\0';
+    while (hid_trace_read(&rec)) {
+        used += hid_trace_format(&rec, text + used, size - used);
+    }
+    return used;
+}
+
+void test_format_records() {
+    char text[256];
+    unified_hidData_t hidData;
+    memset(&hidData, 0, sizeof(hidData));
+    hidData.buttons.val = 0x05;  // left and middle
+    hidData.x_displacement = 5;
+    hidData.y_displacement = -300;
+    hidData.scroll_wheel = -1;
+    TEST_ASSERT_TRUE(hid_trace_write(HID_TRACE_CAT_MOUSE, HID_TRACE_REC_HIDDATA, &hidData,
+                                     sizeof(hidData)));
+    drain_text(text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("X: 000005\tY: -00300\t|L|M| |\t-1\n", text);
+
+    uint8_t proto = 3;
+    hid_trace_write(HID_TRACE_CAT_DEVICE, HID_TRACE_REC_HEADER, &proto, 1);
+    hid_trace_write(HID_TRACE_CAT_KEYBOARD, HID_TRACE_REC_TEXT, "ab\r\n", 4);
+    drain_text(text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("\r\nJoystick/Gamepad\r\nab\r\n", text);
+}
+
+// A raw report longer than one record is split, the line ends with the last record
+void test_raw_dump_split() {
+    uint8_t report[2 * HID_TRACE_PAYLOAD + 5];
+    char expected[2 * sizeof(report) + 2];
+    for (size_t i = 0; i < sizeof(report); i++) {
+        report[i] = (uint8_t)(i * 17);
+        snprintf(expected + 2 * i, 3, "%02X", report[i]);
+    }
+    strcat(expected, "\n");
+
+    TEST_ASSERT_TRUE(hid_trace_write_raw(HID_TRACE_CAT_RAW, report, sizeof(report)));
+    char text[256];
+    drain_text(text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+}
+
+void test_mask_and_dropped() {
+    uint8_t proto = 2;
+    hid_trace_set_mask(HID_TRACE_CAT_ALL & ~HID_TRACE_CAT_DEVICE);
+    TEST_ASSERT_FALSE(hid_trace_write(HID_TRACE_CAT_DEVICE, HID_TRACE_REC_HEADER, &proto, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, hid_trace_dropped());  // disabled is not dropped
+
+    for (int i = 0; i < HID_TRACE_RING_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(hid_trace_write(HID_TRACE_CAT_KEYBOARD, HID_TRACE_REC_TEXT, "x", 1));
+    }
+    TEST_ASSERT_FALSE(hid_trace_write(HID_TRACE_CAT_KEYBOARD, HID_TRACE_REC_TEXT, "y", 1));
+    TEST_ASSERT_EQUAL_UINT32(1, hid_trace_dropped());
+
+    char text[HID_TRACE_RING_CAPACITY + 1];
+    TEST_ASSERT_EQUAL(HID_TRACE_RING_CAPACITY, drain_text(text, sizeof(text)));
+    TEST_ASSERT_NULL(strchr(text, 'y'));
+}
+
+// Unknown record types still produce a line, so a decoder never stops on them
+void test_unknown_type() {
+    hid_trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = 42;
+    char text[64];
+    hid_trace_format(&rec, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("[trace record type 42]\n", text);
+
+    // truncated to the buffer, always terminated
+    TEST_ASSERT_EQUAL(7, hid_trace_format(&rec, text, 8));
+    TEST_ASSERT_EQUAL_STRING("[trace ", text);
+}
+
+// USB task and sender task write while the drain task reads: every record
+// arrives intact or is counted as dropped, and each writer's records stay in order
+void test_two_writers() {
+    std::atomic<int> done(0);
+    auto writer = [&done](uint8_t id) {
+        uint8_t data[HID_TRACE_PAYLOAD];
+        for (uint32_t seq = 0; seq < WRITER_RECORDS; seq++) {
+            memset(data, id, sizeof(data));
+            memcpy(data, &seq, sizeof(seq));
+            hid_trace_write(HID_TRACE_CAT_RAW, HID_TRACE_REC_RAW, data, sizeof(data));
+            if ((seq & 63) == 0) std::this_thread::yield();
+        }
+        done.fetch_add(1);
+    };
+    std::thread a(writer, 1), b(writer, 2);
+
+    uint32_t received = 0, errors = 0;
+    int64_t last[3] = {-1, -1, -1};
+    hid_trace_record_t rec;
+    while (true) {
+        bool finished = done.load() == 2;
+        if (!hid_trace_read(&rec)) {
+            if (finished) break;
+            std::this_thread::yield();
+            continue;
+        }
+        uint8_t id = rec.data[HID_TRACE_PAYLOAD - 1];
+        uint32_t seq;
+        memcpy(&seq, rec.data, sizeof(seq));
+        bool intact = rec.length == HID_TRACE_PAYLOAD && (id == 1 || id == 2);
+        for (int i = sizeof(seq); intact && i < HID_TRACE_PAYLOAD; i++) intact = rec.data[i] == id;
+        if (!intact || (int64_t)seq <= last[id]) {
+            errors++;
+        } else {
+            last[id] = seq;
+        }
+        received++;
+    }
+    a.join();
+    b.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+    TEST_ASSERT_EQUAL_UINT32(2 * WRITER_RECORDS, received + hid_trace_dropped());
+}
+
+// What the report path pays: a record, against formatting the text in place
+void bench_record_vs_format() {
+    unified_hidData_t hidData;
+    memset(&hidData, 0, sizeof(hidData));
+    hidData.x_displacement = -12;
+    hidData.y_displacement = 7;
+    hid_trace_record_t rec;
+    char text[128];
+
+    bench_result_t record = bench_run("hid_trace_write hidData", 1000000, [&]() {
+        hid_trace_write(HID_TRACE_CAT_MOUSE, HID_TRACE_REC_HIDDATA, &hidData, sizeof(hidData));
+        hid_trace_read(&rec);  // the drain task's part, not on the report path
+    });
+    bench_result_t format = bench_run("snprintf hidData", 1000000, [&]() {
+        bench_consume(snprintf(text, sizeof(text), "X: %06d\tY: %06d\t|%c|%c|%c|\t%d\n",
+                               hidData.x_displacement, hidData.y_displacement, ' ', ' ', ' ',
+                               hidData.scroll_wheel));
+    });
+    printf("record instead of text: %.2fx faster, before any UART wait\n",
+           format.ns_per_op / record.ns_per_op);
+    TEST_ASSERT_EQUAL(0, record.allocs_per_op);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_format_records);
+    RUN_TEST(test_raw_dump_split);
+    RUN_TEST(test_mask_and_dropped);
+    RUN_TEST(test_unknown_type);
+    RUN_TEST(test_two_writers);
+    RUN_TEST(bench_record_vs_format);
+    return UNITY_END();
+}
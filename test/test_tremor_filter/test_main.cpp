@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "hid_tremor_filter.h"
+
+/*
+ * Tremor filter on traces modelled on recorded tremor: a slow or fast
+ * intended path with 4 to 8 Hz tremor and sensor noise on top, reported by a
+ * 125 Hz mouse in whole counts and not at all while it rests. Measured: the
+ * jitter left at slow speed, the lag added at fast speed against a moving
+ * average, and the distance after the pointer stops.
+ */
+
+#define REPORT_US 8000
+#define MOVING_AVERAGE 5
+
+// Settings of src/main.cpp: 1 Hz at rest, +0.02 Hz per count/s
+static const hid_tremor_filter_config_t tremor_cfg = {100, 200, 100};
+
+typedef struct {
+    uint32_t us;
+    int16_t dx;
+    int16_t dy;
+    double intended_x;  // position the hand aims at, at report time
+    double intended_y;
+} trace_report_t;
+
+static uint32_t random_state = 1;
+
+static double random_unit() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return (double)(random_state >> 8) / (1 << 24) - 0.5;
+}
+
+void setUp() { random_state = 1; }
+
+void tearDown() {}
+
+// Reports of a hand moving at speed_x/speed_y counts/s with tremor of the
+// given amplitude, for duration_us; whole counts are reported, the rest of a
+// count stays in the sensor
+static void make_trace(std::vector<trace_report_t>* trace, uint32_t start_us, uint32_t duration_us,
+                       double speed_x, double speed_y, double tremor, double* pos_x,
+                       double* pos_y) {
+    double sensor_x = floor(*pos_x), sensor_y = floor(*pos_y);
+    double freq_x = 4.0 + 4.0 * (random_unit() + 0.5);
+    double freq_y = 4.0 + 4.0 * (random_unit() + 0.5);
+    for (uint32_t t = REPORT_US; t <= duration_us; t += REPORT_US) {
+        double s = t / 1e6;
+        double ix = *pos_x + speed_x * s;
+        double iy = *pos_y + speed_y * s;
+        double rx = ix + tremor * sin(2 * M_PI * freq_x * s) + 0.3 * random_unit();
+        double ry = iy + tremor * sin(2 * M_PI * freq_y * s + 1.0) + 0.3 * random_unit();
+        trace_report_t r;
+        r.us = start_us + t;
+        r.dx = (int16_t)(floor(rx) - sensor_x);
+        r.dy = (int16_t)(floor(ry) - sensor_y);
+        r.intended_x = ix;
+        r.intended_y = iy;
+        if (r.dx == 0 && r.dy == 0) continue;  // a mouse does not report without motion
+        sensor_x += r.dx;
+        sensor_y += r.dy;
+        trace->push_back(r);
+    }
+    *pos_x += speed_x * duration_us / 1e6;
+    *pos_y += speed_y * duration_us / 1e6;
+}
+
+// Positions after every report of the trace, raw and filtered
+static void run_trace(const std::vector<trace_report_t>& trace, std::vector<double>* raw_x,
+                      std::vector<double>* out_x, std::vector<double>* out_y) {
+    hid_tremor_filter_t filter;
+    hid_tremor_filter_init(&filter, &tremor_cfg);
+    double rx = 0, ox = 0, oy = 0;
+    for (const trace_report_t& r : trace) {
+        int16_t dx = r.dx, dy = r.dy;
+        rx += r.dx;
+        hid_tremor_filter_apply(&filter, r.us, &dx, &dy);
+        ox += dx;
+        oy += dy;
+        if (raw_x) raw_x->push_back(rx);
+        if (out_x) out_x->push_back(ox);
+        if (out_y) out_y->push_back(oy);
+    }
+}
+
+// Deviation from the intended path once the constant offset (the lag at a
+// steady speed) is taken out
+static double jitter(const std::vector<trace_report_t>& trace, const std::vector<double>& pos,
+                     size_t from) {
+    double mean = 0, sq = 0;
+    size_t n = pos.size() - from;
+    for (size_t i = from; i < pos.size(); i++) mean += pos[i] - trace[i].intended_x;
+    mean /= n;
+    for (size_t i = from; i < pos.size(); i++) {
+        double e = pos[i] - trace[i].intended_x - mean;
+        sq += e * e;
+    }
+    return sqrt(sq / n);
+}
+
+// Slow motion with tremor: at least half of the jitter is removed
+void test_jitter_at_slow_speed() {
+    for (int round = 0; round < 5; round++) {
+        std::vector<trace_report_t> trace;
+        double x = 0, y = 0;
+        make_trace(&trace, 0, 3000000, 20, 0, 3.0, &x, &y);
+        std::vector<double> raw, out;
+        run_trace(trace, &raw, &out, NULL);
+
+        size_t settled = trace.size() / 3;
+        double raw_jitter = jitter(trace, raw, settled);
+        double out_jitter = jitter(trace, out, settled);
+        printf("slow, tremor 3 counts: jitter %.2f -> %.2f counts\n", raw_jitter, out_jitter);
+        TEST_ASSERT_TRUE(out_jitter < raw_jitter / 2);
+    }
+}
+
+// Mean distance behind the intended path over the steady part of a flick, in ms
+static double lag_ms(const std::vector<trace_report_t>& trace, const std::vector<double>& pos,
+                     double speed) {
+    double behind = 0;
+    size_t from = trace.size() / 2;
+    for (size_t i = from; i < pos.size(); i++) behind += trace[i].intended_x - pos[i];
+    return behind / (pos.size() - from) / speed * 1000.0;
+}
+
+// Fast motion: little lag is added, less than a moving average of 5 reports
+void test_lag_at_fast_speed() {
+    const double speed = 2000;
+    std::vector<trace_report_t> trace;
+    double x = 0, y = 0;
+    make_trace(&trace, 0, 300000, speed, 0, 3.0, &x, &y);
+    std::vector<double> raw, out;
+    run_trace(trace, &raw, &out, NULL);
+
+    // naive smoothing: the position averaged over the last reports
+    std::vector<double> averaged;
+    for (size_t i = 0; i < raw.size(); i++) {
+        double sum = 0;
+        for (size_t j = 0; j < MOVING_AVERAGE; j++) sum += (i >= j) ? raw[i - j] : 0;
+        averaged.push_back(sum / MOVING_AVERAGE);
+    }
+
+    double raw_lag = lag_ms(trace, raw, speed);
+    double filter_lag = lag_ms(trace, out, speed) - raw_lag;
+    double average_lag = lag_ms(trace, averaged, speed) - raw_lag;
+    printf("fast, %.0f counts/s: lag added %.1f ms, moving average %.1f ms\n", speed, filter_lag,
+           average_lag);
+    TEST_ASSERT_TRUE(filter_lag < 8.0);
+    TEST_ASSERT_TRUE(filter_lag < average_lag);
+}
+
+// The lag left when the hand stops is not lost: after a pause, the first
+// report brings the pointer to where the raw motion ended
+void test_lag_drained_after_pause() {
+    std::vector<trace_report_t> trace;
+    double x = 0, y = 0;
+    make_trace(&trace, 0, 500000, 300, -150, 1.0, &x, &y);
+    int32_t in_x = 0, in_y = 0;
+    for (const trace_report_t& r : trace) {
+        in_x += r.dx;
+        in_y += r.dy;
+    }
+    trace_report_t after = {trace.back().us + 200000, 1, 0, 0, 0};
+    trace.push_back(after);
+    in_x += 1;
+
+    std::vector<double> out_x, out_y;
+    run_trace(trace, NULL, &out_x, &out_y);
+    double lag_x = in_x - 1 - out_x[out_x.size() - 2];
+    printf("lag when the hand stopped: %.0f counts\n", lag_x);
+    TEST_ASSERT_TRUE(lag_x > 2);  // there was something to drain
+    TEST_ASSERT_INT_WITHIN(1, in_x, (int32_t)out_x.back());
+    TEST_ASSERT_INT_WITHIN(1, in_y, (int32_t)out_y.back());
+}
+
+// Without a cutoff the filter is off and reports pass unchanged
+void test_filter_off() {
+    hid_tremor_filter_config_t off = {0, 200, 100};
+    hid_tremor_filter_t filter;
+    hid_tremor_filter_init(&filter, &off);
+    for (uint32_t n = 1; n < 100; n++) {
+        int16_t dx = (int16_t)(n * 7 % 23) - 11, dy = -(int16_t)n;
+        int16_t x = dx, y = dy;
+        hid_tremor_filter_apply(&filter, n * REPORT_US, &dx, &dy);
+        TEST_ASSERT_EQUAL(x, dx);
+        TEST_ASSERT_EQUAL(y, dy);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_jitter_at_slow_speed);
+    RUN_TEST(test_lag_at_fast_speed);
+    RUN_TEST(test_lag_drained_after_pause);
+    RUN_TEST(test_filter_off);
+    return UNITY_END();
+}